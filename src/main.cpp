@@ -19,11 +19,33 @@
 #include <cstring>
 #include <iomanip>
 #include <cstdlib>
+#include <cstddef>
 #include "glext.h"
 #include "glInfo.h"                             // glInfo struct
 #include "Timer.h"
 #include "utils/algebra.h"
+#include "utils/timewarp_transform.h"
+#include "utils/pose_predictor.h"
+#include "utils/pose_replay.h"
+#include "utils/pose_handoff.h"
+#include "utils/pose_history.h"
+#include "utils/positional_warp.h"
+#include "utils/scanout.h"
 #include "utils/hmd.h"
+#include "utils/headless.h"
+#include "utils/cpu_warp.h"
+#include "utils/thread_pool.h"
+#include "utils/mesh_cache.h"
+#include "utils/adaptive_mesh.h"
+#include "utils/benchmark.h"
+#include "utils/vertex_cache.h"
+#include "utils/compact_mesh.h"
+#include "utils/fixed_mesh.h"
+#include "utils/distortion_lut.h"
+#include "utils/procedural_warp.h"
+#include "utils/tile_tuner.h"
+#include "utils/distortion_model.h"
+#include "utils/timewarp_arena.h"
 #include "image.h"
 
 using std::stringstream;
@@ -36,6 +58,8 @@ using std::ends;
 #define OPENGL_VERSION_MINOR    3
 #define GLSL_VERSION            "430 core"
 #define GLSL_EXTENSIONS         "#extension GL_EXT_shader_io_blocks : enable\n"
+#define GLSL_STRINGIFY_( x )    #x
+#define GLSL_STRINGIFY( x )     GLSL_STRINGIFY_( x )
 
 
 // GLUT CALLBACK functions ////////////////////////////////////////////////////
@@ -45,6 +69,7 @@ void timerCB(int millisec);
 void idleCB();
 void mouseCB(int button, int stat, int x, int y);
 void mouseMotionCB(int x, int y);
+void keyboardCB(unsigned char key, int x, int y);
 void init_images(const char* fname);
 
 // CALLBACK function when exit() called ///////////////////////////////////////
@@ -52,8 +77,46 @@ void exitCB();
 
 // function declearations /////////////////////////////////////////////////////
 void initGL();
+void initDistortionMeshBuffers();
 int  initGLUT(int argc, char **argv);
+bool initDisplayFramebuffer();
+void runHeadless(int frames);
+void runCpuWarp(int frames);
+void validateAgainstCpuWarp();
+void presentFrame();
+double updateLensSeparation(float lensSeparationInMeters);
+void uploadDistortionVertices();
+void setDistortionVertexAttribs();
+bool refitCompactMeshFormat();
+GLuint createDistortionLutTexture(const distortion_lut_t* lut);
+void drawDistortionLut(GLuint lutTexture);
+void runWarpBenchmark(int frames);
+double timeMeshWarp(const hmd_info_t* hmdInfo, int frames, double* positionalTimeOut, GLuint* numVerticesOut);
+void runTileTuner(float budget, int frames);
+void uploadProceduralWarpParams();
+void drawProceduralWarp();
+void validateProceduralWarp();
+void calculateTimeWarpTransforms(float renderTime, float time, scanout_transforms_t* scanout);
+void uploadScanoutTransforms(const scanout_transforms_t* scanout);
+void calculateTimeWarpTranslations(float renderTime, float time, ksVector3f* start, ksVector3f* end);
+void predictHeadPosition(double time, ksVector3f* position);
+void updateHeadPosePredictor(double time);
+void sampleHeadTracker(pose_sample_t* sample, double time);
+void recordHeadPose(const pose_sample_t* sample);
+void startHeadTracker();
+void stopHeadTracker();
+cpu_warp_mesh_t getCpuWarpMesh();
+bool writeFramebufferPPM(const char* fname, int width, int height);
+bool writePPM(const char* fname, const GLubyte* pixels, int width, int height, int channels);
 bool initSharedMem(const char* fname);
+bool initDistortionModel(const char* name, const hmd_info_t* hmdInfo);
+void loadOrBuildTimewarp(hmd_info_t* hmdInfo);
+void BuildTimewarp(hmd_info_t* hmdInfo, TimewarpArena* arena, ThreadPool* pool);
+void releaseTimewarpBuildData();
+void printDistortionMeshAcmr();
+void getUvToPixels(float uvToPixels[2]);
+bool chooseCompactMeshFormat();
+void getAdaptiveMeshParams(const hmd_info_t* hmdInfo, adaptive_mesh_params_t* params);
 void clearSharedMem();
 void drawString(const char *str, int x, int y, float color[4], void *font);
 void drawString3D(const char *str, float pos[3], float color[4], void *font);
@@ -74,13 +137,74 @@ const int   TEXT_WIDTH      = 8;
 const int   TEXT_HEIGHT     = 13;
 const int   TEXTURE_WIDTH   = 2560;  // NOTE: texture size cannot be larger than
 const int   TEXTURE_HEIGHT  = 1440;  // the rendering window size in non-FBO mode
-const int   NUM_EYES        = 2;
-const int   NUM_COLOR_CHANNELS = 3;
+const int   DEFAULT_HEADLESS_FRAMES = 1000;
+const int   ADAPTIVE_MESH_MAX_CELL  = 256;   // coarsest adaptive mesh cell, in display pixels
+const float LENS_SEPARATION_STEP    = 0.001f; // [ and ] keys, in meters
+const int   TILE_TUNER_MIN_PIXELS   = 8;     // tile edges the tuner tries, in display pixels
+const int   TILE_TUNER_MAX_PIXELS   = 256;
+const int   TILE_TUNER_TIMED_CANDIDATES = 8; // coarsest tilings within the error budget to time
+const int   DISTORTION_MODEL_GRID_SIZE  = 129; // samples per side of the --distortion-model=grid table
+const double SIMULATED_IMU_PERIOD    = 0.001; // seconds between samples of the simulated head tracker
+const double SIMULATED_IMU_HISTORY   = 0.05;  // how far back the simulated tracker starts, or restarts after a jump
+const float SCANOUT_SECONDS          = 0.1f;  // display refresh the transforms span (exaggerated)
+const float EYE_BUFFER_NEAR_Z        = 0.1f;  // near plane of basicProjection, its far plane is at infinity
+const double HEAD_VELOCITY_SECONDS   = 0.01;  // history span the head velocity for the scanout positions is taken over
+const GLuint SCANOUT_TRANSFORMS_BINDING = 1;  // uniform buffer binding of the ScanoutTransforms block (DistortionParameters has 0)
+
+// Which context/presentation backend main() brings up
+typedef enum
+{
+    DISPLAY_BACKEND_GLUT,           // windowed, presents with glutSwapBuffers()
+    DISPLAY_BACKEND_EGL,            // surfaceless, renders into displayFboId
+    DISPLAY_BACKEND_CPU             // no GL at all, warps with the CPU reference renderer
+} display_backend_t;
+
+// How the GL backends warp the eye buffer onto the display
+typedef enum
+{
+    WARP_MODE_MESH,                 // distortion mesh, UVs interpolated across the tiles
+    WARP_MODE_LUT,                  // full screen pass reading per-pixel UVs from distortion_lut_tex
+    WARP_MODE_PROCEDURAL            // the uniform mesh generated in the vertex shader, no vertex buffers
+} warp_mode_t;
 
 // global variables
+display_backend_t displayBackend;
+int headlessFrames;                 // number of frames to run with the EGL backend
+const char* headlessDumpFile;       // optional PPM dump of the last headless frame
+GLuint displayFboId;                // framebuffer the warp renders to (0 = window)
+GLuint displayColorRboId, displayDepthRboId;
+bool printFrameTimes;
+int cpuWarpThreads;                 // CPU reference renderer threads (0 = all cores)
+ThreadPool* workerPool;             // --threads pool for the whole process: CPU warp, mesh and LUT builds
+bool validateWarp;                  // compare the last GL frame with the CPU reference
+const char* meshCacheDir;           // distortion mesh cache directory (NULL = no cache)
+float adaptiveMeshTolerance;        // adaptive mesh error bound in eye buffer pixels (0 = uniform grid)
+float ipdSweepMeters;               // headless: move the lenses by this much every frame (0 = off)
+float compactMeshTolerance;         // max warp error of compact vertices in eye buffer pixels (0 = float vertices)
+bool runtimeMesh;                   // always build the mesh, even for a profile with a built-in one
+warp_mode_t warpMode;
+distortion_lut_format_t lutFormat;  // table format for WARP_MODE_LUT
+bool warpBenchmark;                 // headless: time the mesh and LUT warps at several display sizes
+float tileTunerBudget;              // headless: find the fastest tiling within this error in eye buffer pixels (0 = off)
+const char* distortionModelName;    // lens model replacing hmd_info.K, see distortion_model.h (NULL = the Catmull-Rom spline)
+distortion_model_t distortionModel;
+const distortion_model_t* lensModel; // &distortionModel once it is set up, else NULL
+pose_prediction_t posePrediction;   // how the scanout orientations are extrapolated from the head tracker
+pose_predictor_t headPosePredictor;
+bool sensorThread;                  // the head tracker publishes its samples from a thread of its own
+PoseHandoff headPoseHandoff;        // sensor thread to warp handoff
+SensorThread headTracker;
+LatencyStats poseReadStats;         // warp side of the handoff: time to take the new samples
+LatencyStats poseAgeStats;          // age of the newest sample when the warp takes it
+int poseReadRetries;                // seqlock reads that found the slot changing
+PoseHistory headPoseHistory;        // tracked head poses, for the pose each eye buffer was rendered with
+bool positionalWarp;                // mesh warp: reproject for the head translation with the eye buffer depth
+int scanoutSlices;                  // the warps lerp between scanoutSlices + 1 transforms across the scanout
+scanout_direction_t scanoutDirection;
 GLuint fboId;                       // ID of FBO
 GLuint textureId;                   // ID of texture
-GLuint rboColorId, rboDepthId;      // IDs of Renderbuffer objects
+GLuint rboColorId;                  // ID of Renderbuffer object
+GLuint depthTextureId;              // eye buffer depth, a layer per eye like textureId
 void *font = GLUT_BITMAP_8_BY_13;
 int screenWidth;
 int screenHeight;
@@ -131,21 +255,43 @@ GLuint num_distortion_vertices;
 GLuint num_distortion_indices;
 
 // Distortion mesh CPU buffers and GPU VBO handles
-mesh_coord3d_t* distortion_positions;
-GLuint distortion_positions_vbo;
+// (one interleaved {pos, uv0, uv1, uv2} vertex stream for both eyes)
+distortion_vertex_t* distortion_vertices;
+GLuint distortion_vertices_vbo;            // two regions, see uploadDistortionVertices()
+int distortion_vertices_region;             // the region displayCB() draws from
+GLsync distortion_vertices_fence[2];        // last draws from each region
 GLuint* distortion_indices;
 GLuint distortion_indices_vbo;
-uv_coord_t* distortion_uv0;
-GLuint distortion_uv0_vbo;
-uv_coord_t* distortion_uv1;
-GLuint distortion_uv1_vbo;
-uv_coord_t* distortion_uv2;
-GLuint distortion_uv2_vbo;
-
-// Handles to the start and end timewarp
-// transform matrices (3x4 uniforms)
-GLuint tw_start_transform_unif;
-GLuint tw_end_transform_unif;
+GLenum distortion_index_type;               // GL_UNSIGNED_SHORT whenever an eye's vertices fit
+GLsizei distortion_vertex_size;             // size of one vertex in distortion_vertices_vbo
+TimewarpArena timewarpArena;                // owns distortion_vertices and distortion_indices when they were built at runtime
+distortion_vertex_compact_t* distortion_vertices_compact;  // staging for the compact GPU copy, in timewarpArena; NULL = floats or released
+compact_mesh_format_t distortion_compact_format;
+mesh_cache_t distortion_mesh_cache;         // set when the CPU buffers above are mapped from disk
+const fixed_distortion_mesh_t* distortion_fixed_mesh;  // set while they point at a built-in read-only mesh
+
+// Per-pixel distortion lookup table and the full screen program reading it
+distortion_lut_t distortion_lut;            // CPU copy, only in WARP_MODE_LUT
+GLuint distortion_lut_tex;
+GLuint tw_lut_shader_program;
+GLuint tw_lut_vao;                          // no attributes, the triangle comes from gl_VertexID
+
+// Mesh-less warp: the lens parameters block and the program generating the mesh
+GLuint tw_procedural_shader_program;
+GLuint tw_procedural_vao;                   // no attributes, vertices come from gl_VertexID
+GLuint tw_procedural_params_ubo;            // procedural_warp_params_t
+
+// Positional warp: the mesh warp program, displaced by the head translation over the depth
+GLuint tw_positional_shader_program;
+GLuint tw_positional_start_translation_unif;
+GLuint tw_positional_end_translation_unif;
+
+// The timewarp transforms across the scanout, the ScanoutTransforms
+// block of all the warp programs
+GLuint tw_scanout_ubo;
+
+// Transforms used for the most recent frame
+scanout_transforms_t timeWarpScanout;
 
 // Basic perspective projection matrix
 ksMatrix4x4f basicProjection;
@@ -202,10 +348,29 @@ const char* const timeWarpSpatialFragmentProgramGLSL =
     "   outColor = vec4(fract(fragmentUv1.x * 4.), fract(fragmentUv1.y * 4.), 1.0, 1.0);\n"
     "}\n";
 
+// The timewarp transforms across the scanout, see scanout.h. Lerping the
+// transform gives the same UVs as lerping the UVs of the two transforms,
+// and it is done once for all three channels.
+#define TIMEWARP_SCANOUT_TRANSFORMS \
+  "layout( std140 ) uniform ScanoutTransforms\n" \
+  "{\n" \
+  " highp vec4 Scanout;\n"                                       /* display fraction plane over ( x, y, 1 ), slices */ \
+  " highp mat3x4 Transforms[" GLSL_STRINGIFY( SCANOUT_MAX_SLICES ) " + 1];\n" \
+  "};\n" \
+  "float ScanoutFraction( vec2 ndc )\n" \
+  "{\n" \
+  " return clamp( dot( Scanout.xyz, vec3( ndc, 1.0 ) ), 0.0, 1.0 );\n" \
+  "}\n" \
+  "mat3x4 ScanoutTransform( vec2 ndc )\n" \
+  "{\n" \
+  " float slice = ScanoutFraction( ndc ) * Scanout.w;\n" \
+  " int i = min( int( slice ), int( Scanout.w ) - 1 );\n" \
+  " return Transforms[i] + ( Transforms[i + 1] - Transforms[i] ) * ( slice - float( i ) );\n" \
+  "}\n"
+
 const char* const timeWarpChromaticVertexProgramGLSL =
   "#version " GLSL_VERSION "\n"
-  "uniform highp mat3x4 TimeWarpStartTransform;\n"
-  "uniform highp mat3x4 TimeWarpEndTransform;\n"
+  TIMEWARP_SCANOUT_TRANSFORMS
   "in highp vec3 vertexPosition;\n"
   "in highp vec2 vertexUv0;\n"
   "in highp vec2 vertexUv1;\n"
@@ -218,19 +383,11 @@ const char* const timeWarpChromaticVertexProgramGLSL =
   "{\n"
   " gl_Position = vec4( vertexPosition, 1.0 );\n"
   "\n"
-  " float displayFraction = vertexPosition.x * 0.5 + 0.5;\n"  // landscape left-to-right
+  " mat3x4 transform = ScanoutTransform( vertexPosition.xy );\n"
   "\n"
-  " vec3 startUv0 = vec4( vertexUv0, -1, 1 ) * TimeWarpStartTransform;\n"
-  " vec3 startUv1 = vec4( vertexUv1, -1, 1 ) * TimeWarpStartTransform;\n"
-  " vec3 startUv2 = vec4( vertexUv2, -1, 1 ) * TimeWarpStartTransform;\n"
-  "\n"
-  " vec3 endUv0 = vec4( vertexUv0, -1, 1 ) * TimeWarpEndTransform;\n"
-  " vec3 endUv1 = vec4( vertexUv1, -1, 1 ) * TimeWarpEndTransform;\n"
-  " vec3 endUv2 = vec4( vertexUv2, -1, 1 ) * TimeWarpEndTransform;\n"
-  "\n"
-  " vec3 curUv0 = mix( startUv0, endUv0, displayFraction );\n"
-  " vec3 curUv1 = mix( startUv1, endUv1, displayFraction );\n"
-  " vec3 curUv2 = mix( startUv2, endUv2, displayFraction );\n"
+  " vec3 curUv0 = vec4( vertexUv0, -1, 1 ) * transform;\n"
+  " vec3 curUv1 = vec4( vertexUv1, -1, 1 ) * transform;\n"
+  " vec3 curUv2 = vec4( vertexUv2, -1, 1 ) * transform;\n"
   "\n"
   " fragmentUv0 = curUv0.xy * ( 1.0 / max( curUv0.z, 0.00001 ) );\n"
   " fragmentUv1 = curUv1.xy * ( 1.0 / max( curUv1.z, 0.00001 ) );\n"
@@ -253,6 +410,195 @@ const char* const timeWarpChromaticFragmentProgramGLSL =
   " outColor.a = 1.0;\n"
   "}\n";
 
+// The positional warp: the chromatic vertex program, plus the head translation
+// of each UV over its depth (see positional_warp.h). One depth lookup at the
+// green rotation-only UV serves all three channels. Pairs with
+// timeWarpChromaticFragmentProgramGLSL.
+const char* const timeWarpPositionalVertexProgramGLSL =
+  "#version " GLSL_VERSION "\n"
+  TIMEWARP_SCANOUT_TRANSFORMS
+  "uniform highp vec3 TimeWarpStartTranslation;\n"
+  "uniform highp vec3 TimeWarpEndTranslation;\n"
+  "uniform highp float InverseNearZ;\n"
+  "uniform int ArrayLayer;\n"
+  "uniform highp sampler2DArray Depth;\n"
+  "in highp vec3 vertexPosition;\n"
+  "in highp vec2 vertexUv0;\n"
+  "in highp vec2 vertexUv1;\n"
+  "in highp vec2 vertexUv2;\n"
+  "out mediump vec2 fragmentUv0;\n"
+  "out mediump vec2 fragmentUv1;\n"
+  "out mediump vec2 fragmentUv2;\n"
+  "out gl_PerVertex { vec4 gl_Position; };\n"
+  "vec2 Reproject( vec3 uv, vec3 translation, float inverseW )\n"
+  "{\n"
+  " float inverseZ = uv.z * inverseW / max( 1.0 - translation.z * inverseW, 0.00001 );\n"
+  " vec3 h = uv + translation * inverseZ;\n"
+  " return h.xy * ( 1.0 / max( h.z, 0.00001 ) );\n"
+  "}\n"
+  "void main( void )\n"
+  "{\n"
+  " gl_Position = vec4( vertexPosition, 1.0 );\n"
+  "\n"
+  " mat3x4 transform = ScanoutTransform( vertexPosition.xy );\n"
+  "\n"
+  " vec3 curUv0 = vec4( vertexUv0, -1, 1 ) * transform;\n"
+  " vec3 curUv1 = vec4( vertexUv1, -1, 1 ) * transform;\n"
+  " vec3 curUv2 = vec4( vertexUv2, -1, 1 ) * transform;\n"
+  " vec3 translation = mix( TimeWarpStartTranslation, TimeWarpEndTranslation, ScanoutFraction( vertexPosition.xy ) );\n"
+  "\n"
+  " vec2 rotationUv1 = curUv1.xy * ( 1.0 / max( curUv1.z, 0.00001 ) );\n"
+  " float depth = textureLod( Depth, vec3( rotationUv1, ArrayLayer ), 0.0 ).r;\n"
+  " float inverseW = ( 1.0 - depth ) * InverseNearZ;\n"         // 1 / render view depth
+  "\n"
+  " fragmentUv0 = Reproject( curUv0, translation, inverseW );\n"
+  " fragmentUv1 = Reproject( curUv1, translation, inverseW );\n"
+  " fragmentUv2 = Reproject( curUv2, translation, inverseW );\n"
+  "}\n";
+
+// The LUT warp: one triangle covering the screen, and the vertex program's
+// timewarp done per fragment on the UVs of the pixel center.
+const char* const timeWarpLutVertexProgramGLSL =
+  "#version " GLSL_VERSION "\n"
+  "out gl_PerVertex { vec4 gl_Position; };\n"
+  "void main( void )\n"
+  "{\n"
+  " gl_Position = vec4( float( ( gl_VertexID & 1 ) * 4 - 1 ), float( ( gl_VertexID >> 1 ) * 4 - 1 ), 0.0, 1.0 );\n"
+  "}\n";
+
+const char* const timeWarpLutFragmentProgramGLSL =
+  "#version " GLSL_VERSION "\n"
+  TIMEWARP_SCANOUT_TRANSFORMS
+  "uniform int ArrayLayer;\n"
+  "uniform highp sampler2DArray Texture;\n"
+  "uniform highp sampler2DArray DistortionLut;\n"
+  "out lowp vec4 outColor;\n"
+  "void main()\n"
+  "{\n"
+  " ivec2 pixel = ivec2( gl_FragCoord.xy );\n"
+  " vec2 uv0 = texelFetch( DistortionLut, ivec3( pixel, 0 ), 0 ).xy;\n"
+  " vec2 uv1 = texelFetch( DistortionLut, ivec3( pixel, 1 ), 0 ).xy;\n"
+  " vec2 uv2 = texelFetch( DistortionLut, ivec3( pixel, 2 ), 0 ).xy;\n"
+  " if ( uv1.x > 1000.0 ) discard;\n"                        // DISTORTION_LUT_OUTSIDE
+  "\n"
+  " vec2 ndc = gl_FragCoord.xy / vec2( textureSize( DistortionLut, 0 ).xy ) * 2.0 - 1.0;\n"
+  " mat3x4 transform = ScanoutTransform( ndc );\n"
+  "\n"
+  " vec3 curUv0 = vec4( uv0, -1, 1 ) * transform;\n"
+  " vec3 curUv1 = vec4( uv1, -1, 1 ) * transform;\n"
+  " vec3 curUv2 = vec4( uv2, -1, 1 ) * transform;\n"
+  "\n"
+  " outColor.r = texture( Texture, vec3( curUv0.xy * ( 1.0 / max( curUv0.z, 0.00001 ) ), ArrayLayer ) ).r;\n"
+  " outColor.g = texture( Texture, vec3( curUv1.xy * ( 1.0 / max( curUv1.z, 0.00001 ) ), ArrayLayer ) ).g;\n"
+  " outColor.b = texture( Texture, vec3( curUv2.xy * ( 1.0 / max( curUv2.z, 0.00001 ) ), ArrayLayer ) ).b;\n"
+  " outColor.a = 1.0;\n"
+  "}\n";
+
+// The procedural warp: the uniform distortion mesh without any buffers. Each
+// vertex finds its grid point from gl_VertexID (six per tile, in the order of
+// BuildTimewarp()'s indices) and its eye from gl_InstanceID, then evaluates
+// the distortion the way EvaluateDistortion() does from the lens parameters
+// in the DistortionParameters block (see procedural_warp.h). The rest is the
+// chromatic vertex program; CAPTURE_MESH also outputs the mesh vertex for
+// transform feedback. Pairs with timeWarpChromaticFragmentProgramGLSL.
+#define TIMEWARP_PROCEDURAL_VERTEX_PROGRAM \
+  TIMEWARP_SCANOUT_TRANSFORMS \
+  "layout( std140 ) uniform DistortionParameters\n" \
+  "{\n" \
+  " ivec4 Tiles;\n"                                               /* tiles wide, tiles high, knots */ \
+  " vec4 Lens;\n"                                                 /* height scale, horizontal shift, meters per tan angle */ \
+  " vec4 NdcToMeters;\n"                                          /* ndc to pixels, pixels to meters */ \
+  " vec4 K[3];\n" \
+  " vec4 ChromaticAberration;\n" \
+  "};\n" \
+  "out mediump vec2 fragmentUv0;\n" \
+  "out mediump vec2 fragmentUv1;\n" \
+  "out mediump vec2 fragmentUv2;\n" \
+  "#ifdef CAPTURE_MESH\n" \
+  "out highp vec2 meshPosition;\n" \
+  "out highp vec2 meshUv0;\n" \
+  "out highp vec2 meshUv1;\n" \
+  "out highp vec2 meshUv2;\n" \
+  "#endif\n" \
+  "out gl_PerVertex { vec4 gl_Position; };\n" \
+  "float Knot( int i )\n" \
+  "{\n" \
+  " return K[i >> 2][i & 3];\n" \
+  "}\n" \
+  "float EvaluateCatmullRomSpline( float value )\n" \
+  "{\n" \
+  " int numKnots = Tiles.z;\n" \
+  " float scaledValue = float( numKnots - 1 ) * value;\n" \
+  " float scaledValueFloor = max( 0.0, min( float( numKnots - 1 ), floor( scaledValue ) ) );\n" \
+  " float t = scaledValue - scaledValueFloor;\n" \
+  " int k = int( scaledValueFloor );\n" \
+  " float p0, p1, m0, m1;\n" \
+  " if ( k == 0 )\n" \
+  " {\n" \
+  "  p0 = Knot( 0 ); m0 = Knot( 1 ) - Knot( 0 ); p1 = Knot( 1 ); m1 = 0.5 * ( Knot( 2 ) - Knot( 0 ) );\n" \
+  " }\n" \
+  " else if ( k < numKnots - 2 )\n" \
+  " {\n" \
+  "  p0 = Knot( k ); m0 = 0.5 * ( Knot( k + 1 ) - Knot( k - 1 ) ); p1 = Knot( k + 1 ); m1 = 0.5 * ( Knot( k + 2 ) - Knot( k ) );\n" \
+  " }\n" \
+  " else if ( k == numKnots - 2 )\n" \
+  " {\n" \
+  "  p0 = Knot( k ); m0 = 0.5 * ( Knot( k + 1 ) - Knot( k - 1 ) ); p1 = Knot( k + 1 ); m1 = Knot( k + 1 ) - Knot( k );\n" \
+  " }\n" \
+  " else\n" \
+  " {\n" \
+  "  p0 = Knot( k ); m0 = Knot( k ) - Knot( k - 1 ); p1 = p0 + m0; m1 = m0;\n" \
+  " }\n" \
+  " float omt = 1.0 - t;\n" \
+  " return ( p0 * ( 1.0 + 2.0 * t ) + m0 * t ) * omt * omt + ( p1 * ( 1.0 + 2.0 * omt ) - m1 * omt ) * t * t;\n" \
+  "}\n" \
+  "void main( void )\n" \
+  "{\n" \
+  " const ivec2 corners[6] = ivec2[6]( ivec2( 0, 0 ), ivec2( 0, 1 ), ivec2( 1, 0 ), ivec2( 1, 0 ), ivec2( 0, 1 ), ivec2( 1, 1 ) );\n" \
+  " int tile = gl_VertexID / 6;\n" \
+  " ivec2 grid = ivec2( tile % Tiles.x, tile / Tiles.x ) + corners[gl_VertexID % 6];\n" \
+  " int eye = gl_InstanceID;\n" \
+  " float xf = float( grid.x ) / float( Tiles.x );\n" \
+  " float yf = 1.0 - float( grid.y ) / float( Tiles.y );\n" \
+  " vec2 position = vec2( -1.0 + float( eye ) + xf,\n" \
+  "                       -1.0 + 2.0 * ( ( float( Tiles.y ) - float( grid.y ) ) / float( Tiles.y ) ) * Lens.x );\n" \
+  "\n" \
+  " vec2 unit = vec2( ( eye == 0 ? Lens.y : -Lens.y ) + xf, yf );\n" \
+  " vec2 theta = ( ( 2.0 * unit - 1.0 ) * NdcToMeters.xy * NdcToMeters.zw ) / Lens.z;\n" \
+  " float rsq = theta.x * theta.x + theta.y * theta.y;\n" \
+  " float scale = EvaluateCatmullRomSpline( rsq );\n" \
+  " vec2 vertexUv0 = scale * ( 1.0 + ChromaticAberration.x + rsq * ChromaticAberration.y ) * theta;\n" \
+  " vec2 vertexUv1 = scale * theta;\n" \
+  " vec2 vertexUv2 = scale * ( 1.0 + ChromaticAberration.z + rsq * ChromaticAberration.w ) * theta;\n" \
+  "#ifdef CAPTURE_MESH\n" \
+  " meshPosition = position;\n" \
+  " meshUv0 = vertexUv0;\n" \
+  " meshUv1 = vertexUv1;\n" \
+  " meshUv2 = vertexUv2;\n" \
+  "#endif\n" \
+  "\n" \
+  " gl_Position = vec4( position, 0.0, 1.0 );\n" \
+  "\n" \
+  " mat3x4 transform = ScanoutTransform( position );\n" \
+  "\n" \
+  " vec3 curUv0 = vec4( vertexUv0, -1, 1 ) * transform;\n" \
+  " vec3 curUv1 = vec4( vertexUv1, -1, 1 ) * transform;\n" \
+  " vec3 curUv2 = vec4( vertexUv2, -1, 1 ) * transform;\n" \
+  "\n" \
+  " fragmentUv0 = curUv0.xy * ( 1.0 / max( curUv0.z, 0.00001 ) );\n" \
+  " fragmentUv1 = curUv1.xy * ( 1.0 / max( curUv1.z, 0.00001 ) );\n" \
+  " fragmentUv2 = curUv2.xy * ( 1.0 / max( curUv2.z, 0.00001 ) );\n" \
+  "}\n"
+
+const char* const timeWarpProceduralVertexProgramGLSL =
+  "#version " GLSL_VERSION "\n"
+  TIMEWARP_PROCEDURAL_VERTEX_PROGRAM;
+
+const char* const timeWarpProceduralCaptureVertexProgramGLSL =
+  "#version " GLSL_VERSION "\n"
+  "#define CAPTURE_MESH\n"
+  TIMEWARP_PROCEDURAL_VERTEX_PROGRAM;
+
 const char* const timeWarpChromaticFragmentDebugProgramGLSL =
   "#version " GLSL_VERSION "\n"
   "uniform int ArrayLayer;\n"
@@ -288,9 +634,14 @@ const char* const basicVertexShader =
         "   vUV = vertexUV;\n"
         "}\n";
 
+// The prerendered image has no depth, so the plane gets the depth of a
+// floor receding from the bottom of the eye buffer to the top, for the
+// positional warp. It only lands in the depth buffer with the depth test on.
 const char* const basicFragmentShader =
         "#version " GLSL_VERSION "\n"
         "uniform highp sampler2D Texture;\n"
+        "uniform highp vec2 SceneInverseDepth;\n"      // 1 / view depth at the bottom and top edges
+        "uniform highp float NearZ;\n"
         "in vec2 vUV;\n"
         "out lowp vec4 outcolor;\n"
         "void main()\n"
@@ -298,6 +649,7 @@ const char* const basicFragmentShader =
         "   outcolor = vec4(vUV.x, vUV.y, 1.0, 1.0);\n"
         //"   outcolor = vec4(0.0,0.0,0.0, 1.0);\n"
         "     outcolor = texture(Texture, vUV);\n"
+        "   gl_FragDepth = 1.0 - NearZ * mix(SceneInverseDepth.x, SceneInverseDepth.y, vUV.y);\n"
         "}\n";
 
 
@@ -324,7 +676,7 @@ GLfloat plane_uvs[8] = {  // UVs for plane
 GLuint plane_indices[6] = {  // Plane indices
           0,2,3, 1,0,3 };
 
-void GetHmdViewMatrixForTime( ksMatrix4x4f * viewMatrix, float time )
+void GetHmdOrientationForTime( ksQuatf * orientation, float time )
 {
 
     // FIXME: use double?
@@ -333,91 +685,65 @@ void GetHmdViewMatrixForTime( ksMatrix4x4f * viewMatrix, float time )
     const float degreesX = sinf( offset ) * degrees;
     const float degreesY = cosf( offset ) * degrees;
 
-    ksMatrix4x4f_CreateRotation( viewMatrix, degreesX, degreesY, 0.0f );
+    CreateRotationQuaternion( orientation, degreesX, degreesY, 0.0f );
 }
 
-void BuildDistortionMeshes( mesh_coord2d_t * distort_coords[NUM_EYES][NUM_COLOR_CHANNELS], hmd_info_t * hmdInfo )
+void GetHmdPositionForTime( ksVector3f * position, float time )
 {
-    const float horizontalShiftMeters = ( hmdInfo->lensSeparationInMeters / 2 ) - ( hmdInfo->visibleMetersWide / 4 );
-    const float horizontalShiftView = horizontalShiftMeters / ( hmdInfo->visibleMetersWide / 2 );
-
-    for ( int eye = 0; eye < NUM_EYES; eye++ )
-    {
-        for ( int y = 0; y <= hmdInfo->eyeTilesHigh; y++ )
-        {
-            const float yf = 1.0f - (float)y / (float)hmdInfo->eyeTilesHigh;
+    // Swaying side to side and leaning in and out a little.
+    position->x = sinf( time * 1.5f ) * 0.1f;
+    position->y = 0.0f;
+    position->z = sinf( time * 0.7f ) * 0.05f;
+}
 
-            for ( int x = 0; x <= hmdInfo->eyeTilesWide; x++ )
-            {
-                const float xf = (float)x / (float)hmdInfo->eyeTilesWide;
-
-                const float in[2] = { ( eye ? -horizontalShiftView : horizontalShiftView ) + xf, yf };
-                const float ndcToPixels[2] = { hmdInfo->visiblePixelsWide * 0.25f, hmdInfo->visiblePixelsHigh * 0.5f };
-                const float pixelsToMeters[2] = { hmdInfo->visibleMetersWide / hmdInfo->visiblePixelsWide, hmdInfo->visibleMetersHigh / hmdInfo->visiblePixelsHigh };
-
-                float theta[2];
-                for ( int i = 0; i < 2; i++ )
-                {
-                    const float unit = in[i];
-                    const float ndc = 2.0f * unit - 1.0f;
-                    const float pixels = ndc * ndcToPixels[i];
-                    const float meters = pixels * pixelsToMeters[i];
-                    const float tanAngle = meters / hmdInfo->metersPerTanAngleAtCenter;
-                    theta[i] = tanAngle;
-                }
-
-                const float rsq = theta[0] * theta[0] + theta[1] * theta[1];
-                const float scale = EvaluateCatmullRomSpline( rsq, hmdInfo->K, hmdInfo->numKnots );
-                const float chromaScale[NUM_COLOR_CHANNELS] =
-                {
-                    scale * ( 1.0f + hmdInfo->chromaticAberration[0] + rsq * hmdInfo->chromaticAberration[1] ),
-                    scale,
-                    scale * ( 1.0f + hmdInfo->chromaticAberration[2] + rsq * hmdInfo->chromaticAberration[3] )
-                };
-
-                const int vertNum = y * ( hmdInfo->eyeTilesWide + 1 ) + x;
-                for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
-                {
-                    distort_coords[eye][channel][vertNum].x = chromaScale[channel] * theta[0];
-                    distort_coords[eye][channel][vertNum].y = chromaScale[channel] * theta[1];
-                }
-            }
+void BuildTimewarp(hmd_info_t* hmdInfo, TimewarpArena* arena, ThreadPool* pool){
+
+    if (adaptiveMeshTolerance > 0.0f) {
+        adaptive_mesh_params_t params;
+        adaptive_mesh_stats_t stats;
+        getAdaptiveMeshParams(hmdInfo, &params);
+        if (BuildAdaptiveDistortionMesh(hmdInfo, &params, arena, &stats)) {
+            distortion_vertices = arena->getVertices();
+            distortion_indices = arena->getIndices();
+            num_distortion_vertices = stats.numVertices;
+            num_distortion_indices = stats.numIndices;
+            printf("Adaptive mesh: %d vertices, %d triangles per eye, max error %.3f pixels (bound %.3f, cells down to %d pixels)\n",
+                   stats.numVertices, stats.numIndices / 3, stats.maxError, params.tolerancePixels, params.minCellPixels);
+            if (stats.maxError > params.tolerancePixels)
+                fprintf(stderr, "WARNING: the adaptive mesh misses its error bound: %.3f pixels > %.3f even with %d pixel cells\n",
+                        stats.maxError, params.tolerancePixels, params.minCellPixels);
+            printf("Uniform %dx%d grid: %d vertices, %d triangles, max error %.3f pixels\n",
+                   hmdInfo->eyeTilesWide, hmdInfo->eyeTilesHigh, stats.uniformVertices, stats.uniformIndices / 3, stats.uniformMaxError);
+            printf("Uniform grid as fine as the adaptive one: %d vertices, %d triangles (adaptive saves %.1f%% of the triangles)\n",
+                   stats.matchedUniformVertices, stats.matchedUniformIndices / 3,
+                   100.0f * (1.0f - (float)stats.numIndices / stats.matchedUniformIndices));
+            // Its triangles come out cell by cell, so they need reordering for the vertex cache.
+            OptimizeVertexCache(distortion_indices, num_distortion_indices, num_distortion_vertices);
+            return;
         }
+        fprintf(stderr, "Adaptive mesh build failed, using the uniform grid\n");
     }
-}
-
-void BuildTimewarp(hmd_info_t* hmdInfo){
 
     // Calculate the number of vertices+indices in the distortion mesh.
     num_distortion_vertices = ( hmdInfo->eyeTilesHigh + 1 ) * ( hmdInfo->eyeTilesWide + 1 );
     num_distortion_indices = hmdInfo->eyeTilesHigh * hmdInfo->eyeTilesWide * 6;
 
-    // Allocate memory for the elements/indices array.
-    distortion_indices = (GLuint*) malloc(num_distortion_indices * sizeof(GLuint));
-
-    // This is just a simple grid/plane index array, nothing fancy.
-    // Same for both eye distortions, too!
-    for ( int y = 0; y < hmdInfo->eyeTilesHigh; y++ )
-    {
-        for ( int x = 0; x < hmdInfo->eyeTilesWide; x++ )
-        {
-            const int offset = ( y * hmdInfo->eyeTilesWide + x ) * 6;
-
-            distortion_indices[offset + 0] = (GLuint)( ( y + 0 ) * ( hmdInfo->eyeTilesWide + 1 ) + ( x + 0 ) );
-            distortion_indices[offset + 1] = (GLuint)( ( y + 1 ) * ( hmdInfo->eyeTilesWide + 1 ) + ( x + 0 ) );
-            distortion_indices[offset + 2] = (GLuint)( ( y + 0 ) * ( hmdInfo->eyeTilesWide + 1 ) + ( x + 1 ) );
-
-            distortion_indices[offset + 3] = (GLuint)( ( y + 0 ) * ( hmdInfo->eyeTilesWide + 1 ) + ( x + 1 ) );
-            distortion_indices[offset + 4] = (GLuint)( ( y + 1 ) * ( hmdInfo->eyeTilesWide + 1 ) + ( x + 0 ) );
-            distortion_indices[offset + 5] = (GLuint)( ( y + 1 ) * ( hmdInfo->eyeTilesWide + 1 ) + ( x + 1 ) );
-        }
+    // Indices, vertices and the UV scratch all come out of one block, sized from the tile counts.
+    if (!arena->reserveUniform(hmdInfo->eyeTilesWide, hmdInfo->eyeTilesHigh)) {
+        fprintf(stderr, "Out of memory for the distortion mesh\n");
+        exit(1);
     }
+    distortion_indices = arena->getIndices();
 
-    // Allocate memory for the distortion coordinates.
+    // A simple grid index array, the same for both eyes, in vertical strips
+    // so it is cache friendly without reordering.
+    BuildStripGridIndices( distortion_indices, hmdInfo->eyeTilesWide, hmdInfo->eyeTilesHigh );
+
+    // The distortion coordinates, in the arena's scratch.
     // These are NOT the actual distortion mesh's vertices,
     // they are calculated distortion grid coefficients
     // that will be used to set the actual distortion mesh's UV space.
-    mesh_coord2d_t* tw_mesh_base_ptr = (mesh_coord2d_t *) malloc( NUM_EYES * NUM_COLOR_CHANNELS * num_distortion_vertices * sizeof( mesh_coord2d_t ) );
+    mesh_coord2d_t* tw_mesh_base_ptr = arena->getScratch();
 
     // Set the distortion coordinates as a series of arrays
     // that will be written into by the BuildDistortionMeshes() function.
@@ -426,48 +752,25 @@ void BuildTimewarp(hmd_info_t* hmdInfo){
         { tw_mesh_base_ptr + 0 * num_distortion_vertices, tw_mesh_base_ptr + 1 * num_distortion_vertices, tw_mesh_base_ptr + 2 * num_distortion_vertices },
         { tw_mesh_base_ptr + 3 * num_distortion_vertices, tw_mesh_base_ptr + 4 * num_distortion_vertices, tw_mesh_base_ptr + 5 * num_distortion_vertices }
     };
-    BuildDistortionMeshes( distort_coords, hmdInfo );
+    // Only a quadrant (or half) of one eye is evaluated when the lenses are symmetric.
+    // The eyes and bands of rows are spread over the pool, the result is the same as a serial build.
+    BuildDistortionMeshes( distort_coords, hmdInfo, GetDistortionSymmetry( hmdInfo, lensModel ), lensModel, pool );
 
-    // Allocate memory for position and UV CPU buffers.
-    for(int eye = 0; eye < NUM_EYES; eye++){
-        distortion_positions = (mesh_coord3d_t *) malloc(NUM_EYES * num_distortion_vertices * sizeof(mesh_coord3d_t));
-        distortion_uv0 = (uv_coord_t *) malloc(NUM_EYES * num_distortion_vertices * sizeof(uv_coord_t));
-        distortion_uv1 = (uv_coord_t *) malloc(NUM_EYES * num_distortion_vertices * sizeof(uv_coord_t));
-        distortion_uv2 = (uv_coord_t *) malloc(NUM_EYES * num_distortion_vertices * sizeof(uv_coord_t));
-    }
+    // The interleaved vertex CPU buffer, both eyes back to back.
+    distortion_vertices = arena->getVertices();
+    BuildDistortionVertices( hmdInfo, distort_coords, distortion_vertices, pool );
+    return;
+}
 
-    for ( int eye = 0; eye < NUM_EYES; eye++ )
-    {
-        for ( int y = 0; y <= hmdInfo->eyeTilesHigh; y++ )
-        {
-            for ( int x = 0; x <= hmdInfo->eyeTilesWide; x++ )
-            {
-                const int index = y * ( hmdInfo->eyeTilesWide + 1 ) + x;
-
-                // Set the physical distortion mesh coordinates. These are rectangular/gridlike, not distorted.
-                // The distortion is handled by the UVs, not the actual mesh coordinates!
-                distortion_positions[eye * num_distortion_vertices + index].x = ( -1.0f + eye + ( (float)x / hmdInfo->eyeTilesWide ) );
-                distortion_positions[eye * num_distortion_vertices + index].y = ( -1.0f + 2.0f * ( ( hmdInfo->eyeTilesHigh - (float)y ) / hmdInfo->eyeTilesHigh ) *
-                                                    ( (float)( hmdInfo->eyeTilesHigh * hmdInfo->tilePixelsHigh ) / hmdInfo->displayPixelsHigh ) );
-                distortion_positions[eye * num_distortion_vertices + index].z = 0.0f;
-
-                // Use the previously-calculated distort_coords to set the UVs on the distortion mesh
-                distortion_uv0[eye * num_distortion_vertices + index].u = distort_coords[eye][0][index].x;
-                distortion_uv0[eye * num_distortion_vertices + index].v = distort_coords[eye][0][index].y;
-                distortion_uv1[eye * num_distortion_vertices + index].u = distort_coords[eye][1][index].x;
-                distortion_uv1[eye * num_distortion_vertices + index].v = distort_coords[eye][1][index].y;
-                distortion_uv2[eye * num_distortion_vertices + index].u = distort_coords[eye][2][index].x;
-                distortion_uv2[eye * num_distortion_vertices + index].v = distort_coords[eye][2][index].y;
-            }
-        }
-    }
-    // Construct a basic perspective projection
-    ksMatrix4x4f_CreateProjectionFov( &basicProjection, 40.0f, 40.0f, 40.0f, 40.0f, 0.1f, 0.0f );
 
-    // This was just temporary.
-    free(tw_mesh_base_ptr);
 
-    return;
+///////////////////////////////////////////////////////////////////////////////
+// how well the distortion mesh triangles use the post-transform vertex cache
+///////////////////////////////////////////////////////////////////////////////
+void printDistortionMeshAcmr()
+{
+    const float acmr = ComputeVertexCacheAcmr(distortion_indices, num_distortion_indices, num_distortion_vertices, VERTEX_CACHE_SIZE);
+    printf("Distortion mesh ACMR (%d entry FIFO): %.3f\n", VERTEX_CACHE_SIZE, acmr);
 }
 
 
@@ -476,20 +779,178 @@ int main(int argc, char **argv)
 {
 
     GLenum err;
+    const char* imageFile = NULL;
+
+    displayBackend = DISPLAY_BACKEND_GLUT;
+    headlessFrames = DEFAULT_HEADLESS_FRAMES;
+    headlessDumpFile = NULL;
+    cpuWarpThreads = 0;
+    workerPool = NULL;
+    validateWarp = false;
+    meshCacheDir = NULL;
+    adaptiveMeshTolerance = 0.0f;
+    ipdSweepMeters = 0.0f;
+    compactMeshTolerance = 0.0f;
+    runtimeMesh = false;
+    warpMode = WARP_MODE_MESH;
+    lutFormat = DISTORTION_LUT_FLOAT;
+    warpBenchmark = false;
+    tileTunerBudget = 0.0f;
+    distortionModelName = NULL;
+    lensModel = NULL;
+    posePrediction = POSE_PREDICTION_CONSTANT_VELOCITY;
+    sensorThread = false;
+    positionalWarp = false;
+    scanoutSlices = 1;
+    scanoutDirection = SCANOUT_LEFT_TO_RIGHT;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--backend=glut") == 0) {
+            displayBackend = DISPLAY_BACKEND_GLUT;
+        } else if (strcmp(argv[i], "--backend=egl") == 0) {
+            displayBackend = DISPLAY_BACKEND_EGL;
+        } else if (strcmp(argv[i], "--backend=cpu") == 0) {
+            displayBackend = DISPLAY_BACKEND_CPU;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            cpuWarpThreads = atoi(argv[i] + 10);
+        } else if (strcmp(argv[i], "--validate") == 0) {
+            validateWarp = true;
+        } else if (strncmp(argv[i], "--mesh-cache=", 13) == 0) {
+            meshCacheDir = argv[i] + 13;
+        } else if (strncmp(argv[i], "--benchmark=", 12) == 0) {
+            // Microbenchmarks need neither an image nor a context.
+            exit(RunBenchmark(argv[i] + 12) ? 0 : 1);
+        } else if (strncmp(argv[i], "--ipd-sweep=", 12) == 0) {
+            ipdSweepMeters = (float)atof(argv[i] + 12) * 0.001f;
+        } else if (strncmp(argv[i], "--compact-mesh=", 15) == 0) {
+            compactMeshTolerance = (float)atof(argv[i] + 15);
+        } else if (strcmp(argv[i], "--warp=mesh") == 0) {
+            warpMode = WARP_MODE_MESH;
+        } else if (strcmp(argv[i], "--warp=lut") == 0) {
+            warpMode = WARP_MODE_LUT;
+            lutFormat = DISTORTION_LUT_FLOAT;
+        } else if (strcmp(argv[i], "--warp=lut16") == 0) {
+            warpMode = WARP_MODE_LUT;
+            lutFormat = DISTORTION_LUT_HALF;
+        } else if (strcmp(argv[i], "--warp=procedural") == 0) {
+            warpMode = WARP_MODE_PROCEDURAL;
+        } else if (strcmp(argv[i], "--warp-benchmark") == 0) {
+            warpBenchmark = true;
+        } else if (strncmp(argv[i], "--tune-tiles=", 13) == 0) {
+            tileTunerBudget = (float)atof(argv[i] + 13);
+        } else if (strncmp(argv[i], "--distortion-model=", 19) == 0) {
+            distortionModelName = argv[i] + 19;
+        } else if (strcmp(argv[i], "--pose-prediction=none") == 0) {
+            posePrediction = POSE_PREDICTION_NONE;
+        } else if (strcmp(argv[i], "--pose-prediction=constant-velocity") == 0) {
+            posePrediction = POSE_PREDICTION_CONSTANT_VELOCITY;
+        } else if (strcmp(argv[i], "--pose-prediction=filtered") == 0) {
+            posePrediction = POSE_PREDICTION_FILTERED;
+        } else if (strcmp(argv[i], "--sensor-thread") == 0) {
+            sensorThread = true;
+        } else if (strcmp(argv[i], "--positional-warp") == 0) {
+            positionalWarp = true;
+        } else if (strncmp(argv[i], "--scanout-slices=", 17) == 0) {
+            scanoutSlices = atoi(argv[i] + 17);
+        } else if (strncmp(argv[i], "--scanout=", 10) == 0) {
+            if (!Scanout_ParseDirection(argv[i] + 10, &scanoutDirection)) {
+                fprintf(stderr, "Unknown --scanout=%s\n", argv[i] + 10);
+                exit(1);
+            }
+        } else if (strncmp(argv[i], "--pose-replay=", 14) == 0) {
+            // Like the microbenchmarks, a replay needs no image or context.
+            pose_trace_t trace;
+            if (!PoseTrace_Load(&trace, argv[i] + 14))
+                exit(1);
+            // Whatever the errors are, they are the measurement, not a failure.
+            PoseTrace_Report(&trace, argv[i] + 14);
+            PoseTrace_Destroy(&trace);
+            exit(0);
+        } else if (strcmp(argv[i], "--runtime-mesh") == 0) {
+            runtimeMesh = true;
+        } else if (strncmp(argv[i], "--adaptive-mesh=", 16) == 0) {
+            adaptiveMeshTolerance = (float)atof(argv[i] + 16);
+        } else if (strncmp(argv[i], "--frames=", 9) == 0) {
+            headlessFrames = atoi(argv[i] + 9);
+        } else if (strncmp(argv[i], "--dump=", 7) == 0) {
+            headlessDumpFile = argv[i] + 7;
+        } else if (argv[i][0] != '-') {
+            imageFile = argv[i];
+        }
+        // Anything else is left for glutInit() to consume.
+    }
+
+    if (imageFile == NULL) {
+        fprintf(stderr, "Usage: %s [--backend=glut|egl|cpu] [--frames=N] [--dump=out.ppm] [--threads=N] [--validate] [--mesh-cache=dir] [--adaptive-mesh=pixels] [--ipd-sweep=mm] [--compact-mesh=pixels] [--runtime-mesh] [--warp=mesh|lut|lut16|procedural] [--warp-benchmark] [--tune-tiles=pixels] [--distortion-model=catmull-rom|brown-conrady|rational|grid] [--pose-prediction=none|constant-velocity|filtered] [--sensor-thread] [--positional-warp] [--scanout-slices=N] [--scanout=left-to-right|right-to-left|top-to-bottom|bottom-to-top] [image]\n"
+                        "       %s --benchmark=spline|fixed-mesh|distortion-models|inverse-distortion|mesh-build|matrix|rotation-timewarp|pose-prediction|pose-handoff|pose-history|positional-timewarp|scanout-slices\n"
+                        "       %s --pose-replay=imu_trace.txt\n", argv[0], argv[0], argv[0]);
+        exit(1);
+    }
+
+    // The procedural warp only knows the uniform grid.
+    if (warpMode == WARP_MODE_PROCEDURAL && adaptiveMeshTolerance > 0.0f) {
+        fprintf(stderr, "--adaptive-mesh does not apply to --warp=procedural, ignored\n");
+        adaptiveMeshTolerance = 0.0f;
+    }
+
+    // Only the uniform mesh is built from a lens model.
+    if (distortionModelName != NULL) {
+        if (warpMode != WARP_MODE_MESH) {
+            fprintf(stderr, "--distortion-model only applies to --warp=mesh, using the mesh\n");
+            warpMode = WARP_MODE_MESH;
+        }
+        if (adaptiveMeshTolerance > 0.0f) {
+            fprintf(stderr, "--adaptive-mesh does not apply to --distortion-model, ignored\n");
+            adaptiveMeshTolerance = 0.0f;
+        }
+    }
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s [image]\n", argv[0]);
+    if (scanoutSlices < 1 || scanoutSlices > SCANOUT_MAX_SLICES) {
+        fprintf(stderr, "--scanout-slices takes 1 to %d\n", SCANOUT_MAX_SLICES);
         exit(1);
     }
 
+    // Only the mesh warp reprojects with depth, and the CPU reference is rotation only.
+    if (positionalWarp) {
+        if (warpMode != WARP_MODE_MESH || displayBackend == DISPLAY_BACKEND_CPU) {
+            fprintf(stderr, "--positional-warp only applies to --warp=mesh on a GL backend, ignored\n");
+            positionalWarp = false;
+        } else if (validateWarp) {
+            fprintf(stderr, "--validate compares with the rotation-only CPU reference, --positional-warp ignored\n");
+            positionalWarp = false;
+        }
+    }
+
+    // One pool for the whole run, so no mesh or LUT build spawns and joins
+    // its own threads.
+    workerPool = new ThreadPool(cpuWarpThreads);
+
     // init global vars
-    initSharedMem(argv[1]);
+    initSharedMem(imageFile);
 
     // register exit callback
     atexit(exitCB);
 
-    // init GLUT and GL
-    initGLUT(argc, argv);
+    // The CPU reference renderer needs no GL context at all.
+    if (displayBackend == DISPLAY_BACKEND_CPU) {
+        timer.start();
+        startHeadTracker();
+        runCpuWarp(headlessFrames);
+        return 0;
+    }
+
+    // init the context backend and GL
+    if (displayBackend == DISPLAY_BACKEND_EGL) {
+        if (!initEGL(OPENGL_VERSION_MAJOR, OPENGL_VERSION_MINOR)) {
+            fprintf(stderr, "Could not create a headless OpenGL context\n");
+            exit(1);
+        }
+        // Thousands of frames of per-frame timings are just noise,
+        // runHeadless() prints a summary instead.
+        printFrameTimes = false;
+    } else {
+        initGLUT(argc, argv);
+    }
     initGL();
 
     err = glGetError();
@@ -527,17 +988,23 @@ int main(int argc, char **argv)
         printf("main, error after creating and binding fbo: %x\n", err);
     }
 
-    // create a renderbuffer object to store depth info
+    // create a texture array to store depth info
     // NOTE: A depth renderable image should be attached the FBO for depth test.
     // If we don't attach a depth renderable image to the FBO, then
     // the rendering output will be corrupted because of missing depth test.
     // If you also need stencil test for your rendering, then you must
     // attach additional image to the stencil attachement point, too.
-    glGenRenderbuffers(1, &rboDepthId);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepthId);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, TEXTURE_WIDTH, TEXTURE_HEIGHT);
-    //glRenderbufferStorageMultisample(GL_RENDERBUFFER, fboSampleCount, GL_DEPTH_COMPONENT, TEXTURE_WIDTH, TEXTURE_HEIGHT);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    // It is a texture rather than a renderbuffer so the positional warp
+    // can sample it; depths are not filtered.
+    glGenTextures(1, &depthTextureId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTextureId);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, TEXTURE_WIDTH, TEXTURE_HEIGHT, 2, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
     glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
     // Attach the texture we created earlier to the FBO.
@@ -548,8 +1015,8 @@ int main(int argc, char **argv)
         printf("main, error2: %x\n", err);
     }
 
-    // attach a renderbuffer to depth attachment point
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepthId);
+    // attach the depth texture's first layer to depth attachment point
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTextureId, 0, 0);
 
     err = glGetError();
     if(err){
@@ -572,8 +1039,26 @@ int main(int argc, char **argv)
     // to the main framebuffer (aka, the screen)
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // Without a window there is no default framebuffer,
+    // so the warp gets an offscreen one of the same size.
+    if (displayBackend == DISPLAY_BACKEND_EGL && !initDisplayFramebuffer()) {
+        fprintf(stderr, "Could not create the offscreen display framebuffer\n");
+        exit(1);
+    }
+
     // start timer
     timer.start();
+    startHeadTracker();
+
+    if (displayBackend == DISPLAY_BACKEND_EGL) {
+        if (warpBenchmark)
+            runWarpBenchmark(headlessFrames);
+        else if (tileTunerBudget > 0.0f)
+            runTileTuner(tileTunerBudget, headlessFrames);
+        else
+            runHeadless(headlessFrames);
+        return 0;
+    }
 
     // the last GLUT call (LOOP)
     // window will be shown and display callback is triggered by events
@@ -584,6 +1069,550 @@ int main(int argc, char **argv)
 }
 
 
+
+///////////////////////////////////////////////////////////////////////////////
+// create the offscreen framebuffer that stands in for the window when
+// running on the headless EGL backend
+///////////////////////////////////////////////////////////////////////////////
+bool initDisplayFramebuffer()
+{
+    glGenRenderbuffers(1, &displayColorRboId);
+    glBindRenderbuffer(GL_RENDERBUFFER, displayColorRboId);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, screenWidth, screenHeight);
+
+    glGenRenderbuffers(1, &displayDepthRboId);
+    glBindRenderbuffer(GL_RENDERBUFFER, displayDepthRboId);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, screenWidth, screenHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &displayFboId);
+    glBindFramebuffer(GL_FRAMEBUFFER, displayFboId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, displayColorRboId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, displayDepthRboId);
+
+    bool status = checkFramebufferStatus(displayFboId);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return status;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// headless main loop: render a fixed number of frames back to back, then
+// report the average app and warp times
+///////////////////////////////////////////////////////////////////////////////
+void runHeadless(int frames)
+{
+    double totalAppTime = 0.0;
+    double totalWarpTime = 0.0;
+    double totalUpdateTime = 0.0;
+    double maxUpdateTime = 0.0;
+    const float baseLensSeparation = hmd_info.lensSeparationInMeters;
+    Timer tRun;
+
+    tRun.start();
+    for (int frame = 0; frame < frames; frame++) {
+        if (ipdSweepMeters != 0.0f) {
+            // Step the lenses back and forth, like a user dialing in their IPD.
+            const double updateTime = updateLensSeparation(baseLensSeparation + ((frame & 1) ? ipdSweepMeters : 0.0f));
+            totalUpdateTime += updateTime;
+            maxUpdateTime = (updateTime > maxUpdateTime) ? updateTime : maxUpdateTime;
+        }
+        displayCB();
+        totalAppTime += renderToTextureTime;
+        totalWarpTime += timewarpTime;
+    }
+    tRun.stop();
+
+    const double runTime = tRun.getElapsedTimeInMilliSec();
+    printf("Headless: %d frames at %dx%d in %f ms\n", frames, screenWidth, screenHeight, runTime);
+    if (frames > 0) {
+        printf("Average app time = %f ms, warp time = %f ms, frame time = %f ms\n",
+               totalAppTime / frames, totalWarpTime / frames, runTime / frames);
+        if (ipdSweepMeters != 0.0f && distortion_vertices == NULL)
+            printf("Average lens separation update = %f ms (max %f ms) for the procedural warp's parameter block\n",
+                   totalUpdateTime / frames, maxUpdateTime);
+        else if (ipdSweepMeters != 0.0f)
+            printf("Average lens separation update = %f ms (max %f ms) for %d vertices\n",
+                   totalUpdateTime / frames, maxUpdateTime, NUM_EYES * num_distortion_vertices);
+    }
+
+    if (headlessDumpFile != NULL) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, displayFboId);
+        if (writeFramebufferPPM(headlessDumpFile, screenWidth, screenHeight))
+            printf("Wrote last frame to %s\n", headlessDumpFile);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    if (validateWarp && frames > 0) {
+        if (warpMode == WARP_MODE_PROCEDURAL)
+            validateProceduralWarp();
+        validateAgainstCpuWarp();
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// headless: build the uniform mesh of hmdInfo and time warping the current
+// eye buffer with it onto the bound framebuffer, in ms per frame, rotation
+// only, and with positionalTimeOut set positional as well on the same mesh
+///////////////////////////////////////////////////////////////////////////////
+double timeMeshWarp(const hmd_info_t* hmdInfo, int frames, double* positionalTimeOut, GLuint* numVerticesOut)
+{
+    // The mesh, built with the globals BuildTimewarp() fills swapped out.
+    hmd_info_t meshHmdInfo = *hmdInfo;
+    distortion_vertex_t* savedVertices = distortion_vertices;
+    GLuint* savedIndices = distortion_indices;
+    const GLuint savedNumVertices = num_distortion_vertices;
+    const GLuint savedNumIndices = num_distortion_indices;
+    TimewarpArena meshArena;
+    meshArena.setStaging(ARENA_STAGING_INDICES16);
+    BuildTimewarp(&meshHmdInfo, &meshArena, workerPool);
+    distortion_vertex_t* vertices = distortion_vertices;
+    GLuint* indices = distortion_indices;
+    const GLuint numVertices = num_distortion_vertices;
+    const GLuint numIndices = num_distortion_indices;
+    distortion_vertices = savedVertices;
+    distortion_indices = savedIndices;
+    num_distortion_vertices = savedNumVertices;
+    num_distortion_indices = savedNumIndices;
+
+    GLuint meshVao, meshVbo, meshIbo;
+    glGenVertexArrays(1, &meshVao);
+    glBindVertexArray(meshVao);
+    glGenBuffers(1, &meshVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, meshVbo);
+    glBufferData(GL_ARRAY_BUFFER, NUM_EYES * numVertices * sizeof(distortion_vertex_t), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(distortion_pos_attr, 3, GL_FLOAT, GL_FALSE, sizeof(distortion_vertex_t), (void*)offsetof(distortion_vertex_t, position));
+    glVertexAttribPointer(distortion_uv0_attr, 2, GL_FLOAT, GL_FALSE, sizeof(distortion_vertex_t), (void*)offsetof(distortion_vertex_t, uv0));
+    glVertexAttribPointer(distortion_uv1_attr, 2, GL_FLOAT, GL_FALSE, sizeof(distortion_vertex_t), (void*)offsetof(distortion_vertex_t, uv1));
+    glVertexAttribPointer(distortion_uv2_attr, 2, GL_FLOAT, GL_FALSE, sizeof(distortion_vertex_t), (void*)offsetof(distortion_vertex_t, uv2));
+    glEnableVertexAttribArray(distortion_pos_attr);
+    glEnableVertexAttribArray(distortion_uv0_attr);
+    glEnableVertexAttribArray(distortion_uv1_attr);
+    glEnableVertexAttribArray(distortion_uv2_attr);
+    glGenBuffers(1, &meshIbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIbo);
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLushort* indices16 = meshArena.getIndices16();
+    if (indices16 != NULL) {
+        for (GLuint i = 0; i < numIndices; i++)
+            indices16[i] = (GLushort)indices[i];
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLushort), indices16, GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_SHORT;
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    }
+    meshArena.release();
+
+    scanout_transforms_t scanout;
+    ksVector3f startTranslation, endTranslation;
+    double passTime[2] = { 0.0, 0.0 };
+    const int passes = (positionalTimeOut != NULL) ? 2 : 1;
+    for (int pass = 0; pass < passes; pass++) {
+        const bool positional = (pass == 1);
+        Timer tRun;
+        glFinish();
+        tRun.start();
+        for (int frame = 0; frame < frames; frame++) {
+            const float time = (float)timer.getElapsedTime();
+            calculateTimeWarpTransforms(time, time, &scanout);
+            uploadScanoutTransforms(&scanout);
+            glClear(GL_COLOR_BUFFER_BIT);
+            if (positional) {
+                calculateTimeWarpTranslations(time, time, &startTranslation, &endTranslation);
+                glUseProgram(tw_positional_shader_program);
+                glUniform3fv(tw_positional_start_translation_unif, 1, &startTranslation.x);
+                glUniform3fv(tw_positional_end_translation_unif, 1, &endTranslation.x);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, depthTextureId);
+                glActiveTexture(GL_TEXTURE0);
+            } else {
+                glUseProgram(tw_shader_program);
+            }
+            glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+            glBindVertexArray(meshVao);
+            for (int eye = 0; eye < NUM_EYES; eye++)
+                glDrawElementsBaseVertex(GL_TRIANGLES, numIndices, indexType, (void*)0, eye * numVertices);
+            glFinish();
+        }
+        tRun.stop();
+        passTime[pass] = (frames > 0) ? tRun.getElapsedTimeInMilliSec() / frames : 0.0;
+    }
+    if (positionalTimeOut != NULL)
+        *positionalTimeOut = passTime[1];
+
+    glDeleteBuffers(1, &meshVbo);
+    glDeleteBuffers(1, &meshIbo);
+    glDeleteVertexArrays(1, &meshVao);
+
+    *numVerticesOut = numVertices;
+    return passTime[0];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// headless: warp the same eye buffer onto displays of several sizes with the
+// mesh and with both LUT formats, so each device can pick the faster mode
+///////////////////////////////////////////////////////////////////////////////
+void runWarpBenchmark(int frames)
+{
+    static const int resolutions[][2] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+    static const distortion_lut_format_t lutFormats[2] = { DISTORTION_LUT_FLOAT, DISTORTION_LUT_HALF };
+
+    // One ordinary frame fills the eye buffer that all the runs below warp.
+    displayCB();
+
+    printf("Warp benchmark: %d frames per run, %dx%d eye buffer, LUTs built on %d threads\n",
+           frames, TEXTURE_WIDTH, TEXTURE_HEIGHT, workerPool->getThreadCount());
+    for (int r = 0; r < (int)(sizeof(resolutions) / sizeof(resolutions[0])); r++) {
+        const int width = resolutions[r][0];
+        const int height = resolutions[r][1];
+        hmd_info_t hmdInfo;
+        GetDefaultHmdInfo(width, height, &hmdInfo);
+
+        // An offscreen display of this size.
+        GLuint colorRbo, fbo;
+        glGenRenderbuffers(1, &colorRbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRbo);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRbo);
+        glViewport(0, 0, width, height);
+        glClearColor(0, 0, 0, 0);
+
+        GLuint numVertices;
+        // Both warps on the one mesh.
+        double positionalTime;
+        const double meshTime = timeMeshWarp(&hmdInfo, frames, &positionalTime, &numVertices);
+        scanout_transforms_t scanout;
+        Timer tRun;
+
+        double lutTime[2];
+        double lutBuildTime[2];
+        size_t lutSize[2];
+        for (int f = 0; f < 2; f++) {
+            distortion_lut_t lut;
+            Timer tLut;
+            tLut.start();
+            DistortionLut_Create(&lut, width, height, lutFormats[f]);
+            DistortionLut_Generate(workerPool, &hmdInfo, &lut);
+            tLut.stop();
+            lutBuildTime[f] = tLut.getElapsedTimeInMilliSec();
+            lutSize[f] = DistortionLut_GetSize(&lut);
+            const GLuint lutTexture = createDistortionLutTexture(&lut);
+            DistortionLut_Destroy(&lut);
+            glFinish();
+            tRun.start();
+            for (int frame = 0; frame < frames; frame++) {
+                const float time = (float)timer.getElapsedTime();
+                calculateTimeWarpTransforms(time, time, &scanout);
+                uploadScanoutTransforms(&scanout);
+                glClear(GL_COLOR_BUFFER_BIT);
+                drawDistortionLut(lutTexture);
+                glFinish();
+            }
+            tRun.stop();
+            lutTime[f] = (frames > 0) ? tRun.getElapsedTimeInMilliSec() / frames : 0.0;
+            glDeleteTextures(1, &lutTexture);
+        }
+
+        const double bestLut = (lutTime[1] < lutTime[0]) ? lutTime[1] : lutTime[0];
+        printf("  %4dx%-4d: mesh %8.3f ms (%5d vertices), LUT RG32F %8.3f ms, LUT RG16F %8.3f ms -> %s\n",
+               width, height, meshTime, NUM_EYES * numVertices, lutTime[0], lutTime[1], (meshTime <= bestLut) ? "mesh" : "LUT");
+        printf("             LUT RG32F built in %8.3f ms, %5.1f MB; RG16F built in %8.3f ms, %5.1f MB\n",
+               lutBuildTime[0], lutSize[0] / (1024.0 * 1024.0), lutBuildTime[1], lutSize[1] / (1024.0 * 1024.0));
+        printf("             positional mesh %8.3f ms (%+.1f%% vs rotation only)\n",
+               positionalTime, (meshTime > 0.0) ? 100.0 * (positionalTime - meshTime) / meshTime : 0.0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorRbo);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, displayFboId);
+    glViewport(0, 0, screenWidth, screenHeight);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// headless: measure the interpolation error of every tiling of the display
+// against the exact per-pixel mapping, time the warp of the coarsest ones
+// within budget (in eye buffer pixels), and report the fastest
+///////////////////////////////////////////////////////////////////////////////
+void runTileTuner(float budget, int frames)
+{
+    float uvToPixels[2];
+    getUvToPixels(uvToPixels);
+
+    tile_candidate_t candidates[TILE_TUNER_MAX_CANDIDATES];
+    const int numCandidates = TileTuner_GetCandidates(&hmd_info, TILE_TUNER_MIN_PIXELS, TILE_TUNER_MAX_PIXELS,
+                                                      candidates, TILE_TUNER_MAX_CANDIDATES);
+    if (numCandidates == 0) {
+        fprintf(stderr, "Tile tuner: no tiling divides the %dx%d display evenly\n", hmd_info.displayPixelsWide, hmd_info.displayPixelsHigh);
+        return;
+    }
+
+    // All candidates cover the whole display, so they share one exact mapping.
+    Timer tMeasure;
+    tMeasure.start();
+    hmd_info_t hmdInfo = hmd_info;
+    TileTuner_SetTileSize(&hmdInfo, candidates[0].tilePixelsWide, candidates[0].tilePixelsHigh);
+    distortion_lut_t exact;
+    if (!DistortionLut_Create(&exact, hmdInfo.displayPixelsWide, hmdInfo.displayPixelsHigh, DISTORTION_LUT_FLOAT)) {
+        fprintf(stderr, "Tile tuner: could not allocate the exact distortion table\n");
+        return;
+    }
+    DistortionLut_Generate(workerPool, &hmdInfo, &exact);
+    for (int i = 0; i < numCandidates; i++)
+        TileTuner_MeasureError(workerPool, &hmdInfo, &exact, uvToPixels, &candidates[i]);
+    DistortionLut_Destroy(&exact);
+    tMeasure.stop();
+
+    // One ordinary frame fills the eye buffer that the timed warps use.
+    displayCB();
+    glBindFramebuffer(GL_FRAMEBUFFER, displayFboId);
+    glViewport(0, 0, screenWidth, screenHeight);
+    glClearColor(0, 0, 0, 0);
+
+    // timeMeshWarp() builds the uniform grid.
+    const float savedAdaptiveMeshTolerance = adaptiveMeshTolerance;
+    adaptiveMeshTolerance = 0.0f;
+
+    printf("Tile tuner: %d tilings of the %dx%d display measured in %f ms on %d threads, budget %.3f eye buffer pixels, %d frames per timing\n",
+           numCandidates, hmd_info.displayPixelsWide, hmd_info.displayPixelsHigh, tMeasure.getElapsedTimeInMilliSec(),
+           workerPool->getThreadCount(), budget, frames);
+    printf("     tile  vertices  max error  mean error   warp time\n");
+    int numWithinBudget = 0;
+    int best = -1;
+    double bestTime = 0.0;
+    int finest = 0;
+    for (int i = 0; i < numCandidates; i++) {
+        const tile_candidate_t* candidate = &candidates[i];
+        const bool current = (candidate->tilePixelsWide == hmd_info.tilePixelsWide && candidate->tilePixelsHigh == hmd_info.tilePixelsHigh);
+        const bool withinBudget = (candidate->maxError <= budget);
+        if (candidate->maxError < candidates[finest].maxError)
+            finest = i;
+
+        // Candidates run coarsest first, so the first ones within budget are the cheap ones.
+        if (!current && !(withinBudget && numWithinBudget < TILE_TUNER_TIMED_CANDIDATES))
+            continue;
+        hmd_info_t tiled = hmd_info;
+        TileTuner_SetTileSize(&tiled, candidate->tilePixelsWide, candidate->tilePixelsHigh);
+        GLuint numVertices;
+        const double warpTime = timeMeshWarp(&tiled, frames, NULL, &numVertices);
+        if (withinBudget) {
+            numWithinBudget++;
+            if (best < 0 || warpTime < bestTime) {
+                best = i;
+                bestTime = warpTime;
+            }
+        }
+        printf("  %3dx%-3d  %8d  %9.3f  %10.4f  %8.3f ms%s%s\n", candidate->tilePixelsWide, candidate->tilePixelsHigh,
+               NUM_EYES * candidate->numVertices, candidate->maxError, candidate->meanError, warpTime,
+               withinBudget ? "" : "  over budget", current ? "  (current)" : "");
+    }
+    adaptiveMeshTolerance = savedAdaptiveMeshTolerance;
+
+    if (best < 0) {
+        printf("Tile tuner: no tiling meets %.3f pixels, the finest (%dx%d) is off by up to %.3f pixels\n",
+               budget, candidates[finest].tilePixelsWide, candidates[finest].tilePixelsHigh, candidates[finest].maxError);
+    } else {
+        printf("Tile tuner: cheapest tiling within %.3f pixels: tilePixelsWide = %d, tilePixelsHigh = %d (%d vertices, max error %.3f pixels, %.3f ms)\n",
+               budget, candidates[best].tilePixelsWide, candidates[best].tilePixelsHigh, NUM_EYES * candidates[best].numVertices,
+               candidates[best].maxError, bestTime);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// describe the CPU-side distortion mesh for the CPU reference renderer
+///////////////////////////////////////////////////////////////////////////////
+cpu_warp_mesh_t getCpuWarpMesh()
+{
+    cpu_warp_mesh_t mesh;
+    mesh.numVertices = num_distortion_vertices;
+    mesh.vertices = distortion_vertices;
+    mesh.numIndices = num_distortion_indices;
+    mesh.indices = distortion_indices;
+    return mesh;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GPU-less main loop: stretch the input image into the eye buffer the way
+// the basic pass does, then warp it on the CPU for a fixed number of frames
+///////////////////////////////////////////////////////////////////////////////
+void runCpuWarp(int frames)
+{
+    cpu_eye_image_t eyeImage;
+    if (!CpuEyeImage_Create(&eyeImage, TEXTURE_WIDTH, TEXTURE_HEIGHT, NUM_EYES)) {
+        fprintf(stderr, "Could not allocate the CPU eye image\n");
+        return;
+    }
+    CpuEyeImage_ResampleLayer(&eyeImage, 0, prerendered_image->texture,
+                              prerendered_image->width, prerendered_image->height,
+                              prerendered_image->hasAlpha ? 4 : 3);
+
+    const cpu_warp_mesh_t mesh = getCpuWarpMesh();
+    const int eyeLayers[NUM_EYES] = { 0, 0 };   // ArrayLayer is never set, so both eyes read layer 0
+    GLubyte* pixels = (GLubyte*) malloc(screenWidth * screenHeight * 4);
+
+    Timer tRun;
+    tRun.start();
+    for (int frame = 0; frame < frames; frame++) {
+        playTime = (float)timer.getElapsedTime();
+        calculateTimeWarpTransforms(playTime, playTime, &timeWarpScanout);
+        CpuWarp_Render(workerPool, pixels, screenWidth, screenHeight, &mesh, &eyeImage, eyeLayers, &timeWarpScanout);
+    }
+    tRun.stop();
+
+    const double runTime = tRun.getElapsedTimeInMilliSec();
+    const double mpixels = (double)frames * screenWidth * screenHeight / 1e6;
+    printf("CPU warp: %d frames at %dx%d on %d threads in %f ms\n", frames, screenWidth, screenHeight, workerPool->getThreadCount(), runTime);
+    if (frames > 0 && runTime > 0.0) {
+        const double mpixelsPerSec = mpixels / (runTime / 1000.0);
+        printf("Average warp time = %f ms, %f Mpixel/s, %f Mpixel/s per core\n",
+               runTime / frames, mpixelsPerSec, mpixelsPerSec / workerPool->getThreadCount());
+    }
+
+    if (headlessDumpFile != NULL && frames > 0) {
+        if (writePPM(headlessDumpFile, pixels, screenWidth, screenHeight, 4))
+            printf("Wrote last frame to %s\n", headlessDumpFile);
+    }
+
+    free(pixels);
+    CpuEyeImage_Destroy(&eyeImage);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// render the last GL frame again with the CPU reference renderer, from the
+// same eye texture and transforms, and report how far apart they are
+///////////////////////////////////////////////////////////////////////////////
+void validateAgainstCpuWarp()
+{
+    cpu_eye_image_t eyeImage;
+    if (!CpuEyeImage_Create(&eyeImage, TEXTURE_WIDTH, TEXTURE_HEIGHT, NUM_EYES)) {
+        fprintf(stderr, "Could not allocate the CPU eye image\n");
+        return;
+    }
+
+    // Pull back both layers of the eye texture.
+    GLubyte* texels = (GLubyte*) malloc(TEXTURE_WIDTH * TEXTURE_HEIGHT * 3 * NUM_EYES);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+    glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, GL_UNSIGNED_BYTE, texels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    for (int layer = 0; layer < NUM_EYES; layer++)
+        CpuEyeImage_SetLayer(&eyeImage, layer, texels + layer * TEXTURE_WIDTH * TEXTURE_HEIGHT * 3, 3);
+    free(texels);
+
+    GLubyte* gpuPixels = (GLubyte*) malloc(screenWidth * screenHeight * 4);
+    GLubyte* cpuPixels = (GLubyte*) malloc(screenWidth * screenHeight * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, displayFboId);
+    glReadPixels(0, 0, screenWidth, screenHeight, GL_RGBA, GL_UNSIGNED_BYTE, gpuPixels);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    // The LUT warp is checked against the same table, not against the mesh
+    // it replaces, so both modes are held to the same differences.
+    const int eyeLayers[NUM_EYES] = { 0, 0 };
+    if (warpMode == WARP_MODE_LUT) {
+        CpuWarp_RenderLut(workerPool, cpuPixels, screenWidth, screenHeight, &distortion_lut, &eyeImage, eyeLayers, &timeWarpScanout);
+    } else {
+        const cpu_warp_mesh_t mesh = getCpuWarpMesh();
+        CpuWarp_Render(workerPool, cpuPixels, screenWidth, screenHeight, &mesh, &eyeImage, eyeLayers, &timeWarpScanout);
+    }
+
+    int maxDiff = 0;
+    double sumDiff = 0.0;
+    int numOff = 0;
+    for (int i = 0; i < screenWidth * screenHeight; i++) {
+        int pixelDiff = 0;
+        for (int c = 0; c < NUM_COLOR_CHANNELS; c++) {
+            const int d = abs((int)gpuPixels[i * 4 + c] - (int)cpuPixels[i * 4 + c]);
+            sumDiff += d;
+            pixelDiff = (d > pixelDiff) ? d : pixelDiff;
+        }
+        maxDiff = (pixelDiff > maxDiff) ? pixelDiff : maxDiff;
+        if (pixelDiff > 2)
+            numOff++;
+    }
+    printf("Validate: GL vs CPU max diff = %d, mean diff = %f, pixels off by more than 2 = %d (%f%%)\n",
+           maxDiff, sumDiff / ((double)screenWidth * screenHeight * NUM_COLOR_CHANNELS),
+           numOff, 100.0 * numOff / ((double)screenWidth * screenHeight));
+
+    free(gpuPixels);
+    free(cpuPixels);
+    CpuEyeImage_Destroy(&eyeImage);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// finish the frame on whichever backend is active
+///////////////////////////////////////////////////////////////////////////////
+void presentFrame()
+{
+    if (displayBackend == DISPLAY_BACKEND_EGL) {
+        // Nothing to swap, but wait for the GPU so frames don't pile up
+        // in the command queue and the run time covers the actual work.
+        glFinish();
+    } else {
+        glutSwapBuffers();
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// read back the bound read framebuffer and write it as a binary PPM
+///////////////////////////////////////////////////////////////////////////////
+bool writeFramebufferPPM(const char* fname, int width, int height)
+{
+    GLubyte* pixels = (GLubyte*) malloc(width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    bool status = writePPM(fname, pixels, width, height, 3);
+    free(pixels);
+    return status;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// write bottom-to-top RGB/RGBA rows as a binary PPM
+///////////////////////////////////////////////////////////////////////////////
+bool writePPM(const char* fname, const GLubyte* pixels, int width, int height, int channels)
+{
+    FILE* fp = fopen(fname, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open %s for writing\n", fname);
+        return false;
+    }
+
+    // GL rows are bottom to top, PPM rows are top to bottom.
+    fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--) {
+        const GLubyte* row = pixels + y * width * channels;
+        for (int x = 0; x < width; x++) {
+            fwrite(row + x * channels, 1, 3, fp);
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // initialize GLUT for windowing
 ///////////////////////////////////////////////////////////////////////////////
@@ -617,13 +1646,16 @@ int initGLUT(int argc, char **argv)
     glutReshapeFunc(reshapeCB);
     glutMouseFunc(mouseCB);
     glutMotionFunc(mouseMotionCB);
+    glutKeyboardFunc(keyboardCB);
 
     return handle;
 }
 
 
 // Return: handle to shader program
-GLuint init_and_link_shader (const char* vertex_shader, const char* fragment_shader) {
+GLuint init_and_link_shader (const char* vertex_shader, const char* fragment_shader,
+                              const char* const* feedback_varyings = NULL, int num_feedback_varyings = 0,
+                              GLuint attribute_program = 0) {
     GLint result, vertex_shader_handle, fragment_shader_handle, shader_program;
 
     vertex_shader_handle = glCreateShader(GL_VERTEX_SHADER);
@@ -666,6 +1698,24 @@ GLuint init_and_link_shader (const char* vertex_shader, const char* fragment_sha
     if(glGetError()){
         printf("AttachShader or createProgram failed\n");
     }
+    // Vertex outputs to capture with transform feedback, interleaved.
+    if(num_feedback_varyings > 0)
+        glTransformFeedbackVaryings(shader_program, num_feedback_varyings, feedback_varyings, GL_INTERLEAVED_ATTRIBS);
+    // Vertex attributes at the locations they have in attribute_program,
+    // so both programs can draw from the same VAO.
+    if(attribute_program != 0){
+        GLint num_attributes = 0;
+        glGetProgramiv(attribute_program, GL_ACTIVE_ATTRIBUTES, &num_attributes);
+        for(GLint i = 0; i < num_attributes; i++){
+            GLchar name[256];
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(attribute_program, i, sizeof(name), NULL, &size, &type, name);
+            const GLint location = glGetAttribLocation(attribute_program, name);
+            if(location >= 0)
+                glBindAttribLocation(shader_program, location, name);
+        }
+    }
 
     ///////////////////
     // Link and verify
@@ -689,188 +1739,812 @@ GLuint init_and_link_shader (const char* vertex_shader, const char* fragment_sha
         printf( "3 Error: %s\n", msg);
     }
 
-    if(glGetError()){
-        printf("initGL, error at end of initGL");
+    if(glGetError()){
+        printf("initGL, error at end of initGL");
+    }
+
+    // After successful link, detach shaders from shader program
+    glDetachShader(shader_program, vertex_shader_handle);
+    glDetachShader(shader_program, fragment_shader_handle);
+
+    return shader_program;
+}
+
+/* initGL()
+ *
+ * Initializes, links, and compiles relevant shaders
+ * Initializes various VBOs for use in the timewarp distortion shader
+ *
+ */
+void initGL()
+{
+
+    // GL features
+    //glEnable(GL_DEPTH_TEST);
+    //glEnable(GL_CULL_FACE);
+
+    //glClearColor(0, 0, 0, 0);                   // background color
+    //glClearStencil(0);                          // clear stencil buffer
+    //glClearDepth(1.0f);                         // 0 is near, 1 is far
+    //glEnable(GL_SCISSOR_TEST);
+    glDepthFunc(GL_LEQUAL);
+
+    // Create and bind global VAO object.
+    // This may not be necessary, and I can't
+    // really find very many good resources
+    // online as to why and how this is needed.
+    glGenVertexArrays(1, &tw_vao);
+    glBindVertexArray(tw_vao);
+
+    ///////////////////////////////////////////////////////
+    // The scanout transforms all the warp programs read, rewritten every frame.
+    glGenBuffers(1, &tw_scanout_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, tw_scanout_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(scanout_transforms_t), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SCANOUT_TRANSFORMS_BINDING, tw_scanout_ubo);
+
+    ///////////////////////////////////////////////////////
+    // Create and compile timewarp distortion vertex shader
+    tw_shader_program = init_and_link_shader(timeWarpChromaticVertexProgramGLSL, timeWarpChromaticFragmentProgramGLSL);
+    glUniformBlockBinding(tw_shader_program, glGetUniformBlockIndex(tw_shader_program, "ScanoutTransforms"), SCANOUT_TRANSFORMS_BINDING);
+
+    //////////////////////
+    // VBO Initialization
+
+    // Acquire attribute and uniform locations from the compiled and linked shader program
+    distortion_pos_attr = glGetAttribLocation(tw_shader_program, "vertexPosition");
+    distortion_uv0_attr = glGetAttribLocation(tw_shader_program, "vertexUv0");
+    distortion_uv1_attr = glGetAttribLocation(tw_shader_program, "vertexUv1");
+    distortion_uv2_attr = glGetAttribLocation(tw_shader_program, "vertexUv2");
+    tw_eye_index_unif = glGetUniformLocation(tw_shader_program, "ArrayLayer");
+    eye_sampler_0 = glGetUniformLocation(tw_shader_program, "Texture[0]");
+    eye_sampler_1 = glGetUniformLocation(tw_shader_program, "Texture[1]");
+
+    // The procedural warp draws without any mesh buffers.
+    if (warpMode != WARP_MODE_PROCEDURAL) {
+        initDistortionMeshBuffers();
+        releaseTimewarpBuildData();
+    }
+
+    // The full screen LUT warp program; its triangle needs no buffers at all.
+    glGenVertexArrays(1, &tw_lut_vao);
+    tw_lut_shader_program = init_and_link_shader(timeWarpLutVertexProgramGLSL, timeWarpLutFragmentProgramGLSL);
+    glUniformBlockBinding(tw_lut_shader_program, glGetUniformBlockIndex(tw_lut_shader_program, "ScanoutTransforms"), SCANOUT_TRANSFORMS_BINDING);
+    glUseProgram(tw_lut_shader_program);
+    glUniform1i(glGetUniformLocation(tw_lut_shader_program, "Texture"), 0);
+    glUniform1i(glGetUniformLocation(tw_lut_shader_program, "DistortionLut"), 1);
+    glUseProgram(0);
+
+    // The mesh-less warp program and the lens parameters it reads.
+    glGenVertexArrays(1, &tw_procedural_vao);
+    tw_procedural_shader_program = 0;
+    tw_procedural_params_ubo = 0;
+    if (warpMode == WARP_MODE_PROCEDURAL) {
+        tw_procedural_shader_program = init_and_link_shader(timeWarpProceduralVertexProgramGLSL, timeWarpChromaticFragmentProgramGLSL);
+        glUniformBlockBinding(tw_procedural_shader_program, glGetUniformBlockIndex(tw_procedural_shader_program, "DistortionParameters"), 0);
+        glUniformBlockBinding(tw_procedural_shader_program, glGetUniformBlockIndex(tw_procedural_shader_program, "ScanoutTransforms"), SCANOUT_TRANSFORMS_BINDING);
+        glUseProgram(tw_procedural_shader_program);
+        glUniform1i(glGetUniformLocation(tw_procedural_shader_program, "Texture"), 0);
+        glUseProgram(0);
+
+        glGenBuffers(1, &tw_procedural_params_ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, tw_procedural_params_ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(procedural_warp_params_t), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, tw_procedural_params_ubo);
+        uploadProceduralWarpParams();
+        printf("Procedural warp: %d vertices per eye from gl_VertexID, no mesh buffers\n", ProceduralWarp_GetVertexCount(&hmd_info));
+    }
+
+    // The positional warp program reads the same mesh, so its attributes
+    // go where tw_vao has them.
+    tw_positional_shader_program = 0;
+    if (positionalWarp || warpBenchmark) {
+        tw_positional_shader_program = init_and_link_shader(timeWarpPositionalVertexProgramGLSL, timeWarpChromaticFragmentProgramGLSL,
+                                                            NULL, 0, tw_shader_program);
+        glUniformBlockBinding(tw_positional_shader_program, glGetUniformBlockIndex(tw_positional_shader_program, "ScanoutTransforms"), SCANOUT_TRANSFORMS_BINDING);
+        tw_positional_start_translation_unif = glGetUniformLocation(tw_positional_shader_program, "TimeWarpStartTranslation");
+        tw_positional_end_translation_unif = glGetUniformLocation(tw_positional_shader_program, "TimeWarpEndTranslation");
+        glUseProgram(tw_positional_shader_program);
+        glUniform1i(glGetUniformLocation(tw_positional_shader_program, "Texture"), 0);
+        glUniform1i(glGetUniformLocation(tw_positional_shader_program, "Depth"), 1);
+        glUniform1f(glGetUniformLocation(tw_positional_shader_program, "InverseNearZ"), 1.0f / EYE_BUFFER_NEAR_Z);
+        glUseProgram(0);
+    }
+
+    memset(&distortion_lut, 0, sizeof(distortion_lut));
+    distortion_lut_tex = 0;
+    if (warpMode == WARP_MODE_LUT) {
+        Timer tLut;
+        tLut.start();
+        DistortionLut_Create(&distortion_lut, hmd_info.displayPixelsWide, hmd_info.displayPixelsHigh, lutFormat);
+        DistortionLut_Generate(workerPool, &hmd_info, &distortion_lut);
+        tLut.stop();
+        distortion_lut_tex = createDistortionLutTexture(&distortion_lut);
+        printf("Distortion LUT: %dx%d %s, %.1f MB, built in %f ms on %d threads\n",
+               distortion_lut.width, distortion_lut.height, DistortionLut_GetFormatName(lutFormat),
+               DistortionLut_GetSize(&distortion_lut) / (1024.0 * 1024.0), tLut.getElapsedTimeInMilliSec(), workerPool->getThreadCount());
+    }
+
+    glGenVertexArrays(1, &basic_vao);
+    glBindVertexArray(basic_vao);
+
+    // Create the basic shader program
+    basic_shader_program = init_and_link_shader (basicVertexShader, basicFragmentShader);
+
+    // Acquire attribute and uniform locations from the compiled and linked shader program
+    basic_pos_attr = glGetAttribLocation(basic_shader_program, "vertexPosition");
+    basic_uv_attr = glGetAttribLocation(basic_shader_program, "vertexUV");
+    glUseProgram(basic_shader_program);
+    glUniform2f(glGetUniformLocation(basic_shader_program, "SceneInverseDepth"),
+                PositionalWarp_GetSceneInverseDepth(0.0f), PositionalWarp_GetSceneInverseDepth(1.0f));
+    glUniform1f(glGetUniformLocation(basic_shader_program, "NearZ"), EYE_BUFFER_NEAR_Z);
+    glUseProgram(0);
+
+    GLenum err;
+
+    // Config basic mesh position vbo
+    glGenBuffers(1, &basic_pos_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, basic_pos_vbo);
+    glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(GLfloat), plane_vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(basic_pos_attr, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    err = glGetError();
+    if(err){
+        printf("Error after configuring basic position vbo: %x\n", err);
+    }
+
+    // Config basic mesh uv vbo
+    glGenBuffers(1, &basic_uv_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, basic_uv_vbo);
+    glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(GLfloat), plane_uvs, GL_STATIC_DRAW);
+    glVertexAttribPointer(basic_uv_attr, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    err = glGetError();
+    if(err){
+        printf("Error after configuring basic uv vbo: %x\n", err);
+    }
+
+    // Config basic mesh indices vbo
+    glGenBuffers(1, &basic_indices_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, basic_indices_vbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLfloat), plane_indices, GL_STATIC_DRAW);
+
+    err = glGetError();
+    if(err){
+        printf("Error after configuring basic uv vbo: %x\n", err);
+    }
+
+    // Generate texture for prerendered_image Image
+    glGenTextures(1, &prerendered_image_tex);
+    glBindTexture(GL_TEXTURE_2D, prerendered_image_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+    //glBindBuffer(GL_TEXTURE_2D, prerendered_image_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0,
+        prerendered_image->hasAlpha ? GL_RGBA : GL_RGB,
+        prerendered_image->width,
+        prerendered_image->height,
+        0,
+        prerendered_image->hasAlpha ? GL_RGBA : GL_RGB,
+        GL_UNSIGNED_BYTE,
+        prerendered_image->texture);
+
+    return;
+
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create the distortion mesh vertex and index buffers and point tw_vao's
+// attributes at them
+///////////////////////////////////////////////////////////////////////////////
+void initDistortionMeshBuffers()
+{
+    glBindVertexArray(tw_vao);
+
+    // A built-in or mapped mesh is not in the arena, but its upload staging is.
+    if (distortion_vertices != timewarpArena.getVertices() && !timewarpArena.reserveStaging(num_distortion_vertices, num_distortion_indices)) {
+        fprintf(stderr, "Out of memory for the distortion mesh\n");
+        exit(1);
+    }
+
+    // Config the interleaved distortion vertex vbo. The attribute layout
+    // is captured by tw_vao here once; displayCB() only picks the eye
+    // with the base vertex of its draw call.
+    glGenBuffers(1, &distortion_vertices_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, distortion_vertices_vbo);
+    distortion_vertices_compact = NULL;
+    distortion_vertex_size = sizeof(distortion_vertex_t);
+    if (compactMeshTolerance > 0.0f && chooseCompactMeshFormat())
+        distortion_vertex_size = sizeof(distortion_vertex_compact_t);
+    glBufferData(GL_ARRAY_BUFFER, 2 * NUM_EYES * num_distortion_vertices * distortion_vertex_size, NULL, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, NUM_EYES * num_distortion_vertices * distortion_vertex_size,
+                    distortion_vertices_compact ? (void*)distortion_vertices_compact : (void*)distortion_vertices);
+    distortion_vertices_region = 0;
+    distortion_vertices_fence[0] = distortion_vertices_fence[1] = 0;
+    setDistortionVertexAttribs();
+    glEnableVertexAttribArray(distortion_pos_attr);
+    glEnableVertexAttribArray(distortion_uv0_attr);
+    glEnableVertexAttribArray(distortion_uv1_attr);
+    glEnableVertexAttribArray(distortion_uv2_attr);
+
+    // Config distortion mesh indices vbo
+    glGenBuffers(1, &distortion_indices_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, distortion_indices_vbo);
+    // Indices are per eye (both eyes draw them with a base vertex), so 16 bits
+    // are enough as long as one eye has no more than 65536 vertices.
+    GLushort* indices16 = timewarpArena.getIndices16();
+    if (indices16 != NULL) {
+        for (GLuint i = 0; i < num_distortion_indices; i++)
+            indices16[i] = (GLushort)distortion_indices[i];
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_distortion_indices * sizeof(GLushort), indices16, GL_STATIC_DRAW);
+        distortion_index_type = GL_UNSIGNED_SHORT;
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_distortion_indices * sizeof(GLuint), distortion_indices, GL_STATIC_DRAW);
+        distortion_index_type = GL_UNSIGNED_INT;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// point tw_vao's attributes at distortion_vertices_vbo, in the compact or
+// the float layout; the vbo must be bound
+///////////////////////////////////////////////////////////////////////////////
+void setDistortionVertexAttribs()
+{
+    glBindVertexArray(tw_vao);
+    if (distortion_vertices_compact != NULL) {
+        // snorm16 positions come in with z = 0, w = 1 filled in
+        const GLenum uvType = (distortion_compact_format.uvEncoding == COMPACT_UV_HALF) ? GL_HALF_FLOAT : GL_SHORT;
+        const GLboolean uvNormalized = (distortion_compact_format.uvEncoding == COMPACT_UV_HALF) ? GL_FALSE : GL_TRUE;
+        glVertexAttribPointer(distortion_pos_attr, 2, GL_SHORT, GL_TRUE, distortion_vertex_size, (void*)offsetof(distortion_vertex_compact_t, position));
+        glVertexAttribPointer(distortion_uv0_attr, 2, uvType, uvNormalized, distortion_vertex_size, (void*)offsetof(distortion_vertex_compact_t, uv0));
+        glVertexAttribPointer(distortion_uv1_attr, 2, uvType, uvNormalized, distortion_vertex_size, (void*)offsetof(distortion_vertex_compact_t, uv1));
+        glVertexAttribPointer(distortion_uv2_attr, 2, uvType, uvNormalized, distortion_vertex_size, (void*)offsetof(distortion_vertex_compact_t, uv2));
+    } else {
+        glVertexAttribPointer(distortion_pos_attr, 3, GL_FLOAT, GL_FALSE, distortion_vertex_size, (void*)offsetof(distortion_vertex_t, position));
+        glVertexAttribPointer(distortion_uv0_attr, 2, GL_FLOAT, GL_FALSE, distortion_vertex_size, (void*)offsetof(distortion_vertex_t, uv0));
+        glVertexAttribPointer(distortion_uv1_attr, 2, GL_FLOAT, GL_FALSE, distortion_vertex_size, (void*)offsetof(distortion_vertex_t, uv1));
+        glVertexAttribPointer(distortion_uv2_attr, 2, GL_FLOAT, GL_FALSE, distortion_vertex_size, (void*)offsetof(distortion_vertex_t, uv2));
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// free the CPU-side mesh once the GPU has its copy, unless something still
+// reads it: IPD changes (the GLUT keys, --ipd-sweep) and --validate
+///////////////////////////////////////////////////////////////////////////////
+void releaseTimewarpBuildData()
+{
+    const bool lensesMove = (displayBackend == DISPLAY_BACKEND_GLUT) || ipdSweepMeters != 0.0f;
+    if (timewarpArena.isEmpty() || lensesMove || validateWarp)
+        return;
+
+    printf("Released %.1f KB of CPU-side distortion mesh data after upload (%d allocation%s)\n",
+           timewarpArena.getCapacity() / 1024.0, timewarpArena.getAllocationCount(),
+           timewarpArena.getAllocationCount() == 1 ? "" : "s");
+    if (distortion_vertices == timewarpArena.getVertices()) {
+        distortion_vertices = NULL;
+        distortion_indices = NULL;
+    }
+    distortion_vertices_compact = NULL;
+    timewarpArena.release();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// initialize global variables
+///////////////////////////////////////////////////////////////////////////////
+bool initSharedMem(const char* fname)
+{
+    init_images(fname);
+
+    screenWidth = SCREEN_WIDTH;
+    screenHeight = SCREEN_HEIGHT;
+
+    mouseLeftDown = mouseRightDown = false;
+    mouseX = mouseY = 0;
+
+    fboId = rboColorId = depthTextureId = textureId = 0;
+    fboSupported = fboUsed = false;
+    displayFboId = displayColorRboId = displayDepthRboId = 0;
+    printFrameTimes = true;
+    playTime = renderToTextureTime = timewarpTime = 0;
+
+    // Generate reference HMD and physical body dimensions
+    GetDefaultHmdInfo(SCREEN_WIDTH, SCREEN_HEIGHT, &hmd_info);
+    GetDefaultBodyInfo(&body_info);
+
+    // Construct a basic perspective projection
+    ksMatrix4x4f_CreateProjectionFov( &basicProjection, 40.0f, 40.0f, 40.0f, 40.0f, EYE_BUFFER_NEAR_Z, 0.0f );
+
+    // A fitted model reports its error in eye buffer pixels, so this needs the projection.
+    if (distortionModelName != NULL && !initDistortionModel(distortionModelName, &hmd_info)) {
+        fprintf(stderr, "Unknown or invalid --distortion-model=%s\n", distortionModelName);
+        exit(1);
+    }
+
+    // Construct timewarp meshes and other data, with room for the upload staging
+    timewarpArena.setStaging(ARENA_STAGING_INDICES16 | (compactMeshTolerance > 0.0f ? ARENA_STAGING_COMPACT : 0));
+    loadOrBuildTimewarp(&hmd_info);
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// set up the lens model the mesh is built from. Without vendor data at hand,
+// the polynomial models are fitted to, and the grid sampled from, the default
+// Catmull-Rom lens.
+///////////////////////////////////////////////////////////////////////////////
+bool initDistortionModel(const char* name, const hmd_info_t* hmdInfo)
+{
+    bool ok = false;
+    if (strcmp(name, "catmull-rom") == 0)
+        ok = DistortionModel_CreateCatmullRom(&distortionModel, hmdInfo);
+    else if (strcmp(name, "brown-conrady") == 0)
+        ok = DistortionModel_FitBrownConrady(&distortionModel, hmdInfo);
+    else if (strcmp(name, "rational") == 0)
+        ok = DistortionModel_FitRational(&distortionModel, hmdInfo);
+    else if (strcmp(name, "grid") == 0)
+        ok = DistortionModel_SampleGrid(&distortionModel, hmdInfo, DISTORTION_MODEL_GRID_SIZE, DISTORTION_MODEL_GRID_SIZE);
+    if (!ok)
+        return false;
+
+    lensModel = &distortionModel;
+    if (distortionModel.type == DISTORTION_MODEL_CATMULL_ROM) {
+        printf("Using the %s distortion model\n", DistortionModel_GetTypeName(distortionModel.type));
+        return true;
+    }
+
+    // The other models stand in for the Catmull-Rom lens, and warp with their fit error.
+    float uvToPixels[2];
+    float maxError, meanError;
+    getUvToPixels(uvToPixels);
+    DistortionModel_MeasureError(&distortionModel, hmdInfo, uvToPixels, &maxError, &meanError);
+    printf("Using the %s distortion model, a stand-in for the Catmull-Rom lens: max %.2f mean %.2f eye buffer pixels off\n",
+           DistortionModel_GetTypeName(distortionModel.type), maxError, meanError);
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// use the built-in distortion mesh of this HMD's profile, or map it from the
+// mesh cache, or build it and store it there for the next start
+///////////////////////////////////////////////////////////////////////////////
+void loadOrBuildTimewarp(hmd_info_t* hmdInfo)
+{
+    memset(&distortion_mesh_cache, 0, sizeof(distortion_mesh_cache));
+    distortion_fixed_mesh = NULL;
+
+    // The procedural warp makes its own mesh on the GPU; the CPU one is
+    // only needed to check it against, or to warp on the CPU.
+    if (warpMode == WARP_MODE_PROCEDURAL && !validateWarp && displayBackend != DISPLAY_BACKEND_CPU) {
+        distortion_vertices = NULL;
+        distortion_indices = NULL;
+        num_distortion_vertices = num_distortion_indices = 0;
+        return;
+    }
+
+    // Only the uniform grid of the Catmull-Rom lens is built in.
+    if (!runtimeMesh && adaptiveMeshTolerance <= 0.0f && lensModel == NULL) {
+        Timer tMesh;
+        tMesh.start();
+        distortion_fixed_mesh = FindFixedDistortionMesh(hmdInfo);
+        if (distortion_fixed_mesh != NULL) {
+            // Read-only, and already in a vertex cache friendly order.
+            num_distortion_vertices = distortion_fixed_mesh->numVertices;
+            num_distortion_indices = distortion_fixed_mesh->numIndices;
+            distortion_vertices = (distortion_vertex_t*)distortion_fixed_mesh->vertices;
+            distortion_indices = (GLuint*)distortion_fixed_mesh->indices;
+            tMesh.stop();
+            printf("Using the built-in %s distortion mesh (%f ms)\n", distortion_fixed_mesh->name, tMesh.getElapsedTimeInMilliSec());
+            return;
+        }
+    }
+
+    // The cache key only covers hmd_info_t, not a lens model.
+    if (meshCacheDir == NULL || lensModel != NULL) {
+        BuildTimewarp(hmdInfo, &timewarpArena, workerPool);
+        printDistortionMeshAcmr();
+        return;
+    }
+
+    // The adaptive mesh depends on its build options too.
+    adaptive_mesh_params_t params;
+    memset(&params, 0, sizeof(params));
+    if (adaptiveMeshTolerance > 0.0f)
+        getAdaptiveMeshParams(hmdInfo, &params);
+    const uint64_t key = MeshCache_GetKey(hmdInfo, adaptiveMeshTolerance > 0.0f ? &params : NULL, sizeof(params));
+
+    char path[1024];
+    MeshCache_GetPath(path, sizeof(path), meshCacheDir, key);
+
+    Timer tMesh;
+    tMesh.start();
+    if (MeshCache_Load(&distortion_mesh_cache, path, key)) {
+        // The mapped arrays are used in place, initGL() uploads straight from them.
+        num_distortion_vertices = distortion_mesh_cache.numVertices;
+        num_distortion_indices = distortion_mesh_cache.numIndices;
+        distortion_vertices = distortion_mesh_cache.vertices;
+        distortion_indices = distortion_mesh_cache.indices;
+        tMesh.stop();
+        printf("Mapped distortion mesh from %s in %f ms\n", path, tMesh.getElapsedTimeInMilliSec());
+        return;
+    }
+
+    BuildTimewarp(hmdInfo, &timewarpArena, workerPool);
+    tMesh.stop();
+    printf("Built distortion mesh in %f ms\n", tMesh.getElapsedTimeInMilliSec());
+    printDistortionMeshAcmr();
+
+    if (MeshCache_Store(path, key, distortion_vertices, num_distortion_vertices,
+                        distortion_indices, num_distortion_indices))
+        printf("Stored distortion mesh in %s\n", path);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// IPD change: only the distortion UVs depend on the lens separation, so
+// recompute those in place and re-upload the vertices, keeping positions,
+// indices, the VAO and the shaders. Returns the CPU time taken in ms.
+///////////////////////////////////////////////////////////////////////////////
+double updateLensSeparation(float lensSeparationInMeters)
+{
+    Timer tUpdate;
+    tUpdate.start();
+
+    if (distortion_fixed_mesh != NULL && distortion_vertices != NULL) {
+        // The built-in mesh is read-only: make it ours on the first change.
+        if (!timewarpArena.reserve(num_distortion_vertices, num_distortion_indices, 0)) {
+            fprintf(stderr, "Out of memory for the distortion mesh\n");
+            exit(1);
+        }
+        memcpy(timewarpArena.getVertices(), distortion_vertices, NUM_EYES * num_distortion_vertices * sizeof(distortion_vertex_t));
+        memcpy(timewarpArena.getIndices(), distortion_indices, num_distortion_indices * sizeof(GLuint));
+        distortion_vertices = timewarpArena.getVertices();
+        distortion_indices = timewarpArena.getIndices();
+        distortion_fixed_mesh = NULL;
+        if (distortion_vertices_compact != NULL)
+            distortion_vertices_compact = timewarpArena.getCompactVertices();
     }
 
-    // After successful link, detach shaders from shader program
-    glDetachShader(shader_program, vertex_shader_handle);
-    glDetachShader(shader_program, fragment_shader_handle);
+    hmd_info.lensSeparationInMeters = lensSeparationInMeters;
+    if (distortion_vertices != NULL)
+        UpdateDistortionUvs(&hmd_info, distortion_vertices, num_distortion_vertices, lensModel);
+    if (warpMode == WARP_MODE_PROCEDURAL && displayBackend != DISPLAY_BACKEND_CPU)
+        uploadProceduralWarpParams();   // a few dozen bytes, whatever the mesh size
+    else if (displayBackend != DISPLAY_BACKEND_CPU)
+        uploadDistortionVertices();
+    if (distortion_lut_tex != 0) {
+        // Every pixel moves with the lenses, so the whole table is redone.
+        DistortionLut_Generate(workerPool, &hmd_info, &distortion_lut);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, distortion_lut_tex);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, distortion_lut.width, distortion_lut.height, NUM_COLOR_CHANNELS,
+                        GL_RG, (distortion_lut.format == DISTORTION_LUT_HALF) ? GL_HALF_FLOAT : GL_FLOAT, distortion_lut.uvs);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
 
-    return shader_program;
+    tUpdate.stop();
+    return tUpdate.getElapsedTimeInMilliSec();
 }
 
-/* initGL()
- *
- * Initializes, links, and compiles relevant shaders
- * Initializes various VBOs for use in the timewarp distortion shader
- *
- */
-void initGL()
+
+
+///////////////////////////////////////////////////////////////////////////////
+// upload distortion_vertices without stalling on the frame in flight: the
+// vertex buffer holds two copies of the mesh, displayCB() draws from one
+// region while this writes the other, then the two swap. A fence left on
+// the region being retired keeps the next write to it from racing its draws.
+///////////////////////////////////////////////////////////////////////////////
+void uploadDistortionVertices()
 {
+    const int region = 1 - distortion_vertices_region;
+    const GLsizeiptr regionSize = NUM_EYES * num_distortion_vertices * distortion_vertex_size;
 
-    // GL features
-    //glEnable(GL_DEPTH_TEST);
-    //glEnable(GL_CULL_FACE);
+    if (distortion_vertices_fence[region]) {
+        glClientWaitSync(distortion_vertices_fence[region], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(distortion_vertices_fence[region]);
+        distortion_vertices_fence[region] = 0;
+    }
 
-    //glClearColor(0, 0, 0, 0);                   // background color
-    //glClearStencil(0);                          // clear stencil buffer
-    //glClearDepth(1.0f);                         // 0 is near, 1 is far
-    //glEnable(GL_SCISSOR_TEST);
-    glDepthFunc(GL_LEQUAL);
+    glBindBuffer(GL_ARRAY_BUFFER, distortion_vertices_vbo);
+    if (distortion_vertices_compact != NULL && !refitCompactMeshFormat()) {
+        // Out of bounds at this lens separation: both regions become float
+        // vertices, so the buffer is reallocated and nothing waits on it.
+        distortion_vertices_compact = NULL;
+        distortion_vertex_size = sizeof(distortion_vertex_t);
+        for (int i = 0; i < 2; i++) {
+            if (distortion_vertices_fence[i])
+                glDeleteSync(distortion_vertices_fence[i]);
+            distortion_vertices_fence[i] = 0;
+        }
+        const GLsizeiptr floatRegionSize = NUM_EYES * num_distortion_vertices * distortion_vertex_size;
+        glBufferData(GL_ARRAY_BUFFER, 2 * floatRegionSize, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, region * floatRegionSize, floatRegionSize, distortion_vertices);
+        setDistortionVertexAttribs();
+        glBindVertexArray(0);
+        distortion_vertices_region = region;
+        return;
+    }
+    if (distortion_vertices_compact != NULL) {
+        glBufferSubData(GL_ARRAY_BUFFER, region * regionSize, regionSize, distortion_vertices_compact);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, region * regionSize, regionSize, distortion_vertices);
+    }
 
-    // Create and bind global VAO object.
-    // This may not be necessary, and I can't
-    // really find very many good resources
-    // online as to why and how this is needed.
-    glGenVertexArrays(1, &tw_vao);
-    glBindVertexArray(tw_vao);
+    distortion_vertices_fence[distortion_vertices_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    distortion_vertices_region = region;
+}
 
-    ///////////////////////////////////////////////////////
-    // Create and compile timewarp distortion vertex shader
-    tw_shader_program = init_and_link_shader(timeWarpChromaticVertexProgramGLSL, timeWarpChromaticFragmentProgramGLSL);
 
-    //////////////////////
-    // VBO Initialization
 
-    // Acquire attribute and uniform locations from the compiled and linked shader program
-    distortion_pos_attr = glGetAttribLocation(tw_shader_program, "vertexPosition");
-    distortion_uv0_attr = glGetAttribLocation(tw_shader_program, "vertexUv0");
-    distortion_uv1_attr = glGetAttribLocation(tw_shader_program, "vertexUv1");
-    distortion_uv2_attr = glGetAttribLocation(tw_shader_program, "vertexUv2");
-    tw_start_transform_unif = glGetUniformLocation(tw_shader_program, "TimeWarpStartTransform");
-    tw_end_transform_unif = glGetUniformLocation(tw_shader_program, "TimeWarpEndTransform");
-    tw_eye_index_unif = glGetUniformLocation(tw_shader_program, "ArrayLayer");
-    eye_sampler_0 = glGetUniformLocation(tw_shader_program, "Texture[0]");
-    eye_sampler_1 = glGetUniformLocation(tw_shader_program, "Texture[1]");
+///////////////////////////////////////////////////////////////////////////////
+// the UV range moved with the lenses: refit the compact scale/bias, re-encode
+// and re-validate; false when the encoding no longer meets compactMeshTolerance
+///////////////////////////////////////////////////////////////////////////////
+bool refitCompactMeshFormat()
+{
+    float uvToPixels[2];
+    getUvToPixels(uvToPixels);
+
+    compact_mesh_error_t error;
+    CompactMesh_CreateFormat(&distortion_compact_format, distortion_compact_format.uvEncoding, distortion_vertices, num_distortion_vertices);
+    CompactMesh_Encode(&distortion_compact_format, distortion_vertices, distortion_vertices_compact, num_distortion_vertices);
+    CompactMesh_Validate(&distortion_compact_format, distortion_vertices, distortion_vertices_compact, num_distortion_vertices,
+                         distortion_indices, num_distortion_indices, screenWidth, screenHeight, uvToPixels, &error);
+    if (error.maxWarpError > compactMeshTolerance) {
+        printf("Compact mesh: warp error %.4f eye buffer pixels at lens separation %.4f m exceeds %.4f, switching to float vertices\n",
+               error.maxWarpError, hmd_info.lensSeparationInMeters, compactMeshTolerance);
+        return false;
+    }
+    return true;
+}
 
-    // Config distortion mesh position vbo
-    glGenBuffers(1, &distortion_positions_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, distortion_positions_vbo);
-    glBufferData(GL_ARRAY_BUFFER, NUM_EYES * (num_distortion_vertices * 3) * sizeof(GLfloat), distortion_positions, GL_STATIC_DRAW);
-    glVertexAttribPointer(distortion_pos_attr, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    //glEnableVertexAttribArray(distortion_pos_attr);
-
-    // Config distortion uv0 vbo
-    glGenBuffers(1, &distortion_uv0_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, distortion_uv0_vbo);
-    glBufferData(GL_ARRAY_BUFFER, NUM_EYES * (num_distortion_vertices * 2) * sizeof(GLfloat), distortion_uv0, GL_STATIC_DRAW);
-    glVertexAttribPointer(distortion_uv0_attr, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    //glEnableVertexAttribArray(distortion_uv0_attr);
-
-    // Config distortion uv1 vbo
-    glGenBuffers(1, &distortion_uv1_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, distortion_uv1_vbo);
-    glBufferData(GL_ARRAY_BUFFER, NUM_EYES * (num_distortion_vertices * 2) * sizeof(GLfloat), distortion_uv1, GL_STATIC_DRAW);
-    glVertexAttribPointer(distortion_uv1_attr, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    //glEnableVertexAttribArray(distortion_uv1_attr);
-
-    // Config distortion uv2 vbo
-    glGenBuffers(1, &distortion_uv2_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, distortion_uv2_vbo);
-    glBufferData(GL_ARRAY_BUFFER, NUM_EYES * (num_distortion_vertices * 2) * sizeof(GLfloat), distortion_uv2, GL_STATIC_DRAW);
-    glVertexAttribPointer(distortion_uv2_attr, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    //glEnableVertexAttribArray(distortion_uv2_attr);
 
-    // Config distortion mesh indices vbo
-    glGenBuffers(1, &distortion_indices_vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, distortion_indices_vbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_distortion_indices * sizeof(GLuint), distortion_indices, GL_STATIC_DRAW);
 
-    glGenVertexArrays(1, &basic_vao);
-    glBindVertexArray(basic_vao);
+///////////////////////////////////////////////////////////////////////////////
+// upload a distortion LUT as a texture array with one layer per color
+// channel; it is only ever read with texelFetch(), so no filtering or mips
+///////////////////////////////////////////////////////////////////////////////
+GLuint createDistortionLutTexture(const distortion_lut_t* lut)
+{
+    const bool half = (lut->format == DISTORTION_LUT_HALF);
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, half ? GL_RG16F : GL_RG32F, lut->width, lut->height, NUM_COLOR_CHANNELS, 0,
+                 GL_RG, half ? GL_HALF_FLOAT : GL_FLOAT, lut->uvs);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texture;
+}
 
-    // Create the basic shader program
-    basic_shader_program = init_and_link_shader (basicVertexShader, basicFragmentShader);
 
-    // Acquire attribute and uniform locations from the compiled and linked shader program
-    basic_pos_attr = glGetAttribLocation(basic_shader_program, "vertexPosition");
-    basic_uv_attr = glGetAttribLocation(basic_shader_program, "vertexUV");
 
-    GLenum err;
+///////////////////////////////////////////////////////////////////////////////
+// warp the eye buffer onto the bound framebuffer with the LUT warp: both eyes
+// in one full screen triangle, with the uploaded scanout transforms
+///////////////////////////////////////////////////////////////////////////////
+void drawDistortionLut(GLuint lutTexture)
+{
+    glUseProgram(tw_lut_shader_program);
 
-    // Config basic mesh position vbo
-    glGenBuffers(1, &basic_pos_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, basic_pos_vbo);
-    glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(GLfloat), plane_vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(basic_pos_attr, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, lutTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
 
-    err = glGetError();
+    glBindVertexArray(tw_lut_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    GLenum err = glGetError();
     if(err){
-        printf("Error after configuring basic position vbo: %x\n", err);
+        printf("drawDistortionLut, error after drawArrays, %x", err);
     }
+}
 
-    // Config basic mesh uv vbo
-    glGenBuffers(1, &basic_uv_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, basic_uv_vbo);
-    glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(GLfloat), plane_uvs, GL_STATIC_DRAW);
-    glVertexAttribPointer(basic_uv_attr, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
-    err = glGetError();
-    if(err){
-        printf("Error after configuring basic uv vbo: %x\n", err);
+
+///////////////////////////////////////////////////////////////////////////////
+// copy the lens parameters of hmd_info into the procedural warp's uniform
+// block; this is all a lens change costs in that mode
+///////////////////////////////////////////////////////////////////////////////
+void uploadProceduralWarpParams()
+{
+    procedural_warp_params_t params;
+    if (!ProceduralWarp_GetParams(&hmd_info, &params)) {
+        fprintf(stderr, "Procedural warp: %d spline knots, at most %d supported\n", hmd_info.numKnots, PROCEDURAL_WARP_MAX_KNOTS);
+        return;
     }
+    glBindBuffer(GL_UNIFORM_BUFFER, tw_procedural_params_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(params), &params);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
 
-    // Config basic mesh indices vbo
-    glGenBuffers(1, &basic_indices_vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, basic_indices_vbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLfloat), plane_indices, GL_STATIC_DRAW);
 
-    err = glGetError();
+
+///////////////////////////////////////////////////////////////////////////////
+// warp the eye buffer onto the bound framebuffer with the procedural warp:
+// one instance per eye, no vertex or index buffers, with the uploaded
+// scanout transforms
+///////////////////////////////////////////////////////////////////////////////
+void drawProceduralWarp()
+{
+    glUseProgram(tw_procedural_shader_program);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, tw_procedural_params_ubo);
+    glBindVertexArray(tw_procedural_vao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, ProceduralWarp_GetVertexCount(&hmd_info), NUM_EYES);
+
+    GLenum err = glGetError();
     if(err){
-        printf("Error after configuring basic uv vbo: %x\n", err);
+        printf("drawProceduralWarp, error after drawArrays, %x", err);
     }
+}
 
-    // Generate texture for prerendered_image Image
-    glGenTextures(1, &prerendered_image_tex);
-    glBindTexture(GL_TEXTURE_2D, prerendered_image_tex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 
-    //glBindBuffer(GL_TEXTURE_2D, prerendered_image_tex);
-    glTexImage2D(GL_TEXTURE_2D, 0,
-        prerendered_image->hasAlpha ? GL_RGBA : GL_RGB,
-        prerendered_image->width,
-        prerendered_image->height,
-        0,
-        prerendered_image->hasAlpha ? GL_RGBA : GL_RGB,
-        GL_UNSIGNED_BYTE,
-        prerendered_image->texture);
 
-    return;
+///////////////////////////////////////////////////////////////////////////////
+// capture the vertices the procedural warp generates with transform feedback
+// and report how far they are from the CPU distortion mesh's, in display
+// pixels for the positions and eye buffer pixels for the UVs
+///////////////////////////////////////////////////////////////////////////////
+void validateProceduralWarp()
+{
+    static const char* const varyings[4] = { "meshPosition", "meshUv0", "meshUv1", "meshUv2" };
+    const int floatsPerVertex = 8;
+    const int vertexCount = ProceduralWarp_GetVertexCount(&hmd_info);
+    const int tilesWide = hmd_info.eyeTilesWide;
+
+    if (distortion_vertices == NULL ||
+        num_distortion_vertices != (GLuint)((hmd_info.eyeTilesWide + 1) * (hmd_info.eyeTilesHigh + 1))) {
+        printf("Validate: no uniform CPU mesh to check the procedural warp against\n");
+        return;
+    }
+
+    GLuint program = init_and_link_shader(timeWarpProceduralCaptureVertexProgramGLSL, timeWarpChromaticFragmentProgramGLSL, varyings, 4);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "DistortionParameters"), 0);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "ScanoutTransforms"), SCANOUT_TRANSFORMS_BINDING);
+
+    GLuint feedback;
+    const GLsizeiptr feedbackSize = (GLsizeiptr)NUM_EYES * vertexCount * floatsPerVertex * sizeof(GLfloat);
+    glGenBuffers(1, &feedback);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, feedback);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, feedbackSize, NULL, GL_STATIC_READ);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedback);
+
+    glUseProgram(program);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, tw_procedural_params_ubo);
+    glBindVertexArray(tw_procedural_vao);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_TRIANGLES);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, NUM_EYES);
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    GLfloat* captured = (GLfloat*) malloc(feedbackSize);
+    glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedbackSize, captured);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDeleteBuffers(1, &feedback);
+    glUseProgram(0);
+    glDeleteProgram(program);
+
+    // Instances come out one after the other, each in gl_VertexID order.
+    static const int corners[6][2] = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+    float uvToPixels[2];
+    getUvToPixels(uvToPixels);
+    float maxPositionError = 0.0f;
+    float maxUvError = 0.0f;
+    for (int eye = 0; eye < NUM_EYES; eye++) {
+        for (int i = 0; i < vertexCount; i++) {
+            const GLfloat* v = captured + ((size_t)eye * vertexCount + i) * floatsPerVertex;
+            const int tile = i / 6;
+            const int x = tile % tilesWide + corners[i % 6][0];
+            const int y = tile / tilesWide + corners[i % 6][1];
+            const distortion_vertex_t* ref = &distortion_vertices[eye * num_distortion_vertices + y * (tilesWide + 1) + x];
+
+            const float dx = fabsf(v[0] - ref->position.x) * 0.5f * screenWidth;
+            const float dy = fabsf(v[1] - ref->position.y) * 0.5f * screenHeight;
+            maxPositionError = fmaxf(maxPositionError, fmaxf(dx, dy));
+
+            const uv_coord_t* refUvs[NUM_COLOR_CHANNELS] = { &ref->uv0, &ref->uv1, &ref->uv2 };
+            for (int c = 0; c < NUM_COLOR_CHANNELS; c++) {
+                maxUvError = fmaxf(maxUvError, fabsf(v[2 + c * 2 + 0] - refUvs[c]->u) * uvToPixels[0]);
+                maxUvError = fmaxf(maxUvError, fabsf(v[2 + c * 2 + 1] - refUvs[c]->v) * uvToPixels[1]);
+            }
+        }
+    }
+    free(captured);
 
+    printf("Validate: procedural vs CPU mesh vertices, max position error = %g display pixels, max UV error = %g eye buffer pixels\n",
+           maxPositionError, maxUvError);
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// initialize global variables
+// pick the compact vertex encoding with the smallest warp error, if it is
+// within compactMeshTolerance; distortion_vertices stay the float master copy
 ///////////////////////////////////////////////////////////////////////////////
-bool initSharedMem(const char* fname)
+bool chooseCompactMeshFormat()
 {
-    init_images(fname);
+    float uvToPixels[2];
+    getUvToPixels(uvToPixels);
+
+    distortion_vertices_compact = timewarpArena.getCompactVertices();
+    const compact_uv_encoding_t encodings[2] = { COMPACT_UV_HALF, COMPACT_UV_SNORM16 };
+    float bestError = 0.0f;
+    int best = -1;
+    for (int i = 0; i < 2; i++) {
+        compact_mesh_format_t format;
+        compact_mesh_error_t error;
+        CompactMesh_CreateFormat(&format, encodings[i], distortion_vertices, num_distortion_vertices);
+        CompactMesh_Encode(&format, distortion_vertices, distortion_vertices_compact, num_distortion_vertices);
+        CompactMesh_Validate(&format, distortion_vertices, distortion_vertices_compact, num_distortion_vertices,
+                             distortion_indices, num_distortion_indices, screenWidth, screenHeight, uvToPixels, &error);
+        printf("Compact mesh, %s UVs: position error %.4f display pixels, UV error %.4f, warp error %.4f eye buffer pixels\n",
+               CompactMesh_GetEncodingName(encodings[i]), error.maxPositionError, error.maxUvError, error.maxWarpError);
+        if (best < 0 || error.maxWarpError < bestError) {
+            best = i;
+            bestError = error.maxWarpError;
+        }
+    }
 
-    screenWidth = SCREEN_WIDTH;
-    screenHeight = SCREEN_HEIGHT;
+    if (bestError > compactMeshTolerance) {
+        printf("Compact mesh: no encoding within %.4f pixels, keeping float vertices\n", compactMeshTolerance);
+        distortion_vertices_compact = NULL;
+        return false;
+    }
 
-    mouseLeftDown = mouseRightDown = false;
-    mouseX = mouseY = 0;
+    CompactMesh_CreateFormat(&distortion_compact_format, encodings[best], distortion_vertices, num_distortion_vertices);
+    CompactMesh_Encode(&distortion_compact_format, distortion_vertices, distortion_vertices_compact, num_distortion_vertices);
+    printf("Compact mesh: using %s UVs, %d instead of %d bytes per vertex\n",
+           CompactMesh_GetEncodingName(encodings[best]), (int)sizeof(distortion_vertex_compact_t), (int)sizeof(distortion_vertex_t));
+    return true;
+}
 
-    fboId = rboColorId = rboDepthId = textureId = 0;
-    fboSupported = fboUsed = false;
-    playTime = renderToTextureTime = timewarpTime = 0;
 
-    // Generate reference HMD and physical body dimensions
-    GetDefaultHmdInfo(SCREEN_WIDTH, SCREEN_HEIGHT, &hmd_info);
-    GetDefaultBodyInfo(&body_info);
 
-    // Construct timewarp meshes and other data
-    BuildTimewarp(&hmd_info);
+///////////////////////////////////////////////////////////////////////////////
+// eye buffer pixels per unit of distortion UV: a UV offset du moves the
+// texture lookup by 0.5 * P00 * du * width
+///////////////////////////////////////////////////////////////////////////////
+void getUvToPixels(float uvToPixels[2])
+{
+    uvToPixels[0] = 0.5f * basicProjection.m[0][0] * TEXTURE_WIDTH;
+    uvToPixels[1] = 0.5f * basicProjection.m[1][1] * TEXTURE_HEIGHT;
+}
+
 
-    return true;
+
+///////////////////////////////////////////////////////////////////////////////
+// adaptive mesh options for this HMD; the error bound is in eye buffer pixels
+///////////////////////////////////////////////////////////////////////////////
+void getAdaptiveMeshParams(const hmd_info_t* hmdInfo, adaptive_mesh_params_t* params)
+{
+    memset(params, 0, sizeof(adaptive_mesh_params_t));
+    params->tolerancePixels = adaptiveMeshTolerance;
+    params->maxCellPixels = ADAPTIVE_MESH_MAX_CELL;
+    getUvToPixels(params->uvToPixels);
+    params->minCellPixels = GetAdaptiveMeshMinCellPixels(hmdInfo, params->uvToPixels, params->tolerancePixels, params->maxCellPixels);
 }
 
 
@@ -880,20 +2554,67 @@ bool initSharedMem(const char* fname)
 ///////////////////////////////////////////////////////////////////////////////
 void clearSharedMem()
 {
+    // release the CPU-side distortion mesh
+    if(distortion_mesh_cache.mapping != NULL)
+    {
+        MeshCache_Unload(&distortion_mesh_cache);
+    }
+    // whatever was built at runtime lives in the arena, the built-in mesh is static
+    timewarpArena.release();
+    distortion_vertices = NULL;
+    distortion_indices = NULL;
+    distortion_fixed_mesh = NULL;
+    distortion_vertices_compact = NULL;
+    DistortionLut_Destroy(&distortion_lut);
+    if(lensModel != NULL)
+        DistortionModel_Destroy(&distortionModel);
+    lensModel = NULL;
+
+    // nothing was created on the GPU without a context
+    if(displayBackend == DISPLAY_BACKEND_CPU)
+        return;
+
     glDeleteTextures(1, &textureId);
     textureId = 0;
 
-    glDeleteBuffers(1, &distortion_positions_vbo);
+    for(int region = 0; region < 2; region++)
+    {
+        if(distortion_vertices_fence[region])
+            glDeleteSync(distortion_vertices_fence[region]);
+        distortion_vertices_fence[region] = 0;
+    }
+    glDeleteBuffers(1, &distortion_vertices_vbo);
     glDeleteBuffers(1, &distortion_indices_vbo);
-    glDeleteBuffers(1, &distortion_uv0_vbo);
+    glDeleteTextures(1, &distortion_lut_tex);
+    distortion_lut_tex = 0;
+    glDeleteVertexArrays(1, &tw_lut_vao);
+    glDeleteProgram(tw_lut_shader_program);
+    glDeleteBuffers(1, &tw_procedural_params_ubo);
+    tw_procedural_params_ubo = 0;
+    glDeleteVertexArrays(1, &tw_procedural_vao);
+    glDeleteProgram(tw_procedural_shader_program);
+    glDeleteProgram(tw_positional_shader_program);
+    glDeleteBuffers(1, &tw_scanout_ubo);
+    tw_scanout_ubo = 0;
 
     // clean up FBO, RBO
     if(fboSupported)
     {
         glDeleteFramebuffers(1, &fboId);
         fboId = 0;
-        glDeleteRenderbuffers(1, &rboDepthId);
-        rboDepthId = 0;
+        glDeleteTextures(1, &depthTextureId);
+        depthTextureId = 0;
+    }
+
+    // clean up the headless display FBO and context
+    if(displayBackend == DISPLAY_BACKEND_EGL)
+    {
+        glDeleteFramebuffers(1, &displayFboId);
+        displayFboId = 0;
+        glDeleteRenderbuffers(1, &displayColorRboId);
+        glDeleteRenderbuffers(1, &displayDepthRboId);
+        displayColorRboId = displayDepthRboId = 0;
+        destroyEGL();
     }
 }
 
@@ -1277,38 +2998,216 @@ std::string convertInternalFormatToString(GLenum format)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Get timewarp transform from projection/view/new view matrix
+// Get the timewarp transforms across the scanout for an eye buffer
+// rendered at renderTime and warped at time
+///////////////////////////////////////////////////////////////////////////////
+void calculateTimeWarpTransforms(float renderTime, float time, scanout_transforms_t* scanout)
+{
+    // The head tracker has samples up to now; the display scans
+    // the frame out from now until the end of the refresh.
+    // The distortion shader will lerp between
+    // these predictive view transformations
+    // as it renders along the scan axis,
+    // compensating for display panel refresh delay (wow!)
+    // (Exaggerated effect, this is set to 0.1s refresh time.)
+    updateHeadPosePredictor(time);
+    Scanout_Init(scanout, scanoutDirection, scanoutSlices);
+
+    // The eye buffer stands for a frame rendered with the tracked
+    // head pose at its render time, which the history has.
+    timed_pose_t renderPose;
+    if (!headPoseHistory.getPose(renderTime, &renderPose)) {
+        const ksQuatf identity = { 0.0f, 0.0f, 0.0f, 1.0f };
+        renderPose.orientation = identity;
+    }
+    const ksQuatf renderOrientation = renderPose.orientation;
+
+    // Calculate the timewarp transformation matrices, one at each
+    // slice boundary. These are a product of the last-known-good
+    // orientation and the predictive ones. The poses are rotation only,
+    // so the quaternion path writes the 3x4 transforms the shaders take directly.
+    for (int i = 0; i <= scanoutSlices; i++) {
+        ksQuatf orientation;
+        PosePredictor_Predict(&headPosePredictor, time + SCANOUT_SECONDS * i / scanoutSlices, &orientation);
+        CalculateRotationTimeWarpTransform(&scanout->transforms[i], &basicProjection, &renderOrientation, &orientation);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// copy scanout transforms into the ScanoutTransforms block of the warps
+///////////////////////////////////////////////////////////////////////////////
+void uploadScanoutTransforms(const scanout_transforms_t* scanout)
+{
+    // Only the transforms in use.
+    const GLsizeiptr size = offsetof(scanout_transforms_t, transforms) + ((int)scanout->slices + 1) * sizeof(ksMatrix3x4f);
+    glBindBuffer(GL_UNIFORM_BUFFER, tw_scanout_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, scanout);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Get the start/end of scanout head translations for the positional warp of
+// an eye buffer rendered at renderTime and warped at time; call after
+// calculateTimeWarpTransforms(), which brings the history up to time. The
+// position is extrapolated linearly, so these two need no scanout slices.
+///////////////////////////////////////////////////////////////////////////////
+void calculateTimeWarpTranslations(float renderTime, float time, ksVector3f* start, ksVector3f* end)
+{
+    timed_pose_t renderPose;
+    if (!headPoseHistory.getPose(renderTime, &renderPose)) {
+        const ksQuatf identity = { 0.0f, 0.0f, 0.0f, 1.0f };
+        renderPose.orientation = identity;
+        renderPose.position.x = renderPose.position.y = renderPose.position.z = 0.0f;
+    }
+
+    ksVector3f positionBegin;
+    ksVector3f positionEnd;
+    predictHeadPosition(time, &positionBegin);
+    predictHeadPosition(time + SCANOUT_SECONDS, &positionEnd);
+
+    CalculatePositionalTimeWarpTranslation(start, &basicProjection, &renderPose.orientation, &renderPose.position, &positionBegin);
+    CalculatePositionalTimeWarpTranslation(end, &basicProjection, &renderPose.orientation, &renderPose.position, &positionEnd);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// head position at time: from the history up to its newest pose, and past
+// that extrapolated with the velocity of its last HEAD_VELOCITY_SECONDS
+///////////////////////////////////////////////////////////////////////////////
+void predictHeadPosition(double time, ksVector3f* position)
+{
+    double oldest, newest;
+    timed_pose_t pose;
+    if (!headPoseHistory.getTimeRange(&oldest, &newest) || !headPoseHistory.getPose(time, &pose)) {
+        position->x = position->y = position->z = 0.0f;
+        return;
+    }
+    *position = pose.position;
+
+    // getPose() clamps to the newest pose, which may have moved on since
+    // getTimeRange(), so extrapolate from the pose it returned.
+    timed_pose_t earlier;
+    const double since = (pose.time - HEAD_VELOCITY_SECONDS > oldest) ? pose.time - HEAD_VELOCITY_SECONDS : oldest;
+    if (time <= pose.time || since >= pose.time || !headPoseHistory.getPose(since, &earlier))
+        return;
+    const float scale = (float)((time - pose.time) / (pose.time - earlier.time));
+    position->x += (pose.position.x - earlier.position.x) * scale;
+    position->y += (pose.position.y - earlier.position.y) * scale;
+    position->z += (pose.position.z - earlier.position.z) * scale;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// feed the predictor the samples of the head tracker up to the given time:
+// whatever the sensor thread published since the last frame, or else the
+// samples a tracker on the simulated head motion would have delivered
+///////////////////////////////////////////////////////////////////////////////
+void updateHeadPosePredictor(double time)
+{
+    if (headTracker.isRunning()) {
+        if (headPosePredictor.model != posePrediction)
+            PosePredictor_Create(&headPosePredictor, posePrediction);
+
+        // Neither step waits on the sensor thread. The ring has the gyro
+        // history for the filter, the slot the newest sample even when the
+        // ring overflowed while the warp was behind.
+        const double begin = PoseHandoff_GetTime();
+        pose_sample_t sample;
+        while (headPoseHandoff.popSample(&sample)) {
+            if (headPosePredictor.numSamples == 0 || sample.time > headPosePredictor.latest.time)
+                PosePredictor_AddSample(&headPosePredictor, &sample);
+        }
+        int retries = 0;
+        if (headPoseHandoff.readLatest(&sample, &retries) &&
+            (headPosePredictor.numSamples == 0 || sample.time > headPosePredictor.latest.time))
+            PosePredictor_AddSample(&headPosePredictor, &sample);
+        poseReadStats.add(PoseHandoff_GetTime() - begin);
+        poseReadRetries += retries;
+        if (headPosePredictor.numSamples > 0)
+            poseAgeStats.add(time - headPosePredictor.latest.time);
+        return;
+    }
+
+    // Restart on the first call, when time goes back, or after a long gap.
+    double next = headPosePredictor.latest.time + SIMULATED_IMU_PERIOD;
+    if (headPosePredictor.numSamples == 0 || headPosePredictor.model != posePrediction ||
+        time < headPosePredictor.latest.time || time - next > SIMULATED_IMU_HISTORY) {
+        PosePredictor_Create(&headPosePredictor, posePrediction);
+        next = time - SIMULATED_IMU_HISTORY;
+    }
+
+    for (; next <= time; next += SIMULATED_IMU_PERIOD) {
+        pose_sample_t sample;
+        sampleHeadTracker(&sample, next);
+        PosePredictor_AddSample(&headPosePredictor, &sample);
+        recordHeadPose(&sample);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// one sample of a head tracker on the simulated head motion
+///////////////////////////////////////////////////////////////////////////////
+void sampleHeadTracker(pose_sample_t* sample, double time)
+{
+    sample->time = time;
+    GetHmdOrientationForTime(&sample->orientation, (float)time);
+
+    // The gyro reads the rate of the motion around the sample.
+    ksQuatf before, after;
+    GetHmdOrientationForTime(&before, (float)(time - 0.5 * SIMULATED_IMU_PERIOD));
+    GetHmdOrientationForTime(&after, (float)(time + 0.5 * SIMULATED_IMU_PERIOD));
+    PosePredictor_GetAngularVelocity(&before, &after, (float)SIMULATED_IMU_PERIOD, &sample->angularVelocity);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add a tracker sample to the pose history, with the position of the
+// simulated head at its time (the predictor is rotation only)
+///////////////////////////////////////////////////////////////////////////////
+void recordHeadPose(const pose_sample_t* sample)
+{
+    timed_pose_t pose;
+    pose.time = sample->time;
+    pose.orientation = sample->orientation;
+    GetHmdPositionForTime(&pose.position, (float)sample->time);
+    headPoseHistory.add(pose);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// with --sensor-thread, sample the simulated head tracker on a thread of its
+// own from now on, on the same clock as the warp
+///////////////////////////////////////////////////////////////////////////////
+void startHeadTracker()
+{
+    if (!sensorThread)
+        return;
+
+    // The thread reads its own copy of the timer, Timer is not thread safe.
+    // It is also the one writer of the pose history, the warp reads it.
+    Timer clock = timer;
+    headTracker.start(&headPoseHandoff, SIMULATED_IMU_PERIOD, [clock](pose_sample_t* sample) mutable {
+        sampleHeadTracker(sample, clock.getElapsedTime());
+        recordHeadPose(sample);
+    });
+
+    // The predictor needs a sample before the first frame.
+    pose_sample_t sample;
+    while (!headPoseHandoff.readLatest(&sample))
+        std::this_thread::yield();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stop the sensor thread and report how the handoff did
 ///////////////////////////////////////////////////////////////////////////////
-void CalculateTimeWarpTransform( ksMatrix4x4f * transform, const ksMatrix4x4f * renderProjectionMatrix,
-                                        const ksMatrix4x4f * renderViewMatrix, const ksMatrix4x4f * newViewMatrix )
+void stopHeadTracker()
 {
-    // Convert the projection matrix from [-1, 1] space to [0, 1] space.
-    const ksMatrix4x4f texCoordProjection =
-    { {
-        { 0.5f * renderProjectionMatrix->m[0][0],        0.0f,                                           0.0f,  0.0f },
-        { 0.0f,                                          0.5f * renderProjectionMatrix->m[1][1],         0.0f,  0.0f },
-        { 0.5f * renderProjectionMatrix->m[2][0] - 0.5f, 0.5f * renderProjectionMatrix->m[2][1] - 0.5f, -1.0f,  0.0f },
-        { 0.0f,                                          0.0f,                                           0.0f,  1.0f }
-    } };
-
-    // Calculate the delta between the view matrix used for rendering and
-    // a more recent or predicted view matrix based on new sensor input.
-    ksMatrix4x4f inverseRenderViewMatrix;
-    ksMatrix4x4f_InvertHomogeneous( &inverseRenderViewMatrix, renderViewMatrix );
-
-    ksMatrix4x4f deltaViewMatrix;
-    ksMatrix4x4f_Multiply( &deltaViewMatrix, &inverseRenderViewMatrix, newViewMatrix );
-
-    ksMatrix4x4f inverseDeltaViewMatrix;
-    ksMatrix4x4f_InvertHomogeneous( &inverseDeltaViewMatrix, &deltaViewMatrix );
-
-    // Make the delta rotation only.
-    inverseDeltaViewMatrix.m[3][0] = 0.0f;
-    inverseDeltaViewMatrix.m[3][1] = 0.0f;
-    inverseDeltaViewMatrix.m[3][2] = 0.0f;
-
-    // Accumulate the transforms.
-    ksMatrix4x4f_Multiply( transform, &texCoordProjection, &inverseDeltaViewMatrix );
+    if (!headTracker.isRunning())
+        return;
+    headTracker.stop();
+
+    printf("Sensor thread at %.0f Hz: %d samples dropped by the ring, %d seqlock retries\n",
+           1.0 / SIMULATED_IMU_PERIOD, headPoseHandoff.getDropCount(), poseReadRetries);
+    headTracker.getIntervalStats().print("sample interval");
+    headPoseHandoff.getPublishStats().print("publish (sensor thread)");
+    poseReadStats.print("read (warp thread)");
+    poseAgeStats.print("newest sample age");
 }
 
 void init_images (const char* fname) {
@@ -1352,20 +3251,32 @@ void displayCB()
     glEnableVertexAttribArray(basic_pos_attr);
     glEnableVertexAttribArray(basic_uv_attr);
 
-    // Draw basic plane to put something in the FBO for testing
+    // Draw basic plane to put something in the FBO for testing,
+    // with its depth when the warp is going to need it
+    const bool writeDepth = positionalWarp || warpBenchmark;
+    if (writeDepth) {
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_ALWAYS);
+    }
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+    if (writeDepth) {
+        glDepthFunc(GL_LEQUAL);
+        glDisable(GL_DEPTH_TEST);
+    }
 
     // measure the elapsed time of render-to-texture
     tApp.stop();
     renderToTextureTime = tApp.getElapsedTimeInMilliSec();
-    printf("App time = %f\n", renderToTextureTime);
+    if(printFrameTimes)
+        printf("App time = %f\n", renderToTextureTime);
 
     ////////////////////////////////////////////////////////////////////////
     // rendering as normal /////////////////////////////////////////////////
     tWarp.start();
 
     // back to normal window-system-provided framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0); // unbind
+    // (or its offscreen stand-in when running headless)
+    glBindFramebuffer(GL_FRAMEBUFFER, displayFboId);
 
     if(glGetError()){
         printf("displayCB, error after unbinding FBO after render");
@@ -1387,54 +3298,54 @@ void displayCB()
     glClearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-    // Use the timewarp program
-    glUseProgram(tw_shader_program);
-
-    // Identity viewMatrix, simulates
-    // the rendered scene's view matrix.
-    ksMatrix4x4f viewMatrix;
-    ksMatrix4x4f_CreateIdentity(&viewMatrix);
-
-    // We simulate two asynchronous view matrices,
-    // one at the beginning of display refresh,
-    // and one at the end of display refresh.
-    // The distortion shader will lerp between
-    // these two predictive view transformations
-    // as it renders across the horizontal view,
-    // compensating for display panel refresh delay (wow!)
-    ksMatrix4x4f viewMatrixBegin;
-    ksMatrix4x4f viewMatrixEnd;
-
-    // Get HMD view matrices, one for the beginning of the
-    // panel refresh, one for the end. (Exaggerated effect,
-    // this is set to 0.1s refresh time.)
-    GetHmdViewMatrixForTime(&viewMatrixBegin, playTime);
-    GetHmdViewMatrixForTime(&viewMatrixEnd, playTime + 0.1f);
-
-    // Calculate the timewarp transformation matrices.
-    // These are a product of the last-known-good view matrix
-    // and the predictive transforms.
-    ksMatrix4x4f timeWarpStartTransform4x4;
-    ksMatrix4x4f timeWarpEndTransform4x4;
-
-    // Calculate timewarp transforms using predictive view transforms
-    CalculateTimeWarpTransform(&timeWarpStartTransform4x4, &basicProjection, &viewMatrix, &viewMatrixBegin);
-    CalculateTimeWarpTransform(&timeWarpEndTransform4x4, &basicProjection, &viewMatrix, &viewMatrixEnd);
-
-    // We transform from 4x4 to 3x4 as we operate on vec3's in NDC space
-    ksMatrix3x4f timeWarpStartTransform3x4;
-    ksMatrix3x4f timeWarpEndTransform3x4;
-    ksMatrix3x4f_CreateFromMatrix4x4f( &timeWarpStartTransform3x4, &timeWarpStartTransform4x4 );
-    ksMatrix3x4f_CreateFromMatrix4x4f( &timeWarpEndTransform3x4, &timeWarpEndTransform4x4 );
+    // The sensor thread has samples up to just now, so predict from
+    // the time of the warp rather than from the start of the frame.
+    const float warpTime = headTracker.isRunning() ? (float)timer.getElapsedTime() : playTime;
+    calculateTimeWarpTransforms(playTime, warpTime, &timeWarpScanout);
+
+    if (warpMode == WARP_MODE_LUT || warpMode == WARP_MODE_PROCEDURAL) {
+        uploadScanoutTransforms(&timeWarpScanout);
+        if (warpMode == WARP_MODE_LUT)
+            drawDistortionLut(distortion_lut_tex);
+        else
+            drawProceduralWarp();
+
+        tWarp.stop();
+        timewarpTime = tWarp.getElapsedTimeInMilliSec();
+        if(printFrameTimes)
+            printf("Warp time = %f\n", timewarpTime);
+
+        presentFrame();
+        return;
+    }
 
     // Push timewarp transform matrices to timewarp shader
-    glUniformMatrix3x4fv(tw_start_transform_unif, 1, GL_FALSE, (GLfloat*)&(timeWarpStartTransform3x4.m[0][0]));
-    glUniformMatrix3x4fv(tw_end_transform_unif, 1, GL_FALSE,  (GLfloat*)&(timeWarpEndTransform3x4.m[0][0]));
-
-    // Debugging aid, toggle switch for rendering in the fragment shader
-    glUniform1i(glGetUniformLocation(tw_shader_program, "ArrayIndex"), 0);
-
-    glUniform1i(eye_sampler_0, 0);
+    // Compact vertices carry their UV scale/bias in the transforms.
+    scanout_transforms_t scanout = timeWarpScanout;
+    if (distortion_vertex_size != sizeof(distortion_vertex_t)) {
+        for (int i = 0; i <= (int)scanout.slices; i++)
+            CompactMesh_FoldUvScaleBias(&distortion_compact_format, &timeWarpScanout.transforms[i], &scanout.transforms[i]);
+    }
+    uploadScanoutTransforms(&scanout);
+    if (positionalWarp) {
+        // Use the positional program, with the head translation and the depth
+        ksVector3f startTranslation, endTranslation;
+        calculateTimeWarpTranslations(playTime, warpTime, &startTranslation, &endTranslation);
+        glUseProgram(tw_positional_shader_program);
+        glUniform3fv(tw_positional_start_translation_unif, 1, &startTranslation.x);
+        glUniform3fv(tw_positional_end_translation_unif, 1, &endTranslation.x);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depthTextureId);
+        glActiveTexture(GL_TEXTURE0);
+    } else {
+        // Use the timewarp program
+        glUseProgram(tw_shader_program);
+
+        // Debugging aid, toggle switch for rendering in the fragment shader
+        glUniform1i(glGetUniformLocation(tw_shader_program, "ArrayIndex"), 0);
+
+        glUniform1i(eye_sampler_0, 0);
+    }
 
     // Bind the FBO's previously-generated glTexture
     glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
@@ -1444,37 +3355,15 @@ void displayCB()
     // Loop over each eye.
     for(int eye = 0; eye < NUM_EYES; eye++){
 
-        // The distortion_positions_vbo GPU buffer already contains
+        // The distortion_vertices_vbo GPU buffer already contains
         // the distortion mesh for both eyes! They are contiguously
-        // laid out in GPU memory. Therefore, on each eye render,
-        // we set the attribute pointer to be offset by the full
-        // eye's distortion mesh size, rendering the correct eye mesh
-        // to that region of the screen. This prevents re-uploading
-        // GPU data for each eye.
-        glBindBuffer(GL_ARRAY_BUFFER, distortion_positions_vbo);
-        glVertexAttribPointer(distortion_pos_attr, 3, GL_FLOAT, GL_FALSE, 0, (void*)(eye * num_distortion_vertices * sizeof(mesh_coord3d_t)));
-        glEnableVertexAttribArray(distortion_pos_attr);
-
-        // We do the exact same thing for the UV GPU memory.
-        glBindBuffer(GL_ARRAY_BUFFER, distortion_uv0_vbo);
-        glVertexAttribPointer(distortion_uv0_attr, 2, GL_FLOAT, GL_FALSE, 0, (void*)(eye * num_distortion_vertices * sizeof(mesh_coord2d_t)));
-        glEnableVertexAttribArray(distortion_uv0_attr);
-
-        // We do the exact same thing for the UV GPU memory.
-        glBindBuffer(GL_ARRAY_BUFFER, distortion_uv1_vbo);
-        glVertexAttribPointer(distortion_uv1_attr, 2, GL_FLOAT, GL_FALSE, 0, (void*)(eye * num_distortion_vertices * sizeof(mesh_coord2d_t)));
-        glEnableVertexAttribArray(distortion_uv1_attr);
-
-        // We do the exact same thing for the UV GPU memory.
-        glBindBuffer(GL_ARRAY_BUFFER, distortion_uv2_vbo);
-        glVertexAttribPointer(distortion_uv2_attr, 2, GL_FLOAT, GL_FALSE, 0, (void*)(eye * num_distortion_vertices * sizeof(mesh_coord2d_t)));
-        glEnableVertexAttribArray(distortion_uv2_attr);
-
-
-        // Interestingly, the element index buffer is identical for both eyes, and is
-        // reused for both eyes. Therefore glDrawElements can be immediately called,
-        // with the UV and position buffers correctly offset.
-        glDrawElements(GL_TRIANGLES, num_distortion_indices, GL_UNSIGNED_INT, (void*)0);
+        // laid out in GPU memory, and the element index buffer is
+        // identical for both eyes. So each eye is just a base vertex
+        // offset into the same buffer, with no rebinding or attribute
+        // respecification per eye. The same goes for the region
+        // uploadDistortionVertices() last wrote.
+        glDrawElementsBaseVertex(GL_TRIANGLES, num_distortion_indices, distortion_index_type, (void*)0,
+                                 (distortion_vertices_region * NUM_EYES + eye) * num_distortion_vertices);
 
         err = glGetError();
         if(err){
@@ -1484,9 +3373,10 @@ void displayCB()
 
     tWarp.stop();
     timewarpTime = tWarp.getElapsedTimeInMilliSec();
-    printf("Warp time = %f\n", timewarpTime);
+    if(printFrameTimes)
+        printf("Warp time = %f\n", timewarpTime);
 
-    glutSwapBuffers();
+    presentFrame();
 }
 
 
@@ -1552,7 +3442,22 @@ void mouseMotionCB(int x, int y)
 }
 
 
+void keyboardCB(unsigned char key, int x, int y)
+{
+    // [ and ] move the lenses apart/together, like an IPD dial
+    if(key == '[' || key == ']')
+    {
+        const float step = (key == ']') ? LENS_SEPARATION_STEP : -LENS_SEPARATION_STEP;
+        const double updateTime = updateLensSeparation(hmd_info.lensSeparationInMeters + step);
+        printf("Lens separation = %f m, mesh updated in %f ms\n", hmd_info.lensSeparationInMeters, updateTime);
+    }
+}
+
+
 void exitCB()
 {
+    stopHeadTracker();
     clearSharedMem();
+    delete workerPool;
+    workerPool = NULL;
 }
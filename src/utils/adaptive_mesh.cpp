@@ -0,0 +1,315 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "adaptive_mesh.h"
+
+// Samples per cell edge when estimating the interpolation error.
+static const int ERROR_SAMPLES = 5;
+
+typedef struct
+{
+	int		x0;
+	int		y0;
+	int		x1;
+	int		y1;
+	float	error;
+} adaptive_cell_t;
+
+float MeasureDistortionCellError( const hmd_info_t * hmdInfo, const float uvToPixels[2],
+								  const float x0, const float y0, const float x1, const float y1 )
+{
+	float maxErrorSq = 0.0f;
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		// Corners in the order of BuildTimewarp(): top left, top right, bottom left, bottom right.
+		mesh_coord2d_t corner[4][NUM_COLOR_CHANNELS];
+		EvaluateDistortion( hmdInfo, eye, x0, 1.0f - y0, corner[0] );
+		EvaluateDistortion( hmdInfo, eye, x1, 1.0f - y0, corner[1] );
+		EvaluateDistortion( hmdInfo, eye, x0, 1.0f - y1, corner[2] );
+		EvaluateDistortion( hmdInfo, eye, x1, 1.0f - y1, corner[3] );
+
+		for ( int j = 0; j < ERROR_SAMPLES; j++ )
+		{
+			const float t = (float)j / ( ERROR_SAMPLES - 1 );
+			for ( int i = 0; i < ERROR_SAMPLES; i++ )
+			{
+				const float s = (float)i / ( ERROR_SAMPLES - 1 );
+				if ( ( i == 0 || i == ERROR_SAMPLES - 1 ) && ( j == 0 || j == ERROR_SAMPLES - 1 ) )
+				{
+					continue;
+				}
+
+				mesh_coord2d_t exact[NUM_COLOR_CHANNELS];
+				EvaluateDistortion( hmdInfo, eye, x0 + s * ( x1 - x0 ), 1.0f - ( y0 + t * ( y1 - y0 ) ), exact );
+
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					// Triangle {TL, BL, TR} or {TR, BL, BR}, split along the TR-BL diagonal.
+					float u, v;
+					if ( s + t <= 1.0f )
+					{
+						u = corner[0][channel].x + s * ( corner[1][channel].x - corner[0][channel].x ) + t * ( corner[2][channel].x - corner[0][channel].x );
+						v = corner[0][channel].y + s * ( corner[1][channel].y - corner[0][channel].y ) + t * ( corner[2][channel].y - corner[0][channel].y );
+					}
+					else
+					{
+						u = corner[3][channel].x + ( 1.0f - s ) * ( corner[2][channel].x - corner[3][channel].x ) + ( 1.0f - t ) * ( corner[1][channel].x - corner[3][channel].x );
+						v = corner[3][channel].y + ( 1.0f - s ) * ( corner[2][channel].y - corner[3][channel].y ) + ( 1.0f - t ) * ( corner[1][channel].y - corner[3][channel].y );
+					}
+					const float du = ( exact[channel].x - u ) * uvToPixels[0];
+					const float dv = ( exact[channel].y - v ) * uvToPixels[1];
+					maxErrorSq = MaxFloat( maxErrorSq, du * du + dv * dv );
+				}
+			}
+		}
+	}
+	return sqrtf( maxErrorSq );
+}
+
+// Lattice vertices around a cell, clockwise from its top left corner,
+// including the corners of smaller neighbors on its edges. Returns how many.
+static int GetCellPerimeter( const adaptive_cell_t & cell, const int latticeStride,
+							 const std::vector<int> & latticeVertex, std::vector<int> & perimeter )
+{
+	// Clockwise in lattice space (y down), which is counter clockwise on screen.
+	perimeter.clear();
+	for ( int x = cell.x0; x < cell.x1; x++ )
+	{
+		perimeter.push_back( cell.y0 * latticeStride + x );
+	}
+	for ( int y = cell.y0; y < cell.y1; y++ )
+	{
+		perimeter.push_back( y * latticeStride + cell.x1 );
+	}
+	for ( int x = cell.x1; x > cell.x0; x-- )
+	{
+		perimeter.push_back( cell.y1 * latticeStride + x );
+	}
+	for ( int y = cell.y1; y > cell.y0; y-- )
+	{
+		perimeter.push_back( y * latticeStride + cell.x0 );
+	}
+
+	int numUsed = 0;
+	for ( size_t p = 0; p < perimeter.size(); p++ )
+	{
+		if ( latticeVertex[perimeter[p]] >= 0 )
+		{
+			perimeter[numUsed++] = latticeVertex[perimeter[p]];
+		}
+	}
+	return numUsed;
+}
+
+static float MeasureUniformGridError( const hmd_info_t * hmdInfo, const float uvToPixels[2] )
+{
+	float maxError = 0.0f;
+	for ( int y = 0; y < hmdInfo->eyeTilesHigh; y++ )
+	{
+		for ( int x = 0; x < hmdInfo->eyeTilesWide; x++ )
+		{
+			maxError = MaxFloat( maxError,
+				MeasureDistortionCellError( hmdInfo, uvToPixels,
+											(float)x / hmdInfo->eyeTilesWide, (float)y / hmdInfo->eyeTilesHigh,
+											(float)( x + 1 ) / hmdInfo->eyeTilesWide, (float)( y + 1 ) / hmdInfo->eyeTilesHigh ) );
+		}
+	}
+	return maxError;
+}
+
+int GetAdaptiveMeshMinCellPixels( const hmd_info_t * hmdInfo, const float uvToPixels[2],
+								  const float tolerancePixels, const int maxCellPixels )
+{
+	const float tileError = MeasureUniformGridError( hmdInfo, uvToPixels );
+	const int tilePixels = ( hmdInfo->tilePixelsWide < hmdInfo->tilePixelsHigh ) ? hmdInfo->tilePixelsWide : hmdInfo->tilePixelsHigh;
+	const float cellPixels = ( tileError > 0.0f ) ? 0.5f * tilePixels * sqrtf( tolerancePixels / tileError ) : (float)maxCellPixels;
+
+	int minCellPixels = 1;
+	while ( 2 * minCellPixels <= cellPixels && 2 * minCellPixels <= maxCellPixels )
+	{
+		minCellPixels *= 2;
+	}
+	return minCellPixels;
+}
+
+bool BuildAdaptiveDistortionMesh( const hmd_info_t * hmdInfo, const adaptive_mesh_params_t * params,
+								  TimewarpArena * arena, adaptive_mesh_stats_t * stats )
+{
+	memset( stats, 0, sizeof( adaptive_mesh_stats_t ) );
+
+	if ( params->minCellPixels <= 0 || params->maxCellPixels < params->minCellPixels )
+	{
+		return false;
+	}
+
+	// Integer lattice of minCellPixels squares over the eye, y = 0 at the top.
+	const int eyePixelsWide = hmdInfo->eyeTilesWide * hmdInfo->tilePixelsWide;
+	const int eyePixelsHigh = hmdInfo->eyeTilesHigh * hmdInfo->tilePixelsHigh;
+	const int latticeWide = ( eyePixelsWide + params->minCellPixels / 2 ) / params->minCellPixels;
+	const int latticeHigh = ( eyePixelsHigh + params->minCellPixels / 2 ) / params->minCellPixels;
+	const int maxCellLattice = params->maxCellPixels / params->minCellPixels;
+	if ( latticeWide < 1 || latticeHigh < 1 )
+	{
+		return false;
+	}
+
+	// Refine top down. Roots are maxCellPixels squares, clipped at the far edges.
+	std::vector<adaptive_cell_t> pending;
+	std::vector<adaptive_cell_t> leaves;
+	for ( int y = 0; y < latticeHigh; y += maxCellLattice )
+	{
+		for ( int x = 0; x < latticeWide; x += maxCellLattice )
+		{
+			const int x1 = ( x + maxCellLattice < latticeWide ) ? x + maxCellLattice : latticeWide;
+			const int y1 = ( y + maxCellLattice < latticeHigh ) ? y + maxCellLattice : latticeHigh;
+			adaptive_cell_t root = { x, y, x1, y1, 0.0f };
+			pending.push_back( root );
+		}
+	}
+	while ( !pending.empty() )
+	{
+		adaptive_cell_t cell = pending.back();
+		pending.pop_back();
+
+		cell.error = MeasureDistortionCellError( hmdInfo, params->uvToPixels,
+									(float)cell.x0 / latticeWide, (float)cell.y0 / latticeHigh,
+									(float)cell.x1 / latticeWide, (float)cell.y1 / latticeHigh );
+
+		const int w = cell.x1 - cell.x0;
+		const int h = cell.y1 - cell.y0;
+		if ( cell.error <= params->tolerancePixels || ( w == 1 && h == 1 ) )
+		{
+			leaves.push_back( cell );
+			continue;
+		}
+
+		// Split the long side(s); quarters for square cells.
+		const int mx = ( w > 1 && 2 * w >= h ) ? cell.x0 + w / 2 : cell.x1;
+		const int my = ( h > 1 && 2 * h >= w ) ? cell.y0 + h / 2 : cell.y1;
+		const int xs[3] = { cell.x0, mx, cell.x1 };
+		const int ys[3] = { cell.y0, my, cell.y1 };
+		for ( int j = 0; j < 2; j++ )
+		{
+			for ( int i = 0; i < 2; i++ )
+			{
+				if ( xs[i] < xs[i + 1] && ys[j] < ys[j + 1] )
+				{
+					adaptive_cell_t child = { xs[i], ys[j], xs[i + 1], ys[j + 1], 0.0f };
+					pending.push_back( child );
+				}
+			}
+		}
+	}
+
+	// Every leaf corner becomes a shared lattice vertex. A leaf with other
+	// leaf corners on its edges (T-junctions) is fanned around an extra
+	// center vertex through all of them instead of split in two.
+	const int latticeStride = latticeWide + 1;
+	std::vector<int> latticeVertex( (size_t)latticeStride * ( latticeHigh + 1 ), -1 );
+	std::vector<float> gridCoords;		// x, y in 0..1 per vertex, y = 0 at the top
+
+	for ( size_t i = 0; i < leaves.size(); i++ )
+	{
+		const int xs[2] = { leaves[i].x0, leaves[i].x1 };
+		const int ys[2] = { leaves[i].y0, leaves[i].y1 };
+		for ( int c = 0; c < 4; c++ )
+		{
+			int & vertex = latticeVertex[ys[c >> 1] * latticeStride + xs[c & 1]];
+			if ( vertex < 0 )
+			{
+				vertex = (int)( gridCoords.size() / 2 );
+				gridCoords.push_back( (float)xs[c & 1] / latticeWide );
+				gridCoords.push_back( (float)ys[c >> 1] / latticeHigh );
+			}
+		}
+	}
+
+	// Count first, so the mesh goes straight into the arena.
+	std::vector<int> perimeter;
+	int numVertices = (int)( gridCoords.size() / 2 );
+	int numIndices = 0;
+	for ( size_t i = 0; i < leaves.size(); i++ )
+	{
+		const int numUsed = GetCellPerimeter( leaves[i], latticeStride, latticeVertex, perimeter );
+		numVertices += ( numUsed == 4 ) ? 0 : 1;
+		numIndices += ( numUsed == 4 ) ? 6 : 3 * numUsed;
+	}
+	if ( !arena->reserve( numVertices, numIndices, 0 ) )
+	{
+		return false;
+	}
+	gridCoords.reserve( 2 * numVertices );
+	distortion_vertex_t * vertices = arena->getVertices();
+	GLuint * indices = arena->getIndices();
+
+	int index = 0;
+	float maxError = 0.0f;
+	int minCellWide = latticeWide;
+	int minCellHigh = latticeHigh;
+	for ( size_t i = 0; i < leaves.size(); i++ )
+	{
+		const adaptive_cell_t & cell = leaves[i];
+		maxError = MaxFloat( maxError, cell.error );
+		minCellWide = ( cell.x1 - cell.x0 < minCellWide ) ? cell.x1 - cell.x0 : minCellWide;
+		minCellHigh = ( cell.y1 - cell.y0 < minCellHigh ) ? cell.y1 - cell.y0 : minCellHigh;
+
+		const int numUsed = GetCellPerimeter( cell, latticeStride, latticeVertex, perimeter );
+		if ( numUsed == 4 )
+		{
+			// Same split and winding as the uniform grid tiles.
+			const GLuint topLeft = perimeter[0], topRight = perimeter[1], bottomRight = perimeter[2], bottomLeft = perimeter[3];
+			const GLuint tile[6] = { topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight };
+			memcpy( indices + index, tile, sizeof( tile ) );
+			index += 6;
+			continue;
+		}
+
+		const GLuint center = (GLuint)( gridCoords.size() / 2 );
+		gridCoords.push_back( 0.5f * ( cell.x0 + cell.x1 ) / latticeWide );
+		gridCoords.push_back( 0.5f * ( cell.y0 + cell.y1 ) / latticeHigh );
+		for ( int p = 0; p < numUsed; p++ )
+		{
+			indices[index++] = center;
+			indices[index++] = (GLuint)perimeter[( p + 1 ) % numUsed];
+			indices[index++] = (GLuint)perimeter[p];
+		}
+	}
+
+	const float heightScale = (float)eyePixelsHigh / hmdInfo->displayPixelsHigh;
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int v = 0; v < numVertices; v++ )
+		{
+			const float gx = gridCoords[v * 2 + 0];
+			const float gy = gridCoords[v * 2 + 1];
+
+			mesh_coord2d_t uv[NUM_COLOR_CHANNELS];
+			EvaluateDistortion( hmdInfo, eye, gx, 1.0f - gy, uv );
+
+			distortion_vertex_t * vertex = &vertices[eye * numVertices + v];
+			vertex->position.x = -1.0f + eye + gx;
+			vertex->position.y = -1.0f + 2.0f * ( 1.0f - gy ) * heightScale;
+			vertex->position.z = 0.0f;
+			vertex->uv0.u = uv[0].x;
+			vertex->uv0.v = uv[0].y;
+			vertex->uv1.u = uv[1].x;
+			vertex->uv1.v = uv[1].y;
+			vertex->uv2.u = uv[2].x;
+			vertex->uv2.v = uv[2].y;
+		}
+	}
+
+	stats->numVertices = numVertices;
+	stats->numIndices = numIndices;
+	stats->numCells = (int)leaves.size();
+	stats->maxError = maxError;
+	stats->uniformVertices = ( hmdInfo->eyeTilesWide + 1 ) * ( hmdInfo->eyeTilesHigh + 1 );
+	stats->uniformIndices = hmdInfo->eyeTilesWide * hmdInfo->eyeTilesHigh * 6;
+	const int matchedWide = ( latticeWide + minCellWide - 1 ) / minCellWide;
+	const int matchedHigh = ( latticeHigh + minCellHigh - 1 ) / minCellHigh;
+	stats->matchedUniformVertices = ( matchedWide + 1 ) * ( matchedHigh + 1 );
+	stats->matchedUniformIndices = matchedWide * matchedHigh * 6;
+	stats->uniformMaxError = MeasureUniformGridError( hmdInfo, params->uvToPixels );
+	return true;
+}
@@ -0,0 +1,59 @@
+#ifndef _ADAPTIVE_MESH_H
+#define _ADAPTIVE_MESH_H
+
+#include "hmd.h"
+#include "timewarp_arena.h"
+
+// Error-bounded adaptive tessellation of the distortion mesh.
+//
+// Instead of a uniform eyeTilesWide x eyeTilesHigh grid, the eye is split as
+// a quadtree down to the point where linearly interpolating the distortion
+// UVs over a cell stays within a tolerance of the exact per-point mapping
+// (EvaluateDistortion()). Both eyes share one tree (a cell is split if either
+// eye needs it), so they keep sharing one index buffer and the base vertex
+// draw. T-junctions between cells of different sizes are closed by fanning
+// the larger cell around its center, so the mesh is crack free.
+
+typedef struct
+{
+	float	tolerancePixels;		// max interpolation error, in eye buffer pixels
+	int		minCellPixels;			// finest cell edge, in display pixels
+	int		maxCellPixels;			// coarsest cell edge, in display pixels
+	float	uvToPixels[2];			// eye buffer pixels per unit of distortion UV
+} adaptive_mesh_params_t;
+
+typedef struct
+{
+	int		numVertices;			// per eye
+	int		numIndices;
+	int		numCells;
+	float	maxError;				// worst estimated error of the emitted cells, in pixels
+	int		uniformVertices;		// what the uniform tile grid needs
+	int		uniformIndices;
+	float	uniformMaxError;		// worst estimated error of the uniform grid, in pixels
+	int		matchedUniformVertices;	// what a uniform grid of the smallest emitted cells needs
+	int		matchedUniformIndices;
+} adaptive_mesh_stats_t;
+
+// Estimated interpolation error, in eye buffer pixels, of one mesh cell
+// spanning [x0, x1] x [y0, y1] of the eye (grid units: 0..1, y = 0 at the
+// top row), split into two triangles the way BuildTimewarp() splits tiles.
+// The worst of all color channels and both eyes.
+float MeasureDistortionCellError( const hmd_info_t * hmdInfo, const float uvToPixels[2],
+								  const float x0, const float y0, const float x1, const float y1 );
+
+// Finest cell edge, in display pixels, that meets tolerancePixels where the
+// lens bends most. The interpolation error of a cell grows with the square of
+// its size, so the worst cell of the uniform tile grid is scaled down to the
+// bound, halved for margin and rounded down to a power of two, at least 1
+// pixel and at most maxCellPixels.
+int GetAdaptiveMeshMinCellPixels( const hmd_info_t * hmdInfo, const float uvToPixels[2],
+								  const float tolerancePixels, const int maxCellPixels );
+
+// Build the adaptive mesh. The cells are counted first, then the vertices
+// (NUM_EYES * numVertices) and indices are written straight into
+// arena->reserve() and read back with arena->getVertices() / getIndices().
+bool BuildAdaptiveDistortionMesh( const hmd_info_t * hmdInfo, const adaptive_mesh_params_t * params,
+								  TimewarpArena * arena, adaptive_mesh_stats_t * stats );
+
+#endif
@@ -0,0 +1,26 @@
+#include "algebra_simd.h"
+
+#if defined( ALGEBRA_SIMD_HAVE_AVX2 )
+#include <immintrin.h>
+
+// Compiled for AVX2 only (no FMA, which would change the rounding), and
+// only called after a runtime check.
+__attribute__(( target( "avx2" ) ))
+void AlgebraSimd_MultiplyAVX2( ksMatrix4x4f * result, const ksMatrix4x4f * a, const ksMatrix4x4f * b )
+{
+	const __m256 a0 = _mm256_broadcast_ps( (const __m128 *)a->m[0] );
+	const __m256 a1 = _mm256_broadcast_ps( (const __m128 *)a->m[1] );
+	const __m256 a2 = _mm256_broadcast_ps( (const __m128 *)a->m[2] );
+	const __m256 a3 = _mm256_broadcast_ps( (const __m128 *)a->m[3] );
+	for ( int c = 0; c < 4; c += 2 )
+	{
+		// Columns c and c + 1 of b, each element broadcast within its half.
+		const __m256 bc = _mm256_loadu_ps( b->m[c] );
+		__m256 r = _mm256_mul_ps( a0, _mm256_permute_ps( bc, _MM_SHUFFLE( 0, 0, 0, 0 ) ) );
+		r = _mm256_add_ps( r, _mm256_mul_ps( a1, _mm256_permute_ps( bc, _MM_SHUFFLE( 1, 1, 1, 1 ) ) ) );
+		r = _mm256_add_ps( r, _mm256_mul_ps( a2, _mm256_permute_ps( bc, _MM_SHUFFLE( 2, 2, 2, 2 ) ) ) );
+		r = _mm256_add_ps( r, _mm256_mul_ps( a3, _mm256_permute_ps( bc, _MM_SHUFFLE( 3, 3, 3, 3 ) ) ) );
+		_mm256_storeu_ps( result->m[c], r );
+	}
+}
+#endif
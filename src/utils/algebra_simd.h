@@ -0,0 +1,239 @@
+#ifndef _ALGEBRA_SIMD_H
+#define _ALGEBRA_SIMD_H
+
+#include "algebra.h"
+#include "simd.h"
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define ALGEBRA_SIMD_HAVE_AVX2
+#endif
+
+// SIMD versions of the algebra.h matrix routines of the general timewarp
+// transform: CalculateTimeWarpTransform() and the 4x4 to 3x4 conversion for
+// the shaders. The app's per-frame transforms are rotation only and take the
+// quaternion path of CalculateRotationTimeWarpTransform() instead, so these
+// only run for poses given as view matrices (and in --benchmark=matrix).
+//
+// A column of a ksMatrix4x4f is one SSE register. The SSE2 code is inline,
+// since a call costs as much as some of these routines. The AVX2 path only
+// changes Multiply, which does two result columns per 256-bit register (in
+// algebra_simd.cpp, called after a runtime check). Invert's minors need about
+// as many lane inserts to pair up as that saves, and the rest is data
+// movement, so they stay on SSE2. Every path does the scalar code's
+// arithmetic in the same order (no FMA), so all of them give bit identical
+// results. Matrices need no particular alignment, and result may not alias
+// a source.
+
+#if defined( ALGEBRA_SIMD_HAVE_AVX2 )
+void AlgebraSimd_MultiplyAVX2( ksMatrix4x4f * result, const ksMatrix4x4f * a, const ksMatrix4x4f * b );
+#endif
+
+#if defined( __SSE2__ )
+
+// Invert() expands the cofactor of result->m[i][j] over the rows other than j
+// and the columns other than i, with the sign of ( -1 )^( i + j ). Lane j of
+// a register holds the cofactor's j-th element, so with the source transposed
+// into rows, the three rows of each minor are these per lane selections:
+//   first row:  1 0 0 0
+//   second row: 2 2 1 1
+//   third row:  3 3 3 2
+
+static inline void AlgebraSimd_MultiplySSE2( ksMatrix4x4f * result, const ksMatrix4x4f * a, const ksMatrix4x4f * b )
+{
+	const __m128 a0 = _mm_loadu_ps( a->m[0] );
+	const __m128 a1 = _mm_loadu_ps( a->m[1] );
+	const __m128 a2 = _mm_loadu_ps( a->m[2] );
+	const __m128 a3 = _mm_loadu_ps( a->m[3] );
+	for ( int c = 0; c < 4; c++ )
+	{
+		__m128 r = _mm_mul_ps( a0, _mm_set1_ps( b->m[c][0] ) );
+		r = _mm_add_ps( r, _mm_mul_ps( a1, _mm_set1_ps( b->m[c][1] ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( a2, _mm_set1_ps( b->m[c][2] ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( a3, _mm_set1_ps( b->m[c][3] ) ) );
+		_mm_storeu_ps( result->m[c], r );
+	}
+}
+
+// The rows of src, one per register.
+static inline void AlgebraSimd_LoadRowsSSE2( const ksMatrix4x4f * src, __m128 rows[4] )
+{
+	rows[0] = _mm_loadu_ps( src->m[0] );
+	rows[1] = _mm_loadu_ps( src->m[1] );
+	rows[2] = _mm_loadu_ps( src->m[2] );
+	rows[3] = _mm_loadu_ps( src->m[3] );
+	_MM_TRANSPOSE4_PS( rows[0], rows[1], rows[2], rows[3] );
+}
+
+static inline void AlgebraSimd_TransposeSSE2( ksMatrix4x4f * result, const ksMatrix4x4f * src )
+{
+	__m128 rows[4];
+	AlgebraSimd_LoadRowsSSE2( src, rows );
+	for ( int c = 0; c < 4; c++ )
+	{
+		_mm_storeu_ps( result->m[c], rows[c] );
+	}
+}
+
+static inline void AlgebraSimd_CreateFromMatrix4x4fSSE2( ksMatrix3x4f * result, const ksMatrix4x4f * src )
+{
+	__m128 rows[4];
+	AlgebraSimd_LoadRowsSSE2( src, rows );
+	for ( int r = 0; r < 3; r++ )
+	{
+		_mm_storeu_ps( result->m[r], rows[r] );
+	}
+}
+
+static inline void AlgebraSimd_InvertHomogeneousSSE2( ksMatrix4x4f * result, const ksMatrix4x4f * src )
+{
+	__m128 rows[4];
+	AlgebraSimd_LoadRowsSSE2( src, rows );
+
+	const __m128 xyz = _mm_castsi128_ps( _mm_set_epi32( 0, -1, -1, -1 ) );
+	const __m128 w = _mm_set_ps( 1.0f, 0.0f, 0.0f, 0.0f );
+	const __m128 sign = _mm_set1_ps( -0.0f );
+
+	// The transposed rotation, and minus its product with the translation.
+	__m128 t = _mm_mul_ps( rows[0], _mm_set1_ps( src->m[3][0] ) );
+	t = _mm_add_ps( t, _mm_mul_ps( rows[1], _mm_set1_ps( src->m[3][1] ) ) );
+	t = _mm_add_ps( t, _mm_mul_ps( rows[2], _mm_set1_ps( src->m[3][2] ) ) );
+	t = _mm_xor_ps( t, sign );
+
+	_mm_storeu_ps( result->m[0], _mm_and_ps( rows[0], xyz ) );
+	_mm_storeu_ps( result->m[1], _mm_and_ps( rows[1], xyz ) );
+	_mm_storeu_ps( result->m[2], _mm_and_ps( rows[2], xyz ) );
+	_mm_storeu_ps( result->m[3], _mm_or_ps( _mm_and_ps( t, xyz ), w ) );
+}
+
+// The minors of one result column, from the selections of the columns other than it.
+static inline __m128 AlgebraSimd_MinorSSE2( const __m128 first[3], const __m128 second[3], const __m128 third[3] )
+{
+	const __m128 m0 = _mm_mul_ps( first[0], _mm_sub_ps( _mm_mul_ps( second[1], third[2] ), _mm_mul_ps( third[1], second[2] ) ) );
+	const __m128 m1 = _mm_mul_ps( first[1], _mm_sub_ps( _mm_mul_ps( second[0], third[2] ), _mm_mul_ps( third[0], second[2] ) ) );
+	const __m128 m2 = _mm_mul_ps( first[2], _mm_sub_ps( _mm_mul_ps( second[0], third[1] ), _mm_mul_ps( third[0], second[1] ) ) );
+	return _mm_add_ps( _mm_sub_ps( m0, m1 ), m2 );
+}
+
+static inline void AlgebraSimd_InvertSSE2( ksMatrix4x4f * result, const ksMatrix4x4f * src )
+{
+	__m128 rows[4];
+	AlgebraSimd_LoadRowsSSE2( src, rows );
+
+	__m128 first[4];
+	__m128 second[4];
+	__m128 third[4];
+	for ( int c = 0; c < 4; c++ )
+	{
+		first[c] = _mm_shuffle_ps( rows[c], rows[c], _MM_SHUFFLE( 0, 0, 0, 1 ) );
+		second[c] = _mm_shuffle_ps( rows[c], rows[c], _MM_SHUFFLE( 1, 1, 2, 2 ) );
+		third[c] = _mm_shuffle_ps( rows[c], rows[c], _MM_SHUFFLE( 2, 3, 3, 3 ) );
+	}
+
+	__m128 minors[4];
+	for ( int i = 0; i < 4; i++ )
+	{
+		const int c0 = ( i > 0 ) ? 0 : 1;
+		const int c1 = ( i > 1 ) ? 1 : 2;
+		const int c2 = ( i > 2 ) ? 2 : 3;
+		const __m128 f[3] = { first[c0], first[c1], first[c2] };
+		const __m128 s[3] = { second[c0], second[c1], second[c2] };
+		const __m128 t[3] = { third[c0], third[c1], third[c2] };
+		minors[i] = AlgebraSimd_MinorSSE2( f, s, t );
+	}
+
+	const float rcpDet = 1.0f / (	src->m[0][0] * _mm_cvtss_f32( minors[0] ) -
+									src->m[0][1] * _mm_cvtss_f32( minors[1] ) +
+									src->m[0][2] * _mm_cvtss_f32( minors[2] ) -
+									src->m[0][3] * _mm_cvtss_f32( minors[3] ) );
+	const __m128 scale = _mm_set1_ps( rcpDet );
+	const __m128 evenSign = _mm_set_ps( -0.0f, 0.0f, -0.0f, 0.0f );
+	const __m128 oddSign = _mm_set_ps( 0.0f, -0.0f, 0.0f, -0.0f );
+	for ( int i = 0; i < 4; i++ )
+	{
+		const __m128 cofactors = _mm_xor_ps( minors[i], ( i & 1 ) ? oddSign : evenSign );
+		_mm_storeu_ps( result->m[i], _mm_mul_ps( cofactors, scale ) );
+	}
+}
+
+#endif
+
+// What SIMD_PATH_BEST resolves to, looked up once.
+static inline simd_path_t AlgebraSimd_GetPath( const simd_path_t simd )
+{
+	static const simd_path_t best = Simd_GetBestPath();
+	return ( simd == SIMD_PATH_BEST || simd > best ) ? best : simd;
+}
+
+static inline void ksMatrix4x4f_MultiplySimd( ksMatrix4x4f * result, const ksMatrix4x4f * a, const ksMatrix4x4f * b,
+											  const simd_path_t simd = SIMD_PATH_BEST )
+{
+	const simd_path_t path = AlgebraSimd_GetPath( simd );
+#if defined( ALGEBRA_SIMD_HAVE_AVX2 )
+	if ( path == SIMD_PATH_AVX2 )
+	{
+		AlgebraSimd_MultiplyAVX2( result, a, b );
+		return;
+	}
+#endif
+#if defined( __SSE2__ )
+	if ( path != SIMD_PATH_SCALAR )
+	{
+		AlgebraSimd_MultiplySSE2( result, a, b );
+		return;
+	}
+#endif
+	ksMatrix4x4f_Multiply( result, a, b );
+}
+
+static inline void ksMatrix4x4f_TransposeSimd( ksMatrix4x4f * result, const ksMatrix4x4f * src, const simd_path_t simd = SIMD_PATH_BEST )
+{
+#if defined( __SSE2__ )
+	if ( AlgebraSimd_GetPath( simd ) != SIMD_PATH_SCALAR )
+	{
+		AlgebraSimd_TransposeSSE2( result, src );
+		return;
+	}
+#endif
+	ksMatrix4x4f_Transpose( result, src );
+}
+
+static inline void ksMatrix4x4f_InvertSimd( ksMatrix4x4f * result, const ksMatrix4x4f * src, const simd_path_t simd = SIMD_PATH_BEST )
+{
+#if defined( __SSE2__ )
+	if ( AlgebraSimd_GetPath( simd ) != SIMD_PATH_SCALAR )
+	{
+		AlgebraSimd_InvertSSE2( result, src );
+		return;
+	}
+#endif
+	ksMatrix4x4f_Invert( result, src );
+}
+
+static inline void ksMatrix4x4f_InvertHomogeneousSimd( ksMatrix4x4f * result, const ksMatrix4x4f * src, const simd_path_t simd = SIMD_PATH_BEST )
+{
+#if defined( __SSE2__ )
+	if ( AlgebraSimd_GetPath( simd ) != SIMD_PATH_SCALAR )
+	{
+		AlgebraSimd_InvertHomogeneousSSE2( result, src );
+		return;
+	}
+#endif
+	ksMatrix4x4f_InvertHomogeneous( result, src );
+}
+
+static inline void ksMatrix3x4f_CreateFromMatrix4x4fSimd( ksMatrix3x4f * result, const ksMatrix4x4f * src, const simd_path_t simd = SIMD_PATH_BEST )
+{
+#if defined( __SSE2__ )
+	if ( AlgebraSimd_GetPath( simd ) != SIMD_PATH_SCALAR )
+	{
+		AlgebraSimd_CreateFromMatrix4x4fSSE2( result, src );
+		return;
+	}
+#endif
+	ksMatrix3x4f_CreateFromMatrix4x4f( result, src );
+}
+
+#endif
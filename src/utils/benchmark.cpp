@@ -0,0 +1,1571 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <chrono>
+#include <thread>
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <x86intrin.h>
+#define BENCHMARK_HAVE_RDTSC
+#endif
+#include <vector>
+#include "benchmark.h"
+#include "hmd.h"
+#include "spline.h"
+#include "fixed_mesh.h"
+#include "vertex_cache.h"
+#include "distortion_model.h"
+#include "inverse_distortion.h"
+#include "thread_pool.h"
+#include "algebra_simd.h"
+#include "timewarp_transform.h"
+#include "pose_replay.h"
+#include "pose_handoff.h"
+#include "pose_history.h"
+#include "positional_warp.h"
+#include "scanout.h"
+#include "../Timer.h"
+
+static const int BENCHMARK_REPEATS = 20;
+
+// The default HMD on a 4K panel, tessellated with 8x8 pixel tiles.
+static void GetDenseHmdInfo( hmd_info_t * hmdInfo )
+{
+	// 4K per eye: a 7680x2160 panel.
+	GetDefaultHmdInfo( 2 * 3840, 2160, hmdInfo );
+	hmdInfo->tilePixelsWide = 8;
+	hmdInfo->tilePixelsHigh = 8;
+	hmdInfo->eyeTilesWide = hmdInfo->visiblePixelsWide / NUM_EYES / hmdInfo->tilePixelsWide;
+	hmdInfo->eyeTilesHigh = hmdInfo->visiblePixelsHigh / hmdInfo->tilePixelsHigh;
+}
+
+// Distance in units in the last place between two floats of the same sign.
+static int UlpDistance( const float a, const float b )
+{
+	int ia, ib;
+	memcpy( &ia, &a, sizeof( ia ) );
+	memcpy( &ib, &b, sizeof( ib ) );
+	return abs( ia - ib );
+}
+
+static bool BenchmarkSpline()
+{
+	hmd_info_t hmdInfo;
+	GetDenseHmdInfo( &hmdInfo );
+
+	// rsq of every vertex of both eyes, in mesh order.
+	std::vector<float> rsq;
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int y = 0; y <= hmdInfo.eyeTilesHigh; y++ )
+		{
+			for ( int x = 0; x <= hmdInfo.eyeTilesWide; x++ )
+			{
+				float theta[2];
+				GetDistortionTanAngles( &hmdInfo, eye, (float)x / hmdInfo.eyeTilesWide, 1.0f - (float)y / hmdInfo.eyeTilesHigh, theta );
+				rsq.push_back( theta[0] * theta[0] + theta[1] * theta[1] );
+			}
+		}
+	}
+	const int count = (int)rsq.size();
+	printf( "Spline benchmark: %d values (%dx%d panel, %dx%d tiles of %dx%d pixels per eye), best of %d runs\n",
+			count, hmdInfo.displayPixelsWide, hmdInfo.displayPixelsHigh, hmdInfo.eyeTilesWide, hmdInfo.eyeTilesHigh, hmdInfo.tilePixelsWide, hmdInfo.tilePixelsHigh, BENCHMARK_REPEATS );
+
+	std::vector<float> reference( count );
+	double scalarBest = 1e30;
+	for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+	{
+		Timer timer;
+		timer.start();
+		for ( int i = 0; i < count; i++ )
+		{
+			reference[i] = EvaluateCatmullRomSpline( rsq[i], hmdInfo.K, hmdInfo.numKnots );
+		}
+		timer.stop();
+		scalarBest = ( timer.getElapsedTimeInMicroSec() < scalarBest ) ? timer.getElapsedTimeInMicroSec() : scalarBest;
+	}
+	printf( "  EvaluateCatmullRomSpline: %8.1f us, %6.2f ns/value\n", scalarBest, 1000.0 * scalarBest / count );
+
+	catmull_rom_spline_t spline;
+	if ( !CatmullRomSpline_Create( &spline, hmdInfo.K, hmdInfo.numKnots ) )
+	{
+		return false;
+	}
+
+	bool ok = true;
+	const simd_path_t paths[] = { SIMD_PATH_SCALAR, SIMD_PATH_SSE2, SIMD_PATH_AVX2 };
+	for ( int p = 0; p < (int)( sizeof( paths ) / sizeof( paths[0] ) ); p++ )
+	{
+		if ( paths[p] > Simd_GetBestPath() )
+		{
+			printf( "  batch %-6s           : not supported on this CPU\n", Simd_GetPathName( paths[p] ) );
+			continue;
+		}
+
+		std::vector<float> results( count );
+		double best = 1e30;
+		for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+		{
+			Timer timer;
+			timer.start();
+			CatmullRomSpline_EvaluateBatch( &spline, rsq.data(), results.data(), count, paths[p] );
+			timer.stop();
+			best = ( timer.getElapsedTimeInMicroSec() < best ) ? timer.getElapsedTimeInMicroSec() : best;
+		}
+
+		int maxUlps = 0;
+		for ( int i = 0; i < count; i++ )
+		{
+			const int ulps = UlpDistance( results[i], reference[i] );
+			maxUlps = ( ulps > maxUlps ) ? ulps : maxUlps;
+		}
+		ok = ok && ( maxUlps <= 1 );
+
+		printf( "  batch %-6s           : %8.1f us, %6.2f ns/value, %5.2fx, max %d ulp from scalar\n",
+				Simd_GetPathName( paths[p] ), best, 1000.0 * best / count, scalarBest / best, maxUlps );
+	}
+
+	// The whole uniform mesh, without symmetry, with the batch path against point by point.
+	const int numVertices = ( hmdInfo.eyeTilesWide + 1 ) * ( hmdInfo.eyeTilesHigh + 1 );
+	std::vector<mesh_coord2d_t> coords( NUM_EYES * NUM_COLOR_CHANNELS * numVertices );
+	mesh_coord2d_t * distort_coords[NUM_EYES][NUM_COLOR_CHANNELS];
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			distort_coords[eye][channel] = coords.data() + ( eye * NUM_COLOR_CHANNELS + channel ) * numVertices;
+		}
+	}
+
+	double pointBest = 1e30;
+	double meshBest = 1e30;
+	for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+	{
+		Timer timer;
+		timer.start();
+		for ( int eye = 0; eye < NUM_EYES; eye++ )
+		{
+			for ( int y = 0; y <= hmdInfo.eyeTilesHigh; y++ )
+			{
+				for ( int x = 0; x <= hmdInfo.eyeTilesWide; x++ )
+				{
+					mesh_coord2d_t uv[NUM_COLOR_CHANNELS];
+					EvaluateDistortion( &hmdInfo, eye, (float)x / hmdInfo.eyeTilesWide, 1.0f - (float)y / hmdInfo.eyeTilesHigh, uv );
+					for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+					{
+						distort_coords[eye][channel][y * ( hmdInfo.eyeTilesWide + 1 ) + x] = uv[channel];
+					}
+				}
+			}
+		}
+		timer.stop();
+		pointBest = ( timer.getElapsedTimeInMicroSec() < pointBest ) ? timer.getElapsedTimeInMicroSec() : pointBest;
+
+		timer.start();
+		BuildDistortionMeshes( distort_coords, &hmdInfo, DISTORTION_SYMMETRY_NONE );
+		timer.stop();
+		meshBest = ( timer.getElapsedTimeInMicroSec() < meshBest ) ? timer.getElapsedTimeInMicroSec() : meshBest;
+	}
+	printf( "  full mesh, point by point: %8.1f us\n", pointBest );
+	printf( "  full mesh, BuildDistortionMeshes (%s batch): %8.1f us, %5.2fx\n",
+			Simd_GetPathName( SIMD_PATH_BEST ), meshBest, pointBest / meshBest );
+
+	printf( "Spline benchmark %s\n", ok ? "passed" : "FAILED: batch results more than 1 ulp from scalar" );
+	return ok;
+}
+
+// Largest distance in ulps between the floats of two vertices.
+static int VertexUlpDistance( const distortion_vertex_t * a, const distortion_vertex_t * b )
+{
+	const float * fa = &a->position.x;
+	const float * fb = &b->position.x;
+	int maxUlps = 0;
+	for ( int i = 0; i < (int)( sizeof( distortion_vertex_t ) / sizeof( float ) ); i++ )
+	{
+		// +0 and -0 are the same UV.
+		const int ulps = ( fa[i] == fb[i] ) ? 0 : UlpDistance( fa[i], fb[i] );
+		maxUlps = ( ulps > maxUlps ) ? ulps : maxUlps;
+	}
+	return maxUlps;
+}
+
+static bool BenchmarkFixedMesh()
+{
+	bool ok = true;
+	for ( int m = 0; m < GetFixedDistortionMeshCount(); m++ )
+	{
+		const fixed_distortion_mesh_t * fixedMesh = GetFixedDistortionMesh( m );
+		const hmd_info_t * profile = fixedMesh->hmdInfo;
+		const int tilesWide = profile->eyeTilesWide;
+		const int tilesHigh = profile->eyeTilesHigh;
+		const int numVertices = ( tilesWide + 1 ) * ( tilesHigh + 1 );
+		printf( "Fixed mesh %s: %dx%d tiles, %d vertices, %d triangles per eye\n",
+				fixedMesh->name, tilesWide, tilesHigh, fixedMesh->numVertices, fixedMesh->numIndices / 3 );
+
+		// The runtime default for this panel has to find it.
+		hmd_info_t hmdInfo;
+		GetDefaultHmdInfo( profile->displayPixelsWide, profile->displayPixelsHigh, &hmdInfo );
+		const bool found = ( FindFixedDistortionMesh( &hmdInfo ) == fixedMesh );
+		ok = ok && found && fixedMesh->numVertices == numVertices && fixedMesh->numIndices == tilesWide * tilesHigh * 6;
+
+		// Every vertex against the runtime math, point by point.
+		int maxUlps = 0;
+		for ( int eye = 0; eye < NUM_EYES; eye++ )
+		{
+			for ( int y = 0; y <= tilesHigh; y++ )
+			{
+				for ( int x = 0; x <= tilesWide; x++ )
+				{
+					distortion_vertex_t vertex;
+					vertex.position.x = ( -1.0f + eye + ( (float)x / tilesWide ) );
+					vertex.position.y = ( -1.0f + 2.0f * ( ( tilesHigh - (float)y ) / tilesHigh ) *
+											( (float)( tilesHigh * hmdInfo.tilePixelsHigh ) / hmdInfo.displayPixelsHigh ) );
+					vertex.position.z = 0.0f;
+					mesh_coord2d_t uv[NUM_COLOR_CHANNELS];
+					EvaluateDistortion( &hmdInfo, eye, (float)x / tilesWide, 1.0f - (float)y / tilesHigh, uv );
+					vertex.uv0.u = uv[0].x;
+					vertex.uv0.v = uv[0].y;
+					vertex.uv1.u = uv[1].x;
+					vertex.uv1.v = uv[1].y;
+					vertex.uv2.u = uv[2].x;
+					vertex.uv2.v = uv[2].y;
+
+					const int ulps = VertexUlpDistance( &vertex, &fixedMesh->vertices[eye * numVertices + y * ( tilesWide + 1 ) + x] );
+					maxUlps = ( ulps > maxUlps ) ? ulps : maxUlps;
+				}
+			}
+		}
+		ok = ok && ( maxUlps == 0 );
+
+		// Every tile exactly once, with the runtime grid's two triangles.
+		std::vector<unsigned char> tiles( tilesWide * tilesHigh, 0 );
+		bool trianglesOk = true;
+		for ( int i = 0; i + 6 <= fixedMesh->numIndices; i += 6 )
+		{
+			const GLuint * tri = &fixedMesh->indices[i];
+			const int x = (int)( tri[0] % ( tilesWide + 1 ) );
+			const int y = (int)( tri[0] / ( tilesWide + 1 ) );
+			const GLuint v00 = tri[0];
+			const GLuint v01 = v00 + 1;
+			const GLuint v10 = v00 + tilesWide + 1;
+			const GLuint v11 = v10 + 1;
+			if ( x >= tilesWide || y >= tilesHigh || tiles[y * tilesWide + x] ||
+				 tri[1] != v10 || tri[2] != v01 || tri[3] != v01 || tri[4] != v10 || tri[5] != v11 )
+			{
+				trianglesOk = false;
+				break;
+			}
+			tiles[y * tilesWide + x] = 1;
+		}
+		ok = ok && trianglesOk;
+		printf( "  runtime GetDefaultHmdInfo() %s the profile, vertices max %d ulp from EvaluateDistortion(), triangles %s\n",
+				found ? "matches" : "DOES NOT match", maxUlps, trianglesOk ? "match the grid" : "DO NOT match the grid" );
+
+		// What startup no longer does: the UVs (with symmetry) and the index reordering.
+		std::vector<mesh_coord2d_t> coords( NUM_EYES * NUM_COLOR_CHANNELS * numVertices );
+		mesh_coord2d_t * distort_coords[NUM_EYES][NUM_COLOR_CHANNELS];
+		for ( int eye = 0; eye < NUM_EYES; eye++ )
+		{
+			for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+			{
+				distort_coords[eye][channel] = coords.data() + ( eye * NUM_COLOR_CHANNELS + channel ) * numVertices;
+			}
+		}
+		std::vector<GLuint> indices( tilesWide * tilesHigh * 6 );
+		double uvBest = 1e30;
+		double indexBest = 1e30;
+		double forsythBest = 1e30;
+		double lookupBest = 1e30;
+		float acmrStrips = 0.0f;
+		float acmrOptimized = 0.0f;
+		for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+		{
+			Timer timer;
+			timer.start();
+			BuildDistortionMeshes( distort_coords, &hmdInfo, GetDistortionSymmetry( &hmdInfo ) );
+			timer.stop();
+			uvBest = ( timer.getElapsedTimeInMicroSec() < uvBest ) ? timer.getElapsedTimeInMicroSec() : uvBest;
+
+			timer.start();
+			BuildStripGridIndices( indices.data(), tilesWide, tilesHigh );
+			timer.stop();
+			indexBest = ( timer.getElapsedTimeInMicroSec() < indexBest ) ? timer.getElapsedTimeInMicroSec() : indexBest;
+			acmrStrips = ComputeVertexCacheAcmr( indices.data(), (int)indices.size(), numVertices, VERTEX_CACHE_SIZE );
+
+			// What reordering the grid with the optimizer would add, for comparison.
+			timer.start();
+			OptimizeVertexCache( indices.data(), (int)indices.size(), numVertices );
+			timer.stop();
+			forsythBest = ( timer.getElapsedTimeInMicroSec() < forsythBest ) ? timer.getElapsedTimeInMicroSec() : forsythBest;
+			acmrOptimized = ComputeVertexCacheAcmr( indices.data(), (int)indices.size(), numVertices, VERTEX_CACHE_SIZE );
+
+			timer.start();
+			const fixed_distortion_mesh_t * lookup = FindFixedDistortionMesh( &hmdInfo );
+			timer.stop();
+			ok = ok && ( lookup == fixedMesh );
+			lookupBest = ( timer.getElapsedTimeInMicroSec() < lookupBest ) ? timer.getElapsedTimeInMicroSec() : lookupBest;
+		}
+		const float acmrFixed = ComputeVertexCacheAcmr( fixedMesh->indices, fixedMesh->numIndices, numVertices, VERTEX_CACHE_SIZE );
+		printf( "  runtime build: UVs %8.1f us, strip indices %8.1f us (ACMR %.3f); a Forsyth reorder would add %8.1f us (ACMR %.3f)\n",
+				uvBest, indexBest, acmrStrips, forsythBest, acmrOptimized );
+		printf( "  built-in     : lookup %8.2f us, strip order ACMR %.3f\n", lookupBest, acmrFixed );
+	}
+
+	printf( "Fixed mesh benchmark %s\n", ok ? "passed" : "FAILED: a built-in mesh does not match the runtime path" );
+	return ok;
+}
+
+// Largest distance in ulps between the UVs of count points.
+static int UvUlpDistance( const mesh_coord2d_t a[][NUM_COLOR_CHANNELS], const mesh_coord2d_t b[][NUM_COLOR_CHANNELS], const int count )
+{
+	int maxUlps = 0;
+	for ( int i = 0; i < count; i++ )
+	{
+		const float * fa = &a[i][0].x;
+		const float * fb = &b[i][0].x;
+		for ( int j = 0; j < NUM_COLOR_CHANNELS * 2; j++ )
+		{
+			const int ulps = ( fa[j] == fb[j] ) ? 0 : UlpDistance( fa[j], fb[j] );
+			maxUlps = ( ulps > maxUlps ) ? ulps : maxUlps;
+		}
+	}
+	return maxUlps;
+}
+
+static bool BenchmarkDistortionModels()
+{
+	hmd_info_t hmdInfo;
+	GetDenseHmdInfo( &hmdInfo );
+
+	// Tangent angles and reference UVs of every vertex of both eyes, in mesh order.
+	std::vector<float> thetaX;
+	std::vector<float> thetaY;
+	std::vector<mesh_coord2d_t> reference;
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int y = 0; y <= hmdInfo.eyeTilesHigh; y++ )
+		{
+			for ( int x = 0; x <= hmdInfo.eyeTilesWide; x++ )
+			{
+				const float xf = (float)x / hmdInfo.eyeTilesWide;
+				const float yf = 1.0f - (float)y / hmdInfo.eyeTilesHigh;
+				float theta[2];
+				GetDistortionTanAngles( &hmdInfo, eye, xf, yf, theta );
+				thetaX.push_back( theta[0] );
+				thetaY.push_back( theta[1] );
+				mesh_coord2d_t uv[NUM_COLOR_CHANNELS];
+				EvaluateDistortion( &hmdInfo, eye, xf, yf, uv );
+				reference.insert( reference.end(), uv, uv + NUM_COLOR_CHANNELS );
+			}
+		}
+	}
+	const int count = (int)thetaX.size();
+	const mesh_coord2d_t ( *referenceUvs )[NUM_COLOR_CHANNELS] = (const mesh_coord2d_t (*)[NUM_COLOR_CHANNELS])reference.data();
+	printf( "Distortion model benchmark: %d points (%dx%d panel, %dx%d tiles of %dx%d pixels per eye), best of %d runs\n",
+			count, hmdInfo.displayPixelsWide, hmdInfo.displayPixelsHigh, hmdInfo.eyeTilesWide, hmdInfo.eyeTilesHigh, hmdInfo.tilePixelsWide, hmdInfo.tilePixelsHigh, BENCHMARK_REPEATS );
+
+	// Errors in pixels of the 2560x1440 eye buffer with the 80 degree field of view of main.cpp.
+	const float uvToPixels[2] = { 0.5f * 2560.0f / tanf( 40.0f * 3.14159265f / 180.0f ), 0.5f * 1440.0f / tanf( 40.0f * 3.14159265f / 180.0f ) };
+
+	bool ok = true;
+	const distortion_model_type_t types[] = { DISTORTION_MODEL_CATMULL_ROM, DISTORTION_MODEL_BROWN_CONRADY, DISTORTION_MODEL_RATIONAL, DISTORTION_MODEL_GRID };
+	for ( int t = 0; t < (int)( sizeof( types ) / sizeof( types[0] ) ); t++ )
+	{
+		distortion_model_t model;
+		bool created = false;
+		switch ( types[t] )
+		{
+			case DISTORTION_MODEL_CATMULL_ROM:		created = DistortionModel_CreateCatmullRom( &model, &hmdInfo ); break;
+			case DISTORTION_MODEL_BROWN_CONRADY:	created = DistortionModel_FitBrownConrady( &model, &hmdInfo ); break;
+			case DISTORTION_MODEL_RATIONAL:			created = DistortionModel_FitRational( &model, &hmdInfo ); break;
+			case DISTORTION_MODEL_GRID:				created = DistortionModel_SampleGrid( &model, &hmdInfo, 129, 129 ); break;
+		}
+		if ( !created )
+		{
+			printf( "  %s: could not be set up\n", DistortionModel_GetTypeName( types[t] ) );
+			ok = false;
+			continue;
+		}
+
+		std::vector<mesh_coord2d_t> scalar( count * NUM_COLOR_CHANNELS );
+		mesh_coord2d_t ( *scalarUvs )[NUM_COLOR_CHANNELS] = (mesh_coord2d_t (*)[NUM_COLOR_CHANNELS])scalar.data();
+		double scalarBest = 1e30;
+		for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+		{
+			Timer timer;
+			timer.start();
+			DistortionModel_EvaluateBatch( &model, thetaX.data(), thetaY.data(), count, scalarUvs, SIMD_PATH_SCALAR );
+			timer.stop();
+			scalarBest = ( timer.getElapsedTimeInMicroSec() < scalarBest ) ? timer.getElapsedTimeInMicroSec() : scalarBest;
+		}
+
+		// How far the model is from the Catmull-Rom lens it stands in for.
+		float maxError;
+		float meanError;
+		DistortionModel_MeasureError( &model, &hmdInfo, uvToPixels, &maxError, &meanError );
+		printf( "  %-13s: max %.4f mean %.4f pixels from the Catmull-Rom lens", DistortionModel_GetTypeName( types[t] ),
+				maxError, meanError );
+		if ( types[t] == DISTORTION_MODEL_CATMULL_ROM )
+		{
+			// The default path's own model has to be exactly EvaluateDistortion().
+			const int ulps = UvUlpDistance( scalarUvs, referenceUvs, count );
+			ok = ok && ( ulps == 0 );
+			printf( " (max %d ulp from EvaluateDistortion())", ulps );
+		}
+		printf( "\n" );
+		printf( "    scalar: %8.1f us, %6.2f ns/point\n", scalarBest, 1000.0 * scalarBest / count );
+
+		const simd_path_t paths[] = { SIMD_PATH_SSE2, SIMD_PATH_AVX2 };
+		for ( int p = 0; p < (int)( sizeof( paths ) / sizeof( paths[0] ) ); p++ )
+		{
+			if ( paths[p] > Simd_GetBestPath() )
+			{
+				printf( "    %-6s: not supported on this CPU\n", Simd_GetPathName( paths[p] ) );
+				continue;
+			}
+
+			std::vector<mesh_coord2d_t> results( count * NUM_COLOR_CHANNELS );
+			mesh_coord2d_t ( *resultUvs )[NUM_COLOR_CHANNELS] = (mesh_coord2d_t (*)[NUM_COLOR_CHANNELS])results.data();
+			double best = 1e30;
+			for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+			{
+				Timer timer;
+				timer.start();
+				DistortionModel_EvaluateBatch( &model, thetaX.data(), thetaY.data(), count, resultUvs, paths[p] );
+				timer.stop();
+				best = ( timer.getElapsedTimeInMicroSec() < best ) ? timer.getElapsedTimeInMicroSec() : best;
+			}
+			const int ulps = UvUlpDistance( resultUvs, scalarUvs, count );
+			ok = ok && ( ulps == 0 );
+			printf( "    %-6s: %8.1f us, %6.2f ns/point, %5.2fx, max %d ulp from scalar%s\n",
+					Simd_GetPathName( paths[p] ), best, 1000.0 * best / count, scalarBest / best, ulps,
+					( paths[p] == DistortionModel_GetBestSimd( &model ) ) ? " (default)" : "" );
+		}
+		DistortionModel_Destroy( &model );
+	}
+
+	printf( "Distortion model benchmark %s\n", ok ? "passed" : "FAILED: a SIMD path or the Catmull-Rom model differs from scalar" );
+	return ok;
+}
+
+static bool BenchmarkInverseDistortion()
+{
+	hmd_info_t hmdInfo;
+	GetDenseHmdInfo( &hmdInfo );
+	const int tilesWide = hmdInfo.eyeTilesWide;
+	const int tilesHigh = hmdInfo.eyeTilesHigh;
+	const float eyePixelsWide = (float)hmdInfo.displayPixelsWide / NUM_EYES;
+	const float meshPixelsHigh = (float)( tilesHigh * hmdInfo.tilePixelsHigh );
+
+	// Tile centers of one eye, which are all visible, and a column just
+	// outside each side of it, which are not.
+	std::vector<float> xfs;
+	std::vector<float> yfs;
+	std::vector<unsigned char> inside;
+	for ( int y = 0; y < tilesHigh; y++ )
+	{
+		const float yf = ( y + 0.5f ) / tilesHigh;
+		for ( int x = -1; x <= tilesWide; x++ )
+		{
+			const bool outside = ( x < 0 || x == tilesWide );
+			xfs.push_back( outside ? ( x < 0 ? -0.02f : 1.02f ) : ( x + 0.5f ) / tilesWide );
+			yfs.push_back( yf );
+			inside.push_back( outside ? 0 : 1 );
+		}
+	}
+	const int count = (int)xfs.size();
+	printf( "Inverse distortion benchmark: %d points per eye (%dx%d tile centers of %dx%d pixels and a column off each side), best of %d runs\n",
+			count, tilesWide, tilesHigh, hmdInfo.tilePixelsWide, hmdInfo.tilePixelsHigh, BENCHMARK_REPEATS );
+
+	bool ok = true;
+	for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+	{
+		for ( int eye = 0; eye < NUM_EYES; eye++ )
+		{
+			// The forward mapping, point by point.
+			std::vector<mesh_coord2d_t> uvs( count * NUM_COLOR_CHANNELS );
+			EvaluateDistortionPoints( &hmdInfo, eye, xfs.data(), yfs.data(), count, (mesh_coord2d_t (*)[NUM_COLOR_CHANNELS])uvs.data() );
+			std::vector<float> u( count );
+			std::vector<float> v( count );
+			for ( int i = 0; i < count; i++ )
+			{
+				u[i] = uvs[i * NUM_COLOR_CHANNELS + channel].x;
+				v[i] = uvs[i * NUM_COLOR_CHANNELS + channel].y;
+			}
+
+			for ( int iterations = 0; iterations <= INVERSE_DISTORTION_ITERATIONS + 1; iterations++ )
+			{
+				inverse_distortion_t inverse;
+				if ( !InverseDistortion_Create( &inverse, &hmdInfo, channel, iterations ) )
+				{
+					printf( "  channel %d: the lens cannot be inverted\n", channel );
+					return false;
+				}
+
+				std::vector<float> pixels( count * 2 );
+				std::vector<unsigned char> visible( count );
+				double best = 1e30;
+				for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+				{
+					Timer timer;
+					timer.start();
+					InverseDistortion_MapToDisplay( &inverse, &hmdInfo, eye, u.data(), v.data(), count,
+													(float (*)[2])pixels.data(), visible.data() );
+					timer.stop();
+					best = ( timer.getElapsedTimeInMicroSec() < best ) ? timer.getElapsedTimeInMicroSec() : best;
+				}
+
+				float maxError = 0.0f;
+				int wrongVisibility = 0;
+				for ( int i = 0; i < count; i++ )
+				{
+					const float dx = pixels[i * 2 + 0] - ( eye + xfs[i] ) * eyePixelsWide;
+					const float dy = pixels[i * 2 + 1] - yfs[i] * meshPixelsHigh;
+					const float error = sqrtf( dx * dx + dy * dy );
+					maxError = ( error > maxError ) ? error : maxError;
+					wrongVisibility += ( visible[i] != inside[i] ) ? 1 : 0;
+				}
+				if ( iterations == INVERSE_DISTORTION_ITERATIONS )
+				{
+					ok = ok && ( maxError < 0.01f ) && ( wrongVisibility == 0 );
+				}
+				if ( eye == 0 )
+				{
+					printf( "  channel %d, %d Newton iterations%s: %8.1f us, %6.2f ns/point, max error %.6f display pixels, %d visibility errors\n",
+							channel, iterations, ( iterations == INVERSE_DISTORTION_ITERATIONS ) ? " (default)" : "           ",
+							best, 1000.0 * best / count, maxError, wrongVisibility );
+				}
+			}
+		}
+	}
+
+	printf( "Inverse distortion benchmark %s\n", ok ? "passed" : "FAILED: the default solver is off by 0.01 display pixels or more" );
+	return ok;
+}
+
+static bool BenchmarkMeshBuild()
+{
+	hmd_info_t hmdInfo;
+	GetDenseHmdInfo( &hmdInfo );
+
+	const int numVertices = ( hmdInfo.eyeTilesWide + 1 ) * ( hmdInfo.eyeTilesHigh + 1 );
+	const int hardwareThreads = (int)std::thread::hardware_concurrency();
+	const int maxThreads = ( hardwareThreads > 4 ) ? hardwareThreads : 4;
+	printf( "Mesh build benchmark: %dx%d panel, %dx%d tiles of %dx%d pixels per eye, %d vertices, %d hardware threads, best of %d runs\n",
+			hmdInfo.displayPixelsWide, hmdInfo.displayPixelsHigh, hmdInfo.eyeTilesWide, hmdInfo.eyeTilesHigh,
+			hmdInfo.tilePixelsWide, hmdInfo.tilePixelsHigh, NUM_EYES * numVertices, hardwareThreads, BENCHMARK_REPEATS );
+
+	bool ok = true;
+	const int symmetries[] = { DISTORTION_SYMMETRY_NONE, GetDistortionSymmetry( &hmdInfo ) };
+	for ( int s = 0; s < (int)( sizeof( symmetries ) / sizeof( symmetries[0] ) ); s++ )
+	{
+		std::vector<mesh_coord2d_t> coords[2];
+		std::vector<distortion_vertex_t> vertices[2];
+		mesh_coord2d_t * distort_coords[2][NUM_EYES][NUM_COLOR_CHANNELS];
+		for ( int b = 0; b < 2; b++ )
+		{
+			coords[b].resize( NUM_EYES * NUM_COLOR_CHANNELS * numVertices );
+			vertices[b].resize( NUM_EYES * numVertices );
+			for ( int eye = 0; eye < NUM_EYES; eye++ )
+			{
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					distort_coords[b][eye][channel] = coords[b].data() + ( eye * NUM_COLOR_CHANNELS + channel ) * numVertices;
+				}
+			}
+		}
+
+		// The serial build is the reference.
+		BuildDistortionMeshes( distort_coords[0], &hmdInfo, symmetries[s] );
+		BuildDistortionVertices( &hmdInfo, distort_coords[0], vertices[0].data() );
+
+		printf( "  symmetry 0x%x:\n", symmetries[s] );
+		double serialBest = 0.0;
+		for ( int threads = 1; ; threads = ( threads * 2 < maxThreads ) ? threads * 2 : maxThreads )
+		{
+			// The app starts its pool once per process and builds every mesh on
+			// it, so the builds are timed on a pool that already runs, and what
+			// a pool per build would add (spawning and joining the workers) is
+			// timed on its own.
+			double poolBest = 1e30;
+			for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+			{
+				Timer timer;
+				timer.start();
+				{
+					ThreadPool startStop( threads );
+				}
+				timer.stop();
+				poolBest = ( timer.getElapsedTimeInMicroSec() < poolBest ) ? timer.getElapsedTimeInMicroSec() : poolBest;
+			}
+
+			ThreadPool pool( threads );
+			double meshBest = 1e30;
+			double vertexBest = 1e30;
+			for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+			{
+				memset( coords[1].data(), 0, coords[1].size() * sizeof( mesh_coord2d_t ) );
+				memset( vertices[1].data(), 0, vertices[1].size() * sizeof( distortion_vertex_t ) );
+
+				Timer timer;
+				timer.start();
+				BuildDistortionMeshes( distort_coords[1], &hmdInfo, symmetries[s], NULL, &pool );
+				timer.stop();
+				meshBest = ( timer.getElapsedTimeInMicroSec() < meshBest ) ? timer.getElapsedTimeInMicroSec() : meshBest;
+
+				timer.start();
+				BuildDistortionVertices( &hmdInfo, distort_coords[1], vertices[1].data(), &pool );
+				timer.stop();
+				vertexBest = ( timer.getElapsedTimeInMicroSec() < vertexBest ) ? timer.getElapsedTimeInMicroSec() : vertexBest;
+			}
+
+			const bool identical = memcmp( coords[0].data(), coords[1].data(), coords[0].size() * sizeof( mesh_coord2d_t ) ) == 0 &&
+								   memcmp( vertices[0].data(), vertices[1].data(), vertices[0].size() * sizeof( distortion_vertex_t ) ) == 0;
+			ok = ok && identical;
+
+			const double total = meshBest + vertexBest;
+			serialBest = ( threads == 1 ) ? total : serialBest;
+			printf( "    %2d threads: UVs %8.1f us + vertices %8.1f us = %8.1f us, %5.2fx (pool start/stop %6.1f us), %s\n",
+					threads, meshBest, vertexBest, total, serialBest / total, poolBest, identical ? "identical to serial" : "DIFFERS from serial" );
+			if ( threads == maxThreads )
+			{
+				break;
+			}
+		}
+	}
+
+	printf( "Mesh build benchmark %s\n", ok ? "passed" : "FAILED: a parallel build differs from the serial one" );
+	return ok;
+}
+
+// Matrices per timed run of a matrix routine.
+static const int MATRIX_BENCHMARK_COUNT = 4096;
+
+typedef enum
+{
+	MATRIX_OP_MULTIPLY,
+	MATRIX_OP_TRANSPOSE,
+	MATRIX_OP_INVERT,
+	MATRIX_OP_INVERT_HOMOGENEOUS,
+	MATRIX_OP_CREATE_3X4,
+	MATRIX_OP_TIMEWARP_TRANSFORM,		// the chain of CalculateTimeWarpTransform() and the 3x4 conversion
+	MATRIX_OP_MAX
+} matrix_op_t;
+
+static const char * MatrixOpName( const matrix_op_t op )
+{
+	switch ( op )
+	{
+		case MATRIX_OP_MULTIPLY:			return "Multiply";
+		case MATRIX_OP_TRANSPOSE:			return "Transpose";
+		case MATRIX_OP_INVERT:				return "Invert";
+		case MATRIX_OP_INVERT_HOMOGENEOUS:	return "InvertHomogeneous";
+		case MATRIX_OP_CREATE_3X4:			return "3x4 from 4x4";
+		default:							return "timewarp transform";
+	}
+}
+
+// One routine on a and b (b only for the ones with two operands), with the
+// algebra.h code when reference is set and the SIMD version's simd path otherwise.
+static void RunMatrixOp( const matrix_op_t op, const bool reference, const simd_path_t simd, const ksMatrix4x4f * projection,
+						 const ksMatrix4x4f * a, const ksMatrix4x4f * b, float * out )
+{
+	ksMatrix4x4f * result = (ksMatrix4x4f *)out;
+	switch ( op )
+	{
+		case MATRIX_OP_MULTIPLY:
+			reference ? ksMatrix4x4f_Multiply( result, a, b ) : ksMatrix4x4f_MultiplySimd( result, a, b, simd );
+			break;
+		case MATRIX_OP_TRANSPOSE:
+			reference ? ksMatrix4x4f_Transpose( result, a ) : ksMatrix4x4f_TransposeSimd( result, a, simd );
+			break;
+		case MATRIX_OP_INVERT:
+			reference ? ksMatrix4x4f_Invert( result, a ) : ksMatrix4x4f_InvertSimd( result, a, simd );
+			break;
+		case MATRIX_OP_INVERT_HOMOGENEOUS:
+			reference ? ksMatrix4x4f_InvertHomogeneous( result, a ) : ksMatrix4x4f_InvertHomogeneousSimd( result, a, simd );
+			break;
+		case MATRIX_OP_CREATE_3X4:
+			reference ? ksMatrix3x4f_CreateFromMatrix4x4f( (ksMatrix3x4f *)out, a ) : ksMatrix3x4f_CreateFromMatrix4x4fSimd( (ksMatrix3x4f *)out, a, simd );
+			break;
+		default:
+		{
+			ksMatrix4x4f inverseRender;
+			ksMatrix4x4f delta;
+			ksMatrix4x4f inverseDelta;
+			ksMatrix4x4f transform;
+			if ( reference )
+			{
+				ksMatrix4x4f_InvertHomogeneous( &inverseRender, a );
+				ksMatrix4x4f_Multiply( &delta, &inverseRender, b );
+				ksMatrix4x4f_InvertHomogeneous( &inverseDelta, &delta );
+			}
+			else
+			{
+				ksMatrix4x4f_InvertHomogeneousSimd( &inverseRender, a, simd );
+				ksMatrix4x4f_MultiplySimd( &delta, &inverseRender, b, simd );
+				ksMatrix4x4f_InvertHomogeneousSimd( &inverseDelta, &delta, simd );
+			}
+			inverseDelta.m[3][0] = 0.0f;
+			inverseDelta.m[3][1] = 0.0f;
+			inverseDelta.m[3][2] = 0.0f;
+			if ( reference )
+			{
+				ksMatrix4x4f_Multiply( &transform, projection, &inverseDelta );
+				ksMatrix3x4f_CreateFromMatrix4x4f( (ksMatrix3x4f *)out, &transform );
+			}
+			else
+			{
+				ksMatrix4x4f_MultiplySimd( &transform, projection, &inverseDelta, simd );
+				ksMatrix3x4f_CreateFromMatrix4x4fSimd( (ksMatrix3x4f *)out, &transform, simd );
+			}
+			break;
+		}
+	}
+}
+
+static float RandomFloat( const float low, const float high )
+{
+	return low + ( high - low ) * ( (float)rand() / (float)RAND_MAX );
+}
+
+static bool BenchmarkMatrix()
+{
+	// Head poses (rotation and translation) for the routines that need a
+	// homogeneous matrix, diagonally dominant general matrices for the rest.
+	srand( 1 );
+	std::vector<ksMatrix4x4f> poses( MATRIX_BENCHMARK_COUNT + 1 );
+	std::vector<ksMatrix4x4f> general( MATRIX_BENCHMARK_COUNT + 1 );
+	for ( int i = 0; i <= MATRIX_BENCHMARK_COUNT; i++ )
+	{
+		ksMatrix4x4f rotation;
+		ksMatrix4x4f translation;
+		ksMatrix4x4f_CreateRotation( &rotation, RandomFloat( -90.0f, 90.0f ), RandomFloat( -180.0f, 180.0f ), RandomFloat( -45.0f, 45.0f ) );
+		ksMatrix4x4f_CreateTranslation( &translation, RandomFloat( -2.0f, 2.0f ), RandomFloat( -2.0f, 2.0f ), RandomFloat( -2.0f, 2.0f ) );
+		ksMatrix4x4f_Multiply( &poses[i], &translation, &rotation );
+
+		for ( int c = 0; c < 4; c++ )
+		{
+			for ( int r = 0; r < 4; r++ )
+			{
+				general[i].m[c][r] = RandomFloat( -1.0f, 1.0f ) + ( ( c == r ) ? 4.0f : 0.0f );
+			}
+		}
+	}
+	ksMatrix4x4f projection;
+	ksMatrix4x4f_CreateProjectionFov( &projection, 40.0f, 40.0f, 40.0f, 40.0f, 0.1f, 0.0f );
+
+	printf( "Matrix benchmark: %d matrices per run, best of %d runs, ns per call\n", MATRIX_BENCHMARK_COUNT, BENCHMARK_REPEATS );
+
+	bool ok = true;
+	const simd_path_t paths[] = { SIMD_PATH_SCALAR, SIMD_PATH_SSE2, SIMD_PATH_AVX2 };
+	for ( int op = 0; op < MATRIX_OP_MAX; op++ )
+	{
+		const bool homogeneous = ( op == MATRIX_OP_INVERT_HOMOGENEOUS || op == MATRIX_OP_TIMEWARP_TRANSFORM );
+		const ksMatrix4x4f * inputs = homogeneous ? poses.data() : general.data();
+
+		// algebra.h first, as the reference, then each path of the SIMD version.
+		std::vector<ksMatrix4x4f> reference( MATRIX_BENCHMARK_COUNT );
+		std::vector<ksMatrix4x4f> results( MATRIX_BENCHMARK_COUNT );
+		double referenceBest = 1e30;
+		printf( "  %-19s", MatrixOpName( (matrix_op_t)op ) );
+		for ( int p = -1; p < (int)( sizeof( paths ) / sizeof( paths[0] ) ); p++ )
+		{
+			if ( p >= 0 && paths[p] > Simd_GetBestPath() )
+			{
+				printf( "  %s: n/a", Simd_GetPathName( paths[p] ) );
+				continue;
+			}
+			std::vector<ksMatrix4x4f> & out = ( p < 0 ) ? reference : results;
+			memset( out.data(), 0, out.size() * sizeof( ksMatrix4x4f ) );
+
+			double best = 1e30;
+			for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+			{
+				Timer timer;
+				timer.start();
+				for ( int i = 0; i < MATRIX_BENCHMARK_COUNT; i++ )
+				{
+					RunMatrixOp( (matrix_op_t)op, p < 0, ( p < 0 ) ? SIMD_PATH_SCALAR : paths[p], &projection,
+								 &inputs[i], &inputs[i + 1], out[i].m[0] );
+				}
+				timer.stop();
+				best = ( timer.getElapsedTimeInMicroSec() < best ) ? timer.getElapsedTimeInMicroSec() : best;
+			}
+			const double ns = 1000.0 * best / MATRIX_BENCHMARK_COUNT;
+
+			if ( p < 0 )
+			{
+				referenceBest = best;
+				printf( "algebra.h %6.2f", ns );
+				continue;
+			}
+			const bool identical = memcmp( reference.data(), results.data(), results.size() * sizeof( ksMatrix4x4f ) ) == 0;
+			ok = ok && identical;
+			printf( "  %s %6.2f (%4.2fx)%s", Simd_GetPathName( paths[p] ), ns, referenceBest / best, identical ? "" : " DIFFERS" );
+		}
+		printf( "\n" );
+	}
+
+	printf( "Matrix benchmark %s\n", ok ? "passed" : "FAILED: a SIMD routine is not bit identical to algebra.h" );
+	return ok;
+}
+
+// Time stamp counter, or microseconds where there is none.
+static unsigned long long ReadCycles()
+{
+#if defined( BENCHMARK_HAVE_RDTSC )
+	return __rdtsc();
+#else
+	Timer timer;
+	return (unsigned long long)timer.getElapsedTimeInMicroSec();
+#endif
+}
+
+static void RandomOrientation( ksQuatf * result, const float degrees )
+{
+	CreateRotationQuaternion( result, RandomFloat( -degrees, degrees ), RandomFloat( -degrees, degrees ), RandomFloat( -degrees, degrees ) );
+}
+
+static bool BenchmarkRotationTimewarp()
+{
+	// Render orientations all around, with predictions up to 30 degrees per axis off them.
+	srand( 1 );
+	const int count = MATRIX_BENCHMARK_COUNT;
+	std::vector<ksQuatf> render( count );
+	std::vector<ksQuatf> predicted( count );
+	std::vector<ksMatrix4x4f> renderViews( count );
+	std::vector<ksMatrix4x4f> predictedViews( count );
+	for ( int i = 0; i < count; i++ )
+	{
+		ksQuatf offset;
+		RandomOrientation( &render[i], 180.0f );
+		RandomOrientation( &offset, 30.0f );
+		MultiplyQuaternions( &predicted[i], &offset, &render[i] );
+		ksMatrix4x4f_CreateFromQuaternion( &renderViews[i], &render[i] );
+		ksMatrix4x4f_CreateFromQuaternion( &predictedViews[i], &predicted[i] );
+	}
+	ksMatrix4x4f projection;
+	ksMatrix4x4f_CreateProjectionFov( &projection, 40.0f, 40.0f, 40.0f, 40.0f, 0.1f, 0.0f );
+
+	printf( "Rotation timewarp benchmark: %d pose pairs per run, best of %d runs, %s per transform\n", count, BENCHMARK_REPEATS,
+#if defined( BENCHMARK_HAVE_RDTSC )
+			"TSC cycles"
+#else
+			"microseconds"
+#endif
+			);
+
+	// 0: CalculateTimeWarpTransform() from view matrices, 1: from orientations, 2: the quaternion path.
+	std::vector<ksMatrix3x4f> results[3];
+	double bestCycles[3];
+	const char * names[3] =
+	{
+		"CalculateTimeWarpTransform, view matrices in",
+		"CalculateTimeWarpTransform, orientations in",
+		"CalculateRotationTimeWarpTransform"
+	};
+	for ( int path = 0; path < 3; path++ )
+	{
+		results[path].resize( count );
+		bestCycles[path] = 1e30;
+		for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+		{
+			const unsigned long long start = ReadCycles();
+			for ( int i = 0; i < count; i++ )
+			{
+				if ( path == 2 )
+				{
+					CalculateRotationTimeWarpTransform( &results[path][i], &projection, &render[i], &predicted[i] );
+					continue;
+				}
+				ksMatrix4x4f renderView;
+				ksMatrix4x4f predictedView;
+				if ( path == 1 )
+				{
+					ksMatrix4x4f_CreateFromQuaternion( &renderView, &render[i] );
+					ksMatrix4x4f_CreateFromQuaternion( &predictedView, &predicted[i] );
+				}
+				ksMatrix4x4f transform;
+				CalculateTimeWarpTransform( &transform, &projection, ( path == 1 ) ? &renderView : &renderViews[i],
+											( path == 1 ) ? &predictedView : &predictedViews[i] );
+				ksMatrix3x4f_CreateFromMatrix4x4fSimd( &results[path][i], &transform );
+			}
+			const double cycles = (double)( ReadCycles() - start ) / count;
+			bestCycles[path] = ( cycles < bestCycles[path] ) ? cycles : bestCycles[path];
+		}
+	}
+
+	// Against the matrix path; the transform entries are around 1.
+	float maxDifference = 0.0f;
+	for ( int i = 0; i < count; i++ )
+	{
+		for ( int r = 0; r < 3; r++ )
+		{
+			for ( int c = 0; c < 4; c++ )
+			{
+				maxDifference = MaxFloat( maxDifference, fabsf( results[2][i].m[r][c] - results[0][i].m[r][c] ) );
+			}
+		}
+	}
+
+	// And the quaternion of the simulated head motion against ksMatrix4x4f_CreateRotation().
+	float maxRotationDifference = 0.0f;
+	for ( int i = 0; i < count; i++ )
+	{
+		const float degrees[3] = { RandomFloat( -90.0f, 90.0f ), RandomFloat( -180.0f, 180.0f ), RandomFloat( -45.0f, 45.0f ) };
+		ksMatrix4x4f rotation;
+		ksMatrix4x4f fromQuaternion;
+		ksQuatf orientation;
+		ksMatrix4x4f_CreateRotation( &rotation, degrees[0], degrees[1], degrees[2] );
+		CreateRotationQuaternion( &orientation, degrees[0], degrees[1], degrees[2] );
+		ksMatrix4x4f_CreateFromQuaternion( &fromQuaternion, &orientation );
+		for ( int j = 0; j < 16; j++ )
+		{
+			maxRotationDifference = MaxFloat( maxRotationDifference, fabsf( rotation.m[j / 4][j % 4] - fromQuaternion.m[j / 4][j % 4] ) );
+		}
+	}
+
+	for ( int path = 0; path < 3; path++ )
+	{
+		printf( "  %-45s: %7.1f, %5.2fx\n", names[path], bestCycles[path], bestCycles[1] / bestCycles[path] );
+	}
+	printf( "  max difference from the matrix path: %g; CreateRotationQuaternion against ksMatrix4x4f_CreateRotation: %g\n",
+			maxDifference, maxRotationDifference );
+
+	const bool ok = ( maxDifference < 1e-5f ) && ( maxRotationDifference < 1e-5f );
+	printf( "Rotation timewarp benchmark %s\n", ok ? "passed" : "FAILED: the quaternion path differs from the matrix path" );
+	return ok;
+}
+
+// Synthetic head motion: a 60 degree turn every 2 seconds, alternately left
+// and right, over a slow wobble and a small tremor.
+static void SyntheticHeadOrientation( const double time, ksQuatf * orientation )
+{
+	const int turn = (int)floor( time / 2.0 );
+	const double t = MinFloat( (float)( ( time - turn * 2.0 ) / 0.3 ), 1.0f );
+	const double smooth = t * t * ( 3.0 - 2.0 * t );
+	const double yaw = 60.0 * ( ( turn & 1 ) ? ( 1.0 - smooth ) : smooth );
+	const double pitch = 10.0 * sin( 2.0 * time ) + 0.5 * sin( 2.0 * MATH_PI * 3.0 * time );
+	CreateRotationQuaternion( orientation, (float)pitch, (float)( yaw + 10.0 * cos( 2.0 * time ) ), 0.0f );
+}
+
+static bool BenchmarkPosePrediction()
+{
+	// 10 seconds of a 1 kHz tracker: the exact orientation, and the rate of
+	// the motion around each sample plus some gyro noise.
+	const double period = 0.001;
+	const float gyroNoise = 0.02f;		// radians per second, about
+	pose_trace_t trace;
+	trace.numSamples = 10001;
+	trace.samples = (pose_sample_t *)malloc( trace.numSamples * sizeof( pose_sample_t ) );
+	srand( 1 );
+	for ( int i = 0; i < trace.numSamples; i++ )
+	{
+		pose_sample_t * sample = &trace.samples[i];
+		sample->time = i * period;
+		SyntheticHeadOrientation( sample->time, &sample->orientation );
+
+		ksQuatf before;
+		ksQuatf after;
+		SyntheticHeadOrientation( sample->time - 0.5 * period, &before );
+		SyntheticHeadOrientation( sample->time + 0.5 * period, &after );
+		PosePredictor_GetAngularVelocity( &before, &after, (float)period, &sample->angularVelocity );
+		sample->angularVelocity.x += gyroNoise * ( RandomFloat( -1.0f, 1.0f ) + RandomFloat( -1.0f, 1.0f ) + RandomFloat( -1.0f, 1.0f ) );
+		sample->angularVelocity.y += gyroNoise * ( RandomFloat( -1.0f, 1.0f ) + RandomFloat( -1.0f, 1.0f ) + RandomFloat( -1.0f, 1.0f ) );
+		sample->angularVelocity.z += gyroNoise * ( RandomFloat( -1.0f, 1.0f ) + RandomFloat( -1.0f, 1.0f ) + RandomFloat( -1.0f, 1.0f ) );
+	}
+
+	pose_replay_error_t errors[POSE_PREDICTION_MAX][POSE_REPLAY_NUM_HORIZONS];
+	PoseTrace_Report( &trace, "a synthetic head motion", errors );
+	PoseTrace_Destroy( &trace );
+
+	// On this trace constant velocity has to beat no prediction at every horizon past zero.
+	bool ok = true;
+	for ( int h = 0; h < POSE_REPLAY_NUM_HORIZONS; h++ )
+	{
+		if ( errors[POSE_PREDICTION_NONE][h].count > 0 && errors[POSE_PREDICTION_NONE][h].horizon > 0.0f )
+		{
+			ok = ok && ( errors[POSE_PREDICTION_CONSTANT_VELOCITY][h].meanDegrees < errors[POSE_PREDICTION_NONE][h].meanDegrees );
+		}
+	}
+	printf( "Pose prediction benchmark %s\n", ok ? "passed" : "FAILED: constant velocity prediction does not beat none" );
+	return ok;
+}
+
+// A handoff benchmark sample: the synthetic head motion at the time of a
+// clock of its own, so a reader can recompute it and tell a torn sample.
+static void HandoffSample( pose_sample_t * sample, const double start )
+{
+	sample->time = PoseHandoff_GetTime() - start;
+	SyntheticHeadOrientation( sample->time, &sample->orientation );
+	sample->angularVelocity.x = (float)sample->time;
+	sample->angularVelocity.y = (float)( sample->time * 2.0 );
+	sample->angularVelocity.z = (float)( sample->time * 3.0 );
+}
+
+static bool HandoffSampleIsWhole( const pose_sample_t * sample )
+{
+	ksQuatf orientation;
+	SyntheticHeadOrientation( sample->time, &orientation );
+	return	memcmp( &orientation, &sample->orientation, sizeof( orientation ) ) == 0 &&
+			sample->angularVelocity.x == (float)sample->time &&
+			sample->angularVelocity.y == (float)( sample->time * 2.0 ) &&
+			sample->angularVelocity.z == (float)( sample->time * 3.0 );
+}
+
+static const double HANDOFF_BENCHMARK_SECONDS = 2.0;
+static const double HANDOFF_BENCHMARK_PERIOD = 0.001;			// a 1 kHz IMU
+static const double HANDOFF_BENCHMARK_FRAME = 1.0 / 90.0;
+
+static bool BenchmarkPoseHandoff()
+{
+	// The same sensor thread with no reader, with a reader at the display
+	// rate as the warp, and with a reader that reads as fast as it can.
+	const int numReaders = 3;
+	const char * readerNames[numReaders] = { "no reader", "90 Hz reader", "spinning reader" };
+
+	printf( "Pose handoff: a %.0f Hz sensor thread for %.0f s per reader, %d hardware threads\n",
+			1.0 / HANDOFF_BENCHMARK_PERIOD, HANDOFF_BENCHMARK_SECONDS, (int)std::thread::hardware_concurrency() );
+
+	bool ok = true;
+	for ( int reader = 0; reader < numReaders; reader++ )
+	{
+		PoseHandoff handoff;
+		SensorThread sensor;
+		const double start = PoseHandoff_GetTime();
+		sensor.start( &handoff, HANDOFF_BENCHMARK_PERIOD, [start]( pose_sample_t * sample ) { HandoffSample( sample, start ); } );
+
+		LatencyStats readStats;
+		int received = 0;
+		int broken = 0;				// torn or out of order
+		int retries = 0;
+		double lastTime = -1.0;
+		double nextFrame = start;
+		for ( ;; )
+		{
+			const double now = PoseHandoff_GetTime();
+			const bool last = ( now - start >= HANDOFF_BENCHMARK_SECONDS );
+			if ( last )
+			{
+				// What is left in the ring.
+				sensor.stop();
+			}
+			else if ( reader == 0 )
+			{
+				std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+				continue;
+			}
+			else if ( reader == 1 )
+			{
+				nextFrame += HANDOFF_BENCHMARK_FRAME;
+				if ( nextFrame > now )
+				{
+					std::this_thread::sleep_for( std::chrono::duration<double>( nextFrame - now ) );
+				}
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+
+			const double begin = PoseHandoff_GetTime();
+			pose_sample_t sample;
+			while ( handoff.popSample( &sample ) )
+			{
+				broken += ( !HandoffSampleIsWhole( &sample ) || sample.time <= lastTime );
+				lastTime = sample.time;
+				received++;
+			}
+			int sampleRetries = 0;
+			if ( handoff.readLatest( &sample, &sampleRetries ) )
+			{
+				broken += !HandoffSampleIsWhole( &sample );
+			}
+			const double readTime = PoseHandoff_GetTime() - begin;
+			if ( !last )
+			{
+				readStats.add( readTime );
+				retries += sampleRetries;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		const int published = handoff.getPublishStats().getCount();
+		const int dropped = handoff.getDropCount();
+		printf( "%s: %d samples, %d dropped by the full ring, %d seqlock retries, %d torn or out of order\n",
+				readerNames[reader], published, dropped, retries, broken );
+		sensor.getIntervalStats().print( "sample interval" );
+		handoff.getPublishStats().print( "publish (sensor thread)" );
+		if ( reader > 0 )
+		{
+			readStats.print( "read (reader thread)" );
+		}
+
+		// Every sample arrives whole and in order, or is counted as dropped,
+		// and a reader at the display rate never lets the ring fill up.
+		ok = ok && ( broken == 0 ) && ( received + dropped == published ) && ( reader != 1 || dropped == 0 );
+	}
+
+	printf( "Pose handoff benchmark %s\n", ok ? "passed" : "FAILED: samples were torn, out of order or lost" );
+	return ok;
+}
+
+// A history pose of the synthetic head motion, with a position that moves
+// linearly, so interpolating it is exact.
+static void HistoryPose( timed_pose_t * pose, const double time )
+{
+	pose->time = time;
+	SyntheticHeadOrientation( time, &pose->orientation );
+	pose->position.x = (float)( 0.1 * time );
+	pose->position.y = (float)( -0.05 * time );
+	pose->position.z = 0.0f;
+}
+
+static const int HISTORY_BENCHMARK_LOOKUPS = 4096;
+
+static bool BenchmarkPoseHistory()
+{
+	bool ok = true;
+
+	// Interpolation error a quarter of the way between poses (halfway nlerp
+	// and slerp agree), at the spacing of a 1 kHz
+	// tracker and of 90 and 30 Hz app frames, over the 60 degree head turns.
+	const double spacings[] = { 0.001, 1.0 / 90.0, 1.0 / 30.0 };
+	const char * interpolationNames[] = { "nlerp", "slerp" };
+	printf( "Pose history: %d entries\n", POSE_HISTORY_SIZE );
+	printf( "Max orientation error a quarter of the way between poses, degrees:\n" );
+	for ( int s = 0; s < (int)( sizeof( spacings ) / sizeof( spacings[0] ) ); s++ )
+	{
+		PoseHistory history;
+		for ( int i = 0; i < POSE_HISTORY_SIZE; i++ )
+		{
+			timed_pose_t pose;
+			HistoryPose( &pose, i * spacings[s] );
+			history.add( pose );
+		}
+
+		printf( "  %6.2f ms apart:", spacings[s] * 1000.0 );
+		float maxErrors[2] = { 0.0f, 0.0f };
+		for ( int interpolation = 0; interpolation < 2; interpolation++ )
+		{
+			for ( int i = 0; i < POSE_HISTORY_SIZE - 1; i++ )
+			{
+				const double time = ( i + 0.25 ) * spacings[s];
+				timed_pose_t expected;
+				timed_pose_t pose;
+				HistoryPose( &expected, time );
+				history.getPose( time, &pose, (pose_interpolation_t)interpolation );
+				maxErrors[interpolation] = fmaxf( maxErrors[interpolation], PosePredictor_GetAngleDegrees( &pose.orientation, &expected.orientation ) );
+			}
+			printf( "  %s %9.6f", interpolationNames[interpolation], maxErrors[interpolation] );
+		}
+		printf( "\n" );
+		ok = ok && ( maxErrors[POSE_INTERPOLATION_SLERP] <= maxErrors[POSE_INTERPOLATION_NLERP] + 1e-4f );
+	}
+
+	// What the warp was off by with an identity render pose, for eye buffers
+	// rendered at random times of the motion.
+	{
+		srand( 1 );
+		PoseHistory history;
+		for ( int i = 0; i < POSE_HISTORY_SIZE; i++ )
+		{
+			timed_pose_t pose;
+			HistoryPose( &pose, i * 0.001 );
+			history.add( pose );
+		}
+		const ksQuatf identity = { 0.0f, 0.0f, 0.0f, 1.0f };
+		double identityError = 0.0;
+		double historyError = 0.0;
+		for ( int i = 0; i < HISTORY_BENCHMARK_LOOKUPS; i++ )
+		{
+			const double time = RandomFloat( 0.0f, ( POSE_HISTORY_SIZE - 1 ) * 0.001f );
+			timed_pose_t expected;
+			timed_pose_t pose;
+			HistoryPose( &expected, time );
+			history.getPose( time, &pose );
+			identityError += PosePredictor_GetAngleDegrees( &identity, &expected.orientation );
+			historyError += PosePredictor_GetAngleDegrees( &pose.orientation, &expected.orientation );
+		}
+		printf( "Mean render pose error: identity %.3f degrees, history %.6f degrees\n",
+				identityError / HISTORY_BENCHMARK_LOOKUPS, historyError / HISTORY_BENCHMARK_LOOKUPS );
+	}
+
+	// Lookup cost over a full history.
+	{
+		srand( 1 );
+		PoseHistory history;
+		for ( int i = 0; i < POSE_HISTORY_SIZE; i++ )
+		{
+			timed_pose_t pose;
+			HistoryPose( &pose, i * 0.001 );
+			history.add( pose );
+		}
+		std::vector<double> times( HISTORY_BENCHMARK_LOOKUPS );
+		for ( int i = 0; i < HISTORY_BENCHMARK_LOOKUPS; i++ )
+		{
+			times[i] = RandomFloat( 0.0f, ( POSE_HISTORY_SIZE - 1 ) * 0.001f );
+		}
+		printf( "Lookup time:" );
+		for ( int interpolation = 0; interpolation < 2; interpolation++ )
+		{
+			double best = 1e30;
+			float checksum = 0.0f;
+			for ( int r = 0; r < BENCHMARK_REPEATS; r++ )
+			{
+				Timer timer;
+				timer.start();
+				for ( int i = 0; i < HISTORY_BENCHMARK_LOOKUPS; i++ )
+				{
+					timed_pose_t pose;
+					history.getPose( times[i], &pose, (pose_interpolation_t)interpolation );
+					checksum += pose.orientation.w;
+				}
+				timer.stop();
+				best = fmin( best, timer.getElapsedTimeInMicroSec() );
+			}
+			printf( "  %s %.1f ns", interpolationNames[interpolation], best * 1000.0 / HISTORY_BENCHMARK_LOOKUPS + checksum * 0.0f );
+		}
+		printf( "\n" );
+	}
+
+	// A writer that adds as fast as it can, lapping the ring all the time,
+	// and a reader looking up the last half second: every pose it gets must
+	// be the interpolation of two whole entries, or a whole entry newer than
+	// the lookup when the writer overwrote that part of the history first.
+	{
+		PoseHistory history;
+		std::atomic<bool> quit( false );
+		std::atomic<int> added( 0 );
+		std::thread writer( [&]()
+		{
+			for ( int i = 0; !quit.load( std::memory_order_relaxed ); i++ )
+			{
+				timed_pose_t pose;
+				HistoryPose( &pose, i * 0.001 );
+				history.add( pose );
+				added.store( i + 1, std::memory_order_relaxed );
+			}
+		} );
+
+		srand( 1 );
+		int lookups = 0;
+		int overtaken = 0;
+		int wrong = 0;
+		const double start = PoseHandoff_GetTime();
+		while ( PoseHandoff_GetTime() - start < 1.0 )
+		{
+			double oldest;
+			double newest;
+			if ( !history.getTimeRange( &oldest, &newest ) )
+			{
+				continue;
+			}
+			const double time = newest - RandomFloat( 0.0f, 0.5f );
+			timed_pose_t expected;
+			timed_pose_t pose;
+			HistoryPose( &expected, time );
+			history.getPose( time, &pose );
+			if ( pose.time != time )
+			{
+				HistoryPose( &expected, pose.time );
+				overtaken++;
+				wrong += ( pose.time < time || memcmp( &pose.orientation, &expected.orientation, sizeof( ksQuatf ) ) != 0 ||
+						   pose.position.x != expected.position.x || pose.position.y != expected.position.y );
+			}
+			else
+			{
+				wrong += ( PosePredictor_GetAngleDegrees( &pose.orientation, &expected.orientation ) > 0.01f ||
+						   fabsf( pose.position.x - expected.position.x ) > 1e-4f );
+			}
+			lookups++;
+		}
+		quit.store( true );
+		writer.join();
+		printf( "Concurrent: %d lookups while %d poses were added (%d laps of the ring), %d overtaken by the writer, %d wrong\n",
+				lookups, added.load(), added.load() / POSE_HISTORY_SIZE, overtaken, wrong );
+		ok = ok && ( wrong == 0 );
+	}
+
+	printf( "Pose history benchmark %s\n", ok ? "passed" : "FAILED: a lookup returned a wrong pose" );
+	return ok;
+}
+
+static float SceneInverseDepth( const float u, const float v )
+{
+	return PositionalWarp_GetSceneInverseDepth( v );
+}
+
+static const int POSITIONAL_BENCHMARK_RAYS = 64;				// per side, over the eye buffer's field of view
+static const int POSITIONAL_BENCHMARK_EYE_WIDTH = 2560;
+static const int POSITIONAL_BENCHMARK_EYE_HEIGHT = 1440;
+
+static bool BenchmarkPositionalTimewarp()
+{
+	// The eye buffer projection of the warp, and a 2 degree turn on top of
+	// each head translation, which the rotation transform handles exactly.
+	ksMatrix4x4f projection;
+	ksMatrix4x4f_CreateProjectionFov( &projection, 40.0f, 40.0f, 40.0f, 40.0f, 0.1f, 0.0f );
+	const ksQuatf renderOrientation = { 0.0f, 0.0f, 0.0f, 1.0f };
+	ksQuatf newOrientation;
+	CreateRotationQuaternion( &newOrientation, 0.0f, 2.0f, 0.0f );
+	ksMatrix3x4f transform;
+	CalculateRotationTimeWarpTransform( &transform, &projection, &renderOrientation, &newOrientation );
+
+	// The scene's inverse depth is a + b * v.
+	const float a = PositionalWarp_GetSceneInverseDepth( 0.0f );
+	const float b = PositionalWarp_GetSceneInverseDepth( 1.0f ) - a;
+
+	// How far the head moves at 1 m/s while the app renders one frame.
+	const float appRates[] = { 90.0f, 45.0f, 30.0f };
+	const char * directionNames[] = { "sideways", "up", "forward" };
+	const ksVector3f directions[] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } };
+	const int iterations[] = { 0, 1, 2 };
+	const int numIterations = (int)( sizeof( iterations ) / sizeof( iterations[0] ) );
+
+	printf( "Positional timewarp: eye buffer UV error in %dx%d pixels over %dx%d display rays, scene %.0f to %.0f m away\n",
+			POSITIONAL_BENCHMARK_EYE_WIDTH, POSITIONAL_BENCHMARK_EYE_HEIGHT, POSITIONAL_BENCHMARK_RAYS, POSITIONAL_BENCHMARK_RAYS,
+			POSITIONAL_WARP_SCENE_NEAR_DEPTH, POSITIONAL_WARP_SCENE_FAR_DEPTH );
+	printf( "  head motion at 1 m/s         rotation only (mean / max)   1 depth lookup (mean / max)  2 depth lookups (mean / max)\n" );
+
+	bool ok = true;
+	for ( int direction = 0; direction < 3; direction++ )
+	{
+		for ( int r = 0; r < (int)( sizeof( appRates ) / sizeof( appRates[0] ) ); r++ )
+		{
+			const float distance = 1.0f / appRates[r];
+			const ksVector3f renderPosition = { 0.0f, 0.0f, 0.0f };
+			const ksVector3f newPosition = { directions[direction].x * distance, directions[direction].y * distance, directions[direction].z * distance };
+			ksVector3f translation;
+			CalculatePositionalTimeWarpTranslation( &translation, &projection, &renderOrientation, &renderPosition, &newPosition );
+
+			double sum[numIterations] = { 0.0 };
+			float maxError[numIterations] = { 0.0f };
+			int count = 0;
+			for ( int y = 0; y < POSITIONAL_BENCHMARK_RAYS; y++ )
+			{
+				for ( int x = 0; x < POSITIONAL_BENCHMARK_RAYS; x++ )
+				{
+					const float tanAngleX = -0.8f + 1.6f * ( x + 0.5f ) / POSITIONAL_BENCHMARK_RAYS;
+					const float tanAngleY = -0.8f + 1.6f * ( y + 0.5f ) / POSITIONAL_BENCHMARK_RAYS;
+
+					// Where the ray really hits the scene: the homogeneous UV of
+					// the point at new view depth s is translation + s * h.
+					float h[3];
+					for ( int i = 0; i < 3; i++ )
+					{
+						h[i] = transform.m[i][0] * tanAngleX + transform.m[i][1] * tanAngleY - transform.m[i][2] + transform.m[i][3];
+					}
+					const float s = ( 1.0f - a * translation.z - b * translation.y ) / ( a * h[2] + b * h[1] );
+					const float w = translation.z + s * h[2];
+					const float exact[2] = { ( translation.x + s * h[0] ) / w, ( translation.y + s * h[1] ) / w };
+					if ( s <= 0.0f || exact[0] < 0.0f || exact[0] > 1.0f || exact[1] < 0.0f || exact[1] > 1.0f )
+					{
+						continue;
+					}
+
+					for ( int i = 0; i < numIterations; i++ )
+					{
+						float uv[2];
+						PositionalWarp_Reproject( uv, &transform, &translation, tanAngleX, tanAngleY, iterations[i], SceneInverseDepth );
+						const float dx = ( uv[0] - exact[0] ) * POSITIONAL_BENCHMARK_EYE_WIDTH;
+						const float dy = ( uv[1] - exact[1] ) * POSITIONAL_BENCHMARK_EYE_HEIGHT;
+						const float error = sqrtf( dx * dx + dy * dy );
+						sum[i] += error;
+						maxError[i] = fmaxf( maxError[i], error );
+					}
+					count++;
+				}
+			}
+
+			printf( "  %2.0f Hz frame, %-8s %4.1f cm", appRates[r], directionNames[direction], distance * 100.0f );
+			for ( int i = 0; i < numIterations; i++ )
+			{
+				printf( "  %15.3f / %8.3f", sum[i] / count, maxError[i] );
+			}
+			printf( "\n" );
+			ok = ok && ( count > 0 ) && ( sum[1] < sum[0] ) && ( maxError[1] < maxError[0] );
+		}
+	}
+	printf( "Errors at the display rays themselves, the warp does 1 depth lookup per mesh vertex.\n" );
+
+	printf( "Positional timewarp benchmark %s\n", ok ? "passed" : "FAILED: the depth lookup does not reduce the error" );
+	return ok;
+}
+
+static const int SCANOUT_BENCHMARK_LINES = 32;				// display fractions per scanout
+static const int SCANOUT_BENCHMARK_RAYS = 16;				// per side, over the eye buffer's field of view
+static const double SCANOUT_BENCHMARK_RENDER_AGE = 0.02;	// seconds from the eye buffer's render pose to scanout
+
+// The eye buffer UV of a display ray, as the warp programs compute it.
+static void ScanoutRayUv( float uv[2], const ksMatrix3x4f * transform, const float tanAngleX, const float tanAngleY )
+{
+	float h[3];
+	for ( int i = 0; i < 3; i++ )
+	{
+		h[i] = transform->m[i][0] * tanAngleX + transform->m[i][1] * tanAngleY - transform->m[i][2] + transform->m[i][3];
+	}
+	uv[0] = h[0] / fmaxf( h[2], 0.00001f );
+	uv[1] = h[1] / fmaxf( h[2], 0.00001f );
+}
+
+static bool BenchmarkScanoutSlices()
+{
+	ksMatrix4x4f projection;
+	ksMatrix4x4f_CreateProjectionFov( &projection, 40.0f, 40.0f, 40.0f, 40.0f, 0.1f, 0.0f );
+
+	// Scanouts starting every millisecond through the first of the synthetic
+	// head motion's turns, which peaks at 300 degrees per second.
+	const int sliceCounts[] = { 1, 2, 4, 8, 16 };
+	const int numSliceCounts = (int)( sizeof( sliceCounts ) / sizeof( sliceCounts[0] ) );
+	const double scanoutSeconds[] = { 1.0 / 90.0, 0.1 };
+	const char * scanoutNames[] = { "90 Hz panel", "this app's" };
+	const int numStarts = 400;
+
+	printf( "Scanout slices: eye buffer UV error in %dx%d pixels against the exact transform of each display line,\n",
+			POSITIONAL_BENCHMARK_EYE_WIDTH, POSITIONAL_BENCHMARK_EYE_HEIGHT );
+	printf( "%d scanouts through a 60 degree head turn, %d lines of %dx%d rays each\n",
+			numStarts, SCANOUT_BENCHMARK_LINES, SCANOUT_BENCHMARK_RAYS, SCANOUT_BENCHMARK_RAYS );
+	printf( "  scanout             " );
+	for ( int n = 0; n < numSliceCounts; n++ )
+	{
+		printf( "  %3d slice%s (mean / max)", sliceCounts[n], ( sliceCounts[n] == 1 ) ? " " : "s" );
+	}
+	printf( "\n" );
+
+	bool ok = true;
+	for ( int d = 0; d < (int)( sizeof( scanoutSeconds ) / sizeof( scanoutSeconds[0] ) ); d++ )
+	{
+		double sum[numSliceCounts] = { 0.0 };
+		float maxError[numSliceCounts] = { 0.0f };
+		int count = 0;
+		for ( int start = 0; start < numStarts; start++ )
+		{
+			const double startTime = start * 0.001;
+			ksQuatf renderOrientation;
+			SyntheticHeadOrientation( startTime - SCANOUT_BENCHMARK_RENDER_AGE, &renderOrientation );
+
+			// The transform each line really needs.
+			ksMatrix3x4f exact[SCANOUT_BENCHMARK_LINES];
+			for ( int line = 0; line < SCANOUT_BENCHMARK_LINES; line++ )
+			{
+				ksQuatf orientation;
+				SyntheticHeadOrientation( startTime + scanoutSeconds[d] * line / ( SCANOUT_BENCHMARK_LINES - 1 ), &orientation );
+				CalculateRotationTimeWarpTransform( &exact[line], &projection, &renderOrientation, &orientation );
+			}
+
+			for ( int n = 0; n < numSliceCounts; n++ )
+			{
+				scanout_transforms_t scanout;
+				Scanout_Init( &scanout, SCANOUT_LEFT_TO_RIGHT, sliceCounts[n] );
+				for ( int i = 0; i <= sliceCounts[n]; i++ )
+				{
+					ksQuatf orientation;
+					SyntheticHeadOrientation( startTime + scanoutSeconds[d] * i / sliceCounts[n], &orientation );
+					CalculateRotationTimeWarpTransform( &scanout.transforms[i], &projection, &renderOrientation, &orientation );
+				}
+
+				for ( int line = 0; line < SCANOUT_BENCHMARK_LINES; line++ )
+				{
+					ksMatrix3x4f transform;
+					Scanout_GetTransform( &scanout, (float)line / ( SCANOUT_BENCHMARK_LINES - 1 ), &transform );
+					for ( int y = 0; y < SCANOUT_BENCHMARK_RAYS; y++ )
+					{
+						for ( int x = 0; x < SCANOUT_BENCHMARK_RAYS; x++ )
+						{
+							const float tanAngleX = -0.8f + 1.6f * ( x + 0.5f ) / SCANOUT_BENCHMARK_RAYS;
+							const float tanAngleY = -0.8f + 1.6f * ( y + 0.5f ) / SCANOUT_BENCHMARK_RAYS;
+							float uv[2];
+							float exactUv[2];
+							ScanoutRayUv( uv, &transform, tanAngleX, tanAngleY );
+							ScanoutRayUv( exactUv, &exact[line], tanAngleX, tanAngleY );
+							const float dx = ( uv[0] - exactUv[0] ) * POSITIONAL_BENCHMARK_EYE_WIDTH;
+							const float dy = ( uv[1] - exactUv[1] ) * POSITIONAL_BENCHMARK_EYE_HEIGHT;
+							const float error = sqrtf( dx * dx + dy * dy );
+							sum[n] += error;
+							maxError[n] = fmaxf( maxError[n], error );
+						}
+					}
+				}
+			}
+			count += SCANOUT_BENCHMARK_LINES * SCANOUT_BENCHMARK_RAYS * SCANOUT_BENCHMARK_RAYS;
+		}
+
+		printf( "  %-11s %5.1f ms", scanoutNames[d], scanoutSeconds[d] * 1000.0 );
+		for ( int n = 0; n < numSliceCounts; n++ )
+		{
+			printf( "  %12.3f / %8.3f", sum[n] / count, maxError[n] );
+			ok = ok && ( n == 0 || maxError[n] <= maxError[n - 1] );
+		}
+		printf( "\n" );
+		ok = ok && ( maxError[numSliceCounts - 1] < maxError[0] );
+	}
+	printf( "  uniform block       " );
+	for ( int n = 0; n < numSliceCounts; n++ )
+	{
+		printf( "  %17d bytes", (int)( offsetof( scanout_transforms_t, transforms ) + ( sliceCounts[n] + 1 ) * sizeof( ksMatrix3x4f ) ) );
+	}
+	printf( "\n" );
+
+	printf( "Scanout slices benchmark %s\n", ok ? "passed" : "FAILED: more slices do not reduce the error" );
+	return ok;
+}
+
+bool RunBenchmark( const char * name )
+{
+	if ( strcmp( name, "spline" ) == 0 )
+	{
+		return BenchmarkSpline();
+	}
+	if ( strcmp( name, "fixed-mesh" ) == 0 )
+	{
+		return BenchmarkFixedMesh();
+	}
+	if ( strcmp( name, "distortion-models" ) == 0 )
+	{
+		return BenchmarkDistortionModels();
+	}
+	if ( strcmp( name, "inverse-distortion" ) == 0 )
+	{
+		return BenchmarkInverseDistortion();
+	}
+	if ( strcmp( name, "mesh-build" ) == 0 )
+	{
+		return BenchmarkMeshBuild();
+	}
+	if ( strcmp( name, "matrix" ) == 0 )
+	{
+		return BenchmarkMatrix();
+	}
+	if ( strcmp( name, "rotation-timewarp" ) == 0 )
+	{
+		return BenchmarkRotationTimewarp();
+	}
+	if ( strcmp( name, "pose-prediction" ) == 0 )
+	{
+		return BenchmarkPosePrediction();
+	}
+	if ( strcmp( name, "pose-handoff" ) == 0 )
+	{
+		return BenchmarkPoseHandoff();
+	}
+	if ( strcmp( name, "pose-history" ) == 0 )
+	{
+		return BenchmarkPoseHistory();
+	}
+	if ( strcmp( name, "positional-timewarp" ) == 0 )
+	{
+		return BenchmarkPositionalTimewarp();
+	}
+	if ( strcmp( name, "scanout-slices" ) == 0 )
+	{
+		return BenchmarkScanoutSlices();
+	}
+	fprintf( stderr, "Unknown benchmark '%s'\n", name );
+	return false;
+}
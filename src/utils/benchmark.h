@@ -0,0 +1,24 @@
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+// Standalone microbenchmarks, run with --benchmark=name instead of the
+// warp itself. They need no image and no GL context, print their results
+// to stdout and return false if the results are wrong.
+//
+//   spline		batch vs scalar Catmull-Rom spline on a dense (8x8 pixel tiles, 4K per eye) mesh
+//   fixed-mesh	built-in fixed profile meshes against the runtime build, and what they save at startup
+//   distortion-models	each lens model's distance from the Catmull-Rom lens, and its SIMD paths against scalar
+//   inverse-distortion	eye buffer to display solver against the forward mapping, by Newton iterations
+//   mesh-build	parallel BuildDistortionMeshes() and vertex fill by thread count, 4K per eye, against the serial build
+//   matrix		SIMD ksMatrix routines and the timewarp transform chain against algebra.h, bit for bit
+//   rotation-timewarp	quaternion rotation-only timewarp transform against CalculateTimeWarpTransform(), in cycles
+//   pose-prediction	pose predictor error by horizon on a synthetic head tracker trace, as --pose-replay
+//   pose-handoff	sensor thread to warp handoff at 1 kHz: sample interval jitter and publish/read latency by reader
+//   pose-history	pose history interpolation error, lookup time, and lookups racing a writer
+//   positional-timewarp	depth-based positional reprojection error against rotation only, for head translations
+//   scanout-slices	rolling scanout error of 1 to 16 transform slices against the exact transform per display line
+
+// Returns false for an unknown name or a failed check.
+bool RunBenchmark( const char * name );
+
+#endif
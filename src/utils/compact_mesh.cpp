@@ -0,0 +1,259 @@
+#include <math.h>
+#include <string.h>
+#include "compact_mesh.h"
+
+GLushort FloatToHalf( const float value )
+{
+	unsigned int bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	const unsigned int sign = ( bits >> 16 ) & 0x8000;
+	const int exponent = (int)( ( bits >> 23 ) & 0xFF ) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFF;
+
+	if ( exponent >= 31 )
+	{
+		return (GLushort)( sign | 0x7C00 );		// overflow to infinity
+	}
+	if ( exponent <= 0 )
+	{
+		if ( exponent < -10 )
+		{
+			return (GLushort)sign;
+		}
+		mantissa |= 0x800000;
+		const int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		const unsigned int rest = mantissa & ( ( 1u << shift ) - 1 );
+		const unsigned int halfway = 1u << ( shift - 1 );
+		if ( rest > halfway || ( rest == halfway && ( half & 1 ) ) )
+		{
+			half++;
+		}
+		return (GLushort)( sign | half );
+	}
+
+	unsigned int half = ( (unsigned int)exponent << 10 ) | ( mantissa >> 13 );
+	const unsigned int rest = mantissa & 0x1FFF;
+	if ( rest > 0x1000 || ( rest == 0x1000 && ( half & 1 ) ) )
+	{
+		half++;			// may carry into the exponent, which is still correct
+	}
+	return (GLushort)( sign | half );
+}
+
+float HalfToFloat( const GLushort half )
+{
+	const unsigned int sign = ( half & 0x8000 ) << 16;
+	const unsigned int exponent = ( half >> 10 ) & 0x1F;
+	const unsigned int mantissa = half & 0x3FF;
+
+	if ( exponent == 0 )
+	{
+		const float value = ldexpf( (float)mantissa, -24 );
+		return sign ? -value : value;
+	}
+	unsigned int bits;
+	if ( exponent == 31 )
+	{
+		bits = sign | 0x7F800000 | ( mantissa << 13 );
+	}
+	else
+	{
+		bits = sign | ( ( exponent - 15 + 127 ) << 23 ) | ( mantissa << 13 );
+	}
+	float value;
+	memcpy( &value, &bits, sizeof( value ) );
+	return value;
+}
+
+static GLshort FloatToSnorm16( const float value )
+{
+	const float clamped = ( value < -1.0f ) ? -1.0f : ( ( value > 1.0f ) ? 1.0f : value );
+	return (GLshort)lrintf( clamped * 32767.0f );
+}
+
+static float Snorm16ToFloat( const GLshort value )
+{
+	const float f = value / 32767.0f;
+	return ( f < -1.0f ) ? -1.0f : f;
+}
+
+const char * CompactMesh_GetEncodingName( const compact_uv_encoding_t uvEncoding )
+{
+	return ( uvEncoding == COMPACT_UV_HALF ) ? "fp16" : "snorm16 + scale/bias";
+}
+
+void CompactMesh_CreateFormat( compact_mesh_format_t * format, const compact_uv_encoding_t uvEncoding,
+							   const distortion_vertex_t * vertices, const int numVertices )
+{
+	format->uvEncoding = uvEncoding;
+	format->uvScale[0] = format->uvScale[1] = 1.0f;
+	format->uvBias[0] = format->uvBias[1] = 0.0f;
+	if ( uvEncoding == COMPACT_UV_HALF || numVertices == 0 )
+	{
+		return;
+	}
+
+	// One range for all channels and both eyes, so one scale/bias fold does.
+	float minUv[2] = { vertices[0].uv0.u, vertices[0].uv0.v };
+	float maxUv[2] = { minUv[0], minUv[1] };
+	for ( int i = 0; i < NUM_EYES * numVertices; i++ )
+	{
+		const uv_coord_t * uvs[NUM_COLOR_CHANNELS] = { &vertices[i].uv0, &vertices[i].uv1, &vertices[i].uv2 };
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			minUv[0] = MinFloat( minUv[0], uvs[channel]->u );
+			minUv[1] = MinFloat( minUv[1], uvs[channel]->v );
+			maxUv[0] = MaxFloat( maxUv[0], uvs[channel]->u );
+			maxUv[1] = MaxFloat( maxUv[1], uvs[channel]->v );
+		}
+	}
+	for ( int i = 0; i < 2; i++ )
+	{
+		format->uvBias[i] = 0.5f * ( maxUv[i] + minUv[i] );
+		format->uvScale[i] = MaxFloat( 0.5f * ( maxUv[i] - minUv[i] ), 1e-6f );
+	}
+}
+
+static void EncodeUv( const compact_mesh_format_t * format, const uv_coord_t * uv, GLushort encoded[2] )
+{
+	if ( format->uvEncoding == COMPACT_UV_HALF )
+	{
+		encoded[0] = FloatToHalf( uv->u );
+		encoded[1] = FloatToHalf( uv->v );
+	}
+	else
+	{
+		encoded[0] = (GLushort)FloatToSnorm16( ( uv->u - format->uvBias[0] ) / format->uvScale[0] );
+		encoded[1] = (GLushort)FloatToSnorm16( ( uv->v - format->uvBias[1] ) / format->uvScale[1] );
+	}
+}
+
+static void DecodeUv( const compact_mesh_format_t * format, const GLushort encoded[2], uv_coord_t * uv )
+{
+	if ( format->uvEncoding == COMPACT_UV_HALF )
+	{
+		uv->u = HalfToFloat( encoded[0] );
+		uv->v = HalfToFloat( encoded[1] );
+	}
+	else
+	{
+		uv->u = Snorm16ToFloat( (GLshort)encoded[0] ) * format->uvScale[0] + format->uvBias[0];
+		uv->v = Snorm16ToFloat( (GLshort)encoded[1] ) * format->uvScale[1] + format->uvBias[1];
+	}
+}
+
+void CompactMesh_Encode( const compact_mesh_format_t * format, const distortion_vertex_t * vertices,
+						 distortion_vertex_compact_t * compact, const int numVertices )
+{
+	for ( int i = 0; i < NUM_EYES * numVertices; i++ )
+	{
+		compact[i].position[0] = FloatToSnorm16( vertices[i].position.x );
+		compact[i].position[1] = FloatToSnorm16( vertices[i].position.y );
+		EncodeUv( format, &vertices[i].uv0, compact[i].uv0 );
+		EncodeUv( format, &vertices[i].uv1, compact[i].uv1 );
+		EncodeUv( format, &vertices[i].uv2, compact[i].uv2 );
+	}
+}
+
+void CompactMesh_Decode( const compact_mesh_format_t * format, const distortion_vertex_compact_t * compact,
+						 distortion_vertex_t * vertex )
+{
+	vertex->position.x = Snorm16ToFloat( compact->position[0] );
+	vertex->position.y = Snorm16ToFloat( compact->position[1] );
+	vertex->position.z = 0.0f;
+	DecodeUv( format, compact->uv0, &vertex->uv0 );
+	DecodeUv( format, compact->uv1, &vertex->uv1 );
+	DecodeUv( format, compact->uv2, &vertex->uv2 );
+}
+
+void CompactMesh_FoldUvScaleBias( const compact_mesh_format_t * format, const ksMatrix3x4f * transform, ksMatrix3x4f * folded )
+{
+	// The shader computes vec4( uv, -1, 1 ) * transform, so with
+	// uv = raw * scale + bias every column picks up the scale on its first
+	// two entries and the bias in its constant term.
+	for ( int j = 0; j < 3; j++ )
+	{
+		const float a = transform->m[j][0];
+		const float b = transform->m[j][1];
+		folded->m[j][0] = a * format->uvScale[0];
+		folded->m[j][1] = b * format->uvScale[1];
+		folded->m[j][2] = transform->m[j][2];
+		folded->m[j][3] = transform->m[j][3] + a * format->uvBias[0] + b * format->uvBias[1];
+	}
+}
+
+void CompactMesh_Validate( const compact_mesh_format_t * format, const distortion_vertex_t * vertices,
+						   const distortion_vertex_compact_t * compact, const int numVertices,
+						   const GLuint * indices, const int numIndices,
+						   const int displayPixelsWide, const int displayPixelsHigh, const float uvToPixels[2],
+						   compact_mesh_error_t * error )
+{
+	memset( error, 0, sizeof( compact_mesh_error_t ) );
+	const float ndcToPixels[2] = { 0.5f * displayPixelsWide, 0.5f * displayPixelsHigh };
+
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		const distortion_vertex_t * eyeVertices = vertices + eye * numVertices;
+		const distortion_vertex_compact_t * eyeCompact = compact + eye * numVertices;
+
+		for ( int t = 0; t + 2 < numIndices; t += 3 )
+		{
+			float uvError = 0.0f;
+			float positionError = 0.0f;
+			float position[3][2];
+			float uv[3][NUM_COLOR_CHANNELS][2];
+
+			for ( int c = 0; c < 3; c++ )
+			{
+				const distortion_vertex_t * exact = &eyeVertices[indices[t + c]];
+				distortion_vertex_t decoded;
+				CompactMesh_Decode( format, &eyeCompact[indices[t + c]], &decoded );
+
+				const float dx = ( decoded.position.x - exact->position.x ) * ndcToPixels[0];
+				const float dy = ( decoded.position.y - exact->position.y ) * ndcToPixels[1];
+				positionError = MaxFloat( positionError, sqrtf( dx * dx + dy * dy ) );
+
+				const uv_coord_t * exactUvs[NUM_COLOR_CHANNELS] = { &exact->uv0, &exact->uv1, &exact->uv2 };
+				const uv_coord_t * decodedUvs[NUM_COLOR_CHANNELS] = { &decoded.uv0, &decoded.uv1, &decoded.uv2 };
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					const float du = ( decodedUvs[channel]->u - exactUvs[channel]->u ) * uvToPixels[0];
+					const float dv = ( decodedUvs[channel]->v - exactUvs[channel]->v ) * uvToPixels[1];
+					uvError = MaxFloat( uvError, sqrtf( du * du + dv * dv ) );
+					uv[c][channel][0] = exactUvs[channel]->u * uvToPixels[0];
+					uv[c][channel][1] = exactUvs[channel]->v * uvToPixels[1];
+				}
+				position[c][0] = exact->position.x * ndcToPixels[0];
+				position[c][1] = exact->position.y * ndcToPixels[1];
+			}
+
+			// Eye buffer pixels per display pixel across this triangle: the
+			// Frobenius norm of d(uv) / d(position), worst channel.
+			const float e1[2] = { position[1][0] - position[0][0], position[1][1] - position[0][1] };
+			const float e2[2] = { position[2][0] - position[0][0], position[2][1] - position[0][1] };
+			const float det = e1[0] * e2[1] - e1[1] * e2[0];
+			float gradient = 0.0f;
+			if ( fabsf( det ) > 1e-6f )
+			{
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					float norm = 0.0f;
+					for ( int i = 0; i < 2; i++ )
+					{
+						const float d1 = uv[1][channel][i] - uv[0][channel][i];
+						const float d2 = uv[2][channel][i] - uv[0][channel][i];
+						const float dx = ( d1 * e2[1] - d2 * e1[1] ) / det;
+						const float dy = ( d2 * e1[0] - d1 * e2[0] ) / det;
+						norm += dx * dx + dy * dy;
+					}
+					gradient = MaxFloat( gradient, sqrtf( norm ) );
+				}
+			}
+
+			error->maxPositionError = MaxFloat( error->maxPositionError, positionError );
+			error->maxUvError = MaxFloat( error->maxUvError, uvError );
+			error->maxWarpError = MaxFloat( error->maxWarpError, uvError + positionError * gradient );
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef _COMPACT_MESH_H
+#define _COMPACT_MESH_H
+
+#include "hmd.h"
+#include "algebra.h"
+
+// Compact GPU encoding of the distortion mesh vertices.
+//
+// distortion_vertex_t is 36 bytes: three floats of position, of which z is
+// always 0, and three float UV pairs. The compact vertex is 16 bytes: the
+// position as two snorm16, and the UVs either as half floats or as snorm16
+// with one scale/bias for the whole mesh. The scale/bias costs nothing in
+// the vertex shader, it is folded into the timewarp transforms the UVs are
+// multiplied with anyway (CompactMesh_FoldUvScaleBias()). Whether the
+// encoding is precise enough is for CompactMesh_Validate() to say.
+
+typedef struct
+{
+	GLshort		position[2];			// snorm16
+	GLushort	uv0[2];					// fp16 or snorm16, see compact_uv_encoding_t
+	GLushort	uv1[2];
+	GLushort	uv2[2];
+} distortion_vertex_compact_t;
+
+typedef enum
+{
+	COMPACT_UV_HALF,					// IEEE half floats
+	COMPACT_UV_SNORM16					// snorm16 * uvScale + uvBias
+} compact_uv_encoding_t;
+
+typedef struct
+{
+	compact_uv_encoding_t	uvEncoding;
+	float					uvScale[2];
+	float					uvBias[2];
+} compact_mesh_format_t;
+
+typedef struct
+{
+	float	maxPositionError;			// in display pixels
+	float	maxUvError;					// in eye buffer pixels
+	float	maxWarpError;				// bound on the error of the warped image, in eye buffer pixels
+} compact_mesh_error_t;
+
+// Pick the format for these vertices (NUM_EYES * numVertices); for
+// COMPACT_UV_SNORM16 this fits the scale/bias to the UV range.
+void CompactMesh_CreateFormat( compact_mesh_format_t * format, const compact_uv_encoding_t uvEncoding,
+							   const distortion_vertex_t * vertices, const int numVertices );
+
+void CompactMesh_Encode( const compact_mesh_format_t * format, const distortion_vertex_t * vertices,
+						 distortion_vertex_compact_t * compact, const int numVertices );
+
+// What the GPU reads back from a compact vertex (snorm16 per the GL 4.2+ rules).
+void CompactMesh_Decode( const compact_mesh_format_t * format, const distortion_vertex_compact_t * compact,
+						 distortion_vertex_t * vertex );
+
+// The start/end timewarp transform to use with compact vertices.
+void CompactMesh_FoldUvScaleBias( const compact_mesh_format_t * format, const ksMatrix3x4f * transform, ksMatrix3x4f * folded );
+
+// Measure the encoding error of every vertex against the float mesh, and
+// bound the error it causes in the warped image: the UV error of a vertex
+// is interpolated across its triangles as is, and a position error moves
+// the triangle, which moves the lookup by the position error times the
+// triangle's UV gradient.
+void CompactMesh_Validate( const compact_mesh_format_t * format, const distortion_vertex_t * vertices,
+						   const distortion_vertex_compact_t * compact, const int numVertices,
+						   const GLuint * indices, const int numIndices,
+						   const int displayPixelsWide, const int displayPixelsHigh, const float uvToPixels[2],
+						   compact_mesh_error_t * error );
+
+// float <-> IEEE half, round to nearest even, with denormals.
+GLushort FloatToHalf( const float value );
+float HalfToFloat( const GLushort half );
+
+const char * CompactMesh_GetEncodingName( const compact_uv_encoding_t uvEncoding );
+
+#endif
@@ -0,0 +1,453 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+#include "cpu_warp.h"
+#include "compact_mesh.h"
+
+// Rows of output handed to the pool as one job.
+static const int SCANLINE_TILE_HEIGHT = 16;
+
+bool CpuEyeImage_Create( cpu_eye_image_t * image, const int width, const int height, const int layers )
+{
+	image->width = width;
+	image->height = height;
+	image->layers = layers;
+	image->stride = width + 2;
+	image->planeSize = image->stride * ( height + 2 );
+	// The sampler builds plane offsets in float, keep them exact.
+	if ( image->planeSize >= ( 1 << 24 ) )
+	{
+		image->texels = NULL;
+		return false;
+	}
+	image->texels = (unsigned char *) calloc( (size_t)layers * NUM_COLOR_CHANNELS * image->planeSize, 1 );
+	return image->texels != NULL;
+}
+
+void CpuEyeImage_Destroy( cpu_eye_image_t * image )
+{
+	free( image->texels );
+	memset( image, 0, sizeof( cpu_eye_image_t ) );
+}
+
+static unsigned char * CpuEyeImage_Plane( const cpu_eye_image_t * image, const int layer, const int channel )
+{
+	return image->texels + (size_t)( layer * NUM_COLOR_CHANNELS + channel ) * image->planeSize;
+}
+
+void CpuEyeImage_SetLayer( cpu_eye_image_t * image, const int layer, const unsigned char * src, const int srcChannels )
+{
+	for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+	{
+		unsigned char * plane = CpuEyeImage_Plane( image, layer, channel );
+		for ( int y = 0; y < image->height; y++ )
+		{
+			unsigned char * dst = plane + ( y + 1 ) * image->stride + 1;
+			const unsigned char * row = src + (size_t)y * image->width * srcChannels + channel;
+			for ( int x = 0; x < image->width; x++ )
+			{
+				dst[x] = row[x * srcChannels];
+			}
+		}
+	}
+}
+
+void CpuEyeImage_ResampleLayer( cpu_eye_image_t * image, const int layer, const unsigned char * src,
+								const int srcWidth, const int srcHeight, const int srcChannels )
+{
+	for ( int y = 0; y < image->height; y++ )
+	{
+		const float sy = ( y + 0.5f ) / image->height * srcHeight - 0.5f;
+		const int y0 = (int)floorf( sy );
+		const float b = sy - y0;
+
+		for ( int x = 0; x < image->width; x++ )
+		{
+			const float sx = ( x + 0.5f ) / image->width * srcWidth - 0.5f;
+			const int x0 = (int)floorf( sx );
+			const float a = sx - x0;
+
+			for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+			{
+				float t[2][2];
+				for ( int j = 0; j < 2; j++ )
+				{
+					for ( int i = 0; i < 2; i++ )
+					{
+						const int tx = x0 + i;
+						const int ty = y0 + j;
+						const bool inside = ( tx >= 0 && tx < srcWidth && ty >= 0 && ty < srcHeight );
+						t[j][i] = inside ? src[( (size_t)ty * srcWidth + tx ) * srcChannels + channel] : 0.0f;
+					}
+				}
+				const float c = ( t[0][0] * ( 1.0f - a ) + t[0][1] * a ) * ( 1.0f - b ) +
+								( t[1][0] * ( 1.0f - a ) + t[1][1] * a ) * b;
+				CpuEyeImage_Plane( image, layer, channel )[( y + 1 ) * image->stride + x + 1] = (unsigned char)( c + 0.5f );
+			}
+		}
+	}
+}
+
+// vec4( uv, -1, 1 ) * mat3x4, as the vertex shader does it.
+static void TransformUv( float result[3], const ksMatrix3x4f * m, const float u, const float v )
+{
+	for ( int i = 0; i < 3; i++ )
+	{
+		result[i] = u * m->m[i][0] + v * m->m[i][1] - m->m[i][2] + m->m[i][3];
+	}
+}
+
+// Per-vertex stage: the final, divided fragment UVs of every vertex and channel.
+static void WarpVertices( float * warped, const cpu_warp_mesh_t * mesh, const int eye, const int first, const int count,
+						  const scanout_transforms_t * scanout )
+{
+	for ( int i = first; i < first + count; i++ )
+	{
+		const int vertex = eye * mesh->numVertices + i;
+		const distortion_vertex_t * in = &mesh->vertices[vertex];
+		const uv_coord_t * uvs[NUM_COLOR_CHANNELS] = { &in->uv0, &in->uv1, &in->uv2 };
+		const float displayFraction = Scanout_GetDisplayFraction( scanout, in->position.x, in->position.y );
+		ksMatrix3x4f transform;
+		Scanout_GetTransform( scanout, displayFraction, &transform );
+
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			float cur[3];
+			TransformUv( cur, &transform, uvs[channel]->u, uvs[channel]->v );
+			const float rcpZ = 1.0f / MaxFloat( cur[2], 0.00001f );
+
+			float * out = warped + ( (size_t)vertex * NUM_COLOR_CHANNELS + channel ) * 2;
+			out[0] = cur[0] * rcpZ;
+			out[1] = cur[1] * rcpZ;
+		}
+	}
+}
+
+// Bilinear fetch of count pixels from one padded plane. u/v are texture coordinates.
+// Pixels with valid[i] == 0 are outside the mesh and are not sampled.
+static void SampleRow( unsigned char * rgbaOut, const int channel, const int count,
+					   const float * u, const float * v, const unsigned char * valid,
+					   const unsigned char * plane, const cpu_eye_image_t * image )
+{
+	const float texWidth = (float)image->width;
+	const float texHeight = (float)image->height;
+	const float maxX = (float)image->width;
+	const float maxY = (float)image->height;
+	const float stride = (float)image->stride;
+
+	int i = 0;
+#if defined( __SSE2__ )
+	const __m128 vTexWidth = _mm_set1_ps( texWidth );
+	const __m128 vTexHeight = _mm_set1_ps( texHeight );
+	const __m128 vHalf = _mm_set1_ps( 0.5f );
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	const __m128 vMinusOne = _mm_set1_ps( -1.0f );
+	const __m128 vMaxX = _mm_set1_ps( maxX );
+	const __m128 vMaxY = _mm_set1_ps( maxY );
+	const __m128 vStride = _mm_set1_ps( stride );
+	const __m128 vLowClamp = _mm_set1_ps( -2.0f );
+
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		// Texel space, clamped far enough out that the int conversion is safe
+		// and everything past the border still lands on border texels.
+		__m128 x = _mm_sub_ps( _mm_mul_ps( _mm_loadu_ps( u + i ), vTexWidth ), vHalf );
+		__m128 y = _mm_sub_ps( _mm_mul_ps( _mm_loadu_ps( v + i ), vTexHeight ), vHalf );
+		x = _mm_min_ps( _mm_max_ps( x, vLowClamp ), _mm_add_ps( vMaxX, vOne ) );
+		y = _mm_min_ps( _mm_max_ps( y, vLowClamp ), _mm_add_ps( vMaxY, vOne ) );
+
+		// floor() without SSE4.1: truncate, then step down where that rounded up.
+		__m128 x0 = _mm_cvtepi32_ps( _mm_cvttps_epi32( x ) );
+		__m128 y0 = _mm_cvtepi32_ps( _mm_cvttps_epi32( y ) );
+		x0 = _mm_sub_ps( x0, _mm_and_ps( _mm_cmpgt_ps( x0, x ), vOne ) );
+		y0 = _mm_sub_ps( y0, _mm_and_ps( _mm_cmpgt_ps( y0, y ), vOne ) );
+		const __m128 a = _mm_sub_ps( x, x0 );
+		const __m128 b = _mm_sub_ps( y, y0 );
+
+		// Padded plane coordinates, anything outside the texture lands on the black border.
+		const __m128 px0 = _mm_add_ps( _mm_min_ps( _mm_max_ps( x0, vMinusOne ), vMaxX ), vOne );
+		const __m128 px1 = _mm_add_ps( _mm_min_ps( _mm_max_ps( _mm_add_ps( x0, vOne ), vMinusOne ), vMaxX ), vOne );
+		const __m128 py0 = _mm_mul_ps( _mm_add_ps( _mm_min_ps( _mm_max_ps( y0, vMinusOne ), vMaxY ), vOne ), vStride );
+		const __m128 py1 = _mm_mul_ps( _mm_add_ps( _mm_min_ps( _mm_max_ps( _mm_add_ps( y0, vOne ), vMinusOne ), vMaxY ), vOne ), vStride );
+
+		int i00[4], i01[4], i10[4], i11[4];
+		_mm_storeu_si128( (__m128i *)i00, _mm_cvttps_epi32( _mm_add_ps( py0, px0 ) ) );
+		_mm_storeu_si128( (__m128i *)i01, _mm_cvttps_epi32( _mm_add_ps( py0, px1 ) ) );
+		_mm_storeu_si128( (__m128i *)i10, _mm_cvttps_epi32( _mm_add_ps( py1, px0 ) ) );
+		_mm_storeu_si128( (__m128i *)i11, _mm_cvttps_epi32( _mm_add_ps( py1, px1 ) ) );
+
+		const __m128 t00 = _mm_setr_ps( plane[i00[0]], plane[i00[1]], plane[i00[2]], plane[i00[3]] );
+		const __m128 t01 = _mm_setr_ps( plane[i01[0]], plane[i01[1]], plane[i01[2]], plane[i01[3]] );
+		const __m128 t10 = _mm_setr_ps( plane[i10[0]], plane[i10[1]], plane[i10[2]], plane[i10[3]] );
+		const __m128 t11 = _mm_setr_ps( plane[i11[0]], plane[i11[1]], plane[i11[2]], plane[i11[3]] );
+
+		const __m128 top = _mm_add_ps( t00, _mm_mul_ps( _mm_sub_ps( t01, t00 ), a ) );
+		const __m128 bottom = _mm_add_ps( t10, _mm_mul_ps( _mm_sub_ps( t11, t10 ), a ) );
+		const __m128 c = _mm_add_ps( top, _mm_mul_ps( _mm_sub_ps( bottom, top ), b ) );
+
+		int result[4];
+		_mm_storeu_si128( (__m128i *)result, _mm_cvtps_epi32( c ) );
+		for ( int k = 0; k < 4; k++ )
+		{
+			rgbaOut[( i + k ) * 4 + channel] = valid[i + k] ? (unsigned char)result[k] : 0;
+		}
+	}
+#endif
+
+	for ( ; i < count; i++ )
+	{
+		float x = u[i] * texWidth - 0.5f;
+		float y = v[i] * texHeight - 0.5f;
+		x = MinFloat( MaxFloat( x, -2.0f ), maxX + 1.0f );
+		y = MinFloat( MaxFloat( y, -2.0f ), maxY + 1.0f );
+		const float x0 = floorf( x );
+		const float y0 = floorf( y );
+		const float a = x - x0;
+		const float b = y - y0;
+
+		const int px0 = (int)( MinFloat( MaxFloat( x0, -1.0f ), maxX ) + 1.0f );
+		const int px1 = (int)( MinFloat( MaxFloat( x0 + 1.0f, -1.0f ), maxX ) + 1.0f );
+		const int py0 = (int)( MinFloat( MaxFloat( y0, -1.0f ), maxY ) + 1.0f ) * image->stride;
+		const int py1 = (int)( MinFloat( MaxFloat( y0 + 1.0f, -1.0f ), maxY ) + 1.0f ) * image->stride;
+
+		const float t00 = plane[py0 + px0];
+		const float t01 = plane[py0 + px1];
+		const float t10 = plane[py1 + px0];
+		const float t11 = plane[py1 + px1];
+		const float top = t00 + ( t01 - t00 ) * a;
+		const float bottom = t10 + ( t11 - t10 ) * a;
+		const float c = top + ( bottom - top ) * b;
+
+		rgbaOut[i * 4 + channel] = valid[i] ? (unsigned char)lrintf( c ) : 0;
+	}
+}
+
+void CpuWarp_Render( ThreadPool * pool, unsigned char * rgbaOut, const int width, const int height,
+					 const cpu_warp_mesh_t * mesh, const cpu_eye_image_t * image, const int eyeLayers[NUM_EYES],
+					 const scanout_transforms_t * scanout )
+{
+	// Vertex stage, one job per eye and block of vertices.
+	const int vertexBlock = 256;
+	const int blocksPerEye = ( mesh->numVertices + vertexBlock - 1 ) / vertexBlock;
+	std::vector<float> warped( (size_t)NUM_EYES * mesh->numVertices * NUM_COLOR_CHANNELS * 2 );
+	pool->parallelFor( NUM_EYES * blocksPerEye, [&]( int job )
+	{
+		const int eye = job / blocksPerEye;
+		const int first = ( job % blocksPerEye ) * vertexBlock;
+		const int count = ( first + vertexBlock < mesh->numVertices ) ? vertexBlock : mesh->numVertices - first;
+		WarpVertices( warped.data(), mesh, eye, first, count, scanout );
+	} );
+
+	// Bin the triangles of both eyes by the scanline bands their pixel centers touch.
+	const int numTiles = ( height + SCANLINE_TILE_HEIGHT - 1 ) / SCANLINE_TILE_HEIGHT;
+	const int trianglesPerEye = mesh->numIndices / 3;
+	std::vector<std::vector<int> > bins( numTiles );
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int tri = 0; tri < trianglesPerEye; tri++ )
+		{
+			float minY = 1e30f;
+			float maxY = -1e30f;
+			for ( int k = 0; k < 3; k++ )
+			{
+				const int vertex = eye * mesh->numVertices + mesh->indices[tri * 3 + k];
+				const float sy = ( mesh->vertices[vertex].position.y * 0.5f + 0.5f ) * height;
+				minY = MinFloat( minY, sy );
+				maxY = MaxFloat( maxY, sy );
+			}
+			const int firstRow = (int)MaxFloat( 0.0f, ceilf( minY - 0.5f ) );
+			const int lastRow = (int)MinFloat( (float)( height - 1 ), floorf( maxY - 0.5f ) );
+			for ( int tile = firstRow / SCANLINE_TILE_HEIGHT; firstRow <= lastRow && tile <= lastRow / SCANLINE_TILE_HEIGHT; tile++ )
+			{
+				bins[tile].push_back( eye * trianglesPerEye + tri );
+			}
+		}
+	}
+
+	// Pixel stage, one job per band of scanlines.
+	pool->parallelFor( numTiles, [&]( int tile )
+	{
+		const int firstRow = tile * SCANLINE_TILE_HEIGHT;
+		const int lastRow = ( firstRow + SCANLINE_TILE_HEIGHT < height ) ? firstRow + SCANLINE_TILE_HEIGHT : height;
+		const int bandHeight = lastRow - firstRow;
+		const size_t bandPixels = (size_t)bandHeight * width;
+
+		// Rasterize: interpolate the warped UVs of every triangle in the bin
+		// linearly across the pixel centers it covers, like the GPU does
+		// with w = 1.
+		std::vector<float> bandUv( NUM_COLOR_CHANNELS * 2 * bandPixels );
+		std::vector<unsigned char> valid( bandPixels, 0 );
+		for ( size_t b = 0; b < bins[tile].size(); b++ )
+		{
+			const int eye = bins[tile][b] / trianglesPerEye;
+			const int tri = bins[tile][b] % trianglesPerEye;
+
+			int vertex[3];
+			float sx[3];
+			float sy[3];
+			for ( int k = 0; k < 3; k++ )
+			{
+				vertex[k] = eye * mesh->numVertices + mesh->indices[tri * 3 + k];
+				sx[k] = ( mesh->vertices[vertex[k]].position.x * 0.5f + 0.5f ) * width;
+				sy[k] = ( mesh->vertices[vertex[k]].position.y * 0.5f + 0.5f ) * height;
+			}
+			const float area = ( sx[1] - sx[0] ) * ( sy[2] - sy[0] ) - ( sx[2] - sx[0] ) * ( sy[1] - sy[0] );
+			if ( area == 0.0f )
+			{
+				continue;
+			}
+			const float rcpArea = 1.0f / area;
+
+			const int x0 = (int)MaxFloat( 0.0f, ceilf( MinFloat( sx[0], MinFloat( sx[1], sx[2] ) ) - 0.5f ) );
+			const int x1 = (int)MinFloat( (float)( width - 1 ), floorf( MaxFloat( sx[0], MaxFloat( sx[1], sx[2] ) ) - 0.5f ) );
+			const int y0 = (int)MaxFloat( (float)firstRow, ceilf( MinFloat( sy[0], MinFloat( sy[1], sy[2] ) ) - 0.5f ) );
+			const int y1 = (int)MinFloat( (float)( lastRow - 1 ), floorf( MaxFloat( sy[0], MaxFloat( sy[1], sy[2] ) ) - 0.5f ) );
+
+			const float * w[3];
+			for ( int k = 0; k < 3; k++ )
+			{
+				w[k] = &warped[(size_t)vertex[k] * NUM_COLOR_CHANNELS * 2];
+			}
+
+			for ( int py = y0; py <= y1; py++ )
+			{
+				const float cy = py + 0.5f;
+				for ( int px = x0; px <= x1; px++ )
+				{
+					const float cx = px + 0.5f;
+					// Edge functions, evaluated the same way for both triangles sharing
+					// an edge so no pixel center falls through the crack between them.
+					const float e0 = ( sx[1] - cx ) * ( sy[2] - cy ) - ( sx[2] - cx ) * ( sy[1] - cy );
+					const float e1 = ( sx[2] - cx ) * ( sy[0] - cy ) - ( sx[0] - cx ) * ( sy[2] - cy );
+					const float e2 = ( sx[0] - cx ) * ( sy[1] - cy ) - ( sx[1] - cx ) * ( sy[0] - cy );
+					const float b0 = e0 * rcpArea;
+					const float b1 = e1 * rcpArea;
+					const float b2 = e2 * rcpArea;
+					if ( b0 < 0.0f || b1 < 0.0f || b2 < 0.0f )
+					{
+						continue;
+					}
+
+					const size_t pixel = (size_t)( py - firstRow ) * width + px;
+					valid[pixel] = 1;
+					for ( int c = 0; c < NUM_COLOR_CHANNELS * 2; c++ )
+					{
+						bandUv[c * bandPixels + pixel] = b0 * w[0][c] + b1 * w[1][c] + b2 * w[2][c];
+					}
+				}
+			}
+		}
+
+		// Sample each eye's span of every row from that eye's layer.
+		const int eyeSpan = width / NUM_EYES;
+		for ( int py = firstRow; py < lastRow; py++ )
+		{
+			unsigned char * out = rgbaOut + (size_t)py * width * 4;
+			const size_t row = (size_t)( py - firstRow ) * width;
+			for ( int eye = 0; eye < NUM_EYES; eye++ )
+			{
+				const int first = eye * eyeSpan;
+				const int count = ( eye == NUM_EYES - 1 ) ? width - first : eyeSpan;
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					const float * u = &bandUv[( channel * 2 + 0 ) * bandPixels + row];
+					const float * v = &bandUv[( channel * 2 + 1 ) * bandPixels + row];
+					SampleRow( out + first * 4, channel, count, u + first, v + first, &valid[row + first],
+							   CpuEyeImage_Plane( image, eyeLayers[eye], channel ), image );
+				}
+			}
+			for ( int px = 0; px < width; px++ )
+			{
+				out[px * 4 + 3] = valid[row + px] ? 255 : 0;
+			}
+		}
+	} );
+}
+
+// One RG pair of a LUT layer, in either table format.
+static void FetchLutUv( const distortion_lut_t * lut, const size_t index, float * u, float * v )
+{
+	if ( lut->format == DISTORTION_LUT_HALF )
+	{
+		const GLushort * uvs = (const GLushort *)lut->uvs;
+		*u = HalfToFloat( uvs[index * 2 + 0] );
+		*v = HalfToFloat( uvs[index * 2 + 1] );
+	}
+	else
+	{
+		const float * uvs = (const float *)lut->uvs;
+		*u = uvs[index * 2 + 0];
+		*v = uvs[index * 2 + 1];
+	}
+}
+
+void CpuWarp_RenderLut( ThreadPool * pool, unsigned char * rgbaOut, const int width, const int height,
+						const distortion_lut_t * lut, const cpu_eye_image_t * image, const int eyeLayers[NUM_EYES],
+						const scanout_transforms_t * scanout )
+{
+	const size_t layerPixels = (size_t)lut->width * lut->height;
+	const int numTiles = ( height + SCANLINE_TILE_HEIGHT - 1 ) / SCANLINE_TILE_HEIGHT;
+
+	// One job per band of scanlines, like the mesh warp's pixel stage.
+	pool->parallelFor( numTiles, [&]( int tile )
+	{
+		const int firstRow = tile * SCANLINE_TILE_HEIGHT;
+		const int lastRow = ( firstRow + SCANLINE_TILE_HEIGHT < height ) ? firstRow + SCANLINE_TILE_HEIGHT : height;
+		std::vector<float> rowUv( NUM_COLOR_CHANNELS * 2 * width );
+		std::vector<unsigned char> valid( width );
+
+		for ( int py = firstRow; py < lastRow; py++ )
+		{
+			const float ndcY = ( py + 0.5f ) / lut->height * 2.0f - 1.0f;
+			for ( int px = 0; px < width; px++ )
+			{
+				const size_t texel = (size_t)py * lut->width + px;
+				float lutUv[NUM_COLOR_CHANNELS][2];
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					FetchLutUv( lut, channel * layerPixels + texel, &lutUv[channel][0], &lutUv[channel][1] );
+				}
+				valid[px] = ( lutUv[1][0] <= 1000.0f );		// the shader's DISTORTION_LUT_OUTSIDE test
+				if ( !valid[px] )
+				{
+					continue;
+				}
+
+				const float ndcX = ( px + 0.5f ) / lut->width * 2.0f - 1.0f;
+				ksMatrix3x4f transform;
+				Scanout_GetTransform( scanout, Scanout_GetDisplayFraction( scanout, ndcX, ndcY ), &transform );
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					float cur[3];
+					TransformUv( cur, &transform, lutUv[channel][0], lutUv[channel][1] );
+					const float rcpZ = 1.0f / MaxFloat( cur[2], 0.00001f );
+					rowUv[( channel * 2 + 0 ) * width + px] = cur[0] * rcpZ;
+					rowUv[( channel * 2 + 1 ) * width + px] = cur[1] * rcpZ;
+				}
+			}
+
+			// Sample each eye's span of the row from that eye's layer.
+			unsigned char * out = rgbaOut + (size_t)py * width * 4;
+			const int eyeSpan = width / NUM_EYES;
+			for ( int eye = 0; eye < NUM_EYES; eye++ )
+			{
+				const int first = eye * eyeSpan;
+				const int count = ( eye == NUM_EYES - 1 ) ? width - first : eyeSpan;
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					SampleRow( out + first * 4, channel, count,
+							   &rowUv[( channel * 2 + 0 ) * width + first], &rowUv[( channel * 2 + 1 ) * width + first],
+							   &valid[first], CpuEyeImage_Plane( image, eyeLayers[eye], channel ), image );
+				}
+			}
+			for ( int px = 0; px < width; px++ )
+			{
+				out[px * 4 + 3] = valid[px] ? 255 : 0;
+			}
+		}
+	} );
+}
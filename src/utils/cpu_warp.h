@@ -0,0 +1,69 @@
+#ifndef _CPU_WARP_H
+#define _CPU_WARP_H
+
+#include "hmd.h"
+#include "algebra.h"
+#include "thread_pool.h"
+#include "scanout.h"
+#include "distortion_lut.h"
+
+// CPU reference implementation of the chromatic timewarp pass.
+//
+// Mirrors timeWarpChromaticVertexProgramGLSL/FragmentProgramGLSL: every mesh
+// vertex gets its three UVs transformed by the scanout transform at its display
+// fraction (see scanout.h) and perspective divided, then the triangles are
+// rasterized in scanline bands with the UVs interpolated linearly across
+// them, and every channel does its
+// own bilinear fetch (GL_LINEAR, GL_CLAMP_TO_BORDER with a black border) from
+// one layer of the eye image. Output is RGBA8 in glReadPixels() order.
+
+// Eye image as padded uint8 planes, one per color channel and layer, with a
+// one texel black border all around so the bilinear fetch never needs bounds
+// checks. Rows are bottom to top, like the GL texture it stands in for.
+typedef struct
+{
+	int				width;
+	int				height;
+	int				layers;
+	int				stride;					// width + 2
+	int				planeSize;				// stride * ( height + 2 )
+	unsigned char *	texels;					// layers * NUM_COLOR_CHANNELS planes
+} cpu_eye_image_t;
+
+bool CpuEyeImage_Create( cpu_eye_image_t * image, const int width, const int height, const int layers );
+void CpuEyeImage_Destroy( cpu_eye_image_t * image );
+
+// Copy tightly packed RGB8/RGBA8 rows (bottom to top) of the same size into a layer.
+void CpuEyeImage_SetLayer( cpu_eye_image_t * image, const int layer, const unsigned char * src, const int srcChannels );
+
+// Bilinearly stretch an image of any size over a whole layer, the way the
+// basic full screen plane pass does it on the GPU.
+void CpuEyeImage_ResampleLayer( cpu_eye_image_t * image, const int layer, const unsigned char * src,
+								const int srcWidth, const int srcHeight, const int srcChannels );
+
+// The distortion mesh exactly as uploaded to the GPU by BuildTimewarp(). Like
+// displayCB(), every eye draws the same indices offset by eye * numVertices.
+typedef struct
+{
+	int							numVertices;	// per eye
+	const distortion_vertex_t *	vertices;		// NUM_EYES * numVertices
+	int							numIndices;		// per eye, triangle list
+	const GLuint *				indices;
+} cpu_warp_mesh_t;
+
+// Render one warped frame of width x height RGBA8 pixels. eyeLayers selects
+// the eye image layer per eye (the ArrayLayer uniform), scanout has the
+// contents of the ScanoutTransforms block.
+void CpuWarp_Render( ThreadPool * pool, unsigned char * rgbaOut, const int width, const int height,
+					 const cpu_warp_mesh_t * mesh, const cpu_eye_image_t * image, const int eyeLayers[NUM_EYES],
+					 const scanout_transforms_t * scanout );
+
+// The same frame as the LUT warp renders it (timeWarpLutFragmentProgramGLSL):
+// every pixel center takes its UVs from lut, which must be width x height,
+// and transforms them at its own display fraction, with no interpolation
+// across a mesh. Pixels the table marks DISTORTION_LUT_OUTSIDE stay black.
+void CpuWarp_RenderLut( ThreadPool * pool, unsigned char * rgbaOut, const int width, const int height,
+						const distortion_lut_t * lut, const cpu_eye_image_t * image, const int eyeLayers[NUM_EYES],
+						const scanout_transforms_t * scanout );
+
+#endif
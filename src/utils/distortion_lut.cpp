@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+#include "distortion_lut.h"
+#include "compact_mesh.h"
+
+// Points per EvaluateDistortionPoints() call.
+static const int LUT_CHUNK_SIZE = 64;
+
+static size_t GetElementSize( const distortion_lut_format_t format )
+{
+	return ( format == DISTORTION_LUT_HALF ) ? sizeof( GLushort ) : sizeof( float );
+}
+
+bool DistortionLut_Create( distortion_lut_t * lut, const int width, const int height, const distortion_lut_format_t format )
+{
+	memset( lut, 0, sizeof( distortion_lut_t ) );
+	lut->uvs = malloc( (size_t)NUM_COLOR_CHANNELS * width * height * 2 * GetElementSize( format ) );
+	if ( lut->uvs == NULL )
+	{
+		return false;
+	}
+	lut->width = width;
+	lut->height = height;
+	lut->format = format;
+	return true;
+}
+
+void DistortionLut_Destroy( distortion_lut_t * lut )
+{
+	free( lut->uvs );
+	memset( lut, 0, sizeof( distortion_lut_t ) );
+}
+
+size_t DistortionLut_GetSize( const distortion_lut_t * lut )
+{
+	return (size_t)NUM_COLOR_CHANNELS * lut->width * lut->height * 2 * GetElementSize( lut->format );
+}
+
+const char * DistortionLut_GetFormatName( const distortion_lut_format_t format )
+{
+	return ( format == DISTORTION_LUT_HALF ) ? "RG16F" : "RG32F";
+}
+
+// Store one row of float UVs in the table's format.
+static void StoreRow( distortion_lut_t * lut, const int channel, const int row, const float * uvs )
+{
+	const size_t offset = ( (size_t)channel * lut->height + row ) * lut->width * 2;
+	if ( lut->format == DISTORTION_LUT_HALF )
+	{
+		GLushort * dst = (GLushort *)lut->uvs + offset;
+		for ( int i = 0; i < lut->width * 2; i++ )
+		{
+			dst[i] = FloatToHalf( uvs[i] );
+		}
+	}
+	else
+	{
+		memcpy( (float *)lut->uvs + offset, uvs, lut->width * 2 * sizeof( float ) );
+	}
+}
+
+static void GenerateRow( const hmd_info_t * hmdInfo, distortion_lut_t * lut, const int row, float * rowUvs[NUM_COLOR_CHANNELS] )
+{
+	// Inverse of the vertex position mapping in BuildTimewarp(), at the pixel center.
+	const float heightScale = (float)( hmdInfo->eyeTilesHigh * hmdInfo->tilePixelsHigh ) / hmdInfo->displayPixelsHigh;
+	const float ndcY = 2.0f * ( row + 0.5f ) / lut->height - 1.0f;
+	const float yf = ( ndcY + 1.0f ) / ( 2.0f * heightScale );
+	if ( yf > 1.0f )
+	{
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			for ( int x = 0; x < lut->width * 2; x++ )
+			{
+				rowUvs[channel][x] = DISTORTION_LUT_OUTSIDE;
+			}
+			StoreRow( lut, channel, row, rowUvs[channel] );
+		}
+		return;
+	}
+
+	float xfs[LUT_CHUNK_SIZE];
+	float yfs[LUT_CHUNK_SIZE];
+	mesh_coord2d_t uvs[LUT_CHUNK_SIZE][NUM_COLOR_CHANNELS];
+	for ( int i = 0; i < LUT_CHUNK_SIZE; i++ )
+	{
+		yfs[i] = yf;
+	}
+
+	// The left half of the display is the left eye, the right half the right one.
+	const int eyeWidth = lut->width / NUM_EYES;
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		const int x0 = eye * eyeWidth;
+		const int x1 = ( eye == NUM_EYES - 1 ) ? lut->width : x0 + eyeWidth;
+		for ( int x = x0; x < x1; x += LUT_CHUNK_SIZE )
+		{
+			const int count = ( x1 - x < LUT_CHUNK_SIZE ) ? x1 - x : LUT_CHUNK_SIZE;
+			for ( int i = 0; i < count; i++ )
+			{
+				const float ndcX = 2.0f * ( x + i + 0.5f ) / lut->width - 1.0f;
+				xfs[i] = ndcX + 1.0f - (float)eye;
+			}
+
+			EvaluateDistortionPoints( hmdInfo, eye, xfs, yfs, count, uvs );
+
+			for ( int i = 0; i < count; i++ )
+			{
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					rowUvs[channel][( x + i ) * 2 + 0] = uvs[i][channel].x;
+					rowUvs[channel][( x + i ) * 2 + 1] = uvs[i][channel].y;
+				}
+			}
+		}
+	}
+
+	for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+	{
+		StoreRow( lut, channel, row, rowUvs[channel] );
+	}
+}
+
+void DistortionLut_Generate( ThreadPool * pool, const hmd_info_t * hmdInfo, distortion_lut_t * lut )
+{
+	// One job per thread, each with its own row scratch, taking rows from a
+	// shared counter: one allocation per table instead of one per row, and
+	// the rows still balance across the threads.
+	const int threadCount = pool->getThreadCount();
+	const size_t rowFloats = (size_t)NUM_COLOR_CHANNELS * lut->width * 2;
+	std::vector<float> scratch( threadCount * rowFloats );
+	std::atomic<int> nextRow( 0 );
+	pool->parallelFor( threadCount, [&]( int job )
+	{
+		float * rowUvs[NUM_COLOR_CHANNELS];
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			rowUvs[channel] = scratch.data() + job * rowFloats + channel * lut->width * 2;
+		}
+		for ( int row = nextRow.fetch_add( 1 ); row < lut->height; row = nextRow.fetch_add( 1 ) )
+		{
+			GenerateRow( hmdInfo, lut, row, rowUvs );
+		}
+	} );
+}
@@ -0,0 +1,44 @@
+#ifndef _DISTORTION_LUT_H
+#define _DISTORTION_LUT_H
+
+#include "hmd.h"
+#include "thread_pool.h"
+
+// Per-pixel distortion lookup table, for the full screen warp mode.
+//
+// Instead of a mesh whose UVs are interpolated linearly across its tiles,
+// every display pixel gets the exact distorted UVs of its center, per color
+// channel, from the same math as BuildDistortionMeshes(). The table is laid
+// out as the GL_TEXTURE_2D_ARRAY it is uploaded to: one layer of RG pairs
+// per color channel, both eyes side by side, rows bottom to top. Pixels the
+// mesh does not cover (below the last whole tile row) are marked with
+// DISTORTION_LUT_OUTSIDE in u and left black by the warp, as the mesh
+// leaves them.
+
+#define DISTORTION_LUT_OUTSIDE		1e4f
+
+typedef enum
+{
+	DISTORTION_LUT_FLOAT,				// RG32F
+	DISTORTION_LUT_HALF					// RG16F, converted on the CPU so the upload is a plain copy
+} distortion_lut_format_t;
+
+typedef struct
+{
+	int							width;		// display pixels
+	int							height;
+	distortion_lut_format_t		format;
+	void *						uvs;		// NUM_COLOR_CHANNELS layers of width * height RG pairs
+} distortion_lut_t;
+
+bool DistortionLut_Create( distortion_lut_t * lut, const int width, const int height, const distortion_lut_format_t format );
+void DistortionLut_Destroy( distortion_lut_t * lut );
+
+size_t DistortionLut_GetSize( const distortion_lut_t * lut );
+const char * DistortionLut_GetFormatName( const distortion_lut_format_t format );
+
+// Fill the table for hmdInfo, whose display must be lut->width x
+// lut->height pixels, a scanline at a time on every thread of the pool.
+void DistortionLut_Generate( ThreadPool * pool, const hmd_info_t * hmdInfo, distortion_lut_t * lut );
+
+#endif
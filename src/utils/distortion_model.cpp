@@ -0,0 +1,796 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "distortion_model.h"
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <immintrin.h>
+#define DISTORTION_MODEL_HAVE_AVX2
+#endif
+
+// Points per internal batch.
+static const int MODEL_CHUNK_SIZE = 64;
+
+// Samples of r^2 the polynomial models are fitted to.
+static const int FIT_SAMPLES = 256;
+
+// The rational fit's scan of k[4]: the smallest denominator it may reach
+// within the field of view, the largest k[4], and steps per pass.
+static const double RATIONAL_FIT_MIN_DEN = 0.25;
+static const double RATIONAL_FIT_MAX_K4 = 4.0;
+static const int RATIONAL_FIT_STEPS = 64;
+static const int RATIONAL_FIT_PASSES = 3;
+
+bool DistortionModel_CreateCatmullRom( distortion_model_t * model, const hmd_info_t * hmdInfo )
+{
+	memset( model, 0, sizeof( distortion_model_t ) );
+	model->type = DISTORTION_MODEL_CATMULL_ROM;
+	memcpy( model->chromaticAberration, hmdInfo->chromaticAberration, sizeof( model->chromaticAberration ) );
+	return CatmullRomSpline_Create( &model->spline, hmdInfo->K, hmdInfo->numKnots );
+}
+
+void DistortionModel_CreateBrownConrady( distortion_model_t * model, const float k[NUM_COLOR_CHANNELS][4], const float p[NUM_COLOR_CHANNELS][2] )
+{
+	memset( model, 0, sizeof( distortion_model_t ) );
+	model->type = DISTORTION_MODEL_BROWN_CONRADY;
+	for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+	{
+		memcpy( model->k[channel], k[channel], 4 * sizeof( float ) );
+		model->p[channel][0] = p[channel][0];
+		model->p[channel][1] = p[channel][1];
+	}
+}
+
+void DistortionModel_CreateRational( distortion_model_t * model, const float k[NUM_COLOR_CHANNELS][DISTORTION_MODEL_COEFFICIENTS] )
+{
+	memset( model, 0, sizeof( distortion_model_t ) );
+	model->type = DISTORTION_MODEL_RATIONAL;
+	memcpy( model->k, k, sizeof( model->k ) );
+}
+
+bool DistortionModel_CreateGrid( distortion_model_t * model, const int gridWide, const int gridHigh,
+								 const float thetaMin[2], const float thetaMax[2], const float * uvs )
+{
+	memset( model, 0, sizeof( distortion_model_t ) );
+	if ( gridWide < 2 || gridHigh < 2 || !( thetaMax[0] > thetaMin[0] ) || !( thetaMax[1] > thetaMin[1] ) )
+	{
+		return false;
+	}
+	const size_t size = (size_t)NUM_COLOR_CHANNELS * gridWide * gridHigh * 2 * sizeof( float );
+	model->gridUvs = (float *)malloc( size );
+	if ( model->gridUvs == NULL )
+	{
+		return false;
+	}
+	memcpy( model->gridUvs, uvs, size );
+	model->type = DISTORTION_MODEL_GRID;
+	model->gridWide = gridWide;
+	model->gridHigh = gridHigh;
+	model->thetaMin[0] = thetaMin[0];
+	model->thetaMin[1] = thetaMin[1];
+	model->thetaMax[0] = thetaMax[0];
+	model->thetaMax[1] = thetaMax[1];
+	return true;
+}
+
+void DistortionModel_Destroy( distortion_model_t * model )
+{
+	free( model->gridUvs );
+	memset( model, 0, sizeof( distortion_model_t ) );
+}
+
+const char * DistortionModel_GetTypeName( const distortion_model_type_t type )
+{
+	switch ( type )
+	{
+		case DISTORTION_MODEL_CATMULL_ROM:		return "catmull-rom";
+		case DISTORTION_MODEL_BROWN_CONRADY:	return "brown-conrady";
+		case DISTORTION_MODEL_RATIONAL:			return "rational";
+		case DISTORTION_MODEL_GRID:				return "grid";
+		default:								return "unknown";
+	}
+}
+
+/*
+================================================================================================
+
+Evaluation
+
+================================================================================================
+*/
+
+static void EvaluateCatmullRom( const distortion_model_t * model, const float * thetaX, const float * thetaY, const int count,
+								mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const simd_path_t simd )
+{
+	// The operations of EvaluateDistortion(), with the spline done as a batch.
+	float rsq[MODEL_CHUNK_SIZE];
+	float scale[MODEL_CHUNK_SIZE];
+	for ( int i = 0; i < count; i++ )
+	{
+		rsq[i] = thetaX[i] * thetaX[i] + thetaY[i] * thetaY[i];
+	}
+	CatmullRomSpline_EvaluateBatch( &model->spline, rsq, scale, count, simd );
+	for ( int i = 0; i < count; i++ )
+	{
+		const float chromaScale[NUM_COLOR_CHANNELS] =
+		{
+			scale[i] * ( 1.0f + model->chromaticAberration[0] + rsq[i] * model->chromaticAberration[1] ),
+			scale[i],
+			scale[i] * ( 1.0f + model->chromaticAberration[2] + rsq[i] * model->chromaticAberration[3] )
+		};
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			uv[i][channel].x = chromaScale[channel] * thetaX[i];
+			uv[i][channel].y = chromaScale[channel] * thetaY[i];
+		}
+	}
+}
+
+static void EvaluatePolynomialScalar( const distortion_model_t * model, const float * thetaX, const float * thetaY,
+									  mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const int begin, const int end )
+{
+	for ( int i = begin; i < end; i++ )
+	{
+		const float x = thetaX[i];
+		const float y = thetaY[i];
+		const float r2 = x * x + y * y;
+		const float r4 = r2 * r2;
+		const float r6 = r4 * r2;
+		const float xy = x * y;
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			const float * k = model->k[channel];
+			const float * p = model->p[channel];
+			const float num = k[0] + k[1] * r2 + k[2] * r4 + k[3] * r6;
+			const float den = 1.0f + k[4] * r2 + k[5] * r4 + k[6] * r6;
+			const float scale = num / den;
+			uv[i][channel].x = x * scale + ( ( 2.0f * p[0] ) * xy + p[1] * ( r2 + 2.0f * x * x ) );
+			uv[i][channel].y = y * scale + ( p[0] * ( r2 + 2.0f * y * y ) + ( 2.0f * p[1] ) * xy );
+		}
+	}
+}
+
+static void EvaluateGridScalar( const distortion_model_t * model, const float * thetaX, const float * thetaY,
+								mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const int begin, const int end )
+{
+	const int wide = model->gridWide;
+	const int high = model->gridHigh;
+	const float scaleX = (float)( wide - 1 ) / ( model->thetaMax[0] - model->thetaMin[0] );
+	const float scaleY = (float)( high - 1 ) / ( model->thetaMax[1] - model->thetaMin[1] );
+	const float maxX = (float)( wide - 2 );
+	const float maxY = (float)( high - 2 );
+	for ( int i = begin; i < end; i++ )
+	{
+		// Clamping before truncation picks the edge cell, whose weights then extrapolate.
+		const float gx = ( thetaX[i] - model->thetaMin[0] ) * scaleX;
+		const float gy = ( thetaY[i] - model->thetaMin[1] ) * scaleY;
+		const int ix = (int)MinFloat( MaxFloat( gx, 0.0f ), maxX );
+		const int iy = (int)MinFloat( MaxFloat( gy, 0.0f ), maxY );
+		const float fx = gx - (float)ix;
+		const float fy = gy - (float)iy;
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			const float * g = model->gridUvs + ( (size_t)( channel * high + iy ) * wide + ix ) * 2;
+			for ( int j = 0; j < 2; j++ )
+			{
+				const float top = g[j] + fx * ( g[2 + j] - g[j] );
+				const float bottom = g[wide * 2 + j] + fx * ( g[wide * 2 + 2 + j] - g[wide * 2 + j] );
+				const float value = top + fy * ( bottom - top );
+				if ( j == 0 )
+				{
+					uv[i][channel].x = value;
+				}
+				else
+				{
+					uv[i][channel].y = value;
+				}
+			}
+		}
+	}
+}
+
+#if defined( __SSE2__ )
+static void EvaluatePolynomialSSE2( const distortion_model_t * model, const float * thetaX, const float * thetaY,
+									mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const int count )
+{
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	const __m128 vTwo = _mm_set1_ps( 2.0f );
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const __m128 x = _mm_loadu_ps( thetaX + i );
+		const __m128 y = _mm_loadu_ps( thetaY + i );
+		const __m128 r2 = _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) );
+		const __m128 r4 = _mm_mul_ps( r2, r2 );
+		const __m128 r6 = _mm_mul_ps( r4, r2 );
+		const __m128 xy = _mm_mul_ps( x, y );
+		const __m128 tx = _mm_add_ps( r2, _mm_mul_ps( _mm_mul_ps( vTwo, x ), x ) );
+		const __m128 ty = _mm_add_ps( r2, _mm_mul_ps( _mm_mul_ps( vTwo, y ), y ) );
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			const float * k = model->k[channel];
+			const float * p = model->p[channel];
+			const __m128 num = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_set1_ps( k[0] ), _mm_mul_ps( _mm_set1_ps( k[1] ), r2 ) ),
+													   _mm_mul_ps( _mm_set1_ps( k[2] ), r4 ) ), _mm_mul_ps( _mm_set1_ps( k[3] ), r6 ) );
+			const __m128 den = _mm_add_ps( _mm_add_ps( _mm_add_ps( vOne, _mm_mul_ps( _mm_set1_ps( k[4] ), r2 ) ),
+													   _mm_mul_ps( _mm_set1_ps( k[5] ), r4 ) ), _mm_mul_ps( _mm_set1_ps( k[6] ), r6 ) );
+			const __m128 scale = _mm_div_ps( num, den );
+			const __m128 p0 = _mm_set1_ps( p[0] );
+			const __m128 p1 = _mm_set1_ps( p[1] );
+			const __m128 twoP0 = _mm_set1_ps( 2.0f * p[0] );
+			const __m128 twoP1 = _mm_set1_ps( 2.0f * p[1] );
+			const __m128 u = _mm_add_ps( _mm_mul_ps( x, scale ), _mm_add_ps( _mm_mul_ps( twoP0, xy ), _mm_mul_ps( p1, tx ) ) );
+			const __m128 v = _mm_add_ps( _mm_mul_ps( y, scale ), _mm_add_ps( _mm_mul_ps( p0, ty ), _mm_mul_ps( twoP1, xy ) ) );
+
+			float us[4];
+			float vs[4];
+			_mm_storeu_ps( us, u );
+			_mm_storeu_ps( vs, v );
+			for ( int j = 0; j < 4; j++ )
+			{
+				uv[i + j][channel].x = us[j];
+				uv[i + j][channel].y = vs[j];
+			}
+		}
+	}
+	EvaluatePolynomialScalar( model, thetaX, thetaY, uv, i, count );
+}
+
+static void EvaluateGridSSE2( const distortion_model_t * model, const float * thetaX, const float * thetaY,
+							  mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const int count )
+{
+	const int wide = model->gridWide;
+	const int high = model->gridHigh;
+	const __m128 vMinX = _mm_set1_ps( model->thetaMin[0] );
+	const __m128 vMinY = _mm_set1_ps( model->thetaMin[1] );
+	const __m128 vScaleX = _mm_set1_ps( (float)( wide - 1 ) / ( model->thetaMax[0] - model->thetaMin[0] ) );
+	const __m128 vScaleY = _mm_set1_ps( (float)( high - 1 ) / ( model->thetaMax[1] - model->thetaMin[1] ) );
+	const __m128 vMaxX = _mm_set1_ps( (float)( wide - 2 ) );
+	const __m128 vMaxY = _mm_set1_ps( (float)( high - 2 ) );
+	const __m128 vZero = _mm_setzero_ps();
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const __m128 gx = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( thetaX + i ), vMinX ), vScaleX );
+		const __m128 gy = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( thetaY + i ), vMinY ), vScaleY );
+		const __m128i ix = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( gx, vZero ), vMaxX ) );
+		const __m128i iy = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( gy, vZero ), vMaxY ) );
+		const __m128 fx = _mm_sub_ps( gx, _mm_cvtepi32_ps( ix ) );
+		const __m128 fy = _mm_sub_ps( gy, _mm_cvtepi32_ps( iy ) );
+
+		// No gather before AVX2.
+		int ixs[4];
+		int iys[4];
+		_mm_storeu_si128( (__m128i *)ixs, ix );
+		_mm_storeu_si128( (__m128i *)iys, iy );
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			const float * g[4];
+			for ( int j = 0; j < 4; j++ )
+			{
+				g[j] = model->gridUvs + ( (size_t)( channel * high + iys[j] ) * wide + ixs[j] ) * 2;
+			}
+			__m128 values[2];
+			for ( int c = 0; c < 2; c++ )
+			{
+				const int w2 = wide * 2;
+				const __m128 a = _mm_setr_ps( g[0][c], g[1][c], g[2][c], g[3][c] );
+				const __m128 b = _mm_setr_ps( g[0][2 + c], g[1][2 + c], g[2][2 + c], g[3][2 + c] );
+				const __m128 d = _mm_setr_ps( g[0][w2 + c], g[1][w2 + c], g[2][w2 + c], g[3][w2 + c] );
+				const __m128 e = _mm_setr_ps( g[0][w2 + 2 + c], g[1][w2 + 2 + c], g[2][w2 + 2 + c], g[3][w2 + 2 + c] );
+				const __m128 top = _mm_add_ps( a, _mm_mul_ps( fx, _mm_sub_ps( b, a ) ) );
+				const __m128 bottom = _mm_add_ps( d, _mm_mul_ps( fx, _mm_sub_ps( e, d ) ) );
+				values[c] = _mm_add_ps( top, _mm_mul_ps( fy, _mm_sub_ps( bottom, top ) ) );
+			}
+
+			float us[4];
+			float vs[4];
+			_mm_storeu_ps( us, values[0] );
+			_mm_storeu_ps( vs, values[1] );
+			for ( int j = 0; j < 4; j++ )
+			{
+				uv[i + j][channel].x = us[j];
+				uv[i + j][channel].y = vs[j];
+			}
+		}
+	}
+	EvaluateGridScalar( model, thetaX, thetaY, uv, i, count );
+}
+#endif
+
+#if defined( DISTORTION_MODEL_HAVE_AVX2 )
+// Compiled for AVX2 only (no FMA, which would change the rounding), and
+// only called after checking the CPU supports it.
+__attribute__(( target( "avx2" ) ))
+static void EvaluatePolynomialAVX2( const distortion_model_t * model, const float * thetaX, const float * thetaY,
+									mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const int count )
+{
+	const __m256 vOne = _mm256_set1_ps( 1.0f );
+	const __m256 vTwo = _mm256_set1_ps( 2.0f );
+
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		const __m256 x = _mm256_loadu_ps( thetaX + i );
+		const __m256 y = _mm256_loadu_ps( thetaY + i );
+		const __m256 r2 = _mm256_add_ps( _mm256_mul_ps( x, x ), _mm256_mul_ps( y, y ) );
+		const __m256 r4 = _mm256_mul_ps( r2, r2 );
+		const __m256 r6 = _mm256_mul_ps( r4, r2 );
+		const __m256 xy = _mm256_mul_ps( x, y );
+		const __m256 tx = _mm256_add_ps( r2, _mm256_mul_ps( _mm256_mul_ps( vTwo, x ), x ) );
+		const __m256 ty = _mm256_add_ps( r2, _mm256_mul_ps( _mm256_mul_ps( vTwo, y ), y ) );
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			const float * k = model->k[channel];
+			const float * p = model->p[channel];
+			const __m256 num = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_set1_ps( k[0] ), _mm256_mul_ps( _mm256_set1_ps( k[1] ), r2 ) ),
+															 _mm256_mul_ps( _mm256_set1_ps( k[2] ), r4 ) ), _mm256_mul_ps( _mm256_set1_ps( k[3] ), r6 ) );
+			const __m256 den = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( vOne, _mm256_mul_ps( _mm256_set1_ps( k[4] ), r2 ) ),
+															 _mm256_mul_ps( _mm256_set1_ps( k[5] ), r4 ) ), _mm256_mul_ps( _mm256_set1_ps( k[6] ), r6 ) );
+			const __m256 scale = _mm256_div_ps( num, den );
+			const __m256 p0 = _mm256_set1_ps( p[0] );
+			const __m256 p1 = _mm256_set1_ps( p[1] );
+			const __m256 twoP0 = _mm256_set1_ps( 2.0f * p[0] );
+			const __m256 twoP1 = _mm256_set1_ps( 2.0f * p[1] );
+			const __m256 u = _mm256_add_ps( _mm256_mul_ps( x, scale ), _mm256_add_ps( _mm256_mul_ps( twoP0, xy ), _mm256_mul_ps( p1, tx ) ) );
+			const __m256 v = _mm256_add_ps( _mm256_mul_ps( y, scale ), _mm256_add_ps( _mm256_mul_ps( p0, ty ), _mm256_mul_ps( twoP1, xy ) ) );
+
+			// Interleave back into { u, v } pairs.
+			const __m256 lo = _mm256_unpacklo_ps( u, v );		// u0 v0 u1 v1 | u4 v4 u5 v5
+			const __m256 hi = _mm256_unpackhi_ps( u, v );		// u2 v2 u3 v3 | u6 v6 u7 v7
+			float pairs[16];
+			_mm256_storeu_ps( pairs, _mm256_permute2f128_ps( lo, hi, 0x20 ) );
+			_mm256_storeu_ps( pairs + 8, _mm256_permute2f128_ps( lo, hi, 0x31 ) );
+			for ( int j = 0; j < 8; j++ )
+			{
+				uv[i + j][channel].x = pairs[j * 2 + 0];
+				uv[i + j][channel].y = pairs[j * 2 + 1];
+			}
+		}
+	}
+	EvaluatePolynomialScalar( model, thetaX, thetaY, uv, i, count );
+}
+
+__attribute__(( target( "avx2" ) ))
+static void EvaluateGridAVX2( const distortion_model_t * model, const float * thetaX, const float * thetaY,
+							  mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const int count )
+{
+	const int wide = model->gridWide;
+	const int high = model->gridHigh;
+	const __m256 vMinX = _mm256_set1_ps( model->thetaMin[0] );
+	const __m256 vMinY = _mm256_set1_ps( model->thetaMin[1] );
+	const __m256 vScaleX = _mm256_set1_ps( (float)( wide - 1 ) / ( model->thetaMax[0] - model->thetaMin[0] ) );
+	const __m256 vScaleY = _mm256_set1_ps( (float)( high - 1 ) / ( model->thetaMax[1] - model->thetaMin[1] ) );
+	const __m256 vMaxX = _mm256_set1_ps( (float)( wide - 2 ) );
+	const __m256 vMaxY = _mm256_set1_ps( (float)( high - 2 ) );
+	const __m256 vZero = _mm256_setzero_ps();
+	const __m256i vWide = _mm256_set1_epi32( wide );
+
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		const __m256 gx = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( thetaX + i ), vMinX ), vScaleX );
+		const __m256 gy = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( thetaY + i ), vMinY ), vScaleY );
+		const __m256i ix = _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( gx, vZero ), vMaxX ) );
+		const __m256i iy = _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( gy, vZero ), vMaxY ) );
+		const __m256 fx = _mm256_sub_ps( gx, _mm256_cvtepi32_ps( ix ) );
+		const __m256 fy = _mm256_sub_ps( gy, _mm256_cvtepi32_ps( iy ) );
+		// Float offset of the top left sample in channel 0.
+		const __m256i cell = _mm256_slli_epi32( _mm256_add_epi32( _mm256_mullo_epi32( iy, vWide ), ix ), 1 );
+
+		for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+		{
+			const float * base = model->gridUvs + (size_t)channel * high * wide * 2;
+			__m256 values[2];
+			for ( int c = 0; c < 2; c++ )
+			{
+				const float * g = base + c;
+				const __m256 a = _mm256_i32gather_ps( g, cell, 4 );
+				const __m256 b = _mm256_i32gather_ps( g + 2, cell, 4 );
+				const __m256 d = _mm256_i32gather_ps( g + wide * 2, cell, 4 );
+				const __m256 e = _mm256_i32gather_ps( g + wide * 2 + 2, cell, 4 );
+				const __m256 top = _mm256_add_ps( a, _mm256_mul_ps( fx, _mm256_sub_ps( b, a ) ) );
+				const __m256 bottom = _mm256_add_ps( d, _mm256_mul_ps( fx, _mm256_sub_ps( e, d ) ) );
+				values[c] = _mm256_add_ps( top, _mm256_mul_ps( fy, _mm256_sub_ps( bottom, top ) ) );
+			}
+
+			float us[8];
+			float vs[8];
+			_mm256_storeu_ps( us, values[0] );
+			_mm256_storeu_ps( vs, values[1] );
+			for ( int j = 0; j < 8; j++ )
+			{
+				uv[i + j][channel].x = us[j];
+				uv[i + j][channel].y = vs[j];
+			}
+		}
+	}
+	EvaluateGridScalar( model, thetaX, thetaY, uv, i, count );
+}
+#endif
+
+simd_path_t DistortionModel_GetBestSimd( const distortion_model_t * model )
+{
+	const simd_path_t best = Simd_GetBestPath();
+	// --benchmark=distortion-models has the Catmull-Rom model on AVX2 no
+	// faster than scalar, and SSE2 about 1.4x.
+	if ( model->type == DISTORTION_MODEL_CATMULL_ROM && best == SIMD_PATH_AVX2 )
+	{
+		return SIMD_PATH_SSE2;
+	}
+	return best;
+}
+
+static void EvaluateChunk( const distortion_model_t * model, const float * thetaX, const float * thetaY, const int count,
+						   mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const simd_path_t simd )
+{
+	const simd_path_t path = ( simd == SIMD_PATH_BEST ) ? DistortionModel_GetBestSimd( model ) : simd;
+	const bool polynomial = ( model->type == DISTORTION_MODEL_BROWN_CONRADY || model->type == DISTORTION_MODEL_RATIONAL );
+
+	if ( model->type == DISTORTION_MODEL_CATMULL_ROM )
+	{
+		EvaluateCatmullRom( model, thetaX, thetaY, count, uv, path );
+		return;
+	}
+#if defined( DISTORTION_MODEL_HAVE_AVX2 )
+	if ( path == SIMD_PATH_AVX2 && Simd_GetBestPath() == SIMD_PATH_AVX2 )
+	{
+		if ( polynomial )
+		{
+			EvaluatePolynomialAVX2( model, thetaX, thetaY, uv, count );
+		}
+		else
+		{
+			EvaluateGridAVX2( model, thetaX, thetaY, uv, count );
+		}
+		return;
+	}
+#endif
+#if defined( __SSE2__ )
+	if ( path != SIMD_PATH_SCALAR )
+	{
+		if ( polynomial )
+		{
+			EvaluatePolynomialSSE2( model, thetaX, thetaY, uv, count );
+		}
+		else
+		{
+			EvaluateGridSSE2( model, thetaX, thetaY, uv, count );
+		}
+		return;
+	}
+#endif
+	if ( polynomial )
+	{
+		EvaluatePolynomialScalar( model, thetaX, thetaY, uv, 0, count );
+	}
+	else
+	{
+		EvaluateGridScalar( model, thetaX, thetaY, uv, 0, count );
+	}
+}
+
+void DistortionModel_EvaluateBatch( const distortion_model_t * model, const float * thetaX, const float * thetaY, const int count,
+									mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const simd_path_t simd )
+{
+	for ( int i = 0; i < count; i += MODEL_CHUNK_SIZE )
+	{
+		const int chunk = ( count - i < MODEL_CHUNK_SIZE ) ? count - i : MODEL_CHUNK_SIZE;
+		EvaluateChunk( model, thetaX + i, thetaY + i, chunk, uv + i, simd );
+	}
+}
+
+void DistortionModel_MeasureError( const distortion_model_t * model, const hmd_info_t * hmdInfo, const float uvToPixels[2],
+								   float * maxError, float * meanError )
+{
+	float thetaX[MODEL_CHUNK_SIZE];
+	float thetaY[MODEL_CHUNK_SIZE];
+	mesh_coord2d_t reference[MODEL_CHUNK_SIZE][NUM_COLOR_CHANNELS];
+	mesh_coord2d_t uvs[MODEL_CHUNK_SIZE][NUM_COLOR_CHANNELS];
+	float maxPixels = 0.0f;
+	double sumPixels = 0.0;
+	int count = 0;
+
+	// A row at a time, in chunks of the batch size.
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int y = 0; y <= hmdInfo->eyeTilesHigh; y++ )
+		{
+			for ( int x0 = 0; x0 <= hmdInfo->eyeTilesWide; x0 += MODEL_CHUNK_SIZE )
+			{
+				const int chunk = ( hmdInfo->eyeTilesWide + 1 - x0 < MODEL_CHUNK_SIZE ) ? hmdInfo->eyeTilesWide + 1 - x0 : MODEL_CHUNK_SIZE;
+				for ( int i = 0; i < chunk; i++ )
+				{
+					const float xf = (float)( x0 + i ) / hmdInfo->eyeTilesWide;
+					const float yf = 1.0f - (float)y / hmdInfo->eyeTilesHigh;
+					float theta[2];
+					GetDistortionTanAngles( hmdInfo, eye, xf, yf, theta );
+					thetaX[i] = theta[0];
+					thetaY[i] = theta[1];
+					EvaluateDistortion( hmdInfo, eye, xf, yf, reference[i] );
+				}
+				DistortionModel_EvaluateBatch( model, thetaX, thetaY, chunk, uvs );
+
+				for ( int i = 0; i < chunk; i++ )
+				{
+					for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+					{
+						const float du = ( uvs[i][channel].x - reference[i][channel].x ) * uvToPixels[0];
+						const float dv = ( uvs[i][channel].y - reference[i][channel].y ) * uvToPixels[1];
+						const float error = sqrtf( du * du + dv * dv );
+						maxPixels = MaxFloat( maxPixels, error );
+						sumPixels += error;
+					}
+				}
+				count += chunk;
+			}
+		}
+	}
+
+	*maxError = maxPixels;
+	*meanError = ( count > 0 ) ? (float)( sumPixels / ( (double)count * NUM_COLOR_CHANNELS ) ) : 0.0f;
+}
+
+/*
+================================================================================================
+
+Fitting to the Catmull-Rom lens
+
+================================================================================================
+*/
+
+// Range of tangent angles the mesh of hmdInfo covers, over both eyes.
+static void GetTanAngleRange( const hmd_info_t * hmdInfo, float thetaMin[2], float thetaMax[2], float * maxRsq )
+{
+	thetaMin[0] = thetaMin[1] = 1e30f;
+	thetaMax[0] = thetaMax[1] = -1e30f;
+	*maxRsq = 0.0f;
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int corner = 0; corner < 4; corner++ )
+		{
+			float theta[2];
+			GetDistortionTanAngles( hmdInfo, eye, (float)( corner & 1 ), (float)( corner >> 1 ), theta );
+			for ( int i = 0; i < 2; i++ )
+			{
+				thetaMin[i] = MinFloat( thetaMin[i], theta[i] );
+				thetaMax[i] = MaxFloat( thetaMax[i], theta[i] );
+			}
+			*maxRsq = MaxFloat( *maxRsq, theta[0] * theta[0] + theta[1] * theta[1] );
+		}
+	}
+}
+
+// The radial scale of one color channel of the Catmull-Rom lens at r^2.
+static double CatmullRomChannelScale( const hmd_info_t * hmdInfo, const int channel, const float rsq )
+{
+	const float scale = EvaluateCatmullRomSpline( rsq, hmdInfo->K, hmdInfo->numKnots );
+	if ( channel == 0 )
+	{
+		return scale * ( 1.0f + hmdInfo->chromaticAberration[0] + rsq * hmdInfo->chromaticAberration[1] );
+	}
+	if ( channel == 2 )
+	{
+		return scale * ( 1.0f + hmdInfo->chromaticAberration[2] + rsq * hmdInfo->chromaticAberration[3] );
+	}
+	return scale;
+}
+
+// Least squares solution of the FIT_SAMPLES x numUnknowns system rows * x = rhs,
+// through the normal equations and Gaussian elimination with partial pivoting.
+static bool SolveLeastSquares( const double * rows, const double * rhs, const int numUnknowns, double * x )
+{
+	double a[DISTORTION_MODEL_COEFFICIENTS][DISTORTION_MODEL_COEFFICIENTS + 1];
+	memset( a, 0, sizeof( a ) );
+	for ( int s = 0; s < FIT_SAMPLES; s++ )
+	{
+		const double * row = rows + s * numUnknowns;
+		for ( int i = 0; i < numUnknowns; i++ )
+		{
+			for ( int j = 0; j < numUnknowns; j++ )
+			{
+				a[i][j] += row[i] * row[j];
+			}
+			a[i][numUnknowns] += row[i] * rhs[s];
+		}
+	}
+
+	for ( int col = 0; col < numUnknowns; col++ )
+	{
+		int pivot = col;
+		for ( int r = col + 1; r < numUnknowns; r++ )
+		{
+			if ( fabs( a[r][col] ) > fabs( a[pivot][col] ) )
+			{
+				pivot = r;
+			}
+		}
+		if ( fabs( a[pivot][col] ) < 1e-300 )
+		{
+			return false;
+		}
+		for ( int j = 0; j <= numUnknowns; j++ )
+		{
+			const double t = a[col][j];
+			a[col][j] = a[pivot][j];
+			a[pivot][j] = t;
+		}
+		for ( int r = 0; r < numUnknowns; r++ )
+		{
+			if ( r != col )
+			{
+				const double f = a[r][col] / a[col][col];
+				for ( int j = col; j <= numUnknowns; j++ )
+				{
+					a[r][j] -= f * a[col][j];
+				}
+			}
+		}
+	}
+	for ( int i = 0; i < numUnknowns; i++ )
+	{
+		x[i] = a[i][numUnknowns] / a[i][i];
+	}
+	return true;
+}
+
+// Least squares numerator k[0..3] of one channel for the denominator
+// 1 + k4 r^2, weighting every sample by r, since the UV error is r times the
+// scale error. Returns the weighted sum of squared scale errors.
+static double FitNumerator( const hmd_info_t * hmdInfo, const int channel, const float maxRsq, const double k4, double x[4] )
+{
+	double rows[FIT_SAMPLES * 4];
+	double rhs[FIT_SAMPLES];
+	for ( int s = 0; s < FIT_SAMPLES; s++ )
+	{
+		// With the denominator fixed, num - scale * den is linear in the numerator,
+		// and dividing it by den makes it the scale error itself.
+		const float rsq = maxRsq * s / ( FIT_SAMPLES - 1 );
+		const double scale = CatmullRomChannelScale( hmdInfo, channel, rsq );
+		const double den = 1.0 + k4 * rsq;
+		const double weight = sqrt( (double)rsq ) / den;
+		double * row = rows + s * 4;
+		row[0] = weight;
+		row[1] = weight * rsq;
+		row[2] = weight * rsq * rsq;
+		row[3] = weight * rsq * rsq * rsq;
+		rhs[s] = weight * scale * den;
+	}
+	if ( !SolveLeastSquares( rows, rhs, 4, x ) )
+	{
+		return 1e30;
+	}
+
+	double sum = 0.0;
+	for ( int s = 0; s < FIT_SAMPLES; s++ )
+	{
+		const double * row = rows + s * 4;
+		const double residual = row[0] * x[0] + row[1] * x[1] + row[2] * x[2] + row[3] * x[3] - rhs[s];
+		sum += residual * residual;
+	}
+	return sum;
+}
+
+// Fit k[0..3] of every channel, and for the rational model k[4] as well.
+// The linearized rational fit of all of k[4..6] puts a pole right inside the
+// field of view, where the spline turns into its straight end segment, so
+// only 1 + k4 r^2 is fitted, by scanning k4 over the values that keep the
+// denominator at RATIONAL_FIT_MIN_DEN or more, with the numerator solved
+// exactly for each.
+static bool FitPolynomial( distortion_model_t * model, const hmd_info_t * hmdInfo, const bool rational )
+{
+	float thetaMin[2];
+	float thetaMax[2];
+	float maxRsq;
+	GetTanAngleRange( hmdInfo, thetaMin, thetaMax, &maxRsq );
+
+	for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+	{
+		double x[4];
+		double bestK4 = 0.0;
+		double best = FitNumerator( hmdInfo, channel, maxRsq, bestK4, x );
+		if ( rational )
+		{
+			const double minK4 = ( RATIONAL_FIT_MIN_DEN - 1.0 ) / maxRsq;
+			double low = minK4;
+			double high = RATIONAL_FIT_MAX_K4;
+			for ( int pass = 0; pass < RATIONAL_FIT_PASSES; pass++ )
+			{
+				const double step = ( high - low ) / RATIONAL_FIT_STEPS;
+				for ( int i = 0; i <= RATIONAL_FIT_STEPS; i++ )
+				{
+					double candidate[4];
+					const double k4 = low + step * i;
+					const double error = FitNumerator( hmdInfo, channel, maxRsq, k4, candidate );
+					if ( error < best )
+					{
+						best = error;
+						bestK4 = k4;
+					}
+				}
+				low = ( bestK4 - step > minK4 ) ? bestK4 - step : minK4;
+				high = bestK4 + step;
+			}
+			best = FitNumerator( hmdInfo, channel, maxRsq, bestK4, x );
+		}
+		if ( !( best < 1e30 ) )
+		{
+			return false;
+		}
+		for ( int i = 0; i < 4; i++ )
+		{
+			model->k[channel][i] = (float)x[i];
+		}
+		model->k[channel][4] = (float)bestK4;
+	}
+	return true;
+}
+
+bool DistortionModel_FitBrownConrady( distortion_model_t * model, const hmd_info_t * hmdInfo )
+{
+	memset( model, 0, sizeof( distortion_model_t ) );
+	model->type = DISTORTION_MODEL_BROWN_CONRADY;
+	return FitPolynomial( model, hmdInfo, false );
+}
+
+bool DistortionModel_FitRational( distortion_model_t * model, const hmd_info_t * hmdInfo )
+{
+	memset( model, 0, sizeof( distortion_model_t ) );
+	model->type = DISTORTION_MODEL_RATIONAL;
+	return FitPolynomial( model, hmdInfo, true );
+}
+
+bool DistortionModel_SampleGrid( distortion_model_t * model, const hmd_info_t * hmdInfo, const int gridWide, const int gridHigh )
+{
+	memset( model, 0, sizeof( distortion_model_t ) );
+	distortion_model_t lens;
+	if ( gridWide < 2 || gridHigh < 2 || !DistortionModel_CreateCatmullRom( &lens, hmdInfo ) )
+	{
+		return false;
+	}
+
+	float thetaMin[2];
+	float thetaMax[2];
+	float maxRsq;
+	GetTanAngleRange( hmdInfo, thetaMin, thetaMax, &maxRsq );
+
+	float * uvs = (float *)malloc( (size_t)NUM_COLOR_CHANNELS * gridWide * gridHigh * 2 * sizeof( float ) );
+	if ( uvs == NULL )
+	{
+		return false;
+	}
+	float thetaX[MODEL_CHUNK_SIZE];
+	float thetaY[MODEL_CHUNK_SIZE];
+	mesh_coord2d_t rowUvs[MODEL_CHUNK_SIZE][NUM_COLOR_CHANNELS];
+	for ( int y = 0; y < gridHigh; y++ )
+	{
+		for ( int x0 = 0; x0 < gridWide; x0 += MODEL_CHUNK_SIZE )
+		{
+			const int count = ( gridWide - x0 < MODEL_CHUNK_SIZE ) ? gridWide - x0 : MODEL_CHUNK_SIZE;
+			for ( int i = 0; i < count; i++ )
+			{
+				thetaX[i] = thetaMin[0] + ( thetaMax[0] - thetaMin[0] ) * ( x0 + i ) / ( gridWide - 1 );
+				thetaY[i] = thetaMin[1] + ( thetaMax[1] - thetaMin[1] ) * y / ( gridHigh - 1 );
+			}
+			DistortionModel_EvaluateBatch( &lens, thetaX, thetaY, count, rowUvs );
+			for ( int i = 0; i < count; i++ )
+			{
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					float * g = uvs + ( (size_t)( channel * gridHigh + y ) * gridWide + x0 + i ) * 2;
+					g[0] = rowUvs[i][channel].x;
+					g[1] = rowUvs[i][channel].y;
+				}
+			}
+		}
+	}
+
+	const bool ok = DistortionModel_CreateGrid( model, gridWide, gridHigh, thetaMin, thetaMax, uvs );
+	free( uvs );
+	return ok;
+}
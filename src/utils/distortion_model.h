@@ -0,0 +1,89 @@
+#ifndef _DISTORTION_MODEL_H
+#define _DISTORTION_MODEL_H
+
+#include "hmd.h"
+#include "spline.h"
+
+// Pluggable lens distortion models.
+//
+// Every model maps the tangent angles of a point on the display (from
+// GetDistortionTanAngles()) to the distorted tangent angle UVs of each color
+// channel, the same thing EvaluateDistortion() computes from hmd_info_t's
+// Catmull-Rom spline and linear chromatic aberration. BuildDistortionMeshes(),
+// GetDistortionSymmetry() and UpdateDistortionUvs() take a model in place of
+// that spline, so a lens can be described by the coefficients its vendor
+// supplies instead of a refit to hmd_info_t::K.
+//
+// Batches run on the same SIMD paths as the spline batch evaluator. Each
+// path does the scalar code's operations in the same order (no FMA), so all
+// of them give bit identical UVs.
+
+typedef enum
+{
+	DISTORTION_MODEL_CATMULL_ROM,		// hmd_info_t::K and chromaticAberration, as EvaluateDistortion()
+	DISTORTION_MODEL_BROWN_CONRADY,		// radial polynomial in r^2 plus tangential terms
+	DISTORTION_MODEL_RATIONAL,			// ratio of two polynomials in r^2
+	DISTORTION_MODEL_GRID				// bilinear lookup in a vendor table of UVs
+} distortion_model_type_t;
+
+// Polynomial coefficients per color channel, with r^2 = theta.x^2 + theta.y^2:
+//   scale = ( k[0] + k[1] r^2 + k[2] r^4 + k[3] r^6 ) / ( 1 + k[4] r^2 + k[5] r^4 + k[6] r^6 )
+//   uv.x = theta.x * scale + 2 p[0] theta.x theta.y + p[1] ( r^2 + 2 theta.x^2 )
+//   uv.y = theta.y * scale + p[0] ( r^2 + 2 theta.y^2 ) + 2 p[1] theta.x theta.y
+// k[0] is the magnification at the center (1 for a plain Brown-Conrady lens).
+// Brown-Conrady leaves k[4..6] at 0; the rational model leaves p at 0.
+#define DISTORTION_MODEL_COEFFICIENTS	7
+
+typedef struct distortion_model_s
+{
+	distortion_model_type_t		type;
+
+	// DISTORTION_MODEL_CATMULL_ROM
+	catmull_rom_spline_t		spline;
+	float						chromaticAberration[4];
+
+	// DISTORTION_MODEL_BROWN_CONRADY, DISTORTION_MODEL_RATIONAL
+	float						k[NUM_COLOR_CHANNELS][DISTORTION_MODEL_COEFFICIENTS];
+	float						p[NUM_COLOR_CHANNELS][2];
+
+	// DISTORTION_MODEL_GRID: gridWide x gridHigh samples evenly spaced over
+	// thetaMin .. thetaMax, linearly extrapolated beyond the edges
+	int							gridWide;
+	int							gridHigh;
+	float						thetaMin[2];
+	float						thetaMax[2];
+	float *						gridUvs;	// per channel, gridHigh rows of gridWide { u, v }; malloc'ed
+} distortion_model_t;
+
+bool DistortionModel_CreateCatmullRom( distortion_model_t * model, const hmd_info_t * hmdInfo );
+void DistortionModel_CreateBrownConrady( distortion_model_t * model, const float k[NUM_COLOR_CHANNELS][4], const float p[NUM_COLOR_CHANNELS][2] );
+void DistortionModel_CreateRational( distortion_model_t * model, const float k[NUM_COLOR_CHANNELS][DISTORTION_MODEL_COEFFICIENTS] );
+// Copies the table, uvs laid out as gridUvs.
+bool DistortionModel_CreateGrid( distortion_model_t * model, const int gridWide, const int gridHigh,
+								 const float thetaMin[2], const float thetaMax[2], const float * uvs );
+void DistortionModel_Destroy( distortion_model_t * model );
+
+// Stand-ins for vendor data: the polynomial models least squares fitted to,
+// and a grid sampled from, hmdInfo's Catmull-Rom lens over its field of view.
+bool DistortionModel_FitBrownConrady( distortion_model_t * model, const hmd_info_t * hmdInfo );
+bool DistortionModel_FitRational( distortion_model_t * model, const hmd_info_t * hmdInfo );
+bool DistortionModel_SampleGrid( distortion_model_t * model, const hmd_info_t * hmdInfo, const int gridWide, const int gridHigh );
+
+const char * DistortionModel_GetTypeName( const distortion_model_type_t type );
+
+// How far model is from hmdInfo's Catmull-Rom lens over the vertices of
+// hmdInfo's mesh, in pixels at uvToPixels pixels per UV: the error a fitted
+// stand-in warps with.
+void DistortionModel_MeasureError( const distortion_model_t * model, const hmd_info_t * hmdInfo, const float uvToPixels[2],
+								   float * maxError, float * meanError );
+
+// What SIMD_PATH_BEST resolves to for the model on this CPU: the widest
+// path, except SSE2 for the Catmull-Rom model, whose AVX2 spline gathers do
+// not pay for themselves in the model's short batches.
+simd_path_t DistortionModel_GetBestSimd( const distortion_model_t * model );
+
+// UVs of count points from their tangent angles.
+void DistortionModel_EvaluateBatch( const distortion_model_t * model, const float * thetaX, const float * thetaY, const int count,
+									mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const simd_path_t simd = SIMD_PATH_BEST );
+
+#endif
@@ -0,0 +1,226 @@
+#include <string.h>
+#include "fixed_mesh.h"
+#include "vertex_cache.h"
+
+// constexpr copies of the distortion math in hmd.cpp and BuildTimewarp().
+// The expressions are kept operation for operation the same as the runtime
+// ones, so the compiler folds them to the very same floats.
+
+static constexpr float FixedMaxFloat( const float x, const float y ) { return ( x > y ) ? x : y; }
+static constexpr float FixedMinFloat( const float x, const float y ) { return ( x < y ) ? x : y; }
+
+static constexpr float FixedFloorFloat( const float x )
+{
+	// Everything at or above 2^23 is integral already.
+	if ( x >= 8388608.0f || x <= -8388608.0f )
+	{
+		return x;
+	}
+	const float truncated = (float)(int)x;
+	return ( truncated > x ) ? truncated - 1.0f : truncated;
+}
+
+// EvaluateCatmullRomSpline()
+static constexpr float FixedCatmullRomSpline( const float value, const float * K, const int numKnots )
+{
+	const float scaledValue = (float)( numKnots - 1 ) * value;
+	const float scaledValueFloor = FixedMaxFloat( 0.0f, FixedMinFloat( (float)( numKnots - 1 ), FixedFloorFloat( scaledValue ) ) );
+	const float t = scaledValue - scaledValueFloor;
+	const int k = (int)scaledValueFloor;
+
+	float p0 = 0.0f;
+	float p1 = 0.0f;
+	float m0 = 0.0f;
+	float m1 = 0.0f;
+
+	if ( k == 0 )
+	{
+		p0 = K[0];
+		m0 = K[1] - K[0];
+		p1 = K[1];
+		m1 = 0.5f * ( K[2] - K[0] );
+	}
+	else if ( k < numKnots - 2 )
+	{
+		p0 = K[k];
+		m0 = 0.5f * ( K[k+1] - K[k-1] );
+		p1 = K[k+1];
+		m1 = 0.5f * ( K[k+2] - K[k] );
+	}
+	else if ( k == numKnots - 2 )
+	{
+		p0 = K[k];
+		m0 = 0.5f * ( K[k+1] - K[k-1] );
+		p1 = K[k+1];
+		m1 = K[k+1] - K[k];
+	}
+	else if ( k == numKnots - 1 )
+	{
+		p0 = K[k];
+		m0 = K[k] - K[k-1];
+		p1 = p0 + m0;
+		m1 = m0;
+	}
+
+	const float omt = 1.0f - t;
+	const float res = ( p0 * ( 1.0f + 2.0f *   t ) + m0 *   t ) * omt * omt
+					+ ( p1 * ( 1.0f + 2.0f * omt ) - m1 * omt ) *   t *   t;
+	return res;
+}
+
+// EvaluateDistortion()
+static constexpr void FixedEvaluateDistortion( const hmd_info_t & hmdInfo, const int eye, const float xf, const float yf,
+											   uv_coord_t * uv0, uv_coord_t * uv1, uv_coord_t * uv2 )
+{
+	const float horizontalShiftMeters = ( hmdInfo.lensSeparationInMeters / 2 ) - ( hmdInfo.visibleMetersWide / 4 );
+	const float horizontalShiftView = horizontalShiftMeters / ( hmdInfo.visibleMetersWide / 2 );
+
+	const float in[2] = { ( eye ? -horizontalShiftView : horizontalShiftView ) + xf, yf };
+	const float ndcToPixels[2] = { hmdInfo.visiblePixelsWide * 0.25f, hmdInfo.visiblePixelsHigh * 0.5f };
+	const float pixelsToMeters[2] = { hmdInfo.visibleMetersWide / hmdInfo.visiblePixelsWide, hmdInfo.visibleMetersHigh / hmdInfo.visiblePixelsHigh };
+
+	float theta[2] = { 0.0f, 0.0f };
+	for ( int i = 0; i < 2; i++ )
+	{
+		const float unit = in[i];
+		const float ndc = 2.0f * unit - 1.0f;
+		const float pixels = ndc * ndcToPixels[i];
+		const float meters = pixels * pixelsToMeters[i];
+		const float tanAngle = meters / hmdInfo.metersPerTanAngleAtCenter;
+		theta[i] = tanAngle;
+	}
+
+	const float rsq = theta[0] * theta[0] + theta[1] * theta[1];
+	const float scale = FixedCatmullRomSpline( rsq, hmdInfo.K, hmdInfo.numKnots );
+	const float chromaScale[NUM_COLOR_CHANNELS] =
+	{
+		scale * ( 1.0f + hmdInfo.chromaticAberration[0] + rsq * hmdInfo.chromaticAberration[1] ),
+		scale,
+		scale * ( 1.0f + hmdInfo.chromaticAberration[2] + rsq * hmdInfo.chromaticAberration[3] )
+	};
+
+	uv0->u = chromaScale[0] * theta[0];
+	uv0->v = chromaScale[0] * theta[1];
+	uv1->u = chromaScale[1] * theta[0];
+	uv1->v = chromaScale[1] * theta[1];
+	uv2->u = chromaScale[2] * theta[0];
+	uv2->v = chromaScale[2] * theta[1];
+}
+
+template< int TilesWide, int TilesHigh >
+struct fixed_mesh_tables_t
+{
+	static constexpr int numVertices = ( TilesWide + 1 ) * ( TilesHigh + 1 );
+	static constexpr int numIndices = TilesWide * TilesHigh * 6;
+
+	distortion_vertex_t	vertices[NUM_EYES * numVertices];
+	GLuint				indices[numIndices];
+};
+
+// The uniform mesh BuildTimewarp() builds for hmdInfo, whose eyeTilesWide
+// and eyeTilesHigh must be TilesWide and TilesHigh. Every vertex is
+// evaluated: the runtime path mirrors symmetric lenses from one quadrant,
+// at compile time there is no reason to.
+template< int TilesWide, int TilesHigh >
+static constexpr fixed_mesh_tables_t< TilesWide, TilesHigh > BuildFixedDistortionMesh( const hmd_info_t & hmdInfo )
+{
+	fixed_mesh_tables_t< TilesWide, TilesHigh > mesh = {};
+	const int numVertices = fixed_mesh_tables_t< TilesWide, TilesHigh >::numVertices;
+
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int y = 0; y <= TilesHigh; y++ )
+		{
+			for ( int x = 0; x <= TilesWide; x++ )
+			{
+				const int index = y * ( TilesWide + 1 ) + x;
+				distortion_vertex_t & vertex = mesh.vertices[eye * numVertices + index];
+
+				vertex.position.x = ( -1.0f + eye + ( (float)x / TilesWide ) );
+				vertex.position.y = ( -1.0f + 2.0f * ( ( TilesHigh - (float)y ) / TilesHigh ) *
+										( (float)( TilesHigh * hmdInfo.tilePixelsHigh ) / hmdInfo.displayPixelsHigh ) );
+				vertex.position.z = 0.0f;
+
+				const float xf = (float)x / (float)TilesWide;
+				const float yf = 1.0f - (float)y / (float)TilesHigh;
+				FixedEvaluateDistortion( hmdInfo, eye, xf, yf, &vertex.uv0, &vertex.uv1, &vertex.uv2 );
+			}
+		}
+	}
+
+	// The runtime grid's strip order, so the order is cache friendly without OptimizeVertexCache().
+	BuildStripGridIndices( mesh.indices, TilesWide, TilesHigh );
+	return mesh;
+}
+
+// GetDefaultHmdInfo() for a panel, with the lens calibration of our headsets.
+static constexpr hmd_info_t FixedHmdInfo( const int displayPixelsWide, const int displayPixelsHigh )
+{
+	hmd_info_t hmdInfo = {};
+	hmdInfo.displayPixelsWide = displayPixelsWide;
+	hmdInfo.displayPixelsHigh = displayPixelsHigh;
+	hmdInfo.tilePixelsWide = 32;
+	hmdInfo.tilePixelsHigh = 32;
+	hmdInfo.eyeTilesWide = displayPixelsWide / hmdInfo.tilePixelsWide / NUM_EYES;
+	hmdInfo.eyeTilesHigh = displayPixelsHigh / hmdInfo.tilePixelsHigh;
+	hmdInfo.visiblePixelsWide = hmdInfo.eyeTilesWide * hmdInfo.tilePixelsWide * NUM_EYES;
+	hmdInfo.visiblePixelsHigh = hmdInfo.eyeTilesHigh * hmdInfo.tilePixelsHigh;
+	hmdInfo.visibleMetersWide = 0.11047f * ( hmdInfo.eyeTilesWide * hmdInfo.tilePixelsWide * NUM_EYES ) / displayPixelsWide;
+	hmdInfo.visibleMetersHigh = 0.06214f * ( hmdInfo.eyeTilesHigh * hmdInfo.tilePixelsHigh ) / displayPixelsHigh;
+	hmdInfo.lensSeparationInMeters = hmdInfo.visibleMetersWide / NUM_EYES;
+	hmdInfo.metersPerTanAngleAtCenter = 0.037f;
+	hmdInfo.numKnots = 11;
+	hmdInfo.K[0] = 1.0f;
+	hmdInfo.K[1] = 1.021f;
+	hmdInfo.K[2] = 1.051f;
+	hmdInfo.K[3] = 1.086f;
+	hmdInfo.K[4] = 1.128f;
+	hmdInfo.K[5] = 1.177f;
+	hmdInfo.K[6] = 1.232f;
+	hmdInfo.K[7] = 1.295f;
+	hmdInfo.K[8] = 1.368f;
+	hmdInfo.K[9] = 1.452f;
+	hmdInfo.K[10] = 1.560f;
+	hmdInfo.chromaticAberration[0] = -0.016f;
+	hmdInfo.chromaticAberration[1] =  0.0f;
+	hmdInfo.chromaticAberration[2] =  0.024f;
+	hmdInfo.chromaticAberration[3] =  0.0f;
+	return hmdInfo;
+}
+
+static constexpr hmd_info_t HMD_2560x1440 = FixedHmdInfo( 2560, 1440 );
+static constexpr hmd_info_t HMD_1920x1080 = FixedHmdInfo( 1920, 1080 );
+
+static constexpr fixed_mesh_tables_t< HMD_2560x1440.eyeTilesWide, HMD_2560x1440.eyeTilesHigh > MESH_2560x1440 =
+	BuildFixedDistortionMesh< HMD_2560x1440.eyeTilesWide, HMD_2560x1440.eyeTilesHigh >( HMD_2560x1440 );
+static constexpr fixed_mesh_tables_t< HMD_1920x1080.eyeTilesWide, HMD_1920x1080.eyeTilesHigh > MESH_1920x1080 =
+	BuildFixedDistortionMesh< HMD_1920x1080.eyeTilesWide, HMD_1920x1080.eyeTilesHigh >( HMD_1920x1080 );
+
+static const fixed_distortion_mesh_t fixedMeshes[] =
+{
+	{ "2560x1440", &HMD_2560x1440, MESH_2560x1440.vertices, MESH_2560x1440.indices, MESH_2560x1440.numVertices, MESH_2560x1440.numIndices },
+	{ "1920x1080", &HMD_1920x1080, MESH_1920x1080.vertices, MESH_1920x1080.indices, MESH_1920x1080.numVertices, MESH_1920x1080.numIndices }
+};
+
+int GetFixedDistortionMeshCount()
+{
+	return (int)( sizeof( fixedMeshes ) / sizeof( fixedMeshes[0] ) );
+}
+
+const fixed_distortion_mesh_t * GetFixedDistortionMesh( const int index )
+{
+	return ( index >= 0 && index < GetFixedDistortionMeshCount() ) ? &fixedMeshes[index] : NULL;
+}
+
+const fixed_distortion_mesh_t * FindFixedDistortionMesh( const hmd_info_t * hmdInfo )
+{
+	// hmd_info_t is all ints and floats, no padding, so this compares every field.
+	for ( int i = 0; i < GetFixedDistortionMeshCount(); i++ )
+	{
+		if ( memcmp( fixedMeshes[i].hmdInfo, hmdInfo, sizeof( hmd_info_t ) ) == 0 )
+		{
+			return &fixedMeshes[i];
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,32 @@
+#ifndef _FIXED_MESH_H
+#define _FIXED_MESH_H
+
+#include "hmd.h"
+
+// Distortion meshes of fixed HMD profiles, generated at compile time.
+//
+// A headset with a known panel and lens calibration does not need its mesh
+// built at startup: fixed_mesh.cpp runs the same math as BuildTimewarp()
+// and BuildDistortionMeshes() as constexpr code, templated on the tile
+// counts of the profile, and the resulting vertex and index tables end up
+// in the binary's read-only data. Startup only has to find the profile and
+// upload the tables. Any other hmd_info_t (an uncalibrated device, another
+// panel, a changed lens separation) goes through the runtime path as before.
+
+typedef struct
+{
+	const char *				name;
+	const hmd_info_t *			hmdInfo;		// the profile the tables were generated for
+	const distortion_vertex_t *	vertices;		// NUM_EYES * numVertices, read-only
+	const GLuint *				indices;		// read-only
+	int							numVertices;	// per eye
+	int							numIndices;
+} fixed_distortion_mesh_t;
+
+int GetFixedDistortionMeshCount();
+const fixed_distortion_mesh_t * GetFixedDistortionMesh( const int index );
+
+// The built-in mesh for exactly this hmd_info_t, or NULL.
+const fixed_distortion_mesh_t * FindFixedDistortionMesh( const hmd_info_t * hmdInfo );
+
+#endif
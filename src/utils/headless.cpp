@@ -0,0 +1,140 @@
+// Keep eglplatform.h from dragging in Xlib, we never talk to a window system.
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <string.h>
+#include "headless.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+static EGLContext egl_context = EGL_NO_CONTEXT;
+
+static bool HasExtension( const char * extensions, const char * name )
+{
+	if ( extensions == NULL )
+	{
+		return false;
+	}
+	const size_t length = strlen( name );
+	for ( const char * p = strstr( extensions, name ); p != NULL; p = strstr( p + length, name ) )
+	{
+		if ( ( p == extensions || p[-1] == ' ' ) && ( p[length] == ' ' || p[length] == '\0' ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static EGLDisplay GetSurfacelessDisplay()
+{
+	// Prefer the Mesa surfaceless platform, it needs neither X11/Wayland nor a DRM node.
+	const char * clientExtensions = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+	if ( HasExtension( clientExtensions, "EGL_MESA_platform_surfaceless" ) )
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+		if ( eglGetPlatformDisplayEXT != NULL )
+		{
+			EGLDisplay display = eglGetPlatformDisplayEXT( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+			if ( display != EGL_NO_DISPLAY )
+			{
+				return display;
+			}
+		}
+	}
+	return eglGetDisplay( EGL_DEFAULT_DISPLAY );
+}
+
+bool initEGL( const int majorVersion, const int minorVersion )
+{
+	egl_display = GetSurfacelessDisplay();
+	if ( egl_display == EGL_NO_DISPLAY )
+	{
+		fprintf( stderr, "initEGL, no EGL display available\n" );
+		return false;
+	}
+
+	EGLint eglMajor, eglMinor;
+	if ( !eglInitialize( egl_display, &eglMajor, &eglMinor ) )
+	{
+		fprintf( stderr, "initEGL, eglInitialize failed: %x\n", eglGetError() );
+		return false;
+	}
+
+	const char * displayExtensions = eglQueryString( egl_display, EGL_EXTENSIONS );
+	if ( !HasExtension( displayExtensions, "EGL_KHR_surfaceless_context" ) )
+	{
+		fprintf( stderr, "initEGL, EGL_KHR_surfaceless_context is not supported\n" );
+		return false;
+	}
+
+	if ( !eglBindAPI( EGL_OPENGL_API ) )
+	{
+		fprintf( stderr, "initEGL, desktop OpenGL is not supported: %x\n", eglGetError() );
+		return false;
+	}
+
+	// A config is only needed if the implementation lacks EGL_KHR_no_config_context.
+	EGLConfig config = (EGLConfig) 0;
+	if ( !HasExtension( displayExtensions, "EGL_KHR_no_config_context" ) &&
+		 !HasExtension( displayExtensions, "EGL_MESA_configless_context" ) )
+	{
+		const EGLint configAttribs[] =
+		{
+			EGL_RENDERABLE_TYPE,	EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLint numConfigs = 0;
+		if ( !eglChooseConfig( egl_display, configAttribs, &config, 1, &numConfigs ) || numConfigs == 0 )
+		{
+			fprintf( stderr, "initEGL, no OpenGL capable EGL config\n" );
+			return false;
+		}
+	}
+
+	const EGLint contextAttribs[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION,			majorVersion,
+		EGL_CONTEXT_MINOR_VERSION,			minorVersion,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK,	EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	egl_context = eglCreateContext( egl_display, config, EGL_NO_CONTEXT, contextAttribs );
+	if ( egl_context == EGL_NO_CONTEXT )
+	{
+		fprintf( stderr, "initEGL, could not create an OpenGL %d.%d core context: %x\n", majorVersion, minorVersion, eglGetError() );
+		return false;
+	}
+
+	if ( !eglMakeCurrent( egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context ) )
+	{
+		fprintf( stderr, "initEGL, eglMakeCurrent failed: %x\n", eglGetError() );
+		return false;
+	}
+
+	printf( "EGL %d.%d surfaceless context created\n", eglMajor, eglMinor );
+	return true;
+}
+
+void destroyEGL()
+{
+	if ( egl_display == EGL_NO_DISPLAY )
+	{
+		return;
+	}
+	eglMakeCurrent( egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+	if ( egl_context != EGL_NO_CONTEXT )
+	{
+		eglDestroyContext( egl_display, egl_context );
+		egl_context = EGL_NO_CONTEXT;
+	}
+	eglTerminate( egl_display );
+	egl_display = EGL_NO_DISPLAY;
+}
@@ -0,0 +1,15 @@
+#ifndef _HEADLESS_H
+#define _HEADLESS_H
+
+// Surfaceless EGL backend.
+//
+// Creates an OpenGL core profile context that is not attached to any
+// window system surface (EGL_MESA_platform_surfaceless, falling back to the
+// default display with EGL_KHR_surfaceless_context). Nothing can be drawn to
+// framebuffer 0 in this mode, so the caller must render into its own FBO.
+// Works on Mesa llvmpipe, so no display and no GPU are required.
+
+bool initEGL( const int majorVersion, const int minorVersion );
+void destroyEGL();
+
+#endif
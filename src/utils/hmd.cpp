@@ -1,14 +1,20 @@
 #include <cmath>
 #include "hmd.h"
+#include "spline.h"
+#include "distortion_model.h"
+#include "thread_pool.h"
 
-const int   NUM_EYES        = 2;
-const int   NUM_COLOR_CHANNELS = 3;
+// Points per batch spline evaluation in BuildDistortionMeshes().
+static const int DISTORTION_BATCH_SIZE = 64;
+
+// Mesh rows per job of the parallel mesh build.
+static const int MESH_BAND_ROWS = 8;
 
 float MaxFloat( const float x, const float y ) { return ( x > y ) ? x : y; }
 float MinFloat( const float x, const float y ) { return ( x < y ) ? x : y; }
 
 // A Catmull-Rom spline through the values K[0], K[1], K[2] ... K[numKnots-1] evenly spaced from 0.0 to 1.0
-float EvaluateCatmullRomSpline( float value, float * K, int numKnots )
+float EvaluateCatmullRomSpline( float value, const float * K, int numKnots )
 {
 	const float scaledValue = (float)( numKnots - 1 ) * value;
 	const float scaledValueFloor = MaxFloat( 0.0f, MinFloat( (float)( numKnots - 1 ), floorf( scaledValue ) ) );
@@ -55,6 +61,400 @@ float EvaluateCatmullRomSpline( float value, float * K, int numKnots )
 	return res;
 }
 
+void GetDistortionTanAngles( const hmd_info_t * hmdInfo, const int eye, const float xf, const float yf, float theta[2] )
+{
+	const float horizontalShiftMeters = ( hmdInfo->lensSeparationInMeters / 2 ) - ( hmdInfo->visibleMetersWide / 4 );
+	const float horizontalShiftView = horizontalShiftMeters / ( hmdInfo->visibleMetersWide / 2 );
+
+	const float in[2] = { ( eye ? -horizontalShiftView : horizontalShiftView ) + xf, yf };
+	const float ndcToPixels[2] = { hmdInfo->visiblePixelsWide * 0.25f, hmdInfo->visiblePixelsHigh * 0.5f };
+	const float pixelsToMeters[2] = { hmdInfo->visibleMetersWide / hmdInfo->visiblePixelsWide, hmdInfo->visibleMetersHigh / hmdInfo->visiblePixelsHigh };
+
+	for ( int i = 0; i < 2; i++ )
+	{
+		const float unit = in[i];
+		const float ndc = 2.0f * unit - 1.0f;
+		const float pixels = ndc * ndcToPixels[i];
+		const float meters = pixels * pixelsToMeters[i];
+		const float tanAngle = meters / hmdInfo->metersPerTanAngleAtCenter;
+		theta[i] = tanAngle;
+	}
+}
+
+// Per channel UVs from the tangent angles and the spline value at rsq.
+static void DistortionChromaUvs( const hmd_info_t * hmdInfo, const float theta[2], const float rsq, const float scale,
+								 mesh_coord2d_t uv[NUM_COLOR_CHANNELS] )
+{
+	const float chromaScale[NUM_COLOR_CHANNELS] =
+	{
+		scale * ( 1.0f + hmdInfo->chromaticAberration[0] + rsq * hmdInfo->chromaticAberration[1] ),
+		scale,
+		scale * ( 1.0f + hmdInfo->chromaticAberration[2] + rsq * hmdInfo->chromaticAberration[3] )
+	};
+
+	for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+	{
+		uv[channel].x = chromaScale[channel] * theta[0];
+		uv[channel].y = chromaScale[channel] * theta[1];
+	}
+}
+
+void EvaluateDistortion( const hmd_info_t * hmdInfo, const int eye, const float xf, const float yf, mesh_coord2d_t uv[NUM_COLOR_CHANNELS] )
+{
+	float theta[2];
+	GetDistortionTanAngles( hmdInfo, eye, xf, yf, theta );
+
+	const float rsq = theta[0] * theta[0] + theta[1] * theta[1];
+	const float scale = EvaluateCatmullRomSpline( rsq, hmdInfo->K, hmdInfo->numKnots );
+	DistortionChromaUvs( hmdInfo, theta, rsq, scale, uv );
+}
+
+// EvaluateDistortion() for up to DISTORTION_BATCH_SIZE points of one eye at
+// once, with the spline done by the batch evaluator (scalar if spline is NULL),
+// or the whole lens by model if that is not NULL.
+static void EvaluateDistortionBatch( const hmd_info_t * hmdInfo, const distortion_model_t * model,
+									 const catmull_rom_spline_t * spline, const int eye,
+									 const float * xf, const float * yf, const int count,
+									 mesh_coord2d_t uv[][NUM_COLOR_CHANNELS] )
+{
+	float theta[DISTORTION_BATCH_SIZE][2];
+	float rsq[DISTORTION_BATCH_SIZE];
+	float scale[DISTORTION_BATCH_SIZE];
+
+	if ( model != NULL )
+	{
+		float thetaX[DISTORTION_BATCH_SIZE];
+		float thetaY[DISTORTION_BATCH_SIZE];
+		for ( int i = 0; i < count; i++ )
+		{
+			GetDistortionTanAngles( hmdInfo, eye, xf[i], yf[i], theta[i] );
+			thetaX[i] = theta[i][0];
+			thetaY[i] = theta[i][1];
+		}
+		DistortionModel_EvaluateBatch( model, thetaX, thetaY, count, uv );
+		return;
+	}
+
+	for ( int i = 0; i < count; i++ )
+	{
+		GetDistortionTanAngles( hmdInfo, eye, xf[i], yf[i], theta[i] );
+		rsq[i] = theta[i][0] * theta[i][0] + theta[i][1] * theta[i][1];
+	}
+
+	if ( spline != NULL )
+	{
+		CatmullRomSpline_EvaluateBatch( spline, rsq, scale, count );
+	}
+	else
+	{
+		for ( int i = 0; i < count; i++ )
+		{
+			scale[i] = EvaluateCatmullRomSpline( rsq[i], hmdInfo->K, hmdInfo->numKnots );
+		}
+	}
+
+	for ( int i = 0; i < count; i++ )
+	{
+		DistortionChromaUvs( hmdInfo, theta[i], rsq[i], scale[i], uv[i] );
+	}
+}
+
+void EvaluateDistortionPoints( const hmd_info_t * hmdInfo, const int eye, const float * xf, const float * yf, const int count,
+							   mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const distortion_model_t * model )
+{
+	catmull_rom_spline_t spline;
+	const bool batch = CatmullRomSpline_Create( &spline, hmdInfo->K, hmdInfo->numKnots );
+
+	for ( int i = 0; i < count; i += DISTORTION_BATCH_SIZE )
+	{
+		const int batchCount = ( count - i < DISTORTION_BATCH_SIZE ) ? count - i : DISTORTION_BATCH_SIZE;
+		EvaluateDistortionBatch( hmdInfo, model, batch ? &spline : NULL, eye, xf + i, yf + i, batchCount, uv + i );
+	}
+}
+
+// EvaluateDistortion(), or the model's UVs of the point.
+static void EvaluateDistortionPoint( const hmd_info_t * hmdInfo, const distortion_model_t * model, const int eye,
+									 const float xf, const float yf, mesh_coord2d_t uv[NUM_COLOR_CHANNELS] )
+{
+	EvaluateDistortionBatch( hmdInfo, model, NULL, eye, &xf, &yf, 1, (mesh_coord2d_t (*)[NUM_COLOR_CHANNELS])uv );
+}
+
+static bool MirroredDistortionMatches( const mesh_coord2d_t a[NUM_COLOR_CHANNELS], const mesh_coord2d_t b[NUM_COLOR_CHANNELS],
+									   const float signX, const float signY )
+{
+	for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+	{
+		const float dx = a[channel].x - signX * b[channel].x;
+		const float dy = a[channel].y - signY * b[channel].y;
+		if ( fabsf( dx ) > 1e-5f * ( 1.0f + fabsf( a[channel].x ) ) || fabsf( dy ) > 1e-5f * ( 1.0f + fabsf( a[channel].y ) ) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int GetDistortionSymmetry( const hmd_info_t * hmdInfo, const distortion_model_t * model )
+{
+	// The lens model is radial around the lens center, which sits on the
+	// vertical center of each eye and horizontalShiftView off its horizontal
+	// center, towards the nose for both eyes. So the eyes always mirror each
+	// other, every eye mirrors top to bottom, and it only mirrors left to
+	// right when the lens is centered on the eye.
+	const float horizontalShiftMeters = ( hmdInfo->lensSeparationInMeters / 2 ) - ( hmdInfo->visibleMetersWide / 4 );
+	const float horizontalShiftView = horizontalShiftMeters / ( hmdInfo->visibleMetersWide / 2 );
+
+	int symmetry = DISTORTION_SYMMETRY_EYES | DISTORTION_SYMMETRY_VERTICAL;
+	if ( horizontalShiftView == 0.0f )
+	{
+		symmetry |= DISTORTION_SYMMETRY_HORIZONTAL;
+	}
+
+	// Confirm at an off-axis probe point, so a non-radial term in
+	// EvaluateDistortion() or the model falls back to full evaluation instead of
+	// silently producing a wrong mirror image.
+	const float xf = 0.3f;
+	const float yf = 0.2f;
+	mesh_coord2d_t probe[NUM_COLOR_CHANNELS];
+	mesh_coord2d_t mirror[NUM_COLOR_CHANNELS];
+	EvaluateDistortionPoint( hmdInfo, model, 0, xf, yf, probe );
+	if ( symmetry & DISTORTION_SYMMETRY_EYES )
+	{
+		EvaluateDistortionPoint( hmdInfo, model, 1, 1.0f - xf, yf, mirror );
+		if ( !MirroredDistortionMatches( probe, mirror, -1.0f, 1.0f ) )
+		{
+			symmetry &= ~DISTORTION_SYMMETRY_EYES;
+		}
+	}
+	if ( symmetry & DISTORTION_SYMMETRY_VERTICAL )
+	{
+		EvaluateDistortionPoint( hmdInfo, model, 0, xf, 1.0f - yf, mirror );
+		if ( !MirroredDistortionMatches( probe, mirror, 1.0f, -1.0f ) )
+		{
+			symmetry &= ~DISTORTION_SYMMETRY_VERTICAL;
+		}
+	}
+	if ( symmetry & DISTORTION_SYMMETRY_HORIZONTAL )
+	{
+		EvaluateDistortionPoint( hmdInfo, model, 0, 1.0f - xf, yf, mirror );
+		if ( !MirroredDistortionMatches( probe, mirror, -1.0f, 1.0f ) )
+		{
+			symmetry &= ~DISTORTION_SYMMETRY_HORIZONTAL;
+		}
+	}
+	return symmetry;
+}
+
+// Run job( 0 .. count - 1 ) on the pool, or in order on this thread without one.
+static void ForEachJob( ThreadPool * pool, const int count, const std::function<void( int )> & job )
+{
+	if ( pool != NULL )
+	{
+		pool->parallelFor( count, job );
+		return;
+	}
+	for ( int i = 0; i < count; i++ )
+	{
+		job( i );
+	}
+}
+
+// Jobs covering rows 0 .. numRows - 1 in bands of MESH_BAND_ROWS.
+static int GetRowBands( const int numRows )
+{
+	return ( numRows + MESH_BAND_ROWS - 1 ) / MESH_BAND_ROWS;
+}
+
+int BuildDistortionMeshes( mesh_coord2d_t * distort_coords[NUM_EYES][NUM_COLOR_CHANNELS], const hmd_info_t * hmdInfo, const int symmetry,
+						   const distortion_model_t * model, ThreadPool * pool )
+{
+	const int tilesWide = hmdInfo->eyeTilesWide;
+	const int tilesHigh = hmdInfo->eyeTilesHigh;
+	const int stride = tilesWide + 1;
+
+	// Evaluate the canonical part only: the left eye, top half, left half.
+	const int lastEye = ( symmetry & DISTORTION_SYMMETRY_EYES ) ? 0 : NUM_EYES - 1;
+	const int lastY = ( symmetry & DISTORTION_SYMMETRY_VERTICAL ) ? tilesHigh / 2 : tilesHigh;
+	const int lastX = ( symmetry & DISTORTION_SYMMETRY_HORIZONTAL ) ? tilesWide / 2 : tilesWide;
+
+	// The spline is evaluated a row chunk at a time with the batch evaluator.
+	catmull_rom_spline_t spline;
+	const bool batch = CatmullRomSpline_Create( &spline, hmdInfo->K, hmdInfo->numKnots );
+
+	// Every point is computed by the same code whichever job gets it, so the
+	// result does not depend on the pool. Each step only reads rows an
+	// earlier step wrote.
+	const int topBands = GetRowBands( lastY + 1 );
+	ForEachJob( pool, ( lastEye + 1 ) * topBands, [&]( int job )
+	{
+		const int eye = job / topBands;
+		const int yBegin = ( job % topBands ) * MESH_BAND_ROWS;
+		const int yEnd = ( yBegin + MESH_BAND_ROWS < lastY + 1 ) ? yBegin + MESH_BAND_ROWS : lastY + 1;
+		float xfs[DISTORTION_BATCH_SIZE];
+		float yfs[DISTORTION_BATCH_SIZE];
+		mesh_coord2d_t uvs[DISTORTION_BATCH_SIZE][NUM_COLOR_CHANNELS];
+
+		for ( int y = yBegin; y < yEnd; y++ )
+		{
+			const float yf = 1.0f - (float)y / (float)tilesHigh;
+
+			for ( int x0 = 0; x0 <= lastX; x0 += DISTORTION_BATCH_SIZE )
+			{
+				const int count = ( lastX + 1 - x0 < DISTORTION_BATCH_SIZE ) ? lastX + 1 - x0 : DISTORTION_BATCH_SIZE;
+				for ( int i = 0; i < count; i++ )
+				{
+					xfs[i] = (float)( x0 + i ) / (float)tilesWide;
+					yfs[i] = yf;
+				}
+
+				EvaluateDistortionBatch( hmdInfo, model, batch ? &spline : NULL, eye, xfs, yfs, count, uvs );
+
+				for ( int i = 0; i < count; i++ )
+				{
+					const int vertNum = y * stride + x0 + i;
+					for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+					{
+						distort_coords[eye][channel][vertNum] = uvs[i][channel];
+					}
+				}
+			}
+
+			// Right half: mirror of the left half through the lens center.
+			for ( int x = lastX + 1; x <= tilesWide; x++ )
+			{
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					const mesh_coord2d_t src = distort_coords[eye][channel][y * stride + tilesWide - x];
+					distort_coords[eye][channel][y * stride + x].x = -src.x;
+					distort_coords[eye][channel][y * stride + x].y = src.y;
+				}
+			}
+		}
+	} );
+
+	// Bottom half: mirror of the top half.
+	const int bottomBands = GetRowBands( tilesHigh - lastY );
+	ForEachJob( pool, ( lastEye + 1 ) * bottomBands, [&]( int job )
+	{
+		const int eye = job / bottomBands;
+		const int yBegin = lastY + 1 + ( job % bottomBands ) * MESH_BAND_ROWS;
+		const int yEnd = ( yBegin + MESH_BAND_ROWS < tilesHigh + 1 ) ? yBegin + MESH_BAND_ROWS : tilesHigh + 1;
+		for ( int y = yBegin; y < yEnd; y++ )
+		{
+			for ( int x = 0; x <= tilesWide; x++ )
+			{
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					const mesh_coord2d_t src = distort_coords[eye][channel][( tilesHigh - y ) * stride + x];
+					distort_coords[eye][channel][y * stride + x].x = src.x;
+					distort_coords[eye][channel][y * stride + x].y = -src.y;
+				}
+			}
+		}
+	} );
+
+	// Other eye: mirror of the left eye.
+	const int eyeBands = GetRowBands( tilesHigh + 1 );
+	ForEachJob( pool, ( NUM_EYES - 1 - lastEye ) * eyeBands, [&]( int job )
+	{
+		const int eye = lastEye + 1 + job / eyeBands;
+		const int yBegin = ( job % eyeBands ) * MESH_BAND_ROWS;
+		const int yEnd = ( yBegin + MESH_BAND_ROWS < tilesHigh + 1 ) ? yBegin + MESH_BAND_ROWS : tilesHigh + 1;
+		for ( int y = yBegin; y < yEnd; y++ )
+		{
+			for ( int x = 0; x <= tilesWide; x++ )
+			{
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					const mesh_coord2d_t src = distort_coords[0][channel][y * stride + tilesWide - x];
+					distort_coords[eye][channel][y * stride + x].x = -src.x;
+					distort_coords[eye][channel][y * stride + x].y = src.y;
+				}
+			}
+		}
+	} );
+
+	return ( lastEye + 1 ) * ( lastY + 1 ) * ( lastX + 1 );
+}
+
+void BuildDistortionVertices( const hmd_info_t * hmdInfo, mesh_coord2d_t * distort_coords[NUM_EYES][NUM_COLOR_CHANNELS],
+							  distortion_vertex_t * vertices, ThreadPool * pool )
+{
+	const int tilesWide = hmdInfo->eyeTilesWide;
+	const int tilesHigh = hmdInfo->eyeTilesHigh;
+	const int numVertices = ( tilesWide + 1 ) * ( tilesHigh + 1 );
+	const int bands = GetRowBands( tilesHigh + 1 );
+
+	ForEachJob( pool, NUM_EYES * bands, [&]( int job )
+	{
+		const int eye = job / bands;
+		const int yBegin = ( job % bands ) * MESH_BAND_ROWS;
+		const int yEnd = ( yBegin + MESH_BAND_ROWS < tilesHigh + 1 ) ? yBegin + MESH_BAND_ROWS : tilesHigh + 1;
+		for ( int y = yBegin; y < yEnd; y++ )
+		{
+			for ( int x = 0; x <= tilesWide; x++ )
+			{
+				const int index = y * ( tilesWide + 1 ) + x;
+				distortion_vertex_t * vertex = &vertices[eye * numVertices + index];
+
+				// Set the physical distortion mesh coordinates. These are rectangular/gridlike, not distorted.
+				// The distortion is handled by the UVs, not the actual mesh coordinates!
+				vertex->position.x = ( -1.0f + eye + ( (float)x / tilesWide ) );
+				vertex->position.y = ( -1.0f + 2.0f * ( ( tilesHigh - (float)y ) / tilesHigh ) *
+										( (float)( tilesHigh * hmdInfo->tilePixelsHigh ) / hmdInfo->displayPixelsHigh ) );
+				vertex->position.z = 0.0f;
+
+				// Use the previously-calculated distort_coords to set the UVs on the distortion mesh
+				vertex->uv0.u = distort_coords[eye][0][index].x;
+				vertex->uv0.v = distort_coords[eye][0][index].y;
+				vertex->uv1.u = distort_coords[eye][1][index].x;
+				vertex->uv1.v = distort_coords[eye][1][index].y;
+				vertex->uv2.u = distort_coords[eye][2][index].x;
+				vertex->uv2.v = distort_coords[eye][2][index].y;
+			}
+		}
+	} );
+}
+
+void UpdateDistortionUvs( const hmd_info_t * hmdInfo, distortion_vertex_t * vertices, const int numVertices, const distortion_model_t * model )
+{
+	catmull_rom_spline_t spline;
+	const bool batch = CatmullRomSpline_Create( &spline, hmdInfo->K, hmdInfo->numKnots );
+
+	// Inverse of the vertex position mapping in BuildTimewarp().
+	const float heightScale = (float)( hmdInfo->eyeTilesHigh * hmdInfo->tilePixelsHigh ) / hmdInfo->displayPixelsHigh;
+	float xfs[DISTORTION_BATCH_SIZE];
+	float yfs[DISTORTION_BATCH_SIZE];
+	mesh_coord2d_t uvs[DISTORTION_BATCH_SIZE][NUM_COLOR_CHANNELS];
+
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		distortion_vertex_t * eyeVertices = vertices + eye * numVertices;
+		for ( int v0 = 0; v0 < numVertices; v0 += DISTORTION_BATCH_SIZE )
+		{
+			const int count = ( numVertices - v0 < DISTORTION_BATCH_SIZE ) ? numVertices - v0 : DISTORTION_BATCH_SIZE;
+			for ( int i = 0; i < count; i++ )
+			{
+				xfs[i] = eyeVertices[v0 + i].position.x + 1.0f - (float)eye;
+				yfs[i] = ( eyeVertices[v0 + i].position.y + 1.0f ) / ( 2.0f * heightScale );
+			}
+
+			EvaluateDistortionBatch( hmdInfo, model, batch ? &spline : NULL, eye, xfs, yfs, count, uvs );
+
+			for ( int i = 0; i < count; i++ )
+			{
+				distortion_vertex_t * vertex = &eyeVertices[v0 + i];
+				vertex->uv0.u = uvs[i][0].x;
+				vertex->uv0.v = uvs[i][0].y;
+				vertex->uv1.u = uvs[i][1].x;
+				vertex->uv1.v = uvs[i][1].y;
+				vertex->uv2.u = uvs[i][2].x;
+				vertex->uv2.v = uvs[i][2].y;
+			}
+		}
+	}
+}
+
 void GetDefaultHmdInfo( const int displayPixelsWide, const int displayPixelsHigh, hmd_info_t* hmd_info)
 {
 	hmd_info->displayPixelsWide = displayPixelsWide;
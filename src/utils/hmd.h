@@ -4,6 +4,8 @@
 #include <GL/glut.h>
 #include <GL/freeglut.h>
 
+const int   NUM_EYES        = 2;
+const int   NUM_COLOR_CHANNELS = 3;
 
 typedef struct
 {
@@ -25,6 +27,15 @@ typedef struct
 } uv_coord_t;
 
 
+// One interleaved distortion mesh vertex, as uploaded to the GPU.
+typedef struct
+{
+	mesh_coord3d_t	position;
+	uv_coord_t		uv0;
+	uv_coord_t		uv1;
+	uv_coord_t		uv2;
+} distortion_vertex_t;
+
 typedef struct
 {
 	int		displayPixelsWide;
@@ -54,7 +65,55 @@ int foo();
 float MaxFloat( const float x, const float y );
 float MinFloat( const float x, const float y );
 
-float EvaluateCatmullRomSpline( float value, float* K, int numKnots );
+float EvaluateCatmullRomSpline( float value, const float* K, int numKnots );
+
+// Lens model replacing the Catmull-Rom spline, see distortion_model.h. The
+// functions below that take one evaluate hmd_info_t's spline when it is NULL.
+struct distortion_model_s;
+typedef struct distortion_model_s distortion_model_t;
+
+class ThreadPool;
+
+// Tangent angles from the lens center of one point of an eye's display area, before distortion.
+void GetDistortionTanAngles( const hmd_info_t* hmdInfo, const int eye, const float xf, const float yf, float theta[2] );
+
+// Distorted tan-angle UVs of one point of an eye's display area, per color channel.
+// xf runs 0..1 left to right across the eye, yf 0..1 bottom to top.
+void EvaluateDistortion( const hmd_info_t* hmdInfo, const int eye, const float xf, const float yf, mesh_coord2d_t uv[NUM_COLOR_CHANNELS] );
+
+// EvaluateDistortion() for count points of one eye, with the batch spline evaluator.
+void EvaluateDistortionPoints( const hmd_info_t* hmdInfo, const int eye, const float* xf, const float* yf, const int count,
+							   mesh_coord2d_t uv[][NUM_COLOR_CHANNELS], const distortion_model_t * model = NULL );
+
+// Mirror symmetries of the distortion, as DISTORTION_SYMMETRY_* flags.
+#define DISTORTION_SYMMETRY_NONE		0
+#define DISTORTION_SYMMETRY_EYES		1	// right eye is the left eye mirrored left to right
+#define DISTORTION_SYMMETRY_VERTICAL	2	// each eye mirrors top to bottom
+#define DISTORTION_SYMMETRY_HORIZONTAL	4	// each eye mirrors left to right (lens centered on the eye)
+
+// Symmetries of this HMD's lenses, derived from the hmd_info_t parameters
+// and confirmed against EvaluateDistortion() at a probe point.
+int GetDistortionSymmetry( const hmd_info_t * hmdInfo, const distortion_model_t * model = NULL );
+
+// Distortion UVs of every vertex of the uniform eyeTilesWide x eyeTilesHigh grid.
+// Only the part not covered by the given symmetries (from GetDistortionSymmetry(),
+// or DISTORTION_SYMMETRY_NONE) is evaluated, the rest is mirrored from it.
+// Returns the number of points evaluated.
+// With a pool the eyes and bands of rows are built in parallel, with the
+// same result bit for bit.
+int BuildDistortionMeshes( mesh_coord2d_t * distort_coords[NUM_EYES][NUM_COLOR_CHANNELS], const hmd_info_t * hmdInfo, const int symmetry,
+						   const distortion_model_t * model = NULL, ThreadPool * pool = NULL );
+// The interleaved vertices of both eyes of the uniform grid, back to back:
+// the grid positions of BuildTimewarp() and the UVs of BuildDistortionMeshes().
+void BuildDistortionVertices( const hmd_info_t * hmdInfo, mesh_coord2d_t * distort_coords[NUM_EYES][NUM_COLOR_CHANNELS],
+							  distortion_vertex_t * vertices, ThreadPool * pool = NULL );
+// Recompute only the UVs of an already built mesh (NUM_EYES * numVertices
+// vertices, uniform or adaptive) for new lens parameters, such as a new
+// lensSeparationInMeters after an IPD change. Positions, and so the indices,
+// are left alone; each vertex's point on the eye is recovered from its position.
+void UpdateDistortionUvs( const hmd_info_t * hmdInfo, distortion_vertex_t * vertices, const int numVertices,
+						  const distortion_model_t * model = NULL );
+
 void GetDefaultHmdInfo( const int displayPixelsWide, const int displayPixelsHigh, hmd_info_t* hmd_info);
 void GetDefaultBodyInfo(body_info_t* body_info);
 
@@ -0,0 +1,172 @@
+#include <math.h>
+#include <string.h>
+#include "inverse_distortion.h"
+
+// How far beyond the field of view the seed table reaches, as a factor on its radius.
+static const float SEED_RADIUS_MARGIN = 1.5f;
+
+// Radius samples of the monotonicity check.
+static const int MONOTONIC_SAMPLES = 1024;
+
+// Bisection steps per seed table entry.
+static const int SEED_BISECTIONS = 40;
+
+// |uv| = r * scale( r^2 ) of the channel, and its derivative with respect to r.
+static float DistortedRadius( const inverse_distortion_t * inverse, const float r, float * derivative )
+{
+	const float rsq = r * r;
+	float scale;
+	float dScale;
+	CatmullRomSpline_EvaluateDerivative( &inverse->spline, rsq, &scale, &dScale );
+	const float chroma = inverse->chroma[0] + rsq * inverse->chroma[1];
+	if ( derivative != NULL )
+	{
+		*derivative = scale * chroma + 2.0f * rsq * ( dScale * chroma + scale * inverse->chroma[1] );
+	}
+	return r * scale * chroma;
+}
+
+bool InverseDistortion_Create( inverse_distortion_t * inverse, const hmd_info_t * hmdInfo, const int channel, const int iterations )
+{
+	memset( inverse, 0, sizeof( inverse_distortion_t ) );
+	if ( !CatmullRomSpline_Create( &inverse->spline, hmdInfo->K, hmdInfo->numKnots ) )
+	{
+		return false;
+	}
+	// As DistortionChromaUvs().
+	inverse->chroma[0] = 1.0f;
+	if ( channel == 0 )
+	{
+		inverse->chroma[0] = 1.0f + hmdInfo->chromaticAberration[0];
+		inverse->chroma[1] = hmdInfo->chromaticAberration[1];
+	}
+	else if ( channel == 2 )
+	{
+		inverse->chroma[0] = 1.0f + hmdInfo->chromaticAberration[2];
+		inverse->chroma[1] = hmdInfo->chromaticAberration[3];
+	}
+	inverse->iterations = iterations;
+
+	// The largest radius on the display is at an eye corner.
+	float maxRadius = 0.0f;
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		for ( int corner = 0; corner < 4; corner++ )
+		{
+			float theta[2];
+			GetDistortionTanAngles( hmdInfo, eye, (float)( corner & 1 ), (float)( corner >> 1 ), theta );
+			maxRadius = MaxFloat( maxRadius, sqrtf( theta[0] * theta[0] + theta[1] * theta[1] ) );
+		}
+	}
+	maxRadius *= SEED_RADIUS_MARGIN;
+
+	// Newton's method and the bisection below need |uv| to grow with r.
+	float previous = 0.0f;
+	for ( int i = 1; i <= MONOTONIC_SAMPLES; i++ )
+	{
+		const float rho = DistortedRadius( inverse, maxRadius * i / MONOTONIC_SAMPLES, NULL );
+		if ( !( rho > previous ) )
+		{
+			return false;
+		}
+		previous = rho;
+	}
+
+	const float maxRho = previous;
+	inverse->rhoToSeed = INVERSE_DISTORTION_SEED_SIZE / maxRho;
+	for ( int i = 0; i <= INVERSE_DISTORTION_SEED_SIZE; i++ )
+	{
+		const float rho = maxRho * i / INVERSE_DISTORTION_SEED_SIZE;
+		float low = 0.0f;
+		float high = maxRadius;
+		for ( int step = 0; step < SEED_BISECTIONS; step++ )
+		{
+			const float mid = 0.5f * ( low + high );
+			if ( DistortedRadius( inverse, mid, NULL ) < rho )
+			{
+				low = mid;
+			}
+			else
+			{
+				high = mid;
+			}
+		}
+		inverse->seedR[i] = 0.5f * ( low + high );
+	}
+	return true;
+}
+
+void InverseDistortion_SolveBatch( const inverse_distortion_t * inverse, const float * u, const float * v, const int count,
+								   float * thetaX, float * thetaY )
+{
+	const float maxIndex = (float)( INVERSE_DISTORTION_SEED_SIZE - 1 );
+	const float centerScale = 1.0f / ( inverse->spline.p0[0] * inverse->chroma[0] );
+	for ( int i = 0; i < count; i++ )
+	{
+		const float rho = sqrtf( u[i] * u[i] + v[i] * v[i] );
+
+		// Seed from the table, extrapolating its last segment past the end.
+		const float g = rho * inverse->rhoToSeed;
+		const int k = (int)MinFloat( g, maxIndex );
+		const float f = g - (float)k;
+		float r = inverse->seedR[k] + f * ( inverse->seedR[k + 1] - inverse->seedR[k] );
+
+		for ( int iteration = 0; iteration < inverse->iterations; iteration++ )
+		{
+			float derivative;
+			const float error = DistortedRadius( inverse, r, &derivative ) - rho;
+			r -= error / derivative;
+		}
+
+		// At the center the ratio r / |uv| is 1 / scale( 0 ).
+		const float factor = ( rho > 0.0f ) ? r / rho : centerScale;
+		thetaX[i] = u[i] * factor;
+		thetaY[i] = v[i] * factor;
+	}
+}
+
+// Points per InverseDistortion_SolveBatch() call.
+static const int DISPLAY_CHUNK_SIZE = 64;
+
+int InverseDistortion_MapToDisplay( const inverse_distortion_t * inverse, const hmd_info_t * hmdInfo, const int eye,
+									const float * u, const float * v, const int count,
+									float pixels[][2], unsigned char * visible )
+{
+	// Inverse of GetDistortionTanAngles().
+	const float horizontalShiftMeters = ( hmdInfo->lensSeparationInMeters / 2 ) - ( hmdInfo->visibleMetersWide / 4 );
+	const float horizontalShiftView = horizontalShiftMeters / ( hmdInfo->visibleMetersWide / 2 );
+	const float shift = eye ? -horizontalShiftView : horizontalShiftView;
+	const float tanAngleToNdc[2] =
+	{
+		hmdInfo->metersPerTanAngleAtCenter / ( hmdInfo->visiblePixelsWide * 0.25f * ( hmdInfo->visibleMetersWide / hmdInfo->visiblePixelsWide ) ),
+		hmdInfo->metersPerTanAngleAtCenter / ( hmdInfo->visiblePixelsHigh * 0.5f * ( hmdInfo->visibleMetersHigh / hmdInfo->visiblePixelsHigh ) )
+	};
+
+	// Inverse of the vertex positions of BuildTimewarp().
+	const float eyePixelsWide = (float)hmdInfo->displayPixelsWide / NUM_EYES;
+	const float meshPixelsHigh = (float)( hmdInfo->eyeTilesHigh * hmdInfo->tilePixelsHigh );
+
+	int numVisible = 0;
+	float thetaX[DISPLAY_CHUNK_SIZE];
+	float thetaY[DISPLAY_CHUNK_SIZE];
+	for ( int i0 = 0; i0 < count; i0 += DISPLAY_CHUNK_SIZE )
+	{
+		const int chunk = ( count - i0 < DISPLAY_CHUNK_SIZE ) ? count - i0 : DISPLAY_CHUNK_SIZE;
+		InverseDistortion_SolveBatch( inverse, u + i0, v + i0, chunk, thetaX, thetaY );
+		for ( int i = 0; i < chunk; i++ )
+		{
+			const float xf = 0.5f * ( thetaX[i] * tanAngleToNdc[0] + 1.0f ) - shift;
+			const float yf = 0.5f * ( thetaY[i] * tanAngleToNdc[1] + 1.0f );
+			pixels[i0 + i][0] = ( (float)eye + xf ) * eyePixelsWide;
+			pixels[i0 + i][1] = yf * meshPixelsHigh;
+
+			const bool inside = ( xf >= 0.0f && xf <= 1.0f && yf >= 0.0f && yf <= 1.0f );
+			numVisible += inside ? 1 : 0;
+			if ( visible != NULL )
+			{
+				visible[i0 + i] = inside ? 1 : 0;
+			}
+		}
+	}
+	return numVisible;
+}
@@ -0,0 +1,51 @@
+#ifndef _INVERSE_DISTORTION_H
+#define _INVERSE_DISTORTION_H
+
+#include "hmd.h"
+#include "spline.h"
+
+// Inverse of the lens distortion: eye buffer tangent angles to display pixels.
+//
+// BuildDistortionMeshes() maps a point on the display to the distorted
+// tangent angle UVs of the eye buffer it shows, uv = theta * scale( |theta|^2 ),
+// with a radial scale from the Catmull-Rom spline and the channel's chromatic
+// aberration. Since the scale is radial, inverting it is a 1D problem in the
+// radius: find r with r * scale( r^2 ) = |uv|, then theta = uv * r / |uv|,
+// and undo the affine display to tangent angle mapping of
+// GetDistortionTanAngles(). The radius is seeded by linear interpolation in a
+// small table of the inverse and refined by Newton iterations with the
+// spline's analytic derivative. That is what placing a cursor or UI element
+// at an eye buffer direction, or testing whether a direction is visible on
+// the display at all, needs per frame, without warping an image.
+
+#define INVERSE_DISTORTION_SEED_SIZE		64
+#define INVERSE_DISTORTION_ITERATIONS		1		// converged to float precision over the field of view
+
+typedef struct
+{
+	catmull_rom_spline_t	spline;
+	float					chroma[2];			// the channel's scale factor is chroma[0] + r^2 * chroma[1]
+	int						iterations;
+	float					rhoToSeed;			// |uv| to seed table index
+	float					seedR[INVERSE_DISTORTION_SEED_SIZE + 1];	// r at evenly spaced |uv|
+} inverse_distortion_t;
+
+// Set up the inverse of one color channel of hmdInfo's lens (1 = green, the
+// plain spline). Fails if the spline has too many knots or does not
+// increase |uv| monotonically with the radius.
+bool InverseDistortion_Create( inverse_distortion_t * inverse, const hmd_info_t * hmdInfo, const int channel,
+							   const int iterations = INVERSE_DISTORTION_ITERATIONS );
+
+// Undistorted tangent angles of count distorted tangent angle UVs.
+void InverseDistortion_SolveBatch( const inverse_distortion_t * inverse, const float * u, const float * v, const int count,
+								   float * thetaX, float * thetaY );
+
+// Display pixels (GL window coordinates, origin at the bottom left) that show
+// count eye buffer tangent angle UVs (the mesh's UVs, before the timewarp
+// transform) of one eye. visible (may be NULL) is set to whether each one
+// falls on that eye's part of the display. Returns the number visible.
+int InverseDistortion_MapToDisplay( const inverse_distortion_t * inverse, const hmd_info_t * hmdInfo, const int eye,
+									const float * u, const float * v, const int count,
+									float pixels[][2], unsigned char * visible );
+
+#endif
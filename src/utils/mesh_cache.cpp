@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mesh_cache.h"
+
+static const char MESH_CACHE_MAGIC[4] = { 'T', 'W', 'M', 'C' };
+
+typedef struct
+{
+	char		magic[4];
+	uint32_t	version;
+	uint64_t	key;
+	uint32_t	vertexSize;			// sizeof( distortion_vertex_t )
+	uint32_t	indexSize;			// sizeof( GLuint )
+	uint32_t	numVertices;		// per eye
+	uint32_t	numIndices;
+	uint64_t	vertexOffset;
+	uint64_t	indexOffset;
+} mesh_cache_header_t;
+
+// FNV-1a, 64 bit.
+static uint64_t HashBytes( uint64_t hash, const void * data, const size_t size )
+{
+	const unsigned char * bytes = (const unsigned char *) data;
+	for ( size_t i = 0; i < size; i++ )
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+#define HASH_FIELD( hash, field )	hash = HashBytes( hash, &( field ), sizeof( field ) )
+
+uint64_t HashHmdInfo( const hmd_info_t * hmdInfo )
+{
+	// Field by field, so struct padding can never leak into the key.
+	uint64_t hash = 14695981039346656037ULL;
+	HASH_FIELD( hash, hmdInfo->displayPixelsWide );
+	HASH_FIELD( hash, hmdInfo->displayPixelsHigh );
+	HASH_FIELD( hash, hmdInfo->tilePixelsWide );
+	HASH_FIELD( hash, hmdInfo->tilePixelsHigh );
+	HASH_FIELD( hash, hmdInfo->eyeTilesWide );
+	HASH_FIELD( hash, hmdInfo->eyeTilesHigh );
+	HASH_FIELD( hash, hmdInfo->visiblePixelsWide );
+	HASH_FIELD( hash, hmdInfo->visiblePixelsHigh );
+	HASH_FIELD( hash, hmdInfo->visibleMetersWide );
+	HASH_FIELD( hash, hmdInfo->visibleMetersHigh );
+	HASH_FIELD( hash, hmdInfo->lensSeparationInMeters );
+	HASH_FIELD( hash, hmdInfo->metersPerTanAngleAtCenter );
+	HASH_FIELD( hash, hmdInfo->numKnots );
+	for ( int i = 0; i < hmdInfo->numKnots && i < 11; i++ )
+	{
+		HASH_FIELD( hash, hmdInfo->K[i] );
+	}
+	for ( int i = 0; i < 4; i++ )
+	{
+		HASH_FIELD( hash, hmdInfo->chromaticAberration[i] );
+	}
+	return hash;
+}
+
+uint64_t MeshCache_GetKey( const hmd_info_t * hmdInfo, const void * buildParams, const size_t buildParamsSize )
+{
+	const uint64_t hash = HashHmdInfo( hmdInfo );
+	return ( buildParams != NULL ) ? HashBytes( hash, buildParams, buildParamsSize ) : hash;
+}
+
+void MeshCache_GetPath( char * path, const size_t pathSize, const char * directory, const uint64_t key )
+{
+	snprintf( path, pathSize, "%s/distortion_%016llx.twmesh", directory, (unsigned long long) key );
+}
+
+bool MeshCache_Load( mesh_cache_t * cache, const char * path, const uint64_t key )
+{
+	memset( cache, 0, sizeof( mesh_cache_t ) );
+
+	const int fd = open( path, O_RDONLY );
+	if ( fd < 0 )
+	{
+		return false;
+	}
+
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof( mesh_cache_header_t ) )
+	{
+		close( fd );
+		return false;
+	}
+
+	// Private writable mapping: callers may patch the mesh in place
+	// (copy-on-write), the file itself is never modified.
+	const size_t size = (size_t)st.st_size;
+	void * mapping = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( mapping == MAP_FAILED )
+	{
+		return false;
+	}
+
+	const mesh_cache_header_t * header = (const mesh_cache_header_t *) mapping;
+	const uint64_t vertexBytes = (uint64_t)NUM_EYES * header->numVertices * sizeof( distortion_vertex_t );
+	const uint64_t indexBytes = (uint64_t)header->numIndices * sizeof( GLuint );
+	if ( memcmp( header->magic, MESH_CACHE_MAGIC, sizeof( MESH_CACHE_MAGIC ) ) != 0 ||
+		 header->version != MESH_CACHE_VERSION ||
+		 header->key != key ||
+		 header->vertexSize != sizeof( distortion_vertex_t ) ||
+		 header->indexSize != sizeof( GLuint ) ||
+		 header->vertexOffset < sizeof( mesh_cache_header_t ) ||
+		 header->vertexOffset + vertexBytes > size ||
+		 header->indexOffset + indexBytes > size )
+	{
+		fprintf( stderr, "Ignoring stale or invalid mesh cache %s\n", path );
+		munmap( mapping, size );
+		return false;
+	}
+
+	cache->mapping = mapping;
+	cache->mappingSize = size;
+	cache->vertices = (distortion_vertex_t *)( (char *)mapping + header->vertexOffset );
+	cache->indices = (GLuint *)( (char *)mapping + header->indexOffset );
+	cache->numVertices = (int)header->numVertices;
+	cache->numIndices = (int)header->numIndices;
+	return true;
+}
+
+void MeshCache_Unload( mesh_cache_t * cache )
+{
+	if ( cache->mapping != NULL )
+	{
+		munmap( cache->mapping, cache->mappingSize );
+	}
+	memset( cache, 0, sizeof( mesh_cache_t ) );
+}
+
+bool MeshCache_Store( const char * path, const uint64_t key,
+					  const distortion_vertex_t * vertices, const int numVertices,
+					  const GLuint * indices, const int numIndices )
+{
+	mesh_cache_header_t header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, MESH_CACHE_MAGIC, sizeof( MESH_CACHE_MAGIC ) );
+	header.version = MESH_CACHE_VERSION;
+	header.key = key;
+	header.vertexSize = sizeof( distortion_vertex_t );
+	header.indexSize = sizeof( GLuint );
+	header.numVertices = numVertices;
+	header.numIndices = numIndices;
+	header.vertexOffset = sizeof( mesh_cache_header_t );
+	header.indexOffset = header.vertexOffset + (uint64_t)NUM_EYES * numVertices * sizeof( distortion_vertex_t );
+
+	char tempPath[1024];
+	snprintf( tempPath, sizeof( tempPath ), "%s.%d.tmp", path, (int)getpid() );
+
+	FILE * fp = fopen( tempPath, "wb" );
+	if ( fp == NULL )
+	{
+		fprintf( stderr, "Could not write mesh cache %s\n", tempPath );
+		return false;
+	}
+	bool ok = fwrite( &header, sizeof( header ), 1, fp ) == 1;
+	ok = ok && fwrite( vertices, sizeof( distortion_vertex_t ), (size_t)NUM_EYES * numVertices, fp ) == (size_t)NUM_EYES * numVertices;
+	ok = ok && fwrite( indices, sizeof( GLuint ), numIndices, fp ) == (size_t)numIndices;
+	ok = ( fclose( fp ) == 0 ) && ok;
+
+	if ( !ok || rename( tempPath, path ) != 0 )
+	{
+		fprintf( stderr, "Could not write mesh cache %s\n", path );
+		unlink( tempPath );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,49 @@
+#ifndef _MESH_CACHE_H
+#define _MESH_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hmd.h"
+
+// Persistent on-disk cache of the ready-to-upload distortion mesh.
+//
+// One file per HMD profile, named after a hash of every hmd_info_t field plus
+// the options the mesh was built with (buildParams, NULL for the uniform grid).
+// The file is a small header followed by the interleaved vertices of both
+// eyes and the index buffer, exactly as BuildTimewarp() produces them, so
+// a hit is a single mmap() and the mapped pointers go straight into
+// glBufferData(). Bump MESH_CACHE_VERSION whenever the vertex layout, the
+// index layout or the math in BuildTimewarp() changes.
+
+#define MESH_CACHE_VERSION		4
+
+typedef struct
+{
+	void *						mapping;		// NULL if nothing is loaded
+	size_t						mappingSize;
+	distortion_vertex_t *		vertices;		// NUM_EYES * numVertices, copy-on-write
+	GLuint *					indices;
+	int							numVertices;	// per eye
+	int							numIndices;
+} mesh_cache_t;
+
+uint64_t HashHmdInfo( const hmd_info_t * hmdInfo );
+
+// Cache key of a mesh built from hmdInfo with the given build options.
+uint64_t MeshCache_GetKey( const hmd_info_t * hmdInfo, const void * buildParams, const size_t buildParamsSize );
+
+// Path of the cache file for this key inside directory.
+void MeshCache_GetPath( char * path, const size_t pathSize, const char * directory, const uint64_t key );
+
+// Map a cache file. Fails (without printing) when it does not exist, and
+// rejects files with the wrong version, key or size.
+bool MeshCache_Load( mesh_cache_t * cache, const char * path, const uint64_t key );
+void MeshCache_Unload( mesh_cache_t * cache );
+
+// Write a cache file, via a temporary file and rename() so a crash
+// mid-write never leaves a truncated cache behind.
+bool MeshCache_Store( const char * path, const uint64_t key,
+					  const distortion_vertex_t * vertices, const int numVertices,
+					  const GLuint * indices, const int numIndices );
+
+#endif
@@ -0,0 +1,243 @@
+#include "pose_handoff.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+double PoseHandoff_GetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LatencyStats::LatencyStats()
+{
+	reset();
+}
+
+void LatencyStats::reset()
+{
+	count = 0;
+	sum = 0.0;
+	sumSquares = 0.0;
+	maximum = 0.0;
+	memset(buckets, 0, sizeof(buckets));
+}
+
+void LatencyStats::add(double seconds)
+{
+	count++;
+	sum += seconds;
+	sumSquares += seconds * seconds;
+	if (seconds > maximum)
+		maximum = seconds;
+
+	// Octave e holds [ 2^(e-1), 2^e ) nanoseconds, split evenly in BUCKETS_PER_OCTAVE.
+	int bucket = 0;
+	const double nanoseconds = seconds * 1e9;
+	if (nanoseconds >= 1.0) {
+		int exponent;
+		const double mantissa = frexp(nanoseconds, &exponent);
+		bucket = exponent * BUCKETS_PER_OCTAVE + (int)((mantissa - 0.5) * 2.0 * BUCKETS_PER_OCTAVE);
+		if (bucket >= NUM_BUCKETS)
+			bucket = NUM_BUCKETS - 1;
+	}
+	buckets[bucket]++;
+}
+
+double LatencyStats::getMean() const
+{
+	return (count > 0) ? sum / count : 0.0;
+}
+
+double LatencyStats::getStdDev() const
+{
+	if (count < 2)
+		return 0.0;
+	const double mean = sum / count;
+	const double variance = sumSquares / count - mean * mean;
+	return (variance > 0.0) ? sqrt(variance) : 0.0;
+}
+
+double LatencyStats::getPercentile(double percent) const
+{
+	if (count == 0)
+		return 0.0;
+
+	// The upper end of the bucket the percentile falls in.
+	const double rank = percent * 0.01 * count;
+	int below = 0;
+	for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+		below += buckets[bucket];
+		if (below >= rank && below > 0) {
+			const int exponent = bucket / BUCKETS_PER_OCTAVE;
+			const int step = bucket % BUCKETS_PER_OCTAVE;
+			const double upper = (bucket == 0) ? 1e-9 : ldexp(0.5 + 0.5 * (step + 1) / BUCKETS_PER_OCTAVE, exponent) * 1e-9;
+			return (upper < maximum) ? upper : maximum;
+		}
+	}
+	return maximum;
+}
+
+void LatencyStats::print(const char* name) const
+{
+	printf("  %-26s %8d  mean %9.3f  sd %9.3f  p50 %9.3f  p99 %9.3f  p99.9 %9.3f  max %9.3f us\n",
+		   name, count, getMean() * 1e6, getStdDev() * 1e6, getPercentile(50.0) * 1e6,
+		   getPercentile(99.0) * 1e6, getPercentile(99.9) * 1e6, getMax() * 1e6);
+}
+
+PoseRing::PoseRing()
+	: head(0), tail(0)
+{
+}
+
+bool PoseRing::push(const pose_sample_t& sample)
+{
+	const uint32_t h = head.load(std::memory_order_relaxed);
+	if (h - tail.load(std::memory_order_acquire) >= POSE_HANDOFF_RING_SIZE)
+		return false;
+	samples[h & (POSE_HANDOFF_RING_SIZE - 1)] = sample;
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+bool PoseRing::pop(pose_sample_t* sample)
+{
+	const uint32_t t = tail.load(std::memory_order_relaxed);
+	if (t == head.load(std::memory_order_acquire))
+		return false;
+	*sample = samples[t & (POSE_HANDOFF_RING_SIZE - 1)];
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+PoseSlot::PoseSlot()
+	: published(0)
+{
+	for (int c = 0; c < 2; c++) {
+		copies[c].version.store(0, std::memory_order_relaxed);
+		for (int i = 0; i < NUM_WORDS; i++)
+			copies[c].words[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void PoseSlot::store(const pose_sample_t& sample)
+{
+	uint64_t words[NUM_WORDS] = { 0 };
+	memcpy(words, &sample, sizeof(sample));
+
+	// Write the copy that does not hold the newest sample, then publish it.
+	const uint32_t n = published.load(std::memory_order_relaxed) + 1;
+	Copy& copy = copies[n & 1];
+	const uint32_t version = copy.version.load(std::memory_order_relaxed);
+	copy.version.store(version + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (int i = 0; i < NUM_WORDS; i++)
+		copy.words[i].store(words[i], std::memory_order_relaxed);
+	copy.version.store(version + 2, std::memory_order_release);
+	published.store(n, std::memory_order_release);
+}
+
+bool PoseSlot::load(pose_sample_t* sample, int* retries) const
+{
+	int changed = 0;
+	for (;;) {
+		const uint32_t n = published.load(std::memory_order_acquire);
+		if (n == 0)
+			break;
+
+		// That copy is only written again two stores later, so this
+		// only retries when the writer lapped the read.
+		const Copy& copy = copies[n & 1];
+		const uint32_t before = copy.version.load(std::memory_order_acquire);
+		if ((before & 1) == 0) {
+			uint64_t words[NUM_WORDS];
+			for (int i = 0; i < NUM_WORDS; i++)
+				words[i] = copy.words[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (copy.version.load(std::memory_order_relaxed) == before) {
+				memcpy(sample, words, sizeof(*sample));
+				if (retries != NULL)
+					*retries = changed;
+				return true;
+			}
+		}
+		changed++;
+	}
+	if (retries != NULL)
+		*retries = changed;
+	return false;
+}
+
+PoseHandoff::PoseHandoff()
+	: dropCount(0)
+{
+}
+
+void PoseHandoff::publish(const pose_sample_t& sample)
+{
+	const double begin = PoseHandoff_GetTime();
+	if (!ring.push(sample))
+		dropCount.fetch_add(1, std::memory_order_relaxed);
+	latest.store(sample);
+	publishStats.add(PoseHandoff_GetTime() - begin);
+}
+
+SensorThread::SensorThread()
+	: quit(false), handoff(NULL), period(0.0)
+{
+}
+
+SensorThread::~SensorThread()
+{
+	stop();
+}
+
+void SensorThread::start(PoseHandoff* handoff, double period, const SampleFunction& sample)
+{
+	stop();
+	this->handoff = handoff;
+	this->period = period;
+	this->sample = sample;
+	intervalStats.reset();
+	quit.store(false);
+	thread = std::thread(&SensorThread::run, this);
+}
+
+void SensorThread::stop()
+{
+	if (!thread.joinable())
+		return;
+	quit.store(true);
+	thread.join();
+}
+
+void SensorThread::run()
+{
+	typedef std::chrono::steady_clock clock;
+	const clock::duration step = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(period));
+
+	clock::time_point next = clock::now();
+	double last = 0.0;
+	bool first = true;
+	while (!quit.load(std::memory_order_relaxed)) {
+		std::this_thread::sleep_until(next);
+
+		const double now = PoseHandoff_GetTime();
+		if (!first)
+			intervalStats.add(now - last);
+		last = now;
+		first = false;
+
+		pose_sample_t s;
+		sample(&s);
+		handoff->publish(s);
+
+		// Keep to the schedule, but after a stall carry on from now
+		// instead of delivering the missed samples in a burst.
+		next += step;
+		const clock::time_point current = clock::now();
+		if (current > next + step)
+			next = current;
+	}
+}
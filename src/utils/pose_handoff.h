@@ -0,0 +1,154 @@
+#ifndef _POSE_HANDOFF_H
+#define _POSE_HANDOFF_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include "pose_predictor.h"
+
+// Lock-free handoff of head tracker samples from a sensor thread to the warp.
+//
+// The sensor thread publishes every timestamped sample twice: into a single
+// producer, single consumer ring, so the warp thread can feed the predictor
+// the whole gyro history since its last frame, and into a seqlock slot that
+// always holds the newest sample, so the warp still gets the freshest pose
+// when it fell behind and the ring dropped samples. Neither side ever takes
+// a lock or waits for the other. The slot keeps two copies and a reader takes
+// the last complete one, so even a writer preempted in the middle of a store
+// does not hold the warp up.
+
+#define POSE_HANDOFF_RING_SIZE		256		// samples, a power of two: 256 ms at 1 kHz
+
+// Seconds on a monotonic clock, for timing the handoff.
+double PoseHandoff_GetTime();
+
+// Distribution of a latency, in seconds, with about 2% resolution for the
+// percentiles. Not thread safe: each thread keeps its own.
+class LatencyStats
+{
+public:
+	LatencyStats();
+
+	void   reset();
+	void   add(double seconds);
+
+	int    getCount() const { return count; }
+	double getMean() const;
+	double getStdDev() const;
+	double getMax() const { return maximum; }
+	double getPercentile(double percent) const;
+
+	// One line of microseconds: count, mean, standard deviation, p50, p99, p99.9 and max.
+	void   print(const char* name) const;
+
+private:
+	enum { BUCKETS_PER_OCTAVE = 32, NUM_OCTAVES = 40, NUM_BUCKETS = BUCKETS_PER_OCTAVE * NUM_OCTAVES };
+
+	int    count;
+	double sum;
+	double sumSquares;
+	double maximum;
+	int    buckets[NUM_BUCKETS];                // by nanoseconds, log-linear
+};
+
+// Single producer, single consumer ring of samples. The indices live on
+// cache lines of their own, so the two threads only share a line when the
+// ring is nearly empty.
+class PoseRing
+{
+public:
+	PoseRing();
+
+	bool push(const pose_sample_t& sample);     // writer only, fails when the ring is full
+	bool pop(pose_sample_t* sample);            // reader only, fails when the ring is empty
+
+private:
+	std::atomic<uint32_t> head;                 // next slot the writer fills
+	char                  headPadding[64 - sizeof(std::atomic<uint32_t>)];
+	std::atomic<uint32_t> tail;                 // next slot the reader takes
+	char                  tailPadding[64 - sizeof(std::atomic<uint32_t>)];
+	pose_sample_t         samples[POSE_HANDOFF_RING_SIZE];
+};
+
+// Seqlock slot with the newest sample.
+class PoseSlot
+{
+public:
+	PoseSlot();
+
+	void store(const pose_sample_t& sample);    // writer only
+	// Reader, never waits on the writer. Fails before the first store.
+	// retries (may be NULL) is how often a copy changed under the read.
+	bool load(pose_sample_t* sample, int* retries = NULL) const;
+
+private:
+	enum { NUM_WORDS = ( sizeof(pose_sample_t) + sizeof(uint64_t) - 1 ) / sizeof(uint64_t) };
+
+	// The words are atomics, so a torn read is just a retry and not a data race.
+	struct Copy
+	{
+		std::atomic<uint32_t> version;          // odd while a store is in progress
+		std::atomic<uint64_t> words[NUM_WORDS];
+	};
+
+	std::atomic<uint32_t> published;            // number of complete stores, the newest is in copies[published & 1]
+	Copy                  copies[2];
+};
+
+// The two ends of the handoff. publish() is for the sensor thread and times
+// itself; the rest is for the warp thread.
+class PoseHandoff
+{
+public:
+	PoseHandoff();
+
+	void publish(const pose_sample_t& sample);
+
+	bool popSample(pose_sample_t* sample) { return ring.pop(sample); }
+	bool readLatest(pose_sample_t* sample, int* retries = NULL) const { return latest.load(sample, retries); }
+	int  getDropCount() const { return dropCount.load(std::memory_order_relaxed); }
+
+	// Writer side, only read it once the writer stopped.
+	const LatencyStats& getPublishStats() const { return publishStats; }
+
+private:
+	PoseRing          ring;
+	PoseSlot          latest;
+	std::atomic<int>  dropCount;                // samples the full ring had no room for
+	LatencyStats      publishStats;
+};
+
+// A thread that calls a sample function at a fixed rate, the way an IMU
+// delivers samples, and publishes the results into a handoff.
+class SensorThread
+{
+public:
+	typedef std::function<void(pose_sample_t*)> SampleFunction;
+
+	SensorThread();
+	~SensorThread();
+
+	void start(PoseHandoff* handoff, double period, const SampleFunction& sample);
+	void stop();
+	bool isRunning() const { return thread.joinable(); }
+
+	// Time between consecutive samples (its standard deviation is the
+	// jitter), only read it once the thread stopped.
+	const LatencyStats& getIntervalStats() const { return intervalStats; }
+
+private:
+	SensorThread(const SensorThread&);
+	SensorThread& operator=(const SensorThread&);
+
+	void run();
+
+	std::thread       thread;
+	std::atomic<bool> quit;
+	PoseHandoff*      handoff;
+	double            period;
+	SampleFunction    sample;
+	LatencyStats      intervalStats;
+};
+
+#endif
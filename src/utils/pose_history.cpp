@@ -0,0 +1,138 @@
+#include "pose_history.h"
+#include "timewarp_transform.h"
+
+#include <string.h>
+
+PoseHistory::PoseHistory()
+	: count(0), first(0), lastTime(0.0)
+{
+	for (int i = 0; i < POSE_HISTORY_SIZE; i++) {
+		entries[i].stamp.store(0, std::memory_order_relaxed);
+		for (int w = 0; w < NUM_WORDS; w++)
+			entries[i].words[w].store(0, std::memory_order_relaxed);
+	}
+}
+
+void PoseHistory::add(const timed_pose_t& pose)
+{
+	const uint64_t n = count.load(std::memory_order_relaxed);
+	if (n > first.load(std::memory_order_relaxed) && pose.time <= lastTime) {
+		if (pose.time == lastTime)
+			return;
+		first.store(n, std::memory_order_release);
+	}
+	lastTime = pose.time;
+
+	uint64_t words[NUM_WORDS] = { 0 };
+	memcpy(words, &pose, sizeof(pose));
+
+	Entry& entry = entries[n & (POSE_HISTORY_SIZE - 1)];
+	entry.stamp.store(2 * n + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (int w = 0; w < NUM_WORDS; w++)
+		entry.words[w].store(words[w], std::memory_order_relaxed);
+	entry.stamp.store(2 * n + 2, std::memory_order_release);
+	count.store(n + 1, std::memory_order_release);
+}
+
+void PoseHistory::clear()
+{
+	// The entries stay, they are just no longer part of the history.
+	first.store(count.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+bool PoseHistory::readEntry(uint64_t index, timed_pose_t* pose) const
+{
+	const Entry& entry = entries[index & (POSE_HISTORY_SIZE - 1)];
+	const uint64_t stamp = entry.stamp.load(std::memory_order_acquire);
+	if (stamp != 2 * index + 2)
+		return false;
+
+	uint64_t words[NUM_WORDS];
+	for (int w = 0; w < NUM_WORDS; w++)
+		words[w] = entry.words[w].load(std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (entry.stamp.load(std::memory_order_relaxed) != stamp)
+		return false;
+
+	memcpy(pose, words, sizeof(*pose));
+	return true;
+}
+
+bool PoseHistory::getPose(double time, timed_pose_t* pose, pose_interpolation_t interpolation) const
+{
+	// Any entry read can fail once the writer wrapped around to it, and
+	// then the search starts over on the newer history.
+	for (;;) {
+		// first before count, so count is never behind it.
+		const uint64_t oldest = first.load(std::memory_order_acquire);
+		const uint64_t n = count.load(std::memory_order_acquire);
+		if (n == oldest)
+			return false;
+
+		uint64_t lo = (n - oldest > POSE_HISTORY_SIZE) ? n - POSE_HISTORY_SIZE : oldest;
+		uint64_t hi = n - 1;
+		timed_pose_t a;
+		timed_pose_t b;
+		if (!readEntry(lo, &a))
+			continue;
+		if (time <= a.time || lo == hi) {
+			*pose = a;
+			return true;
+		}
+		if (!readEntry(hi, &b))
+			continue;
+		if (time >= b.time) {
+			*pose = b;
+			return true;
+		}
+
+		// Narrow a.time < time < b.time down to neighbouring entries.
+		bool overwritten = false;
+		while (hi - lo > 1) {
+			const uint64_t mid = lo + (hi - lo) / 2;
+			timed_pose_t m;
+			if (!readEntry(mid, &m)) {
+				overwritten = true;
+				break;
+			}
+			if (m.time <= time) {
+				lo = mid;
+				a = m;
+			} else {
+				hi = mid;
+				b = m;
+			}
+		}
+		if (overwritten)
+			continue;
+
+		const float fraction = (float)((time - a.time) / (b.time - a.time));
+		pose->time = time;
+		if (interpolation == POSE_INTERPOLATION_SLERP)
+			SlerpQuaternions(&pose->orientation, &a.orientation, &b.orientation, fraction);
+		else
+			ksQuatf_Lerp(&pose->orientation, &a.orientation, &b.orientation, fraction);
+		ksVector3f_Lerp(&pose->position, &a.position, &b.position, fraction);
+		return true;
+	}
+}
+
+bool PoseHistory::getTimeRange(double* oldestTime, double* newestTime) const
+{
+	for (;;) {
+		const uint64_t oldest = first.load(std::memory_order_acquire);
+		const uint64_t n = count.load(std::memory_order_acquire);
+		if (n == oldest)
+			return false;
+
+		timed_pose_t a;
+		timed_pose_t b;
+		const uint64_t lo = (n - oldest > POSE_HISTORY_SIZE) ? n - POSE_HISTORY_SIZE : oldest;
+		if (!readEntry(lo, &a) || !readEntry(n - 1, &b))
+			continue;
+		*oldestTime = a.time;
+		*newestTime = b.time;
+		return true;
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef _POSE_HISTORY_H
+#define _POSE_HISTORY_H
+
+#include <stdint.h>
+#include <atomic>
+#include "algebra.h"
+
+// Bounded history of timestamped head poses, for looking up the pose at any
+// time in the recent past.
+//
+// The warp needs the pose the eye buffer was rendered with, which is older
+// than the newest tracker sample by the app's frame time, and the pose the
+// display shows it with. The predictor covers the future; the history covers
+// the past: getPose() finds the two entries around a time by binary search
+// and interpolates between them. The entries live in a fixed ring, so adding
+// never allocates, and a single writer can add while any number of readers
+// look up poses: each entry has a seqlock stamp, and a reader that finds an
+// entry overwritten under it just searches again.
+
+#define POSE_HISTORY_SIZE		1024	// entries, a power of two: about a second at 1 kHz
+
+typedef struct
+{
+	double			time;				// seconds
+	ksQuatf			orientation;		// view orientation
+	ksVector3f		position;			// meters
+} timed_pose_t;
+
+typedef enum
+{
+	POSE_INTERPOLATION_NLERP,			// ksQuatf_Lerp(), exact enough between samples a millisecond apart
+	POSE_INTERPOLATION_SLERP			// SlerpQuaternions(), for sparser poses
+} pose_interpolation_t;
+
+class PoseHistory
+{
+public:
+	PoseHistory();
+
+	// Writer only. Poses must come in time order: an older one than the newest
+	// starts the history over (the clock was reset).
+	void add(const timed_pose_t& pose);
+	void clear();
+
+	// The pose at time, interpolated between the entries around it, or the
+	// oldest / newest entry when time is outside the history (the predictor's
+	// job). Fails when the history is empty.
+	bool getPose(double time, timed_pose_t* pose, pose_interpolation_t interpolation = POSE_INTERPOLATION_SLERP) const;
+	// Times of the oldest and newest entries. Fails when the history is empty.
+	bool getTimeRange(double* oldest, double* newest) const;
+
+private:
+	PoseHistory(const PoseHistory&);
+	PoseHistory& operator=(const PoseHistory&);
+
+	enum { NUM_WORDS = ( sizeof(timed_pose_t) + sizeof(uint64_t) - 1 ) / sizeof(uint64_t) };
+
+	struct Entry
+	{
+		std::atomic<uint64_t> stamp;            // 2 * index + 1 while being written, 2 * index + 2 once written
+		std::atomic<uint64_t> words[NUM_WORDS];
+	};
+
+	bool readEntry(uint64_t index, timed_pose_t* pose) const;
+
+	std::atomic<uint64_t> count;                // poses ever added
+	std::atomic<uint64_t> first;                // index of the oldest pose since the last clear
+	double                lastTime;             // writer only, time of the newest pose
+	Entry                 entries[POSE_HISTORY_SIZE];
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include <math.h>
+#include <string.h>
+#include "pose_predictor.h"
+#include "timewarp_transform.h"
+
+// Below this angle the rotation vector to quaternion maps use their small angle forms.
+static const float SMALL_ANGLE = 1e-6f;
+
+// The view rotation of turning the head by rotation vector v (radians) about its own axes.
+static void RotationVectorToQuaternion( const ksVector3f * v, ksQuatf * result )
+{
+	const float angle = sqrtf( v->x * v->x + v->y * v->y + v->z * v->z );
+	const float scale = ( angle > SMALL_ANGLE ) ? -sinf( 0.5f * angle ) / angle : -0.5f;
+	result->x = v->x * scale;
+	result->y = v->y * scale;
+	result->z = v->z * scale;
+	result->w = ( angle > SMALL_ANGLE ) ? cosf( 0.5f * angle ) : 1.0f;
+}
+
+void PosePredictor_Create( pose_predictor_t * predictor, const pose_prediction_t model, const float filterTimeConstant )
+{
+	memset( predictor, 0, sizeof( pose_predictor_t ) );
+	predictor->model = model;
+	predictor->filterTimeConstant = filterTimeConstant;
+}
+
+void PosePredictor_AddSample( pose_predictor_t * predictor, const pose_sample_t * sample )
+{
+	if ( predictor->model == POSE_PREDICTION_FILTERED && predictor->numSamples > 0 )
+	{
+		// One pole low-pass, exact for any sample spacing.
+		const float dt = (float)( sample->time - predictor->latest.time );
+		const float alpha = 1.0f - expf( -dt / predictor->filterTimeConstant );
+		ksVector3f_Lerp( &predictor->velocity, &predictor->velocity, &sample->angularVelocity, alpha );
+	}
+	else
+	{
+		predictor->velocity = sample->angularVelocity;
+	}
+	predictor->latest = *sample;
+	predictor->numSamples++;
+}
+
+bool PosePredictor_Predict( const pose_predictor_t * predictor, const double time, ksQuatf * orientation )
+{
+	if ( predictor->numSamples == 0 )
+	{
+		return false;
+	}
+	if ( predictor->model == POSE_PREDICTION_NONE )
+	{
+		*orientation = predictor->latest.orientation;
+		return true;
+	}
+
+	const float dt = (float)( time - predictor->latest.time );
+	const ksVector3f rotation = { predictor->velocity.x * dt, predictor->velocity.y * dt, predictor->velocity.z * dt };
+	ksQuatf delta;
+	RotationVectorToQuaternion( &rotation, &delta );
+	MultiplyQuaternions( orientation, &delta, &predictor->latest.orientation );
+	return true;
+}
+
+void PosePredictor_GetAngularVelocity( const ksQuatf * from, const ksQuatf * to, const float dt, ksVector3f * angularVelocity )
+{
+	// delta = to * conj( from ) = exp( -angularVelocity * dt ), on the short way round.
+	const ksQuatf conjugate = { -from->x, -from->y, -from->z, from->w };
+	ksQuatf delta;
+	MultiplyQuaternions( &delta, to, &conjugate );
+	const float sign = ( delta.w < 0.0f ) ? -1.0f : 1.0f;
+	const float sinHalf = sqrtf( delta.x * delta.x + delta.y * delta.y + delta.z * delta.z );
+	const float angle = 2.0f * atan2f( sinHalf, sign * delta.w );
+	const float scale = ( sinHalf > SMALL_ANGLE ) ? -sign * angle / ( sinHalf * dt ) : -sign * 2.0f / dt;
+	angularVelocity->x = delta.x * scale;
+	angularVelocity->y = delta.y * scale;
+	angularVelocity->z = delta.z * scale;
+}
+
+float PosePredictor_GetAngleDegrees( const ksQuatf * a, const ksQuatf * b )
+{
+	const ksQuatf conjugate = { -a->x, -a->y, -a->z, a->w };
+	ksQuatf delta;
+	MultiplyQuaternions( &delta, &conjugate, b );
+	const float sinHalf = sqrtf( delta.x * delta.x + delta.y * delta.y + delta.z * delta.z );
+	return 2.0f * atan2f( sinHalf, fabsf( delta.w ) ) * ( 180.0f / MATH_PI );
+}
+
+const char * PosePredictor_GetModelName( const pose_prediction_t model )
+{
+	switch ( model )
+	{
+		case POSE_PREDICTION_NONE:				return "none";
+		case POSE_PREDICTION_CONSTANT_VELOCITY:	return "constant-velocity";
+		case POSE_PREDICTION_FILTERED:			return "filtered";
+		default:								return "unknown";
+	}
+}
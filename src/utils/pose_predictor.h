@@ -0,0 +1,65 @@
+#ifndef _POSE_PREDICTOR_H
+#define _POSE_PREDICTOR_H
+
+#include "algebra.h"
+
+// Head orientation prediction from timestamped IMU samples.
+//
+// The timewarp transforms need the head orientation at the start and at the
+// end of the scanout of the frame being warped, both a little in the future
+// of the newest sensor sample. The predictor keeps the newest fused
+// orientation and extrapolates it with the gyro's angular velocity:
+//   none				the newest orientation as is, the baseline
+//   constant-velocity	rotated on by the newest gyro sample for the horizon
+//   filtered			the same with the gyro low-pass filtered, which trades
+//						noise for lag on a noisy gyro
+//
+// Orientations are view orientations, as CalculateRotationTimeWarpTransform()
+// takes them (world to head, the conjugate of the head's pose), and angular
+// velocities are gyro rates about the head's own axes in radians per second.
+// So over dt the view orientation becomes exp( -angularVelocity * dt ) * it.
+
+#define POSE_PREDICTOR_FILTER_TIME_CONSTANT		0.005f		// seconds
+
+typedef enum
+{
+	POSE_PREDICTION_NONE,
+	POSE_PREDICTION_CONSTANT_VELOCITY,
+	POSE_PREDICTION_FILTERED,
+	POSE_PREDICTION_MAX
+} pose_prediction_t;
+
+typedef struct
+{
+	double			time;				// seconds
+	ksQuatf			orientation;		// fused view orientation
+	ksVector3f		angularVelocity;	// gyro, radians per second about the head's axes
+} pose_sample_t;
+
+typedef struct
+{
+	pose_prediction_t	model;
+	float				filterTimeConstant;
+	int					numSamples;
+	pose_sample_t		latest;
+	ksVector3f			velocity;		// the angular velocity the prediction uses
+} pose_predictor_t;
+
+void PosePredictor_Create( pose_predictor_t * predictor, const pose_prediction_t model,
+						   const float filterTimeConstant = POSE_PREDICTOR_FILTER_TIME_CONSTANT );
+
+// Samples must come in time order.
+void PosePredictor_AddSample( pose_predictor_t * predictor, const pose_sample_t * sample );
+
+// The orientation at time (normally after the newest sample). Fails without samples.
+bool PosePredictor_Predict( const pose_predictor_t * predictor, const double time, ksQuatf * orientation );
+
+// Angular velocity that turns view orientation from into to in dt, as a gyro would read it.
+void PosePredictor_GetAngularVelocity( const ksQuatf * from, const ksQuatf * to, const float dt, ksVector3f * angularVelocity );
+
+// Angle between two orientations, in degrees.
+float PosePredictor_GetAngleDegrees( const ksQuatf * a, const ksQuatf * b );
+
+const char * PosePredictor_GetModelName( const pose_prediction_t model );
+
+#endif
@@ -0,0 +1,206 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pose_replay.h"
+
+static const float REPLAY_HORIZONS[POSE_REPLAY_NUM_HORIZONS] = { 0.0f, 0.005f, 0.010f, 0.016f, 0.020f, 0.033f, 0.050f, 0.100f };
+
+bool PoseTrace_Load( pose_trace_t * trace, const char * path )
+{
+	memset( trace, 0, sizeof( pose_trace_t ) );
+	FILE * file = fopen( path, "r" );
+	if ( file == NULL )
+	{
+		fprintf( stderr, "Could not open the IMU trace '%s'\n", path );
+		return false;
+	}
+
+	int capacity = 0;
+	int lineNumber = 0;
+	char line[512];
+	while ( fgets( line, sizeof( line ), file ) != NULL )
+	{
+		lineNumber++;
+		const char * start = line;
+		while ( *start == ' ' || *start == '\t' )
+		{
+			start++;
+		}
+		if ( *start == '#' || *start == '\n' || *start == '\r' || *start == '\0' )
+		{
+			continue;
+		}
+
+		pose_sample_t sample;
+		ksQuatf * q = &sample.orientation;
+		ksVector3f * g = &sample.angularVelocity;
+		if ( sscanf( start, "%lf %f %f %f %f %f %f %f", &sample.time, &q->x, &q->y, &q->z, &q->w, &g->x, &g->y, &g->z ) != 8 )
+		{
+			fprintf( stderr, "%s:%d: expected 'time qx qy qz qw gx gy gz'\n", path, lineNumber );
+			break;
+		}
+		const float length = sqrtf( q->x * q->x + q->y * q->y + q->z * q->z + q->w * q->w );
+		if ( !( length > 0.0f ) )
+		{
+			fprintf( stderr, "%s:%d: zero orientation\n", path, lineNumber );
+			break;
+		}
+		if ( trace->numSamples > 0 && !( sample.time > trace->samples[trace->numSamples - 1].time ) )
+		{
+			fprintf( stderr, "%s:%d: time does not increase\n", path, lineNumber );
+			break;
+		}
+		q->x /= length;
+		q->y /= length;
+		q->z /= length;
+		q->w /= length;
+
+		if ( trace->numSamples == capacity )
+		{
+			capacity = ( capacity > 0 ) ? capacity * 2 : 1024;
+			trace->samples = (pose_sample_t *)realloc( trace->samples, capacity * sizeof( pose_sample_t ) );
+		}
+		trace->samples[trace->numSamples++] = sample;
+	}
+	const bool complete = ( feof( file ) != 0 );
+	fclose( file );
+	if ( complete && trace->numSamples < 2 )
+	{
+		fprintf( stderr, "The IMU trace '%s' needs at least two samples\n", path );
+	}
+	if ( !complete || trace->numSamples < 2 )
+	{
+		PoseTrace_Destroy( trace );
+		return false;
+	}
+	return true;
+}
+
+void PoseTrace_Destroy( pose_trace_t * trace )
+{
+	free( trace->samples );
+	memset( trace, 0, sizeof( pose_trace_t ) );
+}
+
+// Index of the last sample at or before time, clamped to the trace.
+static int FindSample( const pose_trace_t * trace, const double time )
+{
+	int low = 0;
+	int high = trace->numSamples - 1;
+	while ( low < high )
+	{
+		const int mid = ( low + high + 1 ) / 2;
+		if ( trace->samples[mid].time <= time )
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+	return low;
+}
+
+void PoseTrace_GetOrientation( const pose_trace_t * trace, const double time, ksQuatf * orientation )
+{
+	const int i = FindSample( trace, time );
+	if ( i == trace->numSamples - 1 )
+	{
+		*orientation = trace->samples[i].orientation;
+		return;
+	}
+	const pose_sample_t * a = &trace->samples[i];
+	const pose_sample_t * b = &trace->samples[i + 1];
+	const float fraction = (float)( ( time - a->time ) / ( b->time - a->time ) );
+	ksQuatf_Lerp( orientation, &a->orientation, &b->orientation, fmaxf( 0.0f, fminf( fraction, 1.0f ) ) );
+}
+
+void PoseTrace_Replay( const pose_trace_t * trace, const pose_prediction_t model, const float filterTimeConstant,
+					   pose_replay_error_t errors[POSE_REPLAY_NUM_HORIZONS] )
+{
+	double sum[POSE_REPLAY_NUM_HORIZONS];
+	double sumSquares[POSE_REPLAY_NUM_HORIZONS];
+	for ( int h = 0; h < POSE_REPLAY_NUM_HORIZONS; h++ )
+	{
+		memset( &errors[h], 0, sizeof( pose_replay_error_t ) );
+		errors[h].horizon = REPLAY_HORIZONS[h];
+		sum[h] = 0.0;
+		sumSquares[h] = 0.0;
+	}
+
+	pose_predictor_t predictor;
+	PosePredictor_Create( &predictor, model, filterTimeConstant );
+	const double endTime = trace->samples[trace->numSamples - 1].time;
+	for ( int i = 0; i < trace->numSamples; i++ )
+	{
+		PosePredictor_AddSample( &predictor, &trace->samples[i] );
+		for ( int h = 0; h < POSE_REPLAY_NUM_HORIZONS; h++ )
+		{
+			const double time = trace->samples[i].time + REPLAY_HORIZONS[h];
+			if ( time > endTime )
+			{
+				break;
+			}
+			ksQuatf predicted;
+			ksQuatf actual;
+			PosePredictor_Predict( &predictor, time, &predicted );
+			PoseTrace_GetOrientation( trace, time, &actual );
+			const float error = PosePredictor_GetAngleDegrees( &predicted, &actual );
+			sum[h] += error;
+			sumSquares[h] += (double)error * error;
+			errors[h].maxDegrees = fmaxf( errors[h].maxDegrees, error );
+			errors[h].count++;
+		}
+	}
+
+	for ( int h = 0; h < POSE_REPLAY_NUM_HORIZONS; h++ )
+	{
+		if ( errors[h].count > 0 )
+		{
+			errors[h].meanDegrees = (float)( sum[h] / errors[h].count );
+			errors[h].rmsDegrees = (float)sqrt( sumSquares[h] / errors[h].count );
+		}
+	}
+}
+
+void PoseTrace_Report( const pose_trace_t * trace, const char * name,
+					   pose_replay_error_t errorsOut[POSE_PREDICTION_MAX][POSE_REPLAY_NUM_HORIZONS] )
+{
+	const double duration = trace->samples[trace->numSamples - 1].time - trace->samples[0].time;
+	printf( "Pose prediction replay of %s: %d samples over %.2f s (%.0f Hz)\n",
+			name, trace->numSamples, duration, ( trace->numSamples - 1 ) / duration );
+
+	pose_replay_error_t errors[POSE_PREDICTION_MAX][POSE_REPLAY_NUM_HORIZONS];
+	for ( int model = 0; model < POSE_PREDICTION_MAX; model++ )
+	{
+		PoseTrace_Replay( trace, (pose_prediction_t)model, POSE_PREDICTOR_FILTER_TIME_CONSTANT, errors[model] );
+	}
+
+	printf( "  horizon  " );
+	for ( int model = 0; model < POSE_PREDICTION_MAX; model++ )
+	{
+		printf( " | %-17s mean / rms / max deg", PosePredictor_GetModelName( (pose_prediction_t)model ) );
+	}
+	printf( "\n" );
+
+	for ( int h = 0; h < POSE_REPLAY_NUM_HORIZONS; h++ )
+	{
+		if ( errors[0][h].count == 0 )
+		{
+			continue;
+		}
+		printf( "  %5.1f ms ", 1000.0f * REPLAY_HORIZONS[h] );
+		for ( int model = 0; model < POSE_PREDICTION_MAX; model++ )
+		{
+			printf( " | %8.4f / %8.4f / %8.4f        ", errors[model][h].meanDegrees, errors[model][h].rmsDegrees, errors[model][h].maxDegrees );
+		}
+		printf( "\n" );
+	}
+
+	if ( errorsOut != NULL )
+	{
+		memcpy( errorsOut, errors, sizeof( errors ) );
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef _POSE_REPLAY_H
+#define _POSE_REPLAY_H
+
+#include "pose_predictor.h"
+
+// Replay of recorded IMU traces through the pose predictor.
+//
+// A trace is a text file with one sample per line:
+//   time qx qy qz qw gx gy gz
+// the time in seconds, the fused view orientation quaternion and the gyro in
+// radians per second (see pose_predictor.h for the frames). Blank lines and
+// lines starting with '#' are skipped.
+//
+// The replay feeds the samples to each prediction model one at a time and,
+// after each one, predicts ahead by every horizon and measures the angle to
+// the trace's own orientation at that time. How far ahead a frame has to be
+// predicted is set by the latency budget, so the error by horizon is what
+// that budget costs in accuracy.
+
+#define POSE_REPLAY_NUM_HORIZONS	8
+
+typedef struct
+{
+	pose_sample_t *		samples;		// malloc'ed
+	int					numSamples;
+} pose_trace_t;
+
+typedef struct
+{
+	float	horizon;					// seconds
+	int		count;
+	float	meanDegrees;
+	float	rmsDegrees;
+	float	maxDegrees;
+} pose_replay_error_t;
+
+// Fails with a message on a missing file, a bad line or time going backwards.
+bool PoseTrace_Load( pose_trace_t * trace, const char * path );
+void PoseTrace_Destroy( pose_trace_t * trace );
+
+// The trace's orientation at time, interpolated between its samples.
+void PoseTrace_GetOrientation( const pose_trace_t * trace, const double time, ksQuatf * orientation );
+
+// Errors at the POSE_REPLAY_NUM_HORIZONS horizons from 0 to 100 milliseconds.
+void PoseTrace_Replay( const pose_trace_t * trace, const pose_prediction_t model, const float filterTimeConstant,
+					   pose_replay_error_t errors[POSE_REPLAY_NUM_HORIZONS] );
+
+// Replays every model and prints their errors side by side, and returns
+// them in errors unless it is NULL. A recorded trace can have any result,
+// so the report passes no judgement on it.
+void PoseTrace_Report( const pose_trace_t * trace, const char * name,
+					   pose_replay_error_t errors[POSE_PREDICTION_MAX][POSE_REPLAY_NUM_HORIZONS] = NULL );
+
+#endif
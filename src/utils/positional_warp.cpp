@@ -0,0 +1,59 @@
+#include <math.h>
+#include "positional_warp.h"
+#include "timewarp_transform.h"
+
+void CalculatePositionalTimeWarpTranslation( ksVector3f * translation, const ksMatrix4x4f * renderProjectionMatrix,
+											 const ksQuatf * renderOrientation, const ksVector3f * renderPosition,
+											 const ksVector3f * newPosition )
+{
+	// The head translation in world space, turned into the render view: q * t * conj( q ).
+	const ksQuatf worldTranslation = { newPosition->x - renderPosition->x, newPosition->y - renderPosition->y,
+									   newPosition->z - renderPosition->z, 0.0f };
+	const ksQuatf conjugate = { -renderOrientation->x, -renderOrientation->y, -renderOrientation->z, renderOrientation->w };
+	ksQuatf rotated;
+	ksQuatf viewTranslation;
+	MultiplyQuaternions( &rotated, renderOrientation, &worldTranslation );
+	MultiplyQuaternions( &viewTranslation, &rotated, &conjugate );
+
+	// The texture projection of the rotation transform, without a rotation.
+	const ksQuatf identity = { 0.0f, 0.0f, 0.0f, 1.0f };
+	ksMatrix3x4f projection;
+	CalculateRotationTimeWarpTransform( &projection, renderProjectionMatrix, &identity, &identity );
+
+	float * result = &translation->x;
+	for ( int i = 0; i < 3; i++ )
+	{
+		result[i] = projection.m[i][0] * viewTranslation.x + projection.m[i][1] * viewTranslation.y + projection.m[i][2] * viewTranslation.z;
+	}
+}
+
+float PositionalWarp_GetSceneInverseDepth( const float v )
+{
+	const float t = fmaxf( 0.0f, fminf( v, 1.0f ) );
+	return ( 1.0f - t ) * ( 1.0f / POSITIONAL_WARP_SCENE_NEAR_DEPTH ) + t * ( 1.0f / POSITIONAL_WARP_SCENE_FAR_DEPTH );
+}
+
+void PositionalWarp_Reproject( float uv[2], const ksMatrix3x4f * transform, const ksVector3f * translation,
+							   const float tanAngleX, const float tanAngleY, const int iterations,
+							   float ( *inverseDepth )( const float u, const float v ) )
+{
+	float rotationUv[3];
+	for ( int i = 0; i < 3; i++ )
+	{
+		rotationUv[i] = transform->m[i][0] * tanAngleX + transform->m[i][1] * tanAngleY - transform->m[i][2] + transform->m[i][3];
+	}
+	uv[0] = rotationUv[0] / fmaxf( rotationUv[2], 0.00001f );
+	uv[1] = rotationUv[1] / fmaxf( rotationUv[2], 0.00001f );
+
+	for ( int iteration = 0; iteration < iterations; iteration++ )
+	{
+		// The depth buffer has the render view depth w = translation.z + z * rotationUv.z.
+		const float inverseW = inverseDepth( uv[0], uv[1] );
+		const float inverseZ = rotationUv[2] * inverseW / fmaxf( 1.0f - translation->z * inverseW, 0.00001f );
+		const float x = rotationUv[0] + translation->x * inverseZ;
+		const float y = rotationUv[1] + translation->y * inverseZ;
+		const float z = rotationUv[2] + translation->z * inverseZ;
+		uv[0] = x / fmaxf( z, 0.00001f );
+		uv[1] = y / fmaxf( z, 0.00001f );
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef _POSITIONAL_WARP_H
+#define _POSITIONAL_WARP_H
+
+#include "algebra.h"
+
+// Positional timewarp: reprojection for a head translation as well as a
+// rotation, from the eye buffer's depth.
+//
+// CalculateTimeWarpTransform() drops the translation of the pose delta,
+// because without depth a translation has no effect on a direction. With
+// depth it does: a display ray d of the new view (tangent angles, z = -1)
+// hits the scene at z * d for a view depth z, which is t + z * R * d in the
+// render view, where R is the delta rotation and t the new eye position in
+// render view coordinates. The rotation transform already takes d to the
+// homogeneous eye buffer UV of R * d, and the texture projection is linear,
+// so the point's UV is
+//   transform * d + ( projection * t ) / z
+// The warp adds the second term per vertex, displacing the distortion mesh's
+// UVs. It samples the eye buffer depth at the rotation-only UV, which gives
+// the render view depth w = t.z + z * ( R * d ).z of a nearby point, and
+// solves that for 1 / z. That is a step of a fixed point iteration that
+// converges as the translation shrinks relative to the depth. Far away
+// (depth 1, the cleared buffer) 1 / z is 0 and this is the rotation-only warp.
+//
+// The eye buffer depth is window depth with an infinite far plane,
+// 1 - nearZ / z, so 1 / z = ( 1 - depth ) / nearZ.
+
+// The prerendered image has no depth, so the app pass gives it the depth of
+// a floor: near at the bottom of the eye buffer, receding to the top.
+#define POSITIONAL_WARP_SCENE_NEAR_DEPTH		1.0f		// meters, bottom edge
+#define POSITIONAL_WARP_SCENE_FAR_DEPTH			10.0f		// meters, top edge
+
+// projection * t for the shader, t the head translation from the render pose
+// to the new pose in render view coordinates. Orientations are view
+// orientations, as CalculateRotationTimeWarpTransform() takes them. Both eyes
+// use the head's translation, the eye offsets turn with the head by less than
+// a millimeter between render and scanout.
+void CalculatePositionalTimeWarpTranslation( ksVector3f * translation, const ksMatrix4x4f * renderProjectionMatrix,
+											 const ksQuatf * renderOrientation, const ksVector3f * renderPosition,
+											 const ksVector3f * newPosition );
+
+// Inverse view depth of the synthetic scene at eye buffer UV v (0 at the bottom).
+float PositionalWarp_GetSceneInverseDepth( const float v );
+
+// What the warp's vertex program computes for one display ray: the eye buffer
+// UV, with 1 / z looked up iterations times (0 = the rotation-only warp).
+// transform comes from CalculateRotationTimeWarpTransform(), inverseDepth(u, v)
+// stands for the depth texture.
+void PositionalWarp_Reproject( float uv[2], const ksMatrix3x4f * transform, const ksVector3f * translation,
+							   const float tanAngleX, const float tanAngleY, const int iterations,
+							   float ( *inverseDepth )( const float u, const float v ) );
+
+#endif
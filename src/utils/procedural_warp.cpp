@@ -0,0 +1,35 @@
+#include <string.h>
+#include "procedural_warp.h"
+
+bool ProceduralWarp_GetParams( const hmd_info_t * hmdInfo, procedural_warp_params_t * params )
+{
+	memset( params, 0, sizeof( procedural_warp_params_t ) );
+	if ( hmdInfo->numKnots > PROCEDURAL_WARP_MAX_KNOTS )
+	{
+		return false;
+	}
+
+	params->tiles[0] = hmdInfo->eyeTilesWide;
+	params->tiles[1] = hmdInfo->eyeTilesHigh;
+	params->tiles[2] = hmdInfo->numKnots;
+
+	// The same intermediate values as BuildTimewarp() and GetDistortionTanAngles().
+	const float horizontalShiftMeters = ( hmdInfo->lensSeparationInMeters / 2 ) - ( hmdInfo->visibleMetersWide / 4 );
+	params->lens[0] = (float)( hmdInfo->eyeTilesHigh * hmdInfo->tilePixelsHigh ) / hmdInfo->displayPixelsHigh;
+	params->lens[1] = horizontalShiftMeters / ( hmdInfo->visibleMetersWide / 2 );
+	params->lens[2] = hmdInfo->metersPerTanAngleAtCenter;
+
+	params->ndcToMeters[0] = hmdInfo->visiblePixelsWide * 0.25f;
+	params->ndcToMeters[1] = hmdInfo->visiblePixelsHigh * 0.5f;
+	params->ndcToMeters[2] = hmdInfo->visibleMetersWide / hmdInfo->visiblePixelsWide;
+	params->ndcToMeters[3] = hmdInfo->visibleMetersHigh / hmdInfo->visiblePixelsHigh;
+
+	memcpy( params->K, hmdInfo->K, hmdInfo->numKnots * sizeof( float ) );
+	memcpy( params->chromaticAberration, hmdInfo->chromaticAberration, sizeof( params->chromaticAberration ) );
+	return true;
+}
+
+int ProceduralWarp_GetVertexCount( const hmd_info_t * hmdInfo )
+{
+	return hmdInfo->eyeTilesWide * hmdInfo->eyeTilesHigh * 6;
+}
@@ -0,0 +1,32 @@
+#ifndef _PROCEDURAL_WARP_H
+#define _PROCEDURAL_WARP_H
+
+#include "hmd.h"
+
+// Lens parameters of the mesh-less warp.
+//
+// The procedural warp vertex shader needs no vertex or index buffers: it
+// works out the grid vertex of BuildTimewarp()'s uniform mesh from
+// gl_VertexID (six per tile, in the triangle order of distortion_indices)
+// and the eye from gl_InstanceID, and then runs EvaluateDistortion() itself.
+// Everything it needs from hmd_info_t is in one std140 uniform block with
+// this layout, so a lens parameter change is one buffer update.
+
+#define PROCEDURAL_WARP_MAX_KNOTS		12
+
+typedef struct
+{
+	GLint		tiles[4];				// eyeTilesWide, eyeTilesHigh, numKnots, unused
+	GLfloat		lens[4];				// fraction of the display height the mesh covers, horizontalShiftView, metersPerTanAngleAtCenter, unused
+	GLfloat		ndcToMeters[4];			// ndcToPixels.xy, pixelsToMeters.xy of GetDistortionTanAngles()
+	GLfloat		K[PROCEDURAL_WARP_MAX_KNOTS];	// vec4 K[3]
+	GLfloat		chromaticAberration[4];
+} procedural_warp_params_t;
+
+// Fails when the spline has more knots than the block holds.
+bool ProceduralWarp_GetParams( const hmd_info_t * hmdInfo, procedural_warp_params_t * params );
+
+// Vertices per eye of one procedural warp draw.
+int ProceduralWarp_GetVertexCount( const hmd_info_t * hmdInfo );
+
+#endif
@@ -0,0 +1,72 @@
+#include <string.h>
+#include "scanout.h"
+
+static const char * const scanoutDirectionNames[] =
+{
+	"left-to-right",
+	"right-to-left",
+	"top-to-bottom",
+	"bottom-to-top"
+};
+
+bool Scanout_ParseDirection( const char * name, scanout_direction_t * direction )
+{
+	for ( int i = 0; i < (int)( sizeof( scanoutDirectionNames ) / sizeof( scanoutDirectionNames[0] ) ); i++ )
+	{
+		if ( strcmp( name, scanoutDirectionNames[i] ) == 0 )
+		{
+			*direction = (scanout_direction_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char * Scanout_GetDirectionName( const scanout_direction_t direction )
+{
+	return scanoutDirectionNames[direction];
+}
+
+void Scanout_Init( scanout_transforms_t * scanout, const scanout_direction_t direction, const int slices )
+{
+	// NDC -1 to 1 along the scan axis is fraction 0 to 1.
+	static const float planes[4][3] =
+	{
+		{  0.5f,  0.0f, 0.5f },
+		{ -0.5f,  0.0f, 0.5f },
+		{  0.0f, -0.5f, 0.5f },
+		{  0.0f,  0.5f, 0.5f }
+	};
+	scanout->fractionPlane[0] = planes[direction][0];
+	scanout->fractionPlane[1] = planes[direction][1];
+	scanout->fractionPlane[2] = planes[direction][2];
+	scanout->slices = (float)( ( slices < 1 ) ? 1 : ( ( slices > SCANOUT_MAX_SLICES ) ? SCANOUT_MAX_SLICES : slices ) );
+}
+
+float Scanout_GetDisplayFraction( const scanout_transforms_t * scanout, const float x, const float y )
+{
+	return scanout->fractionPlane[0] * x + scanout->fractionPlane[1] * y + scanout->fractionPlane[2];
+}
+
+void Scanout_GetTransform( const scanout_transforms_t * scanout, const float displayFraction, ksMatrix3x4f * transform )
+{
+	const int slices = (int)scanout->slices;
+	const float clamped = ( displayFraction < 0.0f ) ? 0.0f : ( ( displayFraction > 1.0f ) ? 1.0f : displayFraction );
+	const float slice = clamped * slices;
+	int i = (int)slice;
+	if ( i > slices - 1 )
+	{
+		i = slices - 1;
+	}
+	const float fraction = slice - i;
+
+	const ksMatrix3x4f * a = &scanout->transforms[i];
+	const ksMatrix3x4f * b = &scanout->transforms[i + 1];
+	for ( int row = 0; row < 3; row++ )
+	{
+		for ( int col = 0; col < 4; col++ )
+		{
+			transform->m[row][col] = a->m[row][col] + ( b->m[row][col] - a->m[row][col] ) * fraction;
+		}
+	}
+}
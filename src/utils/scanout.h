@@ -0,0 +1,59 @@
+#ifndef _SCANOUT_H
+#define _SCANOUT_H
+
+#include "algebra.h"
+
+// Rolling scanout: the panel lights up a line at a time, so every line shows
+// the frame at a slightly later time, and the warp gives every line the view
+// predicted for that time.
+//
+// The warps used to lerp between the transforms predicted for the start and
+// the end of scanout, by display x. On a fast head turn the predicted view is
+// not linear in time, and two points leave an error across the middle of the
+// panel. With N slices there are N + 1 transforms, at even steps from the
+// start of scanout to its end, and each vertex (or pixel, for the LUT warp)
+// lerps between the two around its display fraction; one slice is the old
+// two-transform lerp. The scan order is configurable too: a landscape panel
+// scans left to right, a portrait panel mounted rotated in the headset
+// scans left to right or right to left depending on which way it is turned,
+// and one scanning by display rows goes top to bottom.
+//
+// The warp programs read the transforms from the ScanoutTransforms uniform
+// block, whose std140 layout scanout_transforms_t matches. The CPU reference
+// renderer uses Scanout_GetTransform(), which does what the programs do.
+
+#define SCANOUT_MAX_SLICES		16			// the uniform block has room for 17 transforms, 832 bytes
+
+typedef enum
+{
+	SCANOUT_LEFT_TO_RIGHT,				// landscape panel (the warps' old fixed order), or portrait with its first row on the left
+	SCANOUT_RIGHT_TO_LEFT,				// portrait panel turned the other way
+	SCANOUT_TOP_TO_BOTTOM,				// panel scanning by display rows
+	SCANOUT_BOTTOM_TO_TOP
+} scanout_direction_t;
+
+// The ScanoutTransforms block. A std140 mat3x4 is three vec4 columns, which
+// are the rows of a ksMatrix3x4f, so vec4( uv, -1, 1 ) * mat3x4 in GLSL is
+// transform * ( u, v, -1, 1 ) here.
+typedef struct
+{
+	float			fractionPlane[3];		// display fraction = dot( fractionPlane, ( x, y, 1 ) ), x and y in display NDC
+	float			slices;					// transforms in use - 1
+	ksMatrix3x4f	transforms[SCANOUT_MAX_SLICES + 1];
+} scanout_transforms_t;
+
+bool Scanout_ParseDirection( const char * name, scanout_direction_t * direction );
+const char * Scanout_GetDirectionName( const scanout_direction_t direction );
+
+// Set the scan order and the number of slices; the transforms are up to the
+// caller, transform i for i / slices of the way through scanout.
+void Scanout_Init( scanout_transforms_t * scanout, const scanout_direction_t direction, const int slices );
+
+// How far through scanout the display point at NDC x, y lights up, 0 to 1.
+float Scanout_GetDisplayFraction( const scanout_transforms_t * scanout, const float x, const float y );
+
+// The transform at a display fraction, lerped between the transforms around
+// it: the ScanoutTransform() of the warp programs.
+void Scanout_GetTransform( const scanout_transforms_t * scanout, const float displayFraction, ksMatrix3x4f * transform );
+
+#endif
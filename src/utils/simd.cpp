@@ -0,0 +1,28 @@
+#include "simd.h"
+
+simd_path_t Simd_GetBestPath()
+{
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+	static const bool haveAVX2 = __builtin_cpu_supports( "avx2" );
+	if ( haveAVX2 )
+	{
+		return SIMD_PATH_AVX2;
+	}
+#endif
+#if defined( __SSE2__ )
+	return SIMD_PATH_SSE2;
+#else
+	return SIMD_PATH_SCALAR;
+#endif
+}
+
+const char * Simd_GetPathName( const simd_path_t path )
+{
+	switch ( path )
+	{
+		case SIMD_PATH_SCALAR:	return "scalar";
+		case SIMD_PATH_SSE2:	return "SSE2";
+		case SIMD_PATH_AVX2:	return "AVX2";
+		default:				return Simd_GetPathName( Simd_GetBestPath() );
+	}
+}
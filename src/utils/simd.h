@@ -0,0 +1,21 @@
+#ifndef _SIMD_H
+#define _SIMD_H
+
+// Instruction set selector for the code with scalar, SSE2 and AVX2 paths
+// (the spline batch, the lens models, the matrix routines). Every path of
+// those does the scalar arithmetic in the same order, so the choice only
+// changes the speed.
+
+typedef enum
+{
+	SIMD_PATH_SCALAR,
+	SIMD_PATH_SSE2,
+	SIMD_PATH_AVX2,
+	SIMD_PATH_BEST					// the widest one this CPU supports
+} simd_path_t;
+
+// What SIMD_PATH_BEST resolves to on this CPU.
+simd_path_t Simd_GetBestPath();
+const char * Simd_GetPathName( const simd_path_t path );
+
+#endif
@@ -0,0 +1,179 @@
+#include <string.h>
+#include "spline.h"
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <immintrin.h>
+#define SPLINE_HAVE_AVX2
+#endif
+
+bool CatmullRomSpline_Create( catmull_rom_spline_t * spline, const float * K, const int numKnots )
+{
+	memset( spline, 0, sizeof( catmull_rom_spline_t ) );
+	if ( numKnots < 3 || numKnots > MAX_SPLINE_SEGMENTS )
+	{
+		return false;
+	}
+	spline->numKnots = numKnots;
+
+	// The four cases of EvaluateCatmullRomSpline(), one segment per knot.
+	for ( int k = 0; k < MAX_SPLINE_SEGMENTS; k++ )
+	{
+		const int s = ( k < numKnots ) ? k : numKnots - 1;		// padding, never selected
+		if ( s == 0 )
+		{
+			spline->p0[k] = K[0];
+			spline->m0[k] = K[1] - K[0];
+			spline->p1[k] = K[1];
+			spline->m1[k] = 0.5f * ( K[2] - K[0] );
+		}
+		else if ( s < numKnots - 2 )
+		{
+			spline->p0[k] = K[s];
+			spline->m0[k] = 0.5f * ( K[s+1] - K[s-1] );
+			spline->p1[k] = K[s+1];
+			spline->m1[k] = 0.5f * ( K[s+2] - K[s] );
+		}
+		else if ( s == numKnots - 2 )
+		{
+			spline->p0[k] = K[s];
+			spline->m0[k] = 0.5f * ( K[s+1] - K[s-1] );
+			spline->p1[k] = K[s+1];
+			spline->m1[k] = K[s+1] - K[s];
+		}
+		else
+		{
+			// Past the last knot: linear extrapolation.
+			spline->p0[k] = K[s];
+			spline->m0[k] = K[s] - K[s-1];
+			spline->p1[k] = spline->p0[k] + spline->m0[k];
+			spline->m1[k] = spline->m0[k];
+		}
+	}
+	return true;
+}
+
+static void EvaluateBatchScalar( const catmull_rom_spline_t * spline, const float * values, float * results, const int begin, const int end )
+{
+	const float maxKnot = (float)( spline->numKnots - 1 );
+	for ( int i = begin; i < end; i++ )
+	{
+		const float scaledValue = maxKnot * values[i];
+		const float clamped = ( scaledValue > 0.0f ) ? ( ( scaledValue < maxKnot ) ? scaledValue : maxKnot ) : 0.0f;
+		const int k = (int)clamped;
+		const float t = scaledValue - (float)k;
+
+		const float omt = 1.0f - t;
+		results[i] = ( spline->p0[k] * ( 1.0f + 2.0f *   t ) + spline->m0[k] *   t ) * omt * omt
+				   + ( spline->p1[k] * ( 1.0f + 2.0f * omt ) - spline->m1[k] * omt ) *   t *   t;
+	}
+}
+
+void CatmullRomSpline_EvaluateDerivative( const catmull_rom_spline_t * spline, const float value, float * result, float * derivative )
+{
+	const float maxKnot = (float)( spline->numKnots - 1 );
+	const float scaledValue = maxKnot * value;
+	const float clamped = ( scaledValue > 0.0f ) ? ( ( scaledValue < maxKnot ) ? scaledValue : maxKnot ) : 0.0f;
+	const int k = (int)clamped;
+	const float t = scaledValue - (float)k;
+
+	const float omt = 1.0f - t;
+	*result = ( spline->p0[k] * ( 1.0f + 2.0f *   t ) + spline->m0[k] *   t ) * omt * omt
+			+ ( spline->p1[k] * ( 1.0f + 2.0f * omt ) - spline->m1[k] * omt ) *   t *   t;
+
+	// The Hermite basis derivatives, scaled from t back to value.
+	const float dp0 = 6.0f * t * ( t - 1.0f );
+	const float dm0 = ( 3.0f * t - 1.0f ) * ( t - 1.0f );
+	const float dm1 = t * ( 3.0f * t - 2.0f );
+	*derivative = maxKnot * ( ( spline->p0[k] - spline->p1[k] ) * dp0 + spline->m0[k] * dm0 + spline->m1[k] * dm1 );
+}
+
+#if defined( __SSE2__ )
+static void EvaluateBatchSSE2( const catmull_rom_spline_t * spline, const float * values, float * results, const int count )
+{
+	const __m128 vMaxKnot = _mm_set1_ps( (float)( spline->numKnots - 1 ) );
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	const __m128 vTwo = _mm_set1_ps( 2.0f );
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const __m128 scaledValue = _mm_mul_ps( vMaxKnot, _mm_loadu_ps( values + i ) );
+		// Clamping before truncation is the same as flooring and then clamping.
+		const __m128i k = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( scaledValue, vZero ), vMaxKnot ) );
+		const __m128 t = _mm_sub_ps( scaledValue, _mm_cvtepi32_ps( k ) );
+
+		// No gather before AVX2.
+		int ks[4];
+		_mm_storeu_si128( (__m128i *)ks, k );
+		const __m128 p0 = _mm_setr_ps( spline->p0[ks[0]], spline->p0[ks[1]], spline->p0[ks[2]], spline->p0[ks[3]] );
+		const __m128 m0 = _mm_setr_ps( spline->m0[ks[0]], spline->m0[ks[1]], spline->m0[ks[2]], spline->m0[ks[3]] );
+		const __m128 p1 = _mm_setr_ps( spline->p1[ks[0]], spline->p1[ks[1]], spline->p1[ks[2]], spline->p1[ks[3]] );
+		const __m128 m1 = _mm_setr_ps( spline->m1[ks[0]], spline->m1[ks[1]], spline->m1[ks[2]], spline->m1[ks[3]] );
+
+		const __m128 omt = _mm_sub_ps( vOne, t );
+		const __m128 a = _mm_add_ps( _mm_mul_ps( p0, _mm_add_ps( vOne, _mm_mul_ps( vTwo, t ) ) ), _mm_mul_ps( m0, t ) );
+		const __m128 b = _mm_sub_ps( _mm_mul_ps( p1, _mm_add_ps( vOne, _mm_mul_ps( vTwo, omt ) ) ), _mm_mul_ps( m1, omt ) );
+		const __m128 res = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( a, omt ), omt ), _mm_mul_ps( _mm_mul_ps( b, t ), t ) );
+		_mm_storeu_ps( results + i, res );
+	}
+	EvaluateBatchScalar( spline, values, results, i, count );
+}
+#endif
+
+#if defined( SPLINE_HAVE_AVX2 )
+// Compiled for AVX2 only (no FMA, which would change the rounding), and
+// only called after checking the CPU supports it.
+__attribute__(( target( "avx2" ) ))
+static void EvaluateBatchAVX2( const catmull_rom_spline_t * spline, const float * values, float * results, const int count )
+{
+	const __m256 vMaxKnot = _mm256_set1_ps( (float)( spline->numKnots - 1 ) );
+	const __m256 vZero = _mm256_setzero_ps();
+	const __m256 vOne = _mm256_set1_ps( 1.0f );
+	const __m256 vTwo = _mm256_set1_ps( 2.0f );
+
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		const __m256 scaledValue = _mm256_mul_ps( vMaxKnot, _mm256_loadu_ps( values + i ) );
+		const __m256i k = _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( scaledValue, vZero ), vMaxKnot ) );
+		const __m256 t = _mm256_sub_ps( scaledValue, _mm256_cvtepi32_ps( k ) );
+
+		const __m256 p0 = _mm256_i32gather_ps( spline->p0, k, 4 );
+		const __m256 m0 = _mm256_i32gather_ps( spline->m0, k, 4 );
+		const __m256 p1 = _mm256_i32gather_ps( spline->p1, k, 4 );
+		const __m256 m1 = _mm256_i32gather_ps( spline->m1, k, 4 );
+
+		const __m256 omt = _mm256_sub_ps( vOne, t );
+		const __m256 a = _mm256_add_ps( _mm256_mul_ps( p0, _mm256_add_ps( vOne, _mm256_mul_ps( vTwo, t ) ) ), _mm256_mul_ps( m0, t ) );
+		const __m256 b = _mm256_sub_ps( _mm256_mul_ps( p1, _mm256_add_ps( vOne, _mm256_mul_ps( vTwo, omt ) ) ), _mm256_mul_ps( m1, omt ) );
+		const __m256 res = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( a, omt ), omt ), _mm256_mul_ps( _mm256_mul_ps( b, t ), t ) );
+		_mm256_storeu_ps( results + i, res );
+	}
+	EvaluateBatchScalar( spline, values, results, i, count );
+}
+#endif
+
+void CatmullRomSpline_EvaluateBatch( const catmull_rom_spline_t * spline, const float * values, float * results,
+									 const int count, const simd_path_t simd )
+{
+	const simd_path_t path = ( simd == SIMD_PATH_BEST ) ? Simd_GetBestPath() : simd;
+#if defined( SPLINE_HAVE_AVX2 )
+	if ( path == SIMD_PATH_AVX2 && Simd_GetBestPath() == SIMD_PATH_AVX2 )
+	{
+		EvaluateBatchAVX2( spline, values, results, count );
+		return;
+	}
+#endif
+#if defined( __SSE2__ )
+	if ( path != SIMD_PATH_SCALAR )
+	{
+		EvaluateBatchSSE2( spline, values, results, count );
+		return;
+	}
+#endif
+	EvaluateBatchScalar( spline, values, results, 0, count );
+}
@@ -0,0 +1,38 @@
+#ifndef _SPLINE_H
+#define _SPLINE_H
+
+#include "simd.h"
+
+// Batch evaluation of the lens distortion Catmull-Rom spline.
+//
+// EvaluateCatmullRomSpline() picks one of four cases for the end tangents
+// from the knot index. Here those cases are resolved once, up front, into a
+// table of Hermite segments {p0, m0, p1, m1} padded to a power of two, so
+// evaluating a value is a clamp, a table lookup and the cubic: no branches,
+// four or eight values at a time. The segment math and the cubic are the
+// scalar function's, operation for operation (no FMA), so the batch results
+// are bit identical to EvaluateCatmullRomSpline().
+
+#define MAX_SPLINE_SEGMENTS		16
+
+typedef struct
+{
+	int		numKnots;
+	float	p0[MAX_SPLINE_SEGMENTS];
+	float	m0[MAX_SPLINE_SEGMENTS];
+	float	p1[MAX_SPLINE_SEGMENTS];
+	float	m1[MAX_SPLINE_SEGMENTS];
+} catmull_rom_spline_t;
+
+// Build the segment table for the knots K[0] .. K[numKnots-1], evenly spaced from 0.0 to 1.0.
+// Fails if numKnots is outside 3 .. MAX_SPLINE_SEGMENTS.
+bool CatmullRomSpline_Create( catmull_rom_spline_t * spline, const float * K, const int numKnots );
+
+// results[i] = EvaluateCatmullRomSpline( values[i], K, numKnots ) for i < count.
+void CatmullRomSpline_EvaluateBatch( const catmull_rom_spline_t * spline, const float * values, float * results,
+									 const int count, const simd_path_t simd = SIMD_PATH_BEST );
+
+// One value and its derivative with respect to value, for Newton iterations on the spline.
+void CatmullRomSpline_EvaluateDerivative( const catmull_rom_spline_t * spline, const float value, float * result, float * derivative );
+
+#endif
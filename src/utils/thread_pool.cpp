@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int numThreads)
+	: currentJob(NULL), jobCount(0), nextJob(0), busyWorkers(0), generation(0), quit(false)
+{
+	if (numThreads <= 0) {
+		numThreads = (int)std::thread::hardware_concurrency();
+		if (numThreads <= 0)
+			numThreads = 1;
+	}
+	threadCount = numThreads;
+
+	for (int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& job)
+{
+	if (count <= 0)
+		return;
+
+	// Nothing to share, skip the wake-up round trip.
+	if (workers.empty() || count == 1) {
+		for (int i = 0; i < count; i++)
+			job(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		currentJob = &job;
+		jobCount = count;
+		nextJob.store(0);
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	runJobs();
+
+	// The job object lives on the caller's stack, so every worker
+	// has to be out of runJobs() before we can return.
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]() { return busyWorkers == 0; });
+	currentJob = NULL;
+}
+
+void ThreadPool::runJobs()
+{
+	for (;;) {
+		const int index = nextJob.fetch_add(1);
+		if (index >= jobCount)
+			break;
+		(*currentJob)(index);
+	}
+}
+
+void ThreadPool::workerLoop()
+{
+	unsigned seenGeneration = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return quit || generation != seenGeneration; });
+			if (quit)
+				return;
+			seenGeneration = generation;
+		}
+
+		runJobs();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busyWorkers == 0)
+			done.notify_one();
+	}
+}
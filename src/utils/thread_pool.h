@@ -0,0 +1,45 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed-size pool for data-parallel loops.
+//
+// parallelFor() hands out job indices from a shared counter, so callers split
+// their work into more jobs than threads (scanline bands, mesh rows...) and the
+// pool load balances them. The calling thread works too, so a pool of N
+// threads spawns N - 1 workers, and a pool of 1 runs everything inline.
+class ThreadPool
+{
+public:
+	ThreadPool(int numThreads = 0);             // 0 = one thread per hardware thread
+	~ThreadPool();
+
+	int  getThreadCount() const { return threadCount; }
+
+	// Run job(index) for every index in [0, count) and wait for all of them.
+	void parallelFor(int count, const std::function<void(int)>& job);
+
+private:
+	void workerLoop();
+	void runJobs();
+
+	int                             threadCount;
+	std::vector<std::thread>        workers;
+	std::mutex                      mutex;
+	std::condition_variable         wake;
+	std::condition_variable         done;
+	const std::function<void(int)>* currentJob;
+	int                             jobCount;
+	std::atomic<int>                nextJob;
+	int                             busyWorkers;
+	unsigned                        generation;
+	bool                            quit;
+};
+
+#endif
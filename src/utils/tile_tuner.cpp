@@ -0,0 +1,164 @@
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "tile_tuner.h"
+
+void TileTuner_SetTileSize( hmd_info_t * hmdInfo, const int tilePixelsWide, const int tilePixelsHigh )
+{
+	// The same pixel pitch, whatever part of the display the tiles cover.
+	const float metersPerPixelWide = hmdInfo->visibleMetersWide / hmdInfo->visiblePixelsWide;
+	const float metersPerPixelHigh = hmdInfo->visibleMetersHigh / hmdInfo->visiblePixelsHigh;
+
+	hmdInfo->tilePixelsWide = tilePixelsWide;
+	hmdInfo->tilePixelsHigh = tilePixelsHigh;
+	hmdInfo->eyeTilesWide = hmdInfo->displayPixelsWide / tilePixelsWide / NUM_EYES;
+	hmdInfo->eyeTilesHigh = hmdInfo->displayPixelsHigh / tilePixelsHigh;
+	hmdInfo->visiblePixelsWide = hmdInfo->eyeTilesWide * tilePixelsWide * NUM_EYES;
+	hmdInfo->visiblePixelsHigh = hmdInfo->eyeTilesHigh * tilePixelsHigh;
+	hmdInfo->visibleMetersWide = metersPerPixelWide * hmdInfo->visiblePixelsWide;
+	hmdInfo->visibleMetersHigh = metersPerPixelHigh * hmdInfo->visiblePixelsHigh;
+}
+
+static bool FewerVertices( const tile_candidate_t & a, const tile_candidate_t & b )
+{
+	if ( a.numVertices != b.numVertices )
+	{
+		return a.numVertices < b.numVertices;
+	}
+	return a.tilePixelsWide > b.tilePixelsWide;
+}
+
+int TileTuner_GetCandidates( const hmd_info_t * hmdInfo, const int minPixels, const int maxPixels,
+							 tile_candidate_t * candidates, const int maxCandidates )
+{
+	const int eyePixelsWide = hmdInfo->displayPixelsWide / NUM_EYES;
+	const int eyePixelsHigh = hmdInfo->displayPixelsHigh;
+	int count = 0;
+	for ( int w = minPixels; w <= maxPixels; w++ )
+	{
+		if ( eyePixelsWide % w != 0 )
+		{
+			continue;
+		}
+		for ( int h = minPixels; h <= maxPixels && count < maxCandidates; h++ )
+		{
+			if ( eyePixelsHigh % h != 0 || w > 2 * h || h > 2 * w )
+			{
+				continue;
+			}
+			tile_candidate_t * candidate = &candidates[count++];
+			candidate->tilePixelsWide = w;
+			candidate->tilePixelsHigh = h;
+			candidate->numVertices = ( eyePixelsWide / w + 1 ) * ( eyePixelsHigh / h + 1 );
+			candidate->maxError = 0.0f;
+			candidate->meanError = 0.0f;
+		}
+	}
+	std::sort( candidates, candidates + count, FewerVertices );
+	return count;
+}
+
+// Points per EvaluateDistortionPoints() call.
+static const int CORNER_CHUNK_SIZE = 64;
+
+void TileTuner_MeasureError( ThreadPool * pool, const hmd_info_t * hmdInfo, const distortion_lut_t * exact,
+							 const float uvToPixels[2], tile_candidate_t * candidate )
+{
+	hmd_info_t tiled = *hmdInfo;
+	TileTuner_SetTileSize( &tiled, candidate->tilePixelsWide, candidate->tilePixelsHigh );
+	const int tilesWide = tiled.eyeTilesWide;
+	const int tilesHigh = tiled.eyeTilesHigh;
+	const int stride = tilesWide + 1;
+
+	// The mesh vertices, as BuildDistortionMeshes() places them.
+	std::vector<mesh_coord2d_t> corners[NUM_EYES];
+	for ( int eye = 0; eye < NUM_EYES; eye++ )
+	{
+		corners[eye].resize( (size_t)stride * ( tilesHigh + 1 ) * NUM_COLOR_CHANNELS );
+		float xfs[CORNER_CHUNK_SIZE];
+		float yfs[CORNER_CHUNK_SIZE];
+		mesh_coord2d_t uvs[CORNER_CHUNK_SIZE][NUM_COLOR_CHANNELS];
+		for ( int y = 0; y <= tilesHigh; y++ )
+		{
+			for ( int x0 = 0; x0 <= tilesWide; x0 += CORNER_CHUNK_SIZE )
+			{
+				const int count = ( stride - x0 < CORNER_CHUNK_SIZE ) ? stride - x0 : CORNER_CHUNK_SIZE;
+				for ( int i = 0; i < count; i++ )
+				{
+					xfs[i] = (float)( x0 + i ) / (float)tilesWide;
+					yfs[i] = 1.0f - (float)y / (float)tilesHigh;
+				}
+				EvaluateDistortionPoints( &tiled, eye, xfs, yfs, count, uvs );
+				for ( int i = 0; i < count; i++ )
+				{
+					for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+					{
+						corners[eye][( (size_t)y * stride + x0 + i ) * NUM_COLOR_CHANNELS + channel] = uvs[i][channel];
+					}
+				}
+			}
+		}
+	}
+
+	// One display row per job; the table's rows run bottom to top.
+	const int eyePixelsWide = tilesWide * tiled.tilePixelsWide;
+	const int meshPixelsHigh = tilesHigh * tiled.tilePixelsHigh;
+	std::vector<float> rowMax( exact->height, 0.0f );
+	std::vector<double> rowSum( exact->height, 0.0 );
+	pool->parallelFor( meshPixelsHigh, [&]( int y )
+	{
+		const int row = exact->height - 1 - y;
+		const float fy = ( y + 0.5f ) / tiled.tilePixelsHigh;
+		const int ty = (int)fy;
+		const float t = fy - ty;
+		float maxErrorSq = 0.0f;
+		double sum = 0.0;
+		for ( int eye = 0; eye < NUM_EYES; eye++ )
+		{
+			for ( int x = 0; x < eyePixelsWide; x++ )
+			{
+				const float fx = ( x + 0.5f ) / tiled.tilePixelsWide;
+				const int tx = (int)fx;
+				const float s = fx - tx;
+				const mesh_coord2d_t * tl = &corners[eye][( (size_t)ty * stride + tx ) * NUM_COLOR_CHANNELS];
+				const mesh_coord2d_t * tr = tl + NUM_COLOR_CHANNELS;
+				const mesh_coord2d_t * bl = tl + stride * NUM_COLOR_CHANNELS;
+				const mesh_coord2d_t * br = bl + NUM_COLOR_CHANNELS;
+
+				for ( int channel = 0; channel < NUM_COLOR_CHANNELS; channel++ )
+				{
+					// Triangle {TL, BL, TR} or {TR, BL, BR}, as in MeasureDistortionCellError().
+					float u, v;
+					if ( s + t <= 1.0f )
+					{
+						u = tl[channel].x + s * ( tr[channel].x - tl[channel].x ) + t * ( bl[channel].x - tl[channel].x );
+						v = tl[channel].y + s * ( tr[channel].y - tl[channel].y ) + t * ( bl[channel].y - tl[channel].y );
+					}
+					else
+					{
+						u = br[channel].x + ( 1.0f - s ) * ( bl[channel].x - br[channel].x ) + ( 1.0f - t ) * ( tr[channel].x - br[channel].x );
+						v = br[channel].y + ( 1.0f - s ) * ( bl[channel].y - br[channel].y ) + ( 1.0f - t ) * ( tr[channel].y - br[channel].y );
+					}
+					const float * uv = (const float *)exact->uvs + ( ( (size_t)channel * exact->height + row ) * exact->width + eye * eyePixelsWide + x ) * 2;
+					const float du = ( uv[0] - u ) * uvToPixels[0];
+					const float dv = ( uv[1] - v ) * uvToPixels[1];
+					const float errorSq = du * du + dv * dv;
+					maxErrorSq = ( errorSq > maxErrorSq ) ? errorSq : maxErrorSq;
+					sum += sqrtf( errorSq );
+				}
+			}
+		}
+		rowMax[row] = sqrtf( maxErrorSq );
+		rowSum[row] = sum;
+	} );
+
+	float maxError = 0.0f;
+	double sum = 0.0;
+	for ( int row = 0; row < exact->height; row++ )
+	{
+		maxError = ( rowMax[row] > maxError ) ? rowMax[row] : maxError;
+		sum += rowSum[row];
+	}
+	candidate->maxError = maxError;
+	candidate->meanError = (float)( sum / ( (double)NUM_EYES * eyePixelsWide * meshPixelsHigh * NUM_COLOR_CHANNELS ) );
+}
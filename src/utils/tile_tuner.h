@@ -0,0 +1,43 @@
+#ifndef _TILE_TUNER_H
+#define _TILE_TUNER_H
+
+#include "hmd.h"
+#include "thread_pool.h"
+#include "distortion_lut.h"
+
+// Tile size tuning for the uniform distortion mesh.
+//
+// Coarser tiles leave the warp fewer vertices to transform, but interpolate
+// the distortion linearly over a larger area. The tuner measures that error
+// exactly: the interpolated UVs of every display pixel the mesh covers
+// against the per-pixel mapping of a float distortion LUT. Only tilings
+// whose tiles divide the eye evenly are candidates, so the visible area,
+// and with it the exact mapping, is the same for all of them. Timing the
+// warp of each candidate is up to the caller, which has the GL context.
+
+#define TILE_TUNER_MAX_CANDIDATES		256
+
+typedef struct
+{
+	int		tilePixelsWide;
+	int		tilePixelsHigh;
+	int		numVertices;			// per eye
+	float	maxError;				// eye buffer pixels, worst color channel
+	float	meanError;				// eye buffer pixels, over all pixels and color channels
+} tile_candidate_t;
+
+// Retile hmdInfo, keeping the physical size of its display.
+void TileTuner_SetTileSize( hmd_info_t * hmdInfo, const int tilePixelsWide, const int tilePixelsHigh );
+
+// Tilings of hmdInfo's display with tile edges of minPixels to maxPixels,
+// no more than 2:1, that divide an eye evenly. Sorted by vertex count,
+// coarsest first. Returns the number of candidates.
+int TileTuner_GetCandidates( const hmd_info_t * hmdInfo, const int minPixels, const int maxPixels,
+							 tile_candidate_t * candidates, const int maxCandidates );
+
+// Fill in the error of candidate's tiling of hmdInfo. exact is a
+// DISTORTION_LUT_FLOAT table of the display generated for any candidate.
+void TileTuner_MeasureError( ThreadPool * pool, const hmd_info_t * hmdInfo, const distortion_lut_t * exact,
+							 const float uvToPixels[2], tile_candidate_t * candidate );
+
+#endif
@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include "timewarp_arena.h"
+
+// Every array starts on its own cache line.
+static const size_t ARENA_ALIGNMENT = 64;
+
+static size_t AlignUp(size_t size)
+{
+	return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+TimewarpArena::TimewarpArena()
+	: block(NULL), capacity(0), allocationCount(0), vertices(NULL), indices(NULL), scratch(NULL),
+	  stagingFlags(0), indices16(NULL), compactVertices(NULL)
+{
+}
+
+TimewarpArena::~TimewarpArena()
+{
+	release();
+}
+
+bool TimewarpArena::carve(size_t numVertices, size_t numIndices, size_t numScratchCoords, bool mesh)
+{
+	const bool wantIndices16 = (stagingFlags & ARENA_STAGING_INDICES16) != 0 && numVertices <= 65536;
+	const bool wantCompact = (stagingFlags & ARENA_STAGING_COMPACT) != 0;
+	const size_t verticesSize = mesh ? AlignUp(NUM_EYES * numVertices * sizeof(distortion_vertex_t)) : 0;
+	const size_t indicesSize = mesh ? AlignUp(numIndices * sizeof(GLuint)) : 0;
+	const size_t scratchSize = AlignUp(numScratchCoords * sizeof(mesh_coord2d_t));
+	const size_t indices16Size = wantIndices16 ? AlignUp(numIndices * sizeof(GLushort)) : 0;
+	const size_t compactSize = wantCompact ? AlignUp(NUM_EYES * numVertices * sizeof(distortion_vertex_compact_t)) : 0;
+	const size_t size = verticesSize + indicesSize + scratchSize + indices16Size + compactSize;
+
+	if (size > capacity) {
+		release();
+		void* memory = NULL;
+		if (posix_memalign(&memory, ARENA_ALIGNMENT, size) != 0)
+			return false;
+		block = (unsigned char*)memory;
+		capacity = size;
+		allocationCount++;
+	}
+
+	unsigned char* next = block;
+	vertices = mesh ? (distortion_vertex_t*)next : NULL;
+	next += verticesSize;
+	indices = mesh ? (GLuint*)next : NULL;
+	next += indicesSize;
+	scratch = (numScratchCoords > 0) ? (mesh_coord2d_t*)next : NULL;
+	next += scratchSize;
+	indices16 = wantIndices16 ? (GLushort*)next : NULL;
+	next += indices16Size;
+	compactVertices = wantCompact ? (distortion_vertex_compact_t*)next : NULL;
+	return true;
+}
+
+bool TimewarpArena::reserve(size_t numVertices, size_t numIndices, size_t numScratchCoords)
+{
+	return carve(numVertices, numIndices, numScratchCoords, true);
+}
+
+bool TimewarpArena::reserveStaging(size_t numVertices, size_t numIndices)
+{
+	return carve(numVertices, numIndices, 0, false);
+}
+
+bool TimewarpArena::reserveUniform(int eyeTilesWide, int eyeTilesHigh)
+{
+	const size_t numVertices = (size_t)(eyeTilesWide + 1) * (eyeTilesHigh + 1);
+	const size_t numIndices = (size_t)eyeTilesWide * eyeTilesHigh * 6;
+	return reserve(numVertices, numIndices, NUM_EYES * NUM_COLOR_CHANNELS * numVertices);
+}
+
+void TimewarpArena::release()
+{
+	free(block);
+	block = NULL;
+	capacity = 0;
+	vertices = NULL;
+	indices = NULL;
+	scratch = NULL;
+	indices16 = NULL;
+	compactVertices = NULL;
+}
@@ -0,0 +1,70 @@
+#ifndef _TIMEWARP_ARENA_H
+#define _TIMEWARP_ARENA_H
+
+#include <stddef.h>
+#include "hmd.h"
+#include "compact_mesh.h"
+
+// Upload staging that reserve() carves out of the block after the mesh.
+enum
+{
+	ARENA_STAGING_INDICES16	= 1,	// 16-bit copy of the indices, when one eye has at most 65536 vertices
+	ARENA_STAGING_COMPACT	= 2		// compact copy of both eyes' vertices
+};
+
+// One block for all the CPU-side data of a timewarp mesh build.
+//
+// BuildTimewarp() needs the index array, both eyes' interleaved vertices and
+// per eye, per color channel UV scratch for BuildDistortionMeshes(). Their
+// sizes follow from the tile counts, so reserve() carves all three out of a
+// single allocation, keeping the block when a rebuild fits in it. The
+// staging arrays the upload converts the mesh into, set with setStaging(),
+// come out of the same block. The arena owns the mesh: release() (or the
+// destructor) frees it, once the GPU has its copy and nothing on the CPU
+// reads it any more.
+class TimewarpArena
+{
+public:
+	TimewarpArena();
+	~TimewarpArena();
+
+	// Room for numVertices vertices per eye, numIndices indices and
+	// numScratchCoords UV coordinates, plus the staging for that mesh. The
+	// previous contents are lost.
+	bool reserve(size_t numVertices, size_t numIndices, size_t numScratchCoords);
+	// The same for the uniform mesh of eyeTilesWide x eyeTilesHigh tiles.
+	bool reserveUniform(int eyeTilesWide, int eyeTilesHigh);
+	// Only the staging, for a mesh that lives elsewhere (built in, mapped).
+	bool reserveStaging(size_t numVertices, size_t numIndices);
+	void release();
+
+	// ARENA_STAGING_* flags for the following reserves.
+	void                 setStaging(int flags) { stagingFlags = flags; }
+
+	bool                 isEmpty() const { return block == NULL; }
+	distortion_vertex_t* getVertices() const { return vertices; }
+	GLuint*              getIndices() const { return indices; }
+	mesh_coord2d_t*      getScratch() const { return scratch; }
+	GLushort*            getIndices16() const { return indices16; }
+	distortion_vertex_compact_t* getCompactVertices() const { return compactVertices; }
+	size_t               getCapacity() const { return capacity; }
+	int                  getAllocationCount() const { return allocationCount; }   // over the arena's lifetime
+
+private:
+	TimewarpArena(const TimewarpArena&);                // not copyable: it owns the block
+	TimewarpArena& operator=(const TimewarpArena&);
+
+	bool                 carve(size_t numVertices, size_t numIndices, size_t numScratchCoords, bool mesh);
+
+	unsigned char*       block;
+	size_t               capacity;
+	int                  allocationCount;
+	distortion_vertex_t* vertices;
+	GLuint*              indices;
+	mesh_coord2d_t*      scratch;
+	int                  stagingFlags;
+	GLushort*            indices16;
+	distortion_vertex_compact_t* compactVertices;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include <math.h>
+#include "timewarp_transform.h"
+#include "algebra_simd.h"
+
+void CalculateTimeWarpTransform( ksMatrix4x4f * transform, const ksMatrix4x4f * renderProjectionMatrix,
+								 const ksMatrix4x4f * renderViewMatrix, const ksMatrix4x4f * newViewMatrix )
+{
+	// Convert the projection matrix from [-1, 1] space to [0, 1] space.
+	const ksMatrix4x4f texCoordProjection =
+	{ {
+		{ 0.5f * renderProjectionMatrix->m[0][0],        0.0f,                                           0.0f,  0.0f },
+		{ 0.0f,                                          0.5f * renderProjectionMatrix->m[1][1],         0.0f,  0.0f },
+		{ 0.5f * renderProjectionMatrix->m[2][0] - 0.5f, 0.5f * renderProjectionMatrix->m[2][1] - 0.5f, -1.0f,  0.0f },
+		{ 0.0f,                                          0.0f,                                           0.0f,  1.0f }
+	} };
+
+	// Calculate the delta between the view matrix used for rendering and
+	// a more recent or predicted view matrix based on new sensor input.
+	ksMatrix4x4f inverseRenderViewMatrix;
+	ksMatrix4x4f_InvertHomogeneousSimd( &inverseRenderViewMatrix, renderViewMatrix );
+
+	ksMatrix4x4f deltaViewMatrix;
+	ksMatrix4x4f_MultiplySimd( &deltaViewMatrix, &inverseRenderViewMatrix, newViewMatrix );
+
+	ksMatrix4x4f inverseDeltaViewMatrix;
+	ksMatrix4x4f_InvertHomogeneousSimd( &inverseDeltaViewMatrix, &deltaViewMatrix );
+
+	// Make the delta rotation only.
+	inverseDeltaViewMatrix.m[3][0] = 0.0f;
+	inverseDeltaViewMatrix.m[3][1] = 0.0f;
+	inverseDeltaViewMatrix.m[3][2] = 0.0f;
+
+	// Accumulate the transforms.
+	ksMatrix4x4f_MultiplySimd( transform, &texCoordProjection, &inverseDeltaViewMatrix );
+}
+
+void CalculateRotationTimeWarpTransform( ksMatrix3x4f * transform, const ksMatrix4x4f * renderProjectionMatrix,
+										 const ksQuatf * renderOrientation, const ksQuatf * newOrientation )
+{
+	// The rotation part of inverse( inverse( render ) * new ) is conj( new ) * render.
+	const ksQuatf conjugate = { -newOrientation->x, -newOrientation->y, -newOrientation->z, newOrientation->w };
+	ksQuatf delta;
+	MultiplyQuaternions( &delta, &conjugate, renderOrientation );
+
+	// Its rotation matrix, as ksMatrix4x4f_CreateFromQuaternion(), rotation[column][row].
+	const float x2 = delta.x + delta.x;
+	const float y2 = delta.y + delta.y;
+	const float z2 = delta.z + delta.z;
+	const float xx2 = delta.x * x2;
+	const float yy2 = delta.y * y2;
+	const float zz2 = delta.z * z2;
+	const float yz2 = delta.y * z2;
+	const float wx2 = delta.w * x2;
+	const float xy2 = delta.x * y2;
+	const float wz2 = delta.w * z2;
+	const float xz2 = delta.x * z2;
+	const float wy2 = delta.w * y2;
+	const float rotation[3][3] =
+	{
+		{ 1.0f - yy2 - zz2, xy2 + wz2, xz2 - wy2 },
+		{ xy2 - wz2, 1.0f - xx2 - zz2, yz2 + wx2 },
+		{ xz2 + wy2, yz2 - wx2, 1.0f - xx2 - yy2 }
+	};
+
+	// The texture coordinate projection of CalculateTimeWarpTransform() only
+	// has these entries, and its last column is ( 0, 0, 0, 1 ).
+	const float p00 = 0.5f * renderProjectionMatrix->m[0][0];
+	const float p11 = 0.5f * renderProjectionMatrix->m[1][1];
+	const float p20 = 0.5f * renderProjectionMatrix->m[2][0] - 0.5f;
+	const float p21 = 0.5f * renderProjectionMatrix->m[2][1] - 0.5f;
+
+	// The rows of projection * rotation, as ksMatrix3x4f_CreateFromMatrix4x4f().
+	for ( int c = 0; c < 3; c++ )
+	{
+		transform->m[0][c] = p00 * rotation[c][0] + p20 * rotation[c][2];
+		transform->m[1][c] = p11 * rotation[c][1] + p21 * rotation[c][2];
+		transform->m[2][c] = -rotation[c][2];
+	}
+	transform->m[0][3] = 0.0f;
+	transform->m[1][3] = 0.0f;
+	transform->m[2][3] = 0.0f;
+}
+
+void CreateRotationQuaternion( ksQuatf * result, const float degreesX, const float degreesY, const float degreesZ )
+{
+	// Half angles about each axis, composed in the order Z * Y * X of ksMatrix4x4f_CreateRotation().
+	const float halfRadians = 0.5f * ( MATH_PI / 180.0f );
+	const ksQuatf rotationX = { sinf( degreesX * halfRadians ), 0.0f, 0.0f, cosf( degreesX * halfRadians ) };
+	const ksQuatf rotationY = { 0.0f, sinf( degreesY * halfRadians ), 0.0f, cosf( degreesY * halfRadians ) };
+	const ksQuatf rotationZ = { 0.0f, 0.0f, sinf( degreesZ * halfRadians ), cosf( degreesZ * halfRadians ) };
+	ksQuatf rotationYX;
+	MultiplyQuaternions( &rotationYX, &rotationY, &rotationX );
+	MultiplyQuaternions( result, &rotationZ, &rotationYX );
+}
+
+void MultiplyQuaternions( ksQuatf * result, const ksQuatf * a, const ksQuatf * b )
+{
+	const float x = a->w * b->x + a->x * b->w + a->y * b->z - a->z * b->y;
+	const float y = a->w * b->y - a->x * b->z + a->y * b->w + a->z * b->x;
+	const float z = a->w * b->z + a->x * b->y - a->y * b->x + a->z * b->w;
+	const float w = a->w * b->w - a->x * b->x - a->y * b->y - a->z * b->z;
+	result->x = x;
+	result->y = y;
+	result->z = z;
+	result->w = w;
+}
+
+void SlerpQuaternions( ksQuatf * result, const ksQuatf * a, const ksQuatf * b, const float fraction )
+{
+	const float cosAngle = a->x * b->x + a->y * b->y + a->z * b->z + a->w * b->w;
+	const float absCosAngle = fabsf( cosAngle );
+
+	// Nearly the same rotation: the weights would divide by almost zero, and lerp is exact enough.
+	if ( absCosAngle > 0.9999f )
+	{
+		ksQuatf_Lerp( result, a, b, fraction );
+		return;
+	}
+
+	const float angle = acosf( absCosAngle );
+	const float rcpSinAngle = 1.0f / sinf( angle );
+	const float fa = sinf( ( 1.0f - fraction ) * angle ) * rcpSinAngle;
+	const float fb = sinf( fraction * angle ) * rcpSinAngle * ( ( cosAngle < 0.0f ) ? -1.0f : 1.0f );
+	result->x = a->x * fa + b->x * fb;
+	result->y = a->y * fa + b->y * fb;
+	result->z = a->z * fa + b->z * fb;
+	result->w = a->w * fa + b->w * fb;
+}
@@ -0,0 +1,37 @@
+#ifndef _TIMEWARP_TRANSFORM_H
+#define _TIMEWARP_TRANSFORM_H
+
+#include "algebra.h"
+
+// Timewarp transforms: the eye buffer texture-space projection of the
+// rotation between the view the frame was rendered with and a newer
+// (predicted) one.
+//
+// CalculateTimeWarpTransform() takes full view matrices: it inverts the
+// render view, multiplies in the new one, inverts the delta and then drops
+// its translation. When the poses are orientations only, that is the rotation
+// conj( new ) * render, so CalculateRotationTimeWarpTransform() does one
+// quaternion product and writes the 3x4 shader transform straight from it,
+// using the sparsity of the projection. It agrees with the matrix path to
+// float rounding (see --benchmark=rotation-timewarp).
+
+void CalculateTimeWarpTransform( ksMatrix4x4f * transform, const ksMatrix4x4f * renderProjectionMatrix,
+								 const ksMatrix4x4f * renderViewMatrix, const ksMatrix4x4f * newViewMatrix );
+
+// The orientations are unit quaternions with view matrices
+// ksMatrix4x4f_CreateFromQuaternion( orientation ).
+void CalculateRotationTimeWarpTransform( ksMatrix3x4f * transform, const ksMatrix4x4f * renderProjectionMatrix,
+										 const ksQuatf * renderOrientation, const ksQuatf * newOrientation );
+
+// The orientation of ksMatrix4x4f_CreateRotation( degreesX, degreesY, degreesZ ).
+void CreateRotationQuaternion( ksQuatf * result, const float degreesX, const float degreesY, const float degreesZ );
+
+// result = a * b, the rotation b followed by a.
+void MultiplyQuaternions( ksQuatf * result, const ksQuatf * a, const ksQuatf * b );
+
+// Spherical interpolation of unit quaternions, along the shorter arc. Unlike
+// ksQuatf_Lerp() it turns at a constant rate, which matters once a and b are
+// more than a few degrees apart.
+void SlerpQuaternions( ksQuatf * result, const ksQuatf * a, const ksQuatf * b, const float fraction );
+
+#endif
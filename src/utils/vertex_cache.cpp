@@ -0,0 +1,216 @@
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "vertex_cache.h"
+
+// Scoring constants from the paper.
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+typedef struct
+{
+	int		cachePosition;			// -1 when not in the simulated cache
+	int		remainingTriangles;		// not yet emitted triangles using this vertex
+	int		firstTriangle;			// into the vertex -> triangle adjacency list
+	int		numTriangles;
+	float	score;
+} cache_vertex_t;
+
+static float VertexScore( const cache_vertex_t * vertex )
+{
+	if ( vertex->remainingTriangles == 0 )
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if ( vertex->cachePosition >= 0 )
+	{
+		if ( vertex->cachePosition < 3 )
+		{
+			// Used by the triangle just emitted: fixed score, so the next
+			// triangle does not simply repeat its best two vertices.
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			const float scaler = 1.0f / ( VERTEX_CACHE_SIZE - 3 );
+			score = powf( 1.0f - ( vertex->cachePosition - 3 ) * scaler, CACHE_DECAY_POWER );
+		}
+	}
+
+	// Boost vertices with few triangles left, so they get finished off
+	// instead of being left behind as isolated triangles.
+	score += VALENCE_BOOST_SCALE * powf( (float)vertex->remainingTriangles, -VALENCE_BOOST_POWER );
+	return score;
+}
+
+void OptimizeVertexCache( GLuint * indices, const int numIndices, const int numVertices )
+{
+	const int numTriangles = numIndices / 3;
+	if ( numTriangles == 0 )
+	{
+		return;
+	}
+
+	// Vertex -> triangle adjacency.
+	std::vector<cache_vertex_t> vertices( numVertices );
+	memset( vertices.data(), 0, numVertices * sizeof( cache_vertex_t ) );
+	for ( int i = 0; i < numTriangles * 3; i++ )
+	{
+		vertices[indices[i]].numTriangles++;
+	}
+	int offset = 0;
+	for ( int v = 0; v < numVertices; v++ )
+	{
+		vertices[v].cachePosition = -1;
+		vertices[v].firstTriangle = offset;
+		vertices[v].remainingTriangles = vertices[v].numTriangles;
+		offset += vertices[v].numTriangles;
+		vertices[v].numTriangles = 0;
+	}
+	std::vector<int> adjacency( numTriangles * 3 );
+	for ( int t = 0; t < numTriangles; t++ )
+	{
+		for ( int c = 0; c < 3; c++ )
+		{
+			cache_vertex_t & vertex = vertices[indices[t * 3 + c]];
+			adjacency[vertex.firstTriangle + vertex.numTriangles++] = t;
+		}
+	}
+	for ( int v = 0; v < numVertices; v++ )
+	{
+		vertices[v].score = VertexScore( &vertices[v] );
+	}
+
+	std::vector<float> triangleScore( numTriangles );
+	std::vector<unsigned char> emitted( numTriangles, 0 );
+	for ( int t = 0; t < numTriangles; t++ )
+	{
+		triangleScore[t] = vertices[indices[t * 3 + 0]].score + vertices[indices[t * 3 + 1]].score + vertices[indices[t * 3 + 2]].score;
+	}
+
+	std::vector<GLuint> output( numTriangles * 3 );
+	int cache[VERTEX_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	int bestTriangle = -1;
+	int scanStart = 0;
+
+	for ( int emittedCount = 0; emittedCount < numTriangles; emittedCount++ )
+	{
+		if ( bestTriangle < 0 )
+		{
+			// Nothing in the cache has triangles left: take the best remaining one.
+			while ( emitted[scanStart] )
+			{
+				scanStart++;
+			}
+			bestTriangle = scanStart;
+			for ( int t = scanStart + 1; t < numTriangles; t++ )
+			{
+				if ( !emitted[t] && triangleScore[t] > triangleScore[bestTriangle] )
+				{
+					bestTriangle = t;
+				}
+			}
+		}
+
+		const GLuint * tri = &indices[bestTriangle * 3];
+		output[emittedCount * 3 + 0] = tri[0];
+		output[emittedCount * 3 + 1] = tri[1];
+		output[emittedCount * 3 + 2] = tri[2];
+		emitted[bestTriangle] = 1;
+
+		// Drop the triangle from its vertices' lists.
+		for ( int c = 0; c < 3; c++ )
+		{
+			cache_vertex_t & vertex = vertices[tri[c]];
+			int * list = &adjacency[vertex.firstTriangle];
+			for ( int i = 0; i < vertex.remainingTriangles; i++ )
+			{
+				if ( list[i] == bestTriangle )
+				{
+					list[i] = list[vertex.remainingTriangles - 1];
+					break;
+				}
+			}
+			vertex.remainingTriangles--;
+		}
+
+		// Move its vertices to the front of the LRU cache.
+		int newCache[VERTEX_CACHE_SIZE + 3];
+		int newCount = 0;
+		for ( int c = 0; c < 3; c++ )
+		{
+			newCache[newCount++] = (int)tri[c];
+		}
+		for ( int i = 0; i < cacheCount; i++ )
+		{
+			if ( cache[i] != (int)tri[0] && cache[i] != (int)tri[1] && cache[i] != (int)tri[2] )
+			{
+				newCache[newCount++] = cache[i];
+			}
+		}
+
+		// Rescore everything that moved in or out of the cache, and the triangles they touch.
+		for ( int i = 0; i < newCount; i++ )
+		{
+			cache_vertex_t & vertex = vertices[newCache[i]];
+			vertex.cachePosition = ( i < VERTEX_CACHE_SIZE ) ? i : -1;
+			const float newScore = VertexScore( &vertex );
+			const float delta = newScore - vertex.score;
+			vertex.score = newScore;
+
+			const int * list = &adjacency[vertex.firstTriangle];
+			for ( int j = 0; j < vertex.remainingTriangles; j++ )
+			{
+				triangleScore[list[j]] += delta;
+			}
+		}
+
+		// The next triangle is the best one with a vertex still in the cache.
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for ( int i = 0; i < newCount && i < VERTEX_CACHE_SIZE; i++ )
+		{
+			const cache_vertex_t & vertex = vertices[newCache[i]];
+			const int * list = &adjacency[vertex.firstTriangle];
+			for ( int j = 0; j < vertex.remainingTriangles; j++ )
+			{
+				if ( triangleScore[list[j]] > bestScore )
+				{
+					bestScore = triangleScore[list[j]];
+					bestTriangle = list[j];
+				}
+			}
+		}
+		cacheCount = ( newCount < VERTEX_CACHE_SIZE ) ? newCount : VERTEX_CACHE_SIZE;
+		memcpy( cache, newCache, cacheCount * sizeof( int ) );
+	}
+
+	memcpy( indices, output.data(), numTriangles * 3 * sizeof( GLuint ) );
+}
+
+float ComputeVertexCacheAcmr( const GLuint * indices, const int numIndices, const int numVertices, const int cacheSize )
+{
+	const int numTriangles = numIndices / 3;
+	if ( numTriangles == 0 )
+	{
+		return 0.0f;
+	}
+
+	// FIFO: a vertex counts as cached while fewer than cacheSize misses came after its own.
+	std::vector<int> missTime( numVertices, -cacheSize - 1 );
+	int misses = 0;
+	for ( int i = 0; i < numTriangles * 3; i++ )
+	{
+		if ( misses - missTime[indices[i]] > cacheSize )
+		{
+			missTime[indices[i]] = misses;
+			misses++;
+		}
+	}
+	return (float)misses / numTriangles;
+}
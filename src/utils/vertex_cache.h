@@ -0,0 +1,58 @@
+#ifndef _VERTEX_CACHE_H
+#define _VERTEX_CACHE_H
+
+#include <GL/gl.h>
+
+// Post-transform vertex cache optimization of triangle lists.
+//
+// The warp vertex shader is not cheap (three UVs through two 3x4 transforms
+// each), so every vertex the GPU has to shade again because it fell out of
+// the post-transform cache costs real warp time. A row-major grid loses
+// every vertex of the previous row before it gets back to it once the rows
+// are wider than the cache. A uniform grid is emitted in vertical strips
+// instead, which is cache friendly by construction and costs nothing; any
+// other mesh (the adaptive one) is reordered with Tom Forsyth's
+// "Linear-Speed Vertex Cache Optimisation".
+
+#define VERTEX_CACHE_SIZE				16		// post-transform cache entries the optimizer and ACMR assume
+
+// Vertical strips of this many tiles are emitted one after the other, so
+// the two vertex rows a strip row needs fit a VERTEX_CACHE_SIZE cache.
+#define VERTEX_CACHE_STRIP_TILES		7
+
+// The two triangles of every tile of a tilesWide x tilesHigh grid of
+// ( tilesWide + 1 ) vertices per row, in vertical strips. constexpr, so the
+// built-in meshes are emitted by the same code at compile time.
+static constexpr void BuildStripGridIndices( GLuint * indices, const int tilesWide, const int tilesHigh )
+{
+	int offset = 0;
+	for ( int x0 = 0; x0 < tilesWide; x0 += VERTEX_CACHE_STRIP_TILES )
+	{
+		const int x1 = ( x0 + VERTEX_CACHE_STRIP_TILES < tilesWide ) ? x0 + VERTEX_CACHE_STRIP_TILES : tilesWide;
+		for ( int y = 0; y < tilesHigh; y++ )
+		{
+			for ( int x = x0; x < x1; x++ )
+			{
+				indices[offset + 0] = (GLuint)( ( y + 0 ) * ( tilesWide + 1 ) + ( x + 0 ) );
+				indices[offset + 1] = (GLuint)( ( y + 1 ) * ( tilesWide + 1 ) + ( x + 0 ) );
+				indices[offset + 2] = (GLuint)( ( y + 0 ) * ( tilesWide + 1 ) + ( x + 1 ) );
+
+				indices[offset + 3] = (GLuint)( ( y + 0 ) * ( tilesWide + 1 ) + ( x + 1 ) );
+				indices[offset + 4] = (GLuint)( ( y + 1 ) * ( tilesWide + 1 ) + ( x + 0 ) );
+				indices[offset + 5] = (GLuint)( ( y + 1 ) * ( tilesWide + 1 ) + ( x + 1 ) );
+				offset += 6;
+			}
+		}
+	}
+}
+
+// Reorder the triangles of an indexed triangle list in place. The
+// triangles, their winding and the vertices are unchanged.
+void OptimizeVertexCache( GLuint * indices, const int numIndices, const int numVertices );
+
+// Average cache miss ratio: vertices shaded per triangle with a FIFO
+// post-transform cache of cacheSize entries. 0.5 is the ideal for a
+// large grid, 3.0 means no reuse at all.
+float ComputeVertexCacheAcmr( const GLuint * indices, const int numIndices, const int numVertices, const int cacheSize );
+
+#endif